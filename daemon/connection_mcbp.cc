@@ -429,9 +429,33 @@ McbpConnection::TransmitResult McbpConnection::transmit() {
     if (msgcurr < msglist.size()) {
         ssize_t res;
         struct msghdr* m = &msglist[msgcurr];
+        auto* sender = ssl.isEnabled() ? nullptr : getThread()->io_uring.get();
+
+        int error;
+        if (batchedSend == BatchedSendState::Completed) {
+            // Pick up the result of the send submitted by the thread (the
+            // thread may have stopped using io_uring since)
+            batchedSend = BatchedSendState::Idle;
+            if (batchedSendResult < 0) {
+                res = -1;
+                error = -batchedSendResult;
+            } else {
+                res = batchedSendResult;
+                error = 0;
+                totalSend += res;
+            }
+        } else if (sender == nullptr) {
+            res = sendmsg(m);
+            error = GetLastNetworkError();
+        } else {
+            if (batchedSend == BatchedSendState::Idle) {
+                sender->add(socketDescriptor, m, this);
+                batchedSend = BatchedSendState::Queued;
+                get_thread_stats(this)->iouring_sends++;
+            }
+            return TransmitResult::Queued;
+        }
 
-        res = sendmsg(m);
-        auto error = GetLastNetworkError();
         if (res > 0) {
             get_thread_stats(this)->bytes_written += res;
 
@@ -474,8 +498,10 @@ McbpConnection::TransmitResult McbpConnection::transmit() {
                            "%u: Failed to send data; peer closed the connection",
                            getId());
             } else {
-                log_socket_error(EXTENSION_LOG_WARNING, this,
-                                 "Failed to write, and not due to blocking: %s");
+                log_errcode_error(EXTENSION_LOG_WARNING,
+                                  this,
+                                  "Failed to write, and not due to blocking: %s",
+                                  error);
             }
         } else {
             // sendmsg should return the number of bytes written, but we
@@ -714,6 +740,17 @@ void McbpConnection::addIov(const void* buf, size_t len) {
     m->msg_iovlen++;
 }
 
+void McbpConnection::addValueIov(cb::const_char_buffer value,
+                                 bool zeroCopy) {
+    addIov(value.buf, value.len);
+    auto* ts = get_thread_stats(this);
+    if (zeroCopy) {
+        ts->bytes_get_zero_copy += value.len;
+    } else {
+        ts->bytes_get_copied += value.len;
+    }
+}
+
 void McbpConnection::ensureIovSpace() {
     if (iovused < iov.size()) {
         // There is still size in the list
@@ -1009,6 +1046,13 @@ bool McbpConnection::processServerEvents() {
     return getState() != before;
 }
 
+void McbpConnection::cancelBatchedSend() {
+    if (batchedSend == BatchedSendState::Queued) {
+        getThread()->io_uring->cancel(this);
+    }
+    batchedSend = BatchedSendState::Idle;
+}
+
 void McbpConnection::runEventLoop(short which) {
     conn_loan_buffers(this);
     currentEvent = which;
@@ -309,7 +309,9 @@ public:
         /** Can't write any more right now. */
             SoftError,
         /** Can't write (c->state is set to conn_closing) */
-            HardError
+            HardError,
+        /** The send is queued in the thread's io_uring batch */
+            Queued
     };
 
     /**
@@ -320,9 +322,26 @@ public:
      *   Incomplete More data remaining to write.
      *   SoftError Can't write any more right now.
      *   HardError Can't write (c->state is set to conn_closing)
+     *   Queued    The send is queued with the thread's IoUringSender; the
+     *             connection is resumed once the batch is submitted
      */
     TransmitResult transmit();
 
+    /**
+     * Store the result of the send previously queued with the thread's
+     * IoUringSender (number of bytes sent or -errno)
+     */
+    void setBatchedSendResult(int result) {
+        batchedSend = BatchedSendState::Completed;
+        batchedSendResult = result;
+    }
+
+    /**
+     * Drop any send queued with the thread's IoUringSender (the connection
+     * is about to be closed)
+     */
+    void cancelBatchedSend();
+
     enum class TryReadResult {
         /** Data received on the socket and ready to parse */
             DataReceived,
@@ -377,6 +396,22 @@ public:
      */
     void addIov(const void* buf, size_t len);
 
+    /**
+     * Add the value of a document to the IO vector to send, and account
+     * for it in the zero-copy / copied value byte counters.
+     *
+     * A zero-copy value points straight into the engine's item memory; the
+     * caller must keep the item (and hence its value) alive until the
+     * response has been sent. The command contexts do this by holding the
+     * item until the context is reset when the next command starts.
+     *
+     * @param value the value bytes to send
+     * @param zeroCopy true if value references the item's memory, false if
+     *                 it is a copy (e.g. an inflated version of the value)
+     * @throws std::bad_alloc
+     */
+    void addValueIov(cb::const_char_buffer value, bool zeroCopy);
+
     /**
      * Release all of the items we've saved a reference to
      */
@@ -835,6 +870,12 @@ protected:
     /** number of bytes in current msg */
     int msgbytes = 0;
 
+    /** State of the current message in the thread's io_uring batch */
+    enum class BatchedSendState : uint8_t { Idle, Queued, Completed };
+    BatchedSendState batchedSend = BatchedSendState::Idle;
+    /** Result of the batched send (number of bytes sent or -errno) */
+    int batchedSendResult = 0;
+
     /**
      * List of items we've reserved during the command (should call
      * item_release when transmit is complete)
@@ -47,10 +47,10 @@ enum class BufferLoan {
 /** Function prototypes ******************************************************/
 
 static BufferLoan loan_single_buffer(McbpConnection& c,
-                                     std::unique_ptr<cb::Pipe>& thread_buf,
+                                     PipePool& pool,
                                      std::unique_ptr<cb::Pipe>& conn_buf);
 static void maybe_return_single_buffer(McbpConnection& c,
-                                       std::unique_ptr<cb::Pipe>& thread_buf,
+                                       PipePool& pool,
                                        std::unique_ptr<cb::Pipe>& conn_buf);
 static void conn_destructor(Connection *c);
 static Connection *allocate_connection(SOCKET sfd,
@@ -487,16 +487,16 @@ static void release_connection(Connection *c) {
  * necessary.
  */
 static BufferLoan loan_single_buffer(McbpConnection& c,
-                                     std::unique_ptr<cb::Pipe>& thread_buf,
+                                     PipePool& pool,
                                      std::unique_ptr<cb::Pipe>& conn_buf) {
     /* Already have a (partial) buffer - nothing to do. */
     if (conn_buf) {
         return BufferLoan::Existing;
     }
 
-    // If the thread has a buffer, let's loan that to the connection
-    if (thread_buf) {
-        thread_buf.swap(conn_buf);
+    // If the thread's pool has a buffer, let's loan that to the connection
+    conn_buf = pool.take();
+    if (conn_buf) {
         return BufferLoan::Loaned;
     }
 
@@ -520,16 +520,12 @@ static BufferLoan loan_single_buffer(McbpConnection& c,
 }
 
 static void maybe_return_single_buffer(McbpConnection& c,
-                                       std::unique_ptr<cb::Pipe>& thread_buf,
+                                       PipePool& pool,
                                        std::unique_ptr<cb::Pipe>& conn_buf) {
     if (conn_buf && conn_buf->empty()) {
-        // Buffer clean, dispose of it
-        if (thread_buf) {
-            // Already got a thread buffer.. release this one
-            conn_buf.reset();
-        } else {
-            conn_buf.swap(thread_buf);
-        }
+        // Buffer clean, hand it back to the thread's pool (which releases
+        // it if the pool is full or the buffer has grown too big)
+        pool.give(conn_buf);
     }
 }
 
@@ -0,0 +1,336 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "io_uring_sender.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * We talk to the kernel directly rather than pulling in liburing; we only
+ * need a tiny subset of the functionality.
+ */
+static int sys_io_uring_setup(unsigned int entries, io_uring_params* p) {
+    return int(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int sys_io_uring_enter(int fd,
+                              unsigned int to_submit,
+                              unsigned int min_complete,
+                              unsigned int flags) {
+    return int(syscall(
+            __NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+/// Send directly, for when the ring can't be used
+static int send_directly(SOCKET sock, struct msghdr* msg) {
+    const auto nw = ::sendmsg(sock, msg, MSG_DONTWAIT);
+    return (nw < 0) ? -errno : int(nw);
+}
+
+template <typename T>
+static T* ring_ptr(void* ring, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<uint8_t*>(ring) + offset);
+}
+
+IoUringSender::IoUringSender(unsigned int entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    ringFd = sys_io_uring_setup(entries, &params);
+    if (ringFd < 0) {
+        throw std::system_error(
+                errno, std::system_category(), "IoUringSender: io_uring_setup");
+    }
+    sqEntries = params.sq_entries;
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+    const bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+#else
+    // Kernel headers predating 5.4; map the rings separately (which all
+    // kernels support)
+    const bool singleMmap = false;
+#endif
+    if (singleMmap) {
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+
+    auto map = [this](size_t size, off_t offset) {
+        void* ret = mmap(nullptr,
+                         size,
+                         PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE,
+                         ringFd,
+                         offset);
+        if (ret == MAP_FAILED) {
+            const int error = errno;
+            release();
+            throw std::system_error(
+                    error, std::system_category(), "IoUringSender: mmap");
+        }
+        return ret;
+    };
+
+    sqRing = map(sqRingSize, IORING_OFF_SQ_RING);
+    if (singleMmap) {
+        cqRing = sqRing;
+    } else {
+        cqRing = map(cqRingSize, IORING_OFF_CQ_RING);
+    }
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = map(sqesSize, IORING_OFF_SQES);
+
+    sqHead = ring_ptr<unsigned>(sqRing, params.sq_off.head);
+    sqTail = ring_ptr<unsigned>(sqRing, params.sq_off.tail);
+    sqMask = ring_ptr<unsigned>(sqRing, params.sq_off.ring_mask);
+    sqArray = ring_ptr<unsigned>(sqRing, params.sq_off.array);
+    cqHead = ring_ptr<unsigned>(cqRing, params.cq_off.head);
+    cqTail = ring_ptr<unsigned>(cqRing, params.cq_off.tail);
+    cqMask = ring_ptr<unsigned>(cqRing, params.cq_off.ring_mask);
+    cqes = ring_ptr<void>(cqRing, params.cq_off.cqes);
+
+    probeSendmsg();
+}
+
+void IoUringSender::probeSendmsg() {
+    // IORING_OP_SENDMSG arrived in Linux 5.3; on older kernels with
+    // io_uring every send would complete with -EINVAL. Send a byte over a
+    // socket pair to see if it works.
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        const int error = errno;
+        release();
+        throw std::system_error(
+                error, std::system_category(), "IoUringSender: socketpair");
+    }
+
+    char byte = 0;
+    iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    int result;
+    add(sv[0], &msg, nullptr);
+    try {
+        submitChunk(0);
+        result = pending.front().result;
+    } catch (const std::system_error& e) {
+        result = -e.code().value();
+    }
+    pending.clear();
+    close(sv[0]);
+    close(sv[1]);
+
+    if (result != 1) {
+        release();
+        throw std::system_error(result < 0 ? -result : EIO,
+                                std::system_category(),
+                                "IoUringSender: IORING_OP_SENDMSG unsupported");
+    }
+}
+
+IoUringSender::~IoUringSender() {
+    release();
+}
+
+void IoUringSender::release() {
+    if (sqes != nullptr) {
+        munmap(sqes, sqesSize);
+        sqes = nullptr;
+    }
+    if (cqRing != nullptr && cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    cqRing = nullptr;
+    if (sqRing != nullptr) {
+        munmap(sqRing, sqRingSize);
+        sqRing = nullptr;
+    }
+    if (ringFd != -1) {
+        close(ringFd);
+        ringFd = -1;
+    }
+}
+
+size_t IoUringSender::submitChunk(size_t begin) {
+    const size_t count = std::min(size_t(sqEntries), pending.size() - begin);
+    auto* sqeArray = static_cast<io_uring_sqe*>(sqes);
+
+    // We're the only producer of the submission queue, and the previous
+    // chunk has been completely consumed by the kernel.
+    unsigned tail = __atomic_load_n(sqTail, __ATOMIC_RELAXED);
+    const unsigned mask = *sqMask;
+    for (size_t ii = 0; ii < count; ++ii) {
+        const auto& p = pending[begin + ii];
+        const unsigned index = tail & mask;
+        auto& sqe = sqeArray[index];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_SENDMSG;
+        sqe.fd = int(p.sock);
+        sqe.addr = reinterpret_cast<uint64_t>(p.msg);
+        sqe.len = 1;
+        sqe.msg_flags = MSG_DONTWAIT;
+        sqe.user_data = begin + ii;
+        sqArray[index] = index;
+        ++tail;
+    }
+    __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+    // The kernel consumes the submission queue in order
+    size_t submitted = 0;
+    while (submitted < count) {
+        const int ret = sys_io_uring_enter(ringFd,
+                                           unsigned(count - submitted),
+                                           unsigned(count - submitted),
+                                           IORING_ENTER_GETEVENTS);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno,
+                                    std::system_category(),
+                                    "IoUringSender: io_uring_enter");
+        }
+        for (int ii = 0; ii < ret; ++ii) {
+            pending[begin + submitted + ii].submitted = true;
+        }
+        submitted += size_t(ret);
+    }
+
+    // Reap the completions (waiting for any stragglers)
+    auto* cqeArray = static_cast<io_uring_cqe*>(cqes);
+    size_t completed = 0;
+    while (completed < count) {
+        unsigned head = __atomic_load_n(cqHead, __ATOMIC_RELAXED);
+        const unsigned cqTailValue = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        while (head != cqTailValue) {
+            const auto& cqe = cqeArray[head & *cqMask];
+            auto& p = pending[cqe.user_data];
+            p.completed = true;
+            p.result = cqe.res;
+            ++head;
+            ++completed;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+        if (completed < count) {
+            const int ret = sys_io_uring_enter(
+                    ringFd, 0, unsigned(count - completed),
+                    IORING_ENTER_GETEVENTS);
+            if (ret < 0 && errno != EINTR) {
+                throw std::system_error(errno,
+                                        std::system_category(),
+                                        "IoUringSender: io_uring_enter");
+            }
+        }
+    }
+
+    return count;
+}
+
+#else
+
+static int send_directly(SOCKET, struct msghdr*) {
+    return -ENOSYS;
+}
+
+IoUringSender::IoUringSender(unsigned int) {
+    throw std::system_error(
+            ENOSYS, std::system_category(), "IoUringSender: not supported");
+}
+
+IoUringSender::~IoUringSender() = default;
+
+void IoUringSender::release() {
+}
+
+void IoUringSender::probeSendmsg() {
+}
+
+size_t IoUringSender::submitChunk(size_t) {
+    throw std::system_error(
+            ENOSYS, std::system_category(), "IoUringSender: not supported");
+}
+
+#endif
+
+void IoUringSender::add(SOCKET sock, struct msghdr* msg, void* ctx) {
+    pending.push_back({sock, msg, ctx});
+}
+
+void IoUringSender::cancel(void* ctx) {
+    pending.erase(std::remove_if(pending.begin(),
+                                 pending.end(),
+                                 [ctx](const Pending& p) {
+                                     return p.ctx == ctx;
+                                 }),
+                  pending.end());
+}
+
+std::vector<std::pair<void*, int>> IoUringSender::flush() {
+    if (broken) {
+        throw std::logic_error("IoUringSender::flush: the ring is broken");
+    }
+
+    try {
+        size_t offset = 0;
+        while (offset < pending.size()) {
+            offset += submitChunk(offset);
+        }
+    } catch (const std::system_error& e) {
+        // We no longer know which completions the kernel may still post,
+        // so the ring can't be used again. Complete the sends we never
+        // handed over to the kernel ourselves, and fail the ones it has
+        // (we don't know how much of them was sent).
+        broken = true;
+        release();
+        for (auto& p : pending) {
+            if (p.completed) {
+                continue;
+            }
+            if (p.submitted) {
+                p.result = -e.code().value();
+            } else {
+                p.result = send_directly(p.sock, p.msg);
+            }
+            p.completed = true;
+        }
+    }
+
+    std::vector<std::pair<void*, int>> ret;
+    ret.reserve(pending.size());
+    for (const auto& p : pending) {
+        ret.emplace_back(p.ctx, p.result);
+    }
+    pending.clear();
+    return ret;
+}
@@ -0,0 +1,165 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "config.h"
+
+#include <platform/socket.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+struct msghdr;
+
+/**
+ * IoUringSender batches the sendmsg() calls of all of the connections
+ * served by a worker thread into a single io_uring_enter() system call.
+ *
+ * Rather than writing its response directly, a (non-SSL) connection queues
+ * its current msghdr with add() and stops running its state machine. Once
+ * the worker thread has dispatched all of the ready libevent events it
+ * calls flush(), which submits every queued send in one go and returns the
+ * results; the thread then resumes each of the connections which will
+ * pick up its result as if it had called sendmsg() itself.
+ *
+ * The sends are issued with MSG_DONTWAIT (and the sockets are non-blocking)
+ * so each one completes inline during submission - a send which can't
+ * make progress completes with -EAGAIN just like sendmsg() would, and
+ * the connection falls back to waiting for a libevent write event.
+ *
+ * Only the writes are batched; the connections still read with recv()
+ * when libevent reports them readable.
+ *
+ * Only available on Linux when built against a kernel providing
+ * <linux/io_uring.h>; the constructor throws std::system_error if the
+ * kernel doesn't support io_uring with IORING_OP_SENDMSG (Linux 5.3), or
+ * it isn't available in this build.
+ */
+class IoUringSender {
+public:
+    /**
+     * Create a new sender with the given submission queue size (the
+     * number of sends which may be submitted with a single system call).
+     *
+     * @throws std::system_error if the ring can't be created
+     */
+    explicit IoUringSender(unsigned int entries);
+
+    ~IoUringSender();
+
+    IoUringSender(const IoUringSender&) = delete;
+    IoUringSender& operator=(const IoUringSender&) = delete;
+
+    /**
+     * Queue a sendmsg for the next flush.
+     *
+     * @param sock the socket to send on
+     * @param msg the message to send; must stay valid until flush returns
+     * @param ctx an opaque identifier returned with the result
+     */
+    void add(SOCKET sock, struct msghdr* msg, void* ctx);
+
+    /**
+     * Remove any send queued for the given ctx (for instance because the
+     * connection is being closed).
+     */
+    void cancel(void* ctx);
+
+    bool empty() const {
+        return pending.empty();
+    }
+
+    /**
+     * Submit all of the queued sends and wait for their completion.
+     *
+     * If the kernel rejects the submission the sender becomes broken: the
+     * sends it never took are performed with a plain sendmsg() instead,
+     * and the ones it did take fail with the submission's error (as we
+     * can't tell how much of them was sent). A broken sender must not be
+     * used again.
+     *
+     * @return (ctx, result) for each queued send, where the result is the
+     *         number of bytes sent or -errno
+     */
+    std::vector<std::pair<void*, int>> flush();
+
+    /// Has a failed submission left the sender unusable?
+    bool isBroken() const {
+        return broken;
+    }
+
+private:
+    struct Pending {
+        Pending(SOCKET sock, struct msghdr* msg, void* ctx)
+            : sock(sock), msg(msg), ctx(ctx) {
+        }
+
+        SOCKET sock;
+        struct msghdr* msg;
+        void* ctx;
+        // Has the kernel taken the send, and has it completed (with result)
+        bool submitted = false;
+        bool completed = false;
+        int result = 0;
+    };
+
+    /// Unmap the rings and close the ring descriptor
+    void release();
+
+    /**
+     * Check that the kernel supports IORING_OP_SENDMSG (by sending a byte
+     * over a socket pair).
+     *
+     * @throws std::system_error (after releasing the ring) if it doesn't
+     */
+    void probeSendmsg();
+
+    /**
+     * Submit (and reap) up to sqEntries sends starting at pending[begin],
+     * recording their results in pending.
+     *
+     * @return the number of sends submitted
+     * @throws std::system_error if the kernel rejects the submission
+     */
+    size_t submitChunk(size_t begin);
+
+    std::vector<Pending> pending;
+
+    bool broken = false;
+    int ringFd = -1;
+    unsigned int sqEntries = 0;
+
+    // The memory mapped rings shared with the kernel
+    void* sqRing = nullptr;
+    size_t sqRingSize = 0;
+    void* cqRing = nullptr;
+    size_t cqRingSize = 0;
+    void* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    // Pointers into the rings
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    void* cqes = nullptr;
+};
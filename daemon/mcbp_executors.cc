@@ -46,6 +46,7 @@
 #include "protocol/mcbp/get_context.h"
 #include "protocol/mcbp/get_locked_context.h"
 #include "protocol/mcbp/get_meta_context.h"
+#include "protocol/mcbp/get_multi_context.h"
 #include "protocol/mcbp/mutation_context.h"
 #include "protocol/mcbp/rbac_reload_command_context.h"
 #include "protocol/mcbp/remove_context.h"
@@ -102,6 +103,11 @@ static void get_locked_executor(McbpConnection* c, void* packet) {
     c->obtainContext<GetLockedCommandContext>(*c, req).drive();
 }
 
+static void get_multi_executor(McbpConnection* c, void* packet) {
+    auto* req = reinterpret_cast<protocol_binary_request_no_extras*>(packet);
+    c->obtainContext<GetMultiCommandContext>(*c, req).drive();
+}
+
 static void unlock_executor(McbpConnection* c, void* packet) {
     auto* req = reinterpret_cast<protocol_binary_request_no_extras*>(packet);
     c->obtainContext<UnlockCommandContext>(*c, req).drive();
@@ -475,6 +481,12 @@ static ENGINE_ERROR_CODE dcp_message_control(const void* void_cookie,
     return ret;
 }
 
+/**
+ * The maximum number of DCP messages to collect from the engine before
+ * sending them to the client
+ */
+static const int MaxDcpMessagesPerSend = 32;
+
 void ship_mcbp_dcp_log(McbpConnection* c) {
     static struct dcp_message_producers producers = {
         dcp_message_get_failover_log,
@@ -494,28 +506,65 @@ void ship_mcbp_dcp_log(McbpConnection* c) {
         dcp_message_control,
         dcp_message_system_event
     };
-    ENGINE_ERROR_CODE ret;
-
-    // Begin timing DCP, each dcp callback needs to set the c->cmd for the timing
-    // to be recorded.
-    c->setStart(gethrtime());
 
     c->addMsgHdr(true);
     c->setEwouldblock(false);
-    ret = c->getBucketEngine()->dcp.step(c->getBucketEngineAsV0(), c->getCookie(),
-                                         &producers);
-    if (ret == ENGINE_SUCCESS) {
-        /* the engine don't have more data to send at this moment */
-        c->setEwouldblock(true);
-    } else if (ret == ENGINE_WANT_MORE) {
-        /* The engine got more data it wants to send */
-        ret = ENGINE_SUCCESS;
+
+    // Each message adds its header to the write buffer and its key and
+    // value to the iovecs, so keep stepping to send a batch of messages
+    // with a single sendmsg.
+    int batched = 0;
+    ENGINE_ERROR_CODE ret;
+    do {
+        // Begin timing DCP, each dcp callback needs to set the c->cmd for
+        // the timing to be recorded.
+        c->setStart(gethrtime());
+        ret = c->getBucketEngine()->dcp.step(c->getBucketEngineAsV0(),
+                                             c->getCookie(),
+                                             &producers);
+        if (ret == ENGINE_WANT_MORE) {
+            mcbp_collect_timings(c);
+            ++batched;
+        }
+    } while (ret == ENGINE_WANT_MORE && batched < MaxDcpMessagesPerSend);
+    c->setStart(0);
+
+    switch (ret) {
+    case ENGINE_WANT_MORE:
+        // The batch is full, the engine got more data it wants to send
+        break;
+    case ENGINE_SUCCESS:
+        // The engine don't have more data to send at this moment (or flow
+        // control paused the stream)
+        if (batched == 0) {
+            c->setEwouldblock(true);
+        }
+        break;
+    case ENGINE_E2BIG:
+    case ENGINE_ENOMEM:
+        if (batched > 0) {
+            // The write buffer is full; the engine retries the rejected
+            // message the next time we step it (after sending what we've
+            // got)
+            break;
+        }
+        // The message doesn't fit in an empty write buffer either
+        c->setState(McbpStateMachine::State::closing);
+        return;
+    default:
+        if (batched == 0) {
+            c->setState(McbpStateMachine::State::closing);
+            return;
+        }
+        // Send the messages we've got before closing the connection
         c->setState(McbpStateMachine::State::send_data);
-        c->setWriteAndGo(McbpStateMachine::State::ship_log);
+        c->setWriteAndGo(McbpStateMachine::State::closing);
+        return;
     }
 
-    if (ret != ENGINE_SUCCESS) {
-        c->setState(McbpStateMachine::State::closing);
+    if (batched > 0) {
+        c->setState(McbpStateMachine::State::send_data);
+        c->setWriteAndGo(McbpStateMachine::State::ship_log);
     }
 }
 
@@ -1016,6 +1065,7 @@ std::array<mcbp_package_execute, 0x100>& get_mcbp_executors(void) {
     executors[PROTOCOL_BINARY_CMD_GET] = get_executor;
     executors[PROTOCOL_BINARY_CMD_GETQ] = get_executor;
     executors[PROTOCOL_BINARY_CMD_GETK] = get_executor;
+    executors[PROTOCOL_BINARY_CMD_GET_MULTI] = get_multi_executor;
     executors[PROTOCOL_BINARY_CMD_GETKQ] = get_executor;
     executors[PROTOCOL_BINARY_CMD_GET_META] = get_meta_executor;
     executors[PROTOCOL_BINARY_CMD_GETQ_META] = get_meta_executor;
@@ -771,6 +771,41 @@ static protocol_binary_response_status get_validator(const Cookie& cookie)
     return PROTOCOL_BINARY_RESPONSE_SUCCESS;
 }
 
+static protocol_binary_response_status get_multi_validator(
+        const Cookie& cookie) {
+    auto req = static_cast<protocol_binary_request_no_extras*>(
+            cookie.getPacketAsVoidPtr());
+    const uint32_t blen = ntohl(req->message.header.request.bodylen);
+
+    if (req->message.header.request.magic != PROTOCOL_BINARY_REQ ||
+        req->message.header.request.extlen != 0 ||
+        req->message.header.request.keylen != 0 || blen == 0 ||
+        req->message.header.request.datatype != PROTOCOL_BINARY_RAW_BYTES ||
+        req->message.header.request.cas != 0) {
+        return PROTOCOL_BINARY_RESPONSE_EINVAL;
+    }
+
+    // The body is a sequence of [vbucket:2][keylen:2][key:keylen], with
+    // no trailing bytes, no empty keys and no keys longer than a key may be.
+    const uint8_t* body = req->bytes + sizeof(req->bytes);
+    uint32_t offset = 0;
+    while (offset < blen) {
+        if (blen - offset < 4) {
+            return PROTOCOL_BINARY_RESPONSE_EINVAL;
+        }
+        uint16_t klen;
+        memcpy(&klen, body + offset + 2, sizeof(klen));
+        klen = ntohs(klen);
+        offset += 4;
+        if (klen == 0 || klen > KEY_MAX_LENGTH || blen - offset < klen) {
+            return PROTOCOL_BINARY_RESPONSE_EINVAL;
+        }
+        offset += klen;
+    }
+
+    return PROTOCOL_BINARY_RESPONSE_SUCCESS;
+}
+
 static protocol_binary_response_status gat_validator(const Cookie& cookie) {
     auto req = static_cast<protocol_binary_request_no_extras*>(
             cookie.getPacketAsVoidPtr());
@@ -1380,4 +1415,5 @@ void McbpValidatorChains::initializeMcbpValidatorChains(McbpValidatorChains& cha
     chains.push_unique(PROTOCOL_BINARY_CMD_RBAC_REFRESH, configuration_refresh_validator);
     chains.push_unique(PROTOCOL_BINARY_CMD_COLLECTIONS_SET_MANIFEST,
                        collections_set_manifest_validator);
+    chains.push_unique(PROTOCOL_BINARY_CMD_GET_MULTI, get_multi_validator);
 }
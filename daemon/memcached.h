@@ -26,7 +26,9 @@
 
 #include "dynamic_buffer.h"
 #include "executorpool.h"
+#include "io_uring_sender.h"
 #include "log_macros.h"
+#include "pipe_pool.h"
 #include "settings.h"
 #include "timing_histogram.h"
 
@@ -84,11 +86,23 @@ struct LIBEVENT_THREAD {
     int index;                  /* index of this thread in the threads array */
     ThreadType type;      /* Type of IO this thread processes */
 
-    /** Shared read buffer for all connections serviced by this thread. */
-    std::unique_ptr<cb::Pipe> read;
+    /**
+     * Pool of read buffers loaned to the connections serviced by this
+     * thread while they have data in flight.
+     */
+    PipePool read;
+
+    /**
+     * Pool of write buffers loaned to the connections serviced by this
+     * thread while they have data in flight.
+     */
+    PipePool write;
 
-    /** Shared write buffer for all connections serviced by this thread. */
-    std::unique_ptr<cb::Pipe> write;
+    /**
+     * Batches the socket writes of the connections serviced by this
+     * thread (only set if io_uring is enabled and supported).
+     */
+    std::unique_ptr<IoUringSender> io_uring;
 
     subdoc_OPERATION* subdoc_op; /** Shared sub-document operation for all
                                      connections serviced by this thread. */
@@ -156,6 +170,14 @@ void thread_init(int nthreads, struct event_base *main_base,
 void threads_shutdown(void);
 void threads_cleanup(void);
 
+/**
+ * Get the total number of buffers (and their capacity in bytes) held in
+ * the read and write buffer pools of the worker threads.
+ */
+void threads_get_buffer_pool_stats(size_t& rbufs,
+                                   size_t& wbufs,
+                                   size_t& bytes);
+
 void dispatch_conn_new(SOCKET sfd, int parent_port);
 
 /* Lock wrappers for cache functions that are called from main loop. */
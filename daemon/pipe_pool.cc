@@ -0,0 +1,52 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "pipe_pool.h"
+
+std::unique_ptr<cb::Pipe> PipePool::take() {
+    if (buffers.empty()) {
+        return {};
+    }
+
+    auto ret = std::move(buffers.back());
+    buffers.pop_back();
+    numBuffers.store(buffers.size());
+    numBytes.store(numBytes.load() - ret->capacity());
+    return ret;
+}
+
+bool PipePool::give(std::unique_ptr<cb::Pipe>& pipe) {
+    if (!pipe) {
+        return false;
+    }
+
+    if (buffers.size() >= MaxBuffers || pipe->capacity() > MaxBufferSize) {
+        pipe.reset();
+        return false;
+    }
+
+    pipe->clear();
+    numBytes.store(numBytes.load() + pipe->capacity());
+    buffers.push_back(std::move(pipe));
+    numBuffers.store(buffers.size());
+    return true;
+}
+
+void PipePool::clear() {
+    buffers.clear();
+    numBuffers.store(0);
+    numBytes.store(0);
+}
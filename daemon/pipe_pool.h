@@ -0,0 +1,84 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <platform/pipe.h>
+#include <relaxed_atomic.h>
+
+#include <memory>
+#include <vector>
+
+/**
+ * PipePool is a per worker thread pool of network buffers.
+ *
+ * A connection only owns a read / write buffer while it has data in flight;
+ * once the buffer is drained it is handed back to the pool of the thread
+ * serving the connection, and the next connection needing a buffer takes
+ * it from there. The pool is a LIFO so the buffer handed out is the one
+ * most recently used (and hence most likely to still be in the CPU cache).
+ *
+ * To bound the memory pinned by idle threads the pool holds at most
+ * MaxBuffers buffers, and buffers which have grown beyond MaxBufferSize
+ * (to hold a large packet) are released rather than pooled.
+ *
+ * The pool is only accessed by its worker thread, apart from the size
+ * counters which may be read by other threads (for stats).
+ */
+class PipePool {
+public:
+    /// The maximum number of buffers kept in the pool
+    static const size_t MaxBuffers = 16;
+
+    /// Buffers larger than this are released instead of being pooled
+    static const size_t MaxBufferSize = 64 * 1024;
+
+    /**
+     * Take a buffer from the pool.
+     *
+     * @return the most recently returned buffer, or nullptr if the pool
+     *         is empty
+     */
+    std::unique_ptr<cb::Pipe> take();
+
+    /**
+     * Hand a drained buffer back to the pool. The buffer is released
+     * instead if the pool is full or the buffer is too big.
+     *
+     * @param pipe the buffer to return (reset on return)
+     * @return true if the buffer was added to the pool
+     */
+    bool give(std::unique_ptr<cb::Pipe>& pipe);
+
+    /// Release all of the buffers in the pool
+    void clear();
+
+    /// The number of buffers in the pool
+    size_t size() const {
+        return numBuffers;
+    }
+
+    /// The total capacity of the buffers in the pool
+    size_t bytes() const {
+        return numBytes;
+    }
+
+private:
+    std::vector<std::unique_ptr<cb::Pipe>> buffers;
+
+    Couchbase::RelaxedAtomic<size_t> numBuffers = {(0)};
+    Couchbase::RelaxedAtomic<size_t> numBytes = {(0)};
+};
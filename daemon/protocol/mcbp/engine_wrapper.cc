@@ -182,6 +182,22 @@ cb::EngineErrorItemPair bucket_get(McbpConnection* c,
     return ret;
 }
 
+std::vector<cb::EngineErrorItemPair> bucket_get_multi(
+        McbpConnection* c, const std::vector<cb::KeyAndVBucket>& keys) {
+    auto ret = c->getBucketEngine()->get_multi(
+            c->getBucketEngineAsV0(), c->getCookie(), keys);
+    for (const auto& r : ret) {
+        if (r.first == cb::engine_errc::disconnect) {
+            LOG_INFO(c,
+                     "%u: %s bucket_get_multi return ENGINE_DISCONNECT",
+                     c->getId(),
+                     c->getDescription().c_str());
+            break;
+        }
+    }
+    return ret;
+}
+
 cb::EngineErrorItemPair bucket_get_if(McbpConnection* c,
                                       const DocKey& key,
                                       uint16_t vbucket,
@@ -77,6 +77,9 @@ cb::EngineErrorItemPair bucket_get(
         uint16_t vbucket,
         DocStateFilter documentStateFilter = DocStateFilter::Alive);
 
+std::vector<cb::EngineErrorItemPair> bucket_get_multi(
+        McbpConnection* c, const std::vector<cb::KeyAndVBucket>& keys);
+
 cb::EngineErrorItemPair bucket_get_if(McbpConnection* c,
                                       const DocKey& key,
                                       uint16_t vbucket,
@@ -105,7 +105,9 @@ ENGINE_ERROR_CODE GetCommandContext::sendResponse() {
         connection.addIov(info.key, info.nkey);
     }
 
-    connection.addIov(payload.buf, payload.len);
+    // Unless we had to inflate it, the payload points into the item which
+    // we hold on to until the next command.
+    connection.addValueIov(payload, buffer.data.get() == nullptr);
     connection.setState(McbpStateMachine::State::send_data);
     cb::audit::document::add(connection, cb::audit::document::Operation::Read);
 
@@ -94,7 +94,9 @@ ENGINE_ERROR_CODE GetLockedCommandContext::sendResponse() {
     // Add the flags
     connection.addIov(&info.flags, sizeof(info.flags));
     // Add the value
-    connection.addIov(payload.buf, payload.len);
+    // Unless we had to inflate it, the payload points into the item which
+    // we hold on to until the next command.
+    connection.addValueIov(payload, buffer.data.get() == nullptr);
     connection.setState(McbpStateMachine::State::send_data);
 
     STATS_INCR(&connection, cmd_lock);
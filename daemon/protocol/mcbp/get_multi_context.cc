@@ -0,0 +1,258 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "engine_wrapper.h"
+#include "get_multi_context.h"
+
+#include <daemon/mcaudit.h>
+#include <daemon/mcbp.h>
+#include <xattr/utils.h>
+
+GetMultiCommandContext::GetMultiCommandContext(
+        McbpConnection& c, protocol_binary_request_no_extras* req)
+    : SteppableCommandContext(c),
+      keyData(req->bytes + sizeof(req->bytes),
+              req->bytes + sizeof(req->bytes) +
+                      ntohl(req->message.header.request.bodylen)),
+      state(State::GetItems) {
+    // The validator has already checked that the body is a well-formed
+    // sequence of [vbucket:2][keylen:2][key:keylen] entries.
+    std::vector<std::pair<size_t, size_t>> offsets;
+    size_t offset = 0;
+    while (offset < keyData.size()) {
+        uint16_t keylen;
+        memcpy(&keylen, keyData.data() + offset + 2, sizeof(keylen));
+        keylen = ntohs(keylen);
+        offsets.emplace_back(offset, keylen);
+        offset += 4 + keylen;
+    }
+
+    entries.reserve(offsets.size());
+    for (const auto& o : offsets) {
+        uint16_t vbucket;
+        memcpy(&vbucket, keyData.data() + o.first, sizeof(vbucket));
+        entries.emplace_back(DocKey(keyData.data() + o.first + 4,
+                                    o.second,
+                                    c.getDocNamespace()),
+                             ntohs(vbucket),
+                             c.getBucketEngineAsV0());
+    }
+}
+
+ENGINE_ERROR_CODE GetMultiCommandContext::getItems() {
+    std::vector<size_t> outstanding;
+    std::vector<cb::KeyAndVBucket> keys;
+    for (size_t ii = 0; ii < entries.size(); ++ii) {
+        if (entries[ii].status == cb::engine_errc::would_block) {
+            outstanding.push_back(ii);
+            keys.push_back({entries[ii].key, entries[ii].vbucket});
+        }
+    }
+
+    auto result = bucket_get_multi(&connection, keys);
+    if (result.size() != keys.size()) {
+        LOG_WARNING(&connection,
+                    "%u: get_multi returned %zu results for %zu keys",
+                    connection.getId(),
+                    result.size(),
+                    keys.size());
+        return ENGINE_FAILED;
+    }
+
+    bool blocked = false;
+    for (size_t ii = 0; ii < result.size(); ++ii) {
+        auto& entry = entries[outstanding[ii]];
+        entry.status = result[ii].first;
+        switch (entry.status) {
+        case cb::engine_errc::success:
+            entry.it = std::move(result[ii].second);
+            if (!bucket_get_item_info(
+                        &connection, entry.it.get(), &entry.info)) {
+                LOG_WARNING(&connection,
+                            "%u: Failed to get item info",
+                            connection.getId());
+                return ENGINE_FAILED;
+            }
+            entry.payload.buf =
+                    static_cast<const char*>(entry.info.value[0].iov_base);
+            entry.payload.len = entry.info.value[0].iov_len;
+            break;
+        case cb::engine_errc::would_block:
+            blocked = true;
+            break;
+        case cb::engine_errc::disconnect:
+            return ENGINE_DISCONNECT;
+        default:
+            break;
+        }
+    }
+
+    if (blocked) {
+        return ENGINE_EWOULDBLOCK;
+    }
+
+    state = State::InflateItems;
+    return ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE GetMultiCommandContext::inflateItems() {
+    for (auto& entry : entries) {
+        if (entry.status != cb::engine_errc::success ||
+            !mcbp::datatype::is_snappy(entry.info.datatype)) {
+            continue;
+        }
+        if (!mcbp::datatype::is_xattr(entry.info.datatype) &&
+            connection.isSnappyEnabled()) {
+            continue;
+        }
+
+        try {
+            if (!cb::compression::inflate(cb::compression::Algorithm::Snappy,
+                                          entry.payload.buf,
+                                          entry.payload.len,
+                                          entry.buffer)) {
+                LOG_WARNING(&connection,
+                            "%u: Failed to inflate item",
+                            connection.getId());
+                return ENGINE_FAILED;
+            }
+            entry.payload.buf = entry.buffer.data.get();
+            entry.payload.len = entry.buffer.len;
+        } catch (const std::bad_alloc&) {
+            return ENGINE_ENOMEM;
+        }
+    }
+
+    state = State::SendResponse;
+    return ENGINE_SUCCESS;
+}
+
+static void encodeHeader(protocol_binary_response_header& header,
+                         uint16_t status,
+                         uint8_t extlen,
+                         uint16_t keylen,
+                         uint32_t bodylen,
+                         uint8_t datatype,
+                         uint32_t opaque,
+                         uint64_t cas) {
+    memset(&header, 0, sizeof(header));
+    header.response.magic = uint8_t(PROTOCOL_BINARY_RES);
+    header.response.opcode = PROTOCOL_BINARY_CMD_GET_MULTI;
+    header.response.keylen = htons(keylen);
+    header.response.extlen = extlen;
+    header.response.datatype = datatype;
+    header.response.status = htons(status);
+    header.response.bodylen = htonl(bodylen);
+    header.response.opaque = opaque;
+    header.response.cas = htonll(cas);
+}
+
+ENGINE_ERROR_CODE GetMultiCommandContext::sendResponse() {
+    auto& responseCounters = connection.getBucket().responseCounters;
+    bool anyHit = false;
+
+    connection.addMsgHdr(true);
+    for (auto& entry : entries) {
+        if (entry.status == cb::engine_errc::success) {
+            auto& info = entry.info;
+            protocol_binary_datatype_t datatype = info.datatype;
+            if (mcbp::datatype::is_xattr(datatype)) {
+                entry.payload = cb::xattr::get_body(entry.payload);
+                datatype &= ~PROTOCOL_BINARY_DATATYPE_XATTR;
+            }
+            datatype = connection.getEnabledDatatypes(datatype);
+
+            encodeHeader(entry.header,
+                         PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                         sizeof(info.flags),
+                         info.nkey,
+                         sizeof(info.flags) + info.nkey + entry.payload.len,
+                         datatype,
+                         connection.getOpaque(),
+                         info.cas);
+            connection.addIov(entry.header.bytes, sizeof(entry.header.bytes));
+            connection.addIov(&info.flags, sizeof(info.flags));
+            connection.addIov(info.key, info.nkey);
+            connection.addValueIov(entry.payload,
+                                   entry.buffer.data.get() == nullptr);
+            ++responseCounters[PROTOCOL_BINARY_RESPONSE_SUCCESS];
+
+            STATS_HIT(&connection, get);
+            update_topkeys(entry.key, &connection);
+            anyHit = true;
+        } else if (entry.status == cb::engine_errc::no_such_key) {
+            // Misses are silent (as for GETKQ)
+            STATS_MISS(&connection, get);
+            ++responseCounters[PROTOCOL_BINARY_RESPONSE_KEY_ENOENT];
+        } else {
+            const auto status = engine_error_2_mcbp_protocol_error(
+                    connection.remapErrorCode(
+                            ENGINE_ERROR_CODE(entry.status)));
+            encodeHeader(entry.header,
+                         status,
+                         0,
+                         uint16_t(entry.key.size()),
+                         uint32_t(entry.key.size()),
+                         PROTOCOL_BINARY_RAW_BYTES,
+                         connection.getOpaque(),
+                         0);
+            connection.addIov(entry.header.bytes, sizeof(entry.header.bytes));
+            connection.addIov(entry.key.data(), entry.key.size());
+            ++responseCounters[status];
+        }
+    }
+
+    encodeHeader(terminator,
+                 PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                 0,
+                 0,
+                 0,
+                 PROTOCOL_BINARY_RAW_BYTES,
+                 connection.getOpaque(),
+                 0);
+    connection.addIov(terminator.bytes, sizeof(terminator.bytes));
+    ++responseCounters[PROTOCOL_BINARY_RESPONSE_SUCCESS];
+
+    connection.setState(McbpStateMachine::State::send_data);
+    if (anyHit) {
+        cb::audit::document::add(connection,
+                                 cb::audit::document::Operation::Read);
+    }
+
+    state = State::Done;
+    return ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE GetMultiCommandContext::step() {
+    ENGINE_ERROR_CODE ret;
+    do {
+        switch (state) {
+        case State::GetItems:
+            ret = getItems();
+            break;
+        case State::InflateItems:
+            ret = inflateItems();
+            break;
+        case State::SendResponse:
+            ret = sendResponse();
+            break;
+        case State::Done:
+            return ENGINE_SUCCESS;
+        }
+    } while (ret == ENGINE_SUCCESS);
+
+    return ret;
+}
@@ -0,0 +1,122 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <platform/compress.h>
+#include "../../memcached.h"
+#include "steppable_command_context.h"
+
+#include <vector>
+
+/**
+ * The GetMultiCommandContext is a state machine used by the memcached
+ * core to implement the GetMulti operation.
+ *
+ * The request body contains a list of keys (each prefixed with its vbucket
+ * and key length). All of the keys are looked up with a single call to the
+ * engine's get_multi, and all of the responses are queued up as iovecs
+ * pointing into the retrieved items before the connection moves to
+ * send_data, so the whole batch is written with as few sendmsg calls as
+ * possible. Each hit is returned as its own response message carrying the
+ * key (like GETKQ), misses are silent, other per-key errors are returned
+ * with the key, and the batch is terminated by an empty success response.
+ */
+class GetMultiCommandContext : public SteppableCommandContext {
+public:
+    // The internal states. Look at the function headers below to
+    // for the functions with the same name to figure out what each
+    // state does
+    enum class State : uint8_t { GetItems, InflateItems, SendResponse, Done };
+
+    GetMultiCommandContext(McbpConnection& c,
+                           protocol_binary_request_no_extras* req);
+
+protected:
+    /**
+     * Keep running the state machine.
+     *
+     * @return A standard engine error code (if SUCCESS we've changed the
+     *         the connections state to one of the appropriate states (send
+     *         data, or start processing the next command)
+     */
+    ENGINE_ERROR_CODE step() override;
+
+    /**
+     * Look up all of the keys which haven't been resolved yet with a single
+     * call to the engine.
+     *
+     * The engine notifies the cookie once all of the keys it had to block
+     * on may be retried; we then retry all of the still-outstanding keys
+     * (any which block again are simply waited for again).
+     *
+     * @return ENGINE_EWOULDBLOCK if any of the keys needs to block
+     *         ENGINE_SUCCESS if all keys are resolved
+     */
+    ENGINE_ERROR_CODE getItems();
+
+    /**
+     * Inflate any compressed documents which the client can't receive
+     * compressed (or which contain xattrs which we need to strip off).
+     *
+     * @return ENGINE_FAILED if inflate failed
+     *         ENGINE_ENOMEM if we're out of memory
+     *         ENGINE_SUCCESS to go to the next state
+     */
+    ENGINE_ERROR_CODE inflateItems();
+
+    /**
+     * Craft up all of the response messages. The context lives until we
+     * start the next command so we point directly into the items (or the
+     * inflated buffers) rather than copying values.
+     *
+     * @return ENGINE_SUCCESS
+     */
+    ENGINE_ERROR_CODE sendResponse();
+
+private:
+    struct Entry {
+        Entry(const DocKey& key, uint16_t vbucket, ENGINE_HANDLE* handle)
+            : key(key), vbucket(vbucket), it(nullptr, cb::ItemDeleter{handle}) {
+        }
+
+        const DocKey key;
+        const uint16_t vbucket;
+
+        cb::engine_errc status = cb::engine_errc::would_block;
+        cb::unique_item_ptr it;
+        item_info info;
+
+        cb::const_char_buffer payload;
+        cb::compression::Buffer buffer;
+
+        // Storage for this entry's response header
+        protocol_binary_response_header header;
+    };
+
+    /**
+     * Copy of the request body; the keys point into it, and error
+     * responses send them from here after the request has been consumed.
+     */
+    std::vector<uint8_t> keyData;
+
+    std::vector<Entry> entries;
+
+    // Storage for the header of the terminating response
+    protocol_binary_response_header terminator;
+
+    State state;
+};
@@ -169,6 +169,10 @@ static ENGINE_ERROR_CODE server_stats(ADD_STAT add_stat_callback,
                  thread_stats.bytes_subdoc_mutation_total);
         add_stat(cookie, add_stat_callback, "bytes_subdoc_mutation_inserted",
                  thread_stats.bytes_subdoc_mutation_inserted);
+        add_stat(cookie, add_stat_callback, "bytes_get_zero_copy",
+                 thread_stats.bytes_get_zero_copy);
+        add_stat(cookie, add_stat_callback, "bytes_get_copied",
+                 thread_stats.bytes_get_copied);
 
         // index 0 contains the aggregated timings for all buckets
         auto& timings = all_buckets[0].timings;
@@ -216,6 +220,16 @@ static ENGINE_ERROR_CODE server_stats(ADD_STAT add_stat_callback,
                  add_stat_callback,
                  "wbufs_existing",
                  thread_stats.wbufs_existing);
+        add_stat(cookie, add_stat_callback, "iouring_sends",
+                 thread_stats.iouring_sends);
+
+        size_t rbufs_pooled, wbufs_pooled, bufs_pooled_bytes;
+        threads_get_buffer_pool_stats(
+                rbufs_pooled, wbufs_pooled, bufs_pooled_bytes);
+        add_stat(cookie, add_stat_callback, "rbufs_pooled", rbufs_pooled);
+        add_stat(cookie, add_stat_callback, "wbufs_pooled", wbufs_pooled);
+        add_stat(cookie, add_stat_callback, "bufs_pooled_bytes",
+                 bufs_pooled_bytes);
         add_stat(cookie, add_stat_callback, "iovused_high_watermark",
                  thread_stats.iovused_high_watermark);
         add_stat(cookie, add_stat_callback, "msgused_high_watermark",
@@ -369,6 +383,8 @@ static void process_stat_settings(ADD_STAT add_stat_callback,
              settings.isDatatypeSnappyEnabled() ? "true" : "false");
     add_stat(cookie, add_stat_callback, "dedupe_nmvb_maps",
              settings.isDedupeNmvbMaps() ? "true" : "false");
+    add_stat(cookie, add_stat_callback, "io_uring",
+             settings.isIoUringEnabled() ? "true" : "false");
     add_stat(cookie, add_stat_callback, "max_packet_size",
              std::to_string(settings.getMaxPacketSize()).c_str());
     add_stat(cookie, add_stat_callback, "xattr_enabled",
@@ -216,6 +216,24 @@ static void handle_topkeys_enabled(Settings& s, cJSON* obj) {
     }
 }
 
+/**
+ * Handle the "io_uring" tag in the settings
+ *
+ *  The value must be a boolean value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_io_uring(Settings& s, cJSON* obj) {
+    if (obj->type == cJSON_True) {
+        s.setIoUringEnabled(true);
+    } else if (obj->type == cJSON_False) {
+        s.setIoUringEnabled(false);
+    } else {
+        throw std::invalid_argument("\"io_uring\" must be a boolean value");
+    }
+}
+
 /**
  * Handle "default_reqs_per_event", "reqs_per_event_high_priority",
  * "reqs_per_event_med_priority" and "reqs_per_event_low_priority" tag in
@@ -657,7 +675,8 @@ void Settings::reconfigure(const unique_cJSON_ptr& json) {
             {"client_cert_auth", handle_client_cert_auth},
             {"collections_prototype", handle_collections_prototype},
             {"opcode_attributes_override", handle_opcode_attributes_override},
-            {"topkeys_enabled", handle_topkeys_enabled}};
+            {"topkeys_enabled", handle_topkeys_enabled},
+            {"io_uring", handle_io_uring}};
 
     cJSON* obj = json->child;
     while (obj != nullptr) {
@@ -1259,6 +1278,13 @@ void Settings::updateSettings(const Settings& other, bool apply) {
         }
         setTopkeysEnabled(other.isTopkeysEnabled());
     }
+
+    if (other.has.io_uring) {
+        if (other.isIoUringEnabled() != isIoUringEnabled()) {
+            throw std::invalid_argument(
+                    "io_uring can't be changed dynamically");
+        }
+    }
 }
 
 void Settings::logit(EXTENSION_LOG_LEVEL level, const char* fmt, ...) {
@@ -937,6 +937,16 @@ public:
         notify_changed("topkeys_enabled");
     }
 
+    bool isIoUringEnabled() const {
+        return io_uring.load(std::memory_order_acquire);
+    }
+
+    void setIoUringEnabled(bool enabled) {
+        Settings::io_uring.store(enabled, std::memory_order_release);
+        has.io_uring = true;
+        notify_changed("io_uring");
+    }
+
 protected:
 
     /**
@@ -1093,6 +1103,11 @@ protected:
      */
     std::atomic_bool topkeys_enabled{false};
 
+    /**
+     * Should the worker threads batch their socket writes with io_uring
+     */
+    std::atomic_bool io_uring{false};
+
 public:
     /**
      * Flags for each of the above config options, indicating if they were
@@ -1132,6 +1147,7 @@ public:
         bool collections_prototype;
         bool opcode_attributes_override;
         bool topkeys_enabled;
+        bool io_uring;
     } has;
 
 protected:
@@ -492,6 +492,7 @@ bool conn_send_data(McbpConnection& connection) {
         break;
 
     case McbpConnection::TransmitResult::SoftError:
+    case McbpConnection::TransmitResult::Queued:
         ret = false;
         break;
     }
@@ -555,6 +556,10 @@ bool conn_closing(McbpConnection& connection) {
     // Delete any attached command context
     c->resetCommandContext();
 
+    // The iovecs of a batched send may point into the items we're about
+    // to release
+    c->cancelBatchedSend();
+
     /* We don't want any network notifications anymore.. */
     c->unregisterEvent();
     safe_close(c->getSocketDescriptor());
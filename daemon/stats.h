@@ -60,6 +60,9 @@ struct thread_stats {
         bytes_subdoc_mutation_total = 0;
         bytes_subdoc_mutation_inserted = 0;
 
+        bytes_get_zero_copy = 0;
+        bytes_get_copied = 0;
+
         rbufs_allocated = 0;
         rbufs_loaned = 0;
         rbufs_existing = 0;
@@ -67,6 +70,8 @@ struct thread_stats {
         wbufs_loaned = 0;
         wbufs_existing = 0;
 
+        iouring_sends = 0;
+
         iovused_high_watermark = 0;
         msgused_high_watermark = 0;
     }
@@ -102,6 +107,9 @@ struct thread_stats {
         bytes_subdoc_mutation_total += other.bytes_subdoc_mutation_total;
         bytes_subdoc_mutation_inserted += other.bytes_subdoc_mutation_inserted;
 
+        bytes_get_zero_copy += other.bytes_get_zero_copy;
+        bytes_get_copied += other.bytes_get_copied;
+
         rbufs_allocated += other.rbufs_allocated;
         rbufs_loaned += other.rbufs_loaned;
         rbufs_existing += other.rbufs_existing;
@@ -109,6 +117,8 @@ struct thread_stats {
         wbufs_loaned += other.wbufs_loaned;
         wbufs_existing += other.wbufs_existing;
 
+        iouring_sends += other.iouring_sends;
+
         iovused_high_watermark.setIfGreater(other.iovused_high_watermark);
         msgused_high_watermark.setIfGreater(other.msgused_high_watermark);
 
@@ -165,6 +175,14 @@ struct thread_stats {
        received from the client). */
     Couchbase::RelaxedAtomic<uint64_t> bytes_subdoc_mutation_inserted;
 
+    /* # of document value bytes sent by GET/GAT/GETL responses directly
+       from the engine's item memory (no intermediate copy). */
+    Couchbase::RelaxedAtomic<uint64_t> bytes_get_zero_copy;
+    /* # of document value bytes sent by GET/GAT/GETL responses from a
+       copy of the value (i.e. the value had to be inflated). Compare with
+       'bytes_get_zero_copy' */
+    Couchbase::RelaxedAtomic<uint64_t> bytes_get_copied;
+
     /* # of read buffers allocated. */
     Couchbase::RelaxedAtomic<uint64_t> rbufs_allocated;
     /* # of read buffers which could be loaned (and hence didn't need to be allocated). */
@@ -180,6 +198,9 @@ struct thread_stats {
         connection (and hence didn't need to be allocated). */
     Couchbase::RelaxedAtomic<uint64_t> wbufs_existing;
 
+    /* # of sends submitted in a batch through the worker thread's io_uring */
+    Couchbase::RelaxedAtomic<uint64_t> iouring_sends;
+
     /* Highest value iovsize has got to */
     Couchbase::RelaxedAtomic<int> iovused_high_watermark;
     /* High value Connection->msgused has got to */
@@ -20,6 +20,7 @@
 #include <platform/strerror.h>
 #include <queue>
 #include <memory>
+#include <system_error>
 
 #define ITEMS_PER_ALLOC 64
 
@@ -212,6 +213,44 @@ static void setup_thread(LIBEVENT_THREAD *me) {
     } catch (const std::bad_alloc&) {
         FATAL_ERROR(EXIT_FAILURE, "Failed to allocate memory for JSON validator");
     }
+
+    if (settings.isIoUringEnabled()) {
+        try {
+            me->io_uring = std::make_unique<IoUringSender>(4096);
+        } catch (const std::system_error& e) {
+            LOG_WARNING(nullptr,
+                        "Failed to set up io_uring for worker thread (%s); "
+                        "falling back to sendmsg",
+                        e.what());
+        }
+    }
+}
+
+/*
+ * Submit all of the sends queued up by the connections served by the
+ * thread and resume each of them so that they may pick up the result.
+ */
+static void flush_io_uring(LIBEVENT_THREAD* me) {
+    if (me->io_uring->empty()) {
+        return;
+    }
+
+    const auto completed = me->io_uring->flush();
+    if (me->io_uring->isBroken()) {
+        // The sends have all been completed (or failed) regardless; from
+        // now on the connections send directly.
+        LOG_WARNING(nullptr,
+                    "Failed to submit sends through io_uring for worker "
+                    "thread %u; falling back to sendmsg",
+                    me->index);
+        me->io_uring.reset();
+    }
+
+    for (const auto& send : completed) {
+        auto* c = reinterpret_cast<McbpConnection*>(send.first);
+        c->setBatchedSendResult(send.second);
+        run_event_loop(c, EV_WRITE);
+    }
 }
 
 /*
@@ -229,7 +268,24 @@ static void worker_libevent(void *arg) {
     cb_cond_signal(&init_cond);
     cb_mutex_exit(&init_lock);
 
-    event_base_loop(me->base, 0);
+    // Run a single pass over the ready events at a time so that we may
+    // submit all of the sends they queued up with a single system call
+    // (and don't block waiting for new events while there is still
+    // pending output).
+    bool stopped = false;
+    while (me->io_uring && !stopped) {
+        stopped = event_base_loop(me->base,
+                                  me->io_uring->empty() ? EVLOOP_ONCE
+                                                        : EVLOOP_NONBLOCK) !=
+                          0 ||
+                  event_base_got_break(me->base);
+        if (!stopped) {
+            flush_io_uring(me);
+        }
+    }
+    if (!stopped) {
+        event_base_loop(me->base, 0);
+    }
 
     // Event loop exited; cleanup before thread exits.
     ERR_remove_state(0);
@@ -571,8 +627,9 @@ void threads_cleanup(void)
         safe_close(threads[ii].notify[0]);
         safe_close(threads[ii].notify[1]);
         event_base_free(threads[ii].base);
-        threads[ii].read.reset();
-        threads[ii].write.reset();
+        threads[ii].read.clear();
+        threads[ii].write.clear();
+        threads[ii].io_uring.reset();
         subdoc_op_free(threads[ii].subdoc_op);
         delete threads[ii].validator;
         delete threads[ii].new_conn_queue;
@@ -582,6 +639,17 @@ void threads_cleanup(void)
     cb_free(threads);
 }
 
+void threads_get_buffer_pool_stats(size_t& rbufs,
+                                   size_t& wbufs,
+                                   size_t& bytes) {
+    rbufs = wbufs = bytes = 0;
+    for (int ii = 0; ii < nthreads; ++ii) {
+        rbufs += threads[ii].read.size();
+        wbufs += threads[ii].write.size();
+        bytes += threads[ii].read.bytes() + threads[ii].write.bytes();
+    }
+}
+
 void threads_notify_bucket_deletion(void)
 {
     for (int ii = 0; ii < nthreads; ++ii) {
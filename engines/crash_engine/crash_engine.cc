@@ -173,6 +173,17 @@ static cb::EngineErrorItemPair get(ENGINE_HANDLE* handle,
     return cb::makeEngineErrorItemPair(cb::engine_errc::failed);
 }
 
+static std::vector<cb::EngineErrorItemPair> get_multi(
+        ENGINE_HANDLE* handle,
+        const void*,
+        const std::vector<cb::KeyAndVBucket>& keys) {
+    std::vector<cb::EngineErrorItemPair> ret;
+    for (size_t ii = 0; ii < keys.size(); ++ii) {
+        ret.emplace_back(cb::makeEngineErrorItemPair(cb::engine_errc::failed));
+    }
+    return ret;
+}
+
 static cb::EngineErrorItemPair get_if(ENGINE_HANDLE* handle,
                                       const void*,
                                       const DocKey&,
@@ -287,6 +298,7 @@ ENGINE_ERROR_CODE create_instance(uint64_t interface,
     engine->engine.remove = item_delete;
     engine->engine.release = item_release;
     engine->engine.get = get;
+    engine->engine.get_multi = get_multi;
     engine->engine.get_if = get_if;
     engine->engine.get_and_touch = get_and_touch;
     engine->engine.get_locked = get_locked;
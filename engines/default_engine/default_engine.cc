@@ -61,6 +61,11 @@ static cb::EngineErrorItemPair default_get(ENGINE_HANDLE* handle,
                                            uint16_t vbucket,
                                            DocStateFilter);
 
+static std::vector<cb::EngineErrorItemPair> default_get_multi(
+        ENGINE_HANDLE* handle,
+        const void* cookie,
+        const std::vector<cb::KeyAndVBucket>& keys);
+
 static cb::EngineErrorItemPair default_get_if(ENGINE_HANDLE*,
                                               const void*,
                                               const DocKey&,
@@ -187,6 +192,7 @@ void default_engine_constructor(struct default_engine* engine, bucket_id_t id)
     engine->engine.remove = default_item_delete;
     engine->engine.release = default_item_release;
     engine->engine.get = default_get;
+    engine->engine.get_multi = default_get_multi;
     engine->engine.get_if = default_get_if;
     engine->engine.get_locked = default_get_locked;
     engine->engine.get_meta = default_get_meta;
@@ -470,6 +476,20 @@ static cb::EngineErrorItemPair default_get(ENGINE_HANDLE* handle,
     }
 }
 
+static std::vector<cb::EngineErrorItemPair> default_get_multi(
+        ENGINE_HANDLE* handle,
+        const void* cookie,
+        const std::vector<cb::KeyAndVBucket>& keys) {
+    // Everything is memory-resident; simply look up each key in turn.
+    std::vector<cb::EngineErrorItemPair> ret;
+    ret.reserve(keys.size());
+    for (const auto& k : keys) {
+        ret.emplace_back(default_get(
+                handle, cookie, k.key, k.vbucket, DocStateFilter::Alive));
+    }
+    return ret;
+}
+
 static cb::EngineErrorItemPair default_get_if(
         ENGINE_HANDLE* handle,
         const void* cookie,
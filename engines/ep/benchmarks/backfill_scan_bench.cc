@@ -0,0 +1,228 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <platform/dirutils.h>
+
+#include "callbacks.h"
+#include "item.h"
+#include "kvstore.h"
+#include "kvstore_config.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <mutex>
+#include <random>
+
+static const std::string scanBenchDir = "backfill-scan-bench.db";
+static const uint16_t scanBenchVbid = 0;
+static const int scanBenchBatches = 100;
+static const int scanBenchBatchSize = 1000;
+static const size_t scanBenchValueSize = 1000;
+
+class ScanBenchWriteCallback : public Callback<mutation_result> {
+public:
+    void callback(mutation_result& result) override {
+    }
+};
+
+/**
+ * Fixture scanning (as a backfill does) the whole of a generated couchstore
+ * file, written in a number of commits so the documents and B-tree nodes
+ * are interleaved like those of a real vbucket.
+ *
+ * The file is generated once per process (and removed at exit); each
+ * benchmark opens it with its own CouchKVStore.
+ */
+class BackfillScanBench : public benchmark::Fixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        static std::once_flag generated;
+        std::call_once(generated, generateFile);
+
+        KVStoreConfig config(1024,
+                             4,
+                             scanBenchDir,
+                             "couchdb",
+                             0,
+                             false /*persistnamespace*/);
+        config.setScanReadAheadSize(state.range(0));
+        kvstore = KVStoreFactory::create(config).rw;
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        kvstore.reset();
+    }
+
+    static void generateFile() {
+        cb::io::rmrf(scanBenchDir);
+        std::atexit([]() { cb::io::rmrf(scanBenchDir); });
+
+        KVStoreConfig config(1024,
+                             4,
+                             scanBenchDir,
+                             "couchdb",
+                             0,
+                             false /*persistnamespace*/);
+        auto store = KVStoreFactory::create(config);
+        auto& rw = *store.rw;
+        std::string failoverLog("");
+        vbucket_state state(vbucket_state_active,
+                            0,
+                            0,
+                            0,
+                            0,
+                            0,
+                            0,
+                            0,
+                            0,
+                            false,
+                            failoverLog);
+        rw.incrementRevision(scanBenchVbid);
+        rw.snapshotVBucket(scanBenchVbid,
+                           state,
+                           VBStatePersist::VBSTATE_PERSIST_WITHOUT_COMMIT);
+
+        // Random values, so they don't compress (as a repetitive value
+        // would) and the file is as large as the values written.
+        std::mt19937 gen;
+        std::uniform_int_distribution<int> dist(0, 255);
+        std::string value(scanBenchValueSize, '\0');
+        ScanBenchWriteCallback wc;
+        int64_t seqno = 0;
+        for (int batch = 0; batch < scanBenchBatches; ++batch) {
+            rw.begin();
+            for (int ii = 0; ii < scanBenchBatchSize; ++ii) {
+                ++seqno;
+                for (auto& c : value) {
+                    c = char(dist(gen));
+                }
+                Item item({"key" + std::to_string(seqno),
+                           DocNamespace::DefaultCollection},
+                          /*flags*/ 0,
+                          /*exp*/ 0,
+                          value.data(),
+                          value.size(),
+                          PROTOCOL_BINARY_RAW_BYTES,
+                          /*cas*/ 0,
+                          seqno,
+                          scanBenchVbid);
+                rw.set(item, wc);
+            }
+            rw.commit(nullptr /*no collections manifest*/);
+        }
+    }
+
+    /// Drop the file's pages from the OS page cache, so it's read from disk
+    static void evictFromPageCache() {
+        for (const auto& file :
+             cb::io::findFilesContaining(scanBenchDir, ".couch.")) {
+            const int fd = ::open(file.c_str(), O_RDONLY);
+            if (fd != -1) {
+#ifdef POSIX_FADV_DONTNEED
+                posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+                ::close(fd);
+            }
+        }
+    }
+
+    std::unique_ptr<KVStore> kvstore;
+};
+
+class ScanBenchGetCallback : public Callback<GetValue> {
+public:
+    void callback(GetValue& result) override {
+        bytes += result.item->getKey().size() + result.item->getNBytes();
+    }
+
+    /// The key and value bytes the scan returned
+    size_t bytes = 0;
+};
+
+class ScanBenchCacheCallback : public Callback<CacheLookup> {
+public:
+    void callback(CacheLookup& lookup) override {
+    }
+};
+
+/*
+ * Measures the rate (in key and value bytes returned) at which a backfill
+ * scan reads the vbucket's documents, so the rate doesn't depend on how
+ * much the read-ahead reads from the file. The read-ahead's reads and hits
+ * per scan are reported as separate counters.
+ * Variables:
+ *  - range(0) : The scan read-ahead size (0 to disable read-ahead)
+ *  - range(1) : 1 if the file is evicted from the page cache before each
+ *               scan (cold), 0 if it's left cached (warm)
+ */
+BENCHMARK_DEFINE_F(BackfillScanBench, Scan)(benchmark::State& state) {
+    const bool cold = state.range(1) != 0;
+    size_t bytesScanned = 0;
+    size_t readAheadReads = 0;
+    size_t readAheadHits = 0;
+    while (state.KeepRunning()) {
+        if (cold) {
+            state.PauseTiming();
+            evictFromPageCache();
+            state.ResumeTiming();
+        }
+
+        size_t readsBefore = 0;
+        size_t hitsBefore = 0;
+        kvstore->getStat("Scan_read_ahead_reads", readsBefore);
+        kvstore->getStat("Scan_read_ahead_hits", hitsBefore);
+
+        auto cb = std::make_shared<ScanBenchGetCallback>();
+        auto cl = std::make_shared<ScanBenchCacheCallback>();
+        auto* ctx = kvstore->initScanContext(cb,
+                                             cl,
+                                             scanBenchVbid,
+                                             1,
+                                             DocumentFilter::ALL_ITEMS,
+                                             ValueFilter::VALUES_COMPRESSED);
+        if (!ctx || kvstore->scan(ctx) != scan_success) {
+            state.SkipWithError("Scan failed");
+        }
+        kvstore->destroyScanContext(ctx);
+        bytesScanned += cb->bytes;
+
+        size_t readsAfter = 0;
+        size_t hitsAfter = 0;
+        kvstore->getStat("Scan_read_ahead_reads", readsAfter);
+        kvstore->getStat("Scan_read_ahead_hits", hitsAfter);
+        readAheadReads += readsAfter - readsBefore;
+        readAheadHits += hitsAfter - hitsBefore;
+    }
+    state.SetBytesProcessed(bytesScanned);
+    if (state.iterations() > 0) {
+        state.counters["scan_read_ahead_reads"] =
+                double(readAheadReads) / state.iterations();
+        state.counters["scan_read_ahead_hits"] =
+                double(readAheadHits) / state.iterations();
+    }
+}
+
+BENCHMARK_REGISTER_F(BackfillScanBench, Scan)
+        ->Args({0, 0})
+        ->Args({256 * 1024, 0})
+        ->Args({0, 1})
+        ->Args({64 * 1024, 1})
+        ->Args({256 * 1024, 1})
+        ->Args({1024 * 1024, 1});
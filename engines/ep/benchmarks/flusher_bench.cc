@@ -0,0 +1,113 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <fakes/fake_executorpool.h>
+#include <mock/mock_kvstore.h>
+#include <mock/mock_synchronous_ep_engine.h>
+#include <programs/engine_testapp/mock_server.h>
+
+#include "dcp/dcpconnmap.h"
+#include "ep_time.h"
+#include "item.h"
+#include "kvshard.h"
+
+/**
+ * Fixture running the flusher of a single vbucket against a MockKVStore,
+ * so only the cost of the flush path itself (fetching the items from the
+ * checkpoint, creating the persistence callbacks and running them) is
+ * measured.
+ */
+class FlusherBench : public benchmark::Fixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        SingleThreadedExecutorPool::replaceExecutorPoolWithFake();
+        executorPool = reinterpret_cast<SingleThreadedExecutorPool*>(
+                ExecutorPool::get());
+
+        engine.reset(new SynchronousEPEngine("dbname=flusher-bench"));
+        ObjectRegistry::onSwitchThread(engine.get());
+
+        engine->setKVBucket(
+                engine->public_makeBucket(engine->getConfiguration()));
+        engine->public_initializeEngineCallbacks();
+        initialize_time_functions(get_mock_server_api()->core);
+        cookie = create_mock_cookie();
+
+        auto* store = engine->getKVBucket();
+        store->setVBucketState(vbid, vbucket_state_active, false);
+        auto* shard = store->getVBucket(vbid)->getShard();
+        shard->setRWUnderlying(std::make_unique<MockKVStore>(
+                shard->getRWUnderlying()->getConfig()));
+        // Persist the initial vbucket state
+        store->flushVBucket(vbid);
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        executorPool->cancelAndClearAll();
+        destroy_mock_cookie(cookie);
+        destroy_mock_event_callbacks();
+        engine->getDcpConnMap().manageConnections();
+        engine.reset();
+        ObjectRegistry::onSwitchThread(nullptr);
+        ExecutorPool::shutdown();
+    }
+
+    std::unique_ptr<SynchronousEPEngine> engine;
+    const void* cookie = nullptr;
+    SingleThreadedExecutorPool* executorPool;
+    const uint16_t vbid = 0;
+};
+
+/*
+ * Measures the rate at which the flusher persists items.
+ * Variables:
+ *  - range(0) : The number of items written before each flush
+ */
+BENCHMARK_DEFINE_F(FlusherBench, FlushVBucket)(benchmark::State& state) {
+    auto* store = engine->getKVBucket();
+    const std::string value(200, 'x');
+    const std::string keyPrefix(20, 'a');
+
+    size_t itemsFlushed = 0;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        for (int ii = 0; ii < state.range(0); ++ii) {
+            Item item({keyPrefix + std::to_string(ii),
+                       DocNamespace::DefaultCollection},
+                      /*flags*/ 0,
+                      /*exp*/ 0,
+                      value.c_str(),
+                      value.size(),
+                      PROTOCOL_BINARY_DATATYPE_JSON);
+            item.setVBucketId(vbid);
+            store->set(item, cookie);
+        }
+        state.ResumeTiming();
+
+        const int flushed = store->flushVBucket(vbid);
+        if (flushed > 0) {
+            itemsFlushed += flushed;
+        }
+    }
+    state.SetItemsProcessed(itemsFlushed);
+}
+
+BENCHMARK_REGISTER_F(FlusherBench, FlushVBucket)
+        ->Arg(100)
+        ->Arg(1000)
+        ->Arg(10000);
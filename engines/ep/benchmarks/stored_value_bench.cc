@@ -0,0 +1,161 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks measuring the per-item memory overhead of StoredValue and
+ * OrderedStoredValue.
+ */
+
+#include "benchmark_memory_tracker.h"
+#include "item.h"
+#include "stats.h"
+#include "stored_value_factories.h"
+
+#include <benchmark/benchmark.h>
+#include <boost/intrusive/list.hpp>
+#include <programs/engine_testapp/mock_server.h>
+#include <valgrind/valgrind.h>
+
+/**
+ * The fixed part of StoredValue prior to packing bySeqno and moving the lock
+ * expiry to trailing storage - used to report what each item's size would
+ * have been with the previous layout.
+ */
+struct LegacyStoredValue {
+    value_t value;
+    StoredValue::UniquePtr chain_next_or_replacement;
+    uint64_t cas;
+    uint64_t revSeqno;
+    int64_t bySeqno;
+    rel_time_t lock_expiry_or_delete_time;
+    uint32_t exptime;
+    uint32_t flags;
+    protocol_binary_datatype_t datatype;
+    bool _isDirty : 1;
+    bool deleted : 1;
+    bool newCacheItem : 1;
+    bool isOrdered : 1;
+    uint8_t nru : 2;
+    bool resident : 1;
+    bool unused : 1;
+    std::atomic<bool> stale;
+};
+
+/// The previous layout of OrderedStoredValue.
+struct LegacyOrderedStoredValue : public LegacyStoredValue {
+    boost::intrusive::list_member_hook<> seqno_hook;
+};
+
+class StoredValueBench : public benchmark::Fixture {
+public:
+    void SetUp(const benchmark::State& state) override {
+        memoryTracker = BenchmarkMemoryTracker::getInstance(
+                *get_mock_server_api()->alloc_hooks);
+        memoryTracker->reset();
+
+        // The first parameter selects the StoredValue type.
+        if (state.range(0) == 0) {
+            factory = std::make_unique<StoredValueFactory>(stats);
+            legacyFixedSize = sizeof(LegacyStoredValue);
+        } else {
+            factory = std::make_unique<OrderedStoredValueFactory>(stats);
+            legacyFixedSize = sizeof(LegacyOrderedStoredValue);
+        }
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        factory.reset();
+        memoryTracker->destroyInstance();
+    }
+
+protected:
+    /**
+     * Create the given number of metadata-only Items (no value, so only the
+     * StoredValue itself is measured) with keys of the given length.
+     */
+    std::vector<Item> makeItems(size_t count, size_t keyLen) {
+        std::vector<Item> items;
+        items.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            auto key = std::to_string(i);
+            key.insert(0, keyLen - std::min(keyLen, key.size()), 'k');
+            items.emplace_back(
+                    StoredDocKey(key, DocNamespace::DefaultCollection),
+                    /*flags*/ 0,
+                    /*exptime*/ 0,
+                    value_t{},
+                    PROTOCOL_BINARY_RAW_BYTES,
+                    /*cas*/ i,
+                    /*bySeqno*/ i + 1);
+        }
+        return items;
+    }
+
+    BenchmarkMemoryTracker* memoryTracker;
+    EPStats stats;
+    std::unique_ptr<AbstractStoredValueFactory> factory;
+    size_t legacyFixedSize = 0;
+};
+
+/*
+ * Measure the bytes allocated per StoredValue (including allocator rounding),
+ * along with the object size reported by getObjectSize() and what that size
+ * would have been with the previous (unpacked) layout.
+ *
+ * Parameters: (0) StoredValue type (0=StoredValue, 1=OrderedStoredValue);
+ *             (1) key length.
+ */
+BENCHMARK_DEFINE_F(StoredValueBench, BytesPerItem)(benchmark::State& state) {
+    const size_t numItems = RUNNING_ON_VALGRIND ? 10 : 100000;
+    const auto items = makeItems(numItems, state.range(1));
+
+    std::vector<StoredValue::UniquePtr> values;
+    values.reserve(numItems);
+
+    size_t allocated = 0;
+    size_t objectSize = 0;
+    size_t keySize = 0;
+    while (state.KeepRunning()) {
+        const size_t baseMemory = memoryTracker->getCurrentAlloc();
+        for (const auto& item : items) {
+            values.push_back((*factory)(item, {}));
+        }
+        allocated = memoryTracker->getCurrentAlloc() - baseMemory;
+        objectSize = values.front()->getObjectSize();
+        keySize = values.front()->getKey().getObjectSize();
+
+        state.PauseTiming();
+        values.clear();
+        state.ResumeTiming();
+    }
+
+    state.SetItemsProcessed(state.iterations() * numItems);
+    state.counters["BytesPerItem"] = double(allocated) / numItems;
+    state.counters["ObjectSize"] = objectSize;
+    state.counters["LegacyObjectSize"] = legacyFixedSize + keySize;
+}
+
+static void StoredValueArguments(benchmark::internal::Benchmark* b) {
+    for (int type : {0, 1}) {
+        for (int keyLen : {10, 22, 40, 100}) {
+            b->ArgPair(type, keyLen);
+        }
+    }
+}
+
+BENCHMARK_REGISTER_F(StoredValueBench, BytesPerItem)
+        ->Apply(StoredValueArguments);
@@ -282,6 +282,24 @@ public:
         return value;
     }
 
+    /**
+     * Give up this pointer's reference to the object *without* decrementing
+     * the reference count. The reference must later be taken back with
+     * adopt(), or the object will be leaked.
+     */
+    T* release() {
+        T* rv = value;
+        value = nullptr;
+        return rv;
+    }
+
+    /// Take ownership of a reference previously given up with release()
+    static SingleThreadedRCPtr<T> adopt(T* released) {
+        SingleThreadedRCPtr<T> rv;
+        rv.value = released;
+        return rv;
+    }
+
     SingleThreadedRCPtr<T> & operator =(const SingleThreadedRCPtr<T> &other) {
         reset(other);
         return *this;
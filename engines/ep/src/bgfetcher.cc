@@ -37,16 +37,23 @@ BgFetcher::BgFetcher(KVBucket& s, KVShard& k)
 
 void BgFetcher::start() {
     ExecutorPool* iom = ExecutorPool::get();
-    auto task =
-            std::make_shared<MultiBGFetcherTask>(&(store->getEPEngine()), this);
-    this->setTaskId(task->getId());
-    iom->schedule(task);
+    const size_t numTasks =
+            store->getEPEngine().getConfiguration().getBgFetcherConcurrency();
+    for (size_t ii = 0; ii < numTasks; ++ii) {
+        auto task = std::make_shared<MultiBGFetcherTask>(
+                &(store->getEPEngine()), this);
+        taskIds.push_back(task->getId());
+        iom->schedule(task);
+    }
 }
 
 void BgFetcher::stop() {
     bool inverse = true;
     pendingFetch.compare_exchange_strong(inverse, false);
-    ExecutorPool::get()->cancel(taskId);
+    for (const auto id : taskIds) {
+        ExecutorPool::get()->cancel(id);
+    }
+    taskIds.clear();
 }
 
 void BgFetcher::notifyBGEvent(void) {
@@ -54,10 +61,31 @@ void BgFetcher::notifyBGEvent(void) {
     wakeUpTaskIfSnoozed();
 }
 
+void BgFetcher::deferWakeUps() {
+    ++wakeUpDeferrals;
+}
+
+void BgFetcher::resumeWakeUps() {
+    if (--wakeUpDeferrals == 0 && wakeUpDeferred.exchange(false)) {
+        wakeUpTaskIfSnoozed();
+    }
+}
+
 void BgFetcher::wakeUpTaskIfSnoozed() {
+    if (wakeUpDeferrals.load() > 0) {
+        wakeUpDeferred.store(true);
+        // Re-check in case the last resumeWakeUps() ran before we set the
+        // flag; if so we have to do the wake up ourselves.
+        if (wakeUpDeferrals.load() > 0) {
+            return;
+        }
+    }
+
     bool expected = false;
     if (pendingFetch.compare_exchange_strong(expected, true)) {
-        ExecutorPool::get()->wake(taskId);
+        for (const auto id : taskIds) {
+            ExecutorPool::get()->wake(id);
+        }
     }
 }
 
@@ -80,6 +108,9 @@ size_t BgFetcher::doFetch(VBucket::id_type vbId,
                 .count());
 
     shard->getROUnderlying()->getMulti(vbId, itemsToFetch);
+    stats.bgFetchDiskHisto.add(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                    ProcessClock::now() - startTime));
 
     std::vector<bgfetched_item_t> fetchedItems;
     for (const auto& fetch : itemsToFetch) {
@@ -125,24 +156,31 @@ bool BgFetcher::run(GlobalTask *task) {
     task->snooze(INT_MAX);
     pendingFetch.store(false);
 
-    std::vector<uint16_t> bg_vbs(pendingVbs.size());
-    {
-        LockHolder lh(queueMutex);
-        bg_vbs.assign(pendingVbs.begin(), pendingVbs.end());
-        pendingVbs.clear();
-    }
-
+    // Take one vbucket at a time (rather than all of them) so that any
+    // other tasks of this BgFetcher can fetch the remaining vbuckets
+    // concurrently.
+    std::vector<uint16_t> requeue;
     size_t num_fetched_items = 0;
-    for (const uint16_t vbId : bg_vbs) {
+    while (true) {
+        uint16_t vbId;
+        {
+            LockHolder lh(queueMutex);
+            if (pendingVbs.empty()) {
+                break;
+            }
+            auto next = pendingVbs.begin();
+            vbId = next->first;
+            stats.bgFetchQueueHisto.add(
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                            ProcessClock::now() - next->second));
+            pendingVbs.erase(next);
+        }
+
         VBucketPtr vb = shard->getBucket(vbId);
         if (vb) {
             // Requeue the bg fetch task if vbucket DB file is not created yet.
             if (vb->isBucketCreation()) {
-                {
-                    LockHolder lh(queueMutex);
-                    pendingVbs.insert(vbId);
-                }
-                wakeUpTaskIfSnoozed();
+                requeue.push_back(vbId);
                 continue;
             }
 
@@ -153,6 +191,13 @@ bool BgFetcher::run(GlobalTask *task) {
         }
     }
 
+    if (!requeue.empty()) {
+        for (const auto vbId : requeue) {
+            addPendingVB(vbId);
+        }
+        wakeUpTaskIfSnoozed();
+    }
+
     stats.numRemainingBgItems.fetch_sub(num_fetched_items);
 
     return true;
@@ -21,8 +21,9 @@
 #include "config.h"
 
 #include <list>
-#include <set>
+#include <map>
 #include <string>
+#include <vector>
 
 #include "item.h"
 #include "stats.h"
@@ -35,7 +36,12 @@ class GlobalTask;
 
 /**
  * Dispatcher job responsible for batching data reads and push to
- * underlying storage
+ * underlying storage.
+ *
+ * Each shard's BgFetcher runs bg_fetcher_concurrency MultiBGFetcherTasks
+ * which all take vbuckets from the same pending set, so a vbucket with
+ * outstanding fetches doesn't have to wait behind every other vbucket's
+ * (blocking) getMulti.
  */
 class BgFetcher {
 public:
@@ -47,7 +53,7 @@ public:
      * @param st reference to statistics
      */
     BgFetcher(KVBucket* s, KVShard* k, EPStats &st) :
-        store(s), shard(k), taskId(0), stats(st), pendingFetch(false) {}
+        store(s), shard(k), stats(st), pendingFetch(false) {}
 
     /**
      * Construct a BgFetcher
@@ -75,28 +81,43 @@ public:
     bool run(GlobalTask *task);
     bool pendingJob(void) const;
     void notifyBGEvent(void);
-    void setTaskId(size_t newId) { taskId = newId; }
+
+    /**
+     * Hold back waking the fetch tasks until the matching resumeWakeUps(),
+     * so that fetches queued by a single request (e.g. GET_MULTI) are
+     * serviced as one batch rather than split across task runs. Calls may
+     * be nested and may come from different threads.
+     */
+    void deferWakeUps();
+    void resumeWakeUps();
+
     void addPendingVB(VBucket::id_type vbId) {
         LockHolder lh(queueMutex);
-        pendingVbs.insert(vbId);
+        // Keep the time the vbucket was first queued if already pending
+        pendingVbs.emplace(vbId, ProcessClock::now());
     }
 
 private:
     size_t doFetch(VBucket::id_type vbId, vb_bgfetch_queue_t& items);
 
-    /// If the BGFetch task is currently snoozed (not scheduled to
-    /// run), wake it up. Has no effect the if the task has already
+    /// If the BGFetch tasks are currently snoozed (not scheduled to
+    /// run), wake them up. Has no effect the if the tasks have already
     /// been woken.
     void wakeUpTaskIfSnoozed();
 
     KVBucket* store;
     KVShard* shard;
-    size_t taskId;
+    std::vector<size_t> taskIds;
     std::mutex queueMutex;
     EPStats &stats;
 
     std::atomic<bool> pendingFetch;
-    std::set<VBucket::id_type> pendingVbs;
+    // Outstanding deferWakeUps() calls, and whether a wake up was held
+    // back by one of them
+    std::atomic<size_t> wakeUpDeferrals{0};
+    std::atomic<bool> wakeUpDeferred{false};
+    // vbuckets with outstanding fetches, and when each was queued
+    std::map<VBucket::id_type, ProcessClock::time_point> pendingVbs;
 };
 
 #endif  // SRC_BGFETCHER_H_
@@ -17,8 +17,11 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <platform/checked_snprintf.h>
+#include <platform/processclock.h>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -89,8 +92,12 @@ Checkpoint::Checkpoint(EPStats& st,
       checkpointState(CHECKPOINT_OPEN),
       numItems(0),
       numMetaItems(0),
+      toWrite(CheckpointQueue::allocator_type(arena)),
+      keyIndex(checkpoint_index::allocator_type(arena)),
+      metaKeyIndex(checkpoint_index::allocator_type(arena)),
       memOverhead(0),
-      effectiveMemUsage(0) {
+      effectiveMemUsage(0),
+      highestExpelledSeqno(0) {
     stats.memOverhead->fetch_add(memorySize());
     if (stats.memOverhead->load() >= GIGANTOR) {
         LOG(EXTENSION_LOG_WARNING,
@@ -130,12 +137,40 @@ void Checkpoint::popBackCheckpointEndItem() {
     }
 }
 
+size_t Checkpoint::expelItems(CheckpointQueue::iterator last,
+                              std::vector<queued_item>& expelled) {
+    size_t count = 0;
+    auto it = toWrite.begin();
+    while (it != last) {
+        if ((*it)->isCheckPointMetaItem()) {
+            ++it;
+            continue;
+        }
+
+        const auto& qi = *it;
+        keyIndex.erase(qi->getKey());
+        const size_t entrySize =
+                qi->getKey().size() + sizeof(index_entry) + sizeof(queued_item);
+        memOverhead -= entrySize;
+        stats.memOverhead->fetch_sub(entrySize);
+        effectiveMemUsage -= std::min(effectiveMemUsage, qi->size());
+        highestExpelledSeqno = qi->getBySeqno();
+
+        expelled.push_back(qi);
+        it = toWrite.erase(it);
+        ++count;
+    }
+    numItems -= count;
+    return count;
+}
+
 bool Checkpoint::keyExists(const DocKey& key) {
     return keyIndex.find(key) != keyIndex.end();
 }
 
 queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
-                                     CheckpointManager *checkpointManager) {
+                                     CheckpointManager *checkpointManager,
+                                     queued_item* replaced) {
     if (checkpointState != CHECKPOINT_OPEN) {
         throw std::logic_error("Checkpoint::queueDirty: checkpointState "
                         "(which is" + std::to_string(checkpointState) +
@@ -215,6 +250,11 @@ queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
             }
 
             toWrite.push_back(qi);
+            if (replaced) {
+                // Keep a reference to the old item so it isn't freed here
+                // (under the queueLock) when it's erased.
+                *replaced = *currPos;
+            }
             // Remove the existing item for the same key from the list.
             toWrite.erase(currPos);
         } else {
@@ -431,6 +471,15 @@ CheckpointManager::CheckpointManager(EPStats& st,
       lastBySeqno(lastSeqno),
       isCollapsedCheckpoint(false),
       pCursorPreCheckpointId(0),
+      persistedSeqno(lastSeqno),
+      numClears(0),
+      queueLockContended(0),
+      numItemsExpelled(0),
+      memFreedByExpel(0),
+      numUnlockedReads(0),
+      compressedValuesLowSeqno(lastSeqno + 1),
+      compressedValuesReleases(0),
+      compressedValuesMemUsage(0),
       flusherCB(cb) {
     LockHolder lh(queueLock);
     addNewCheckpoint_UNLOCKED(1, lastSnapStart, lastSnapEnd);
@@ -519,7 +568,7 @@ bool CheckpointManager::addNewCheckpoint_UNLOCKED(uint64_t id,
         id, vbucketId, snapStartSeqno);
 
     bool was_empty = checkpointList.empty() ? true : false;
-    auto checkpoint = std::make_unique<Checkpoint>(stats, id, snapStartSeqno,
+    auto checkpoint = std::make_shared<Checkpoint>(stats, id, snapStartSeqno,
                                             snapEndSeqno, vbucketId);
     // Add a dummy item into the new checkpoint, so that any cursor referring
     // to the actual first
@@ -612,7 +661,7 @@ bool CheckpointManager::registerCursor(
                             uint64_t checkpointId,
                             bool alwaysFromBeginning,
                             MustSendCheckpointEnd needsCheckpointEndMetaItem) {
-    LockHolder lh(queueLock);
+    auto lh = lockQueue();
     return registerCursor_UNLOCKED(name, checkpointId, alwaysFromBeginning,
                                    needsCheckpointEndMetaItem);
 }
@@ -621,7 +670,7 @@ CursorRegResult CheckpointManager::registerCursorBySeqno(
                             const std::string &name,
                             uint64_t startBySeqno,
                             MustSendCheckpointEnd needsCheckPointEndMetaItem) {
-    LockHolder lh(queueLock);
+    auto lh = lockQueue();
     if (checkpointList.empty()) {
         throw std::logic_error("CheckpointManager::registerCursorBySeqno: "
                         "checkpointList is empty");
@@ -655,7 +704,8 @@ CursorRegResult CheckpointManager::registerCursorBySeqno(
                                                  false,
                                                  needsCheckPointEndMetaItem);
             (*itr)->registerCursorName(name);
-            result.first = (*itr)->getLowSeqno();
+            // The items before the cursor position may have been expelled.
+            result.first = (*itr)->getMinimumCursorSeqno();
             break;
         } else if (startBySeqno <= en) {
             // Requested sequence number lies within this checkpoint.
@@ -691,8 +741,10 @@ CursorRegResult CheckpointManager::registerCursorBySeqno(
         }
     }
 
-    result.second = (result.first == checkpointList.front()->getLowSeqno()) ?
-                    true : false;
+    // If the cursor starts at the first seqno we have in memory (allowing
+    // for expelled items), earlier seqnos may need to be backfilled.
+    result.second =
+            result.first <= checkpointList.front()->getMinimumCursorSeqno();
 
     if (result.first == std::numeric_limits<uint64_t>::max()) {
         /*
@@ -971,6 +1023,10 @@ size_t CheckpointManager::removeClosedUnrefCheckpoints(
     }
     unrefCheckpointList.splice(unrefCheckpointList.begin(), checkpointList,
                                checkpointList.begin(), it);
+    if (!unrefCheckpointList.empty()) {
+        releaseCompressedValues_UNLOCKED(
+                checkpointList.front()->getMinimumCursorSeqno());
+    }
 
     // If any cursor on a replica vbucket or downstream active vbucket
     // receiving checkpoints from
@@ -990,6 +1046,79 @@ size_t CheckpointManager::removeClosedUnrefCheckpoints(
     return numUnrefItems;
 }
 
+CheckpointManager::ExpelResult
+CheckpointManager::expelUnreferencedCheckpointItems() {
+    // Declared before the lock so that the items are released after the
+    // lock has been dropped.
+    std::vector<queued_item> expelled;
+    ExpelResult result;
+
+    auto lh = lockQueue();
+    auto& checkpoint = *checkpointList.front();
+    // An unreferenced checkpoint is removed as a whole (once closed) by
+    // removeClosedUnrefCheckpoints. Nothing is expelled while a cursor is
+    // reading the closed checkpoints without the lock.
+    if (checkpoint.getNumberOfCursors() == 0 || numUnlockedReads > 0) {
+        return result;
+    }
+
+    // Find the first item in the checkpoint which a cursor points to;
+    // everything before it has been processed by all of the cursors.
+    std::unordered_set<const Item*> cursorItems;
+    for (const auto& cursor : connCursors) {
+        if (cursor.second.currentCheckpoint == checkpointList.begin()) {
+            cursorItems.insert(cursor.second.currentPos->get());
+        }
+    }
+    auto last = checkpoint.begin();
+    while (last != checkpoint.end() && cursorItems.count(last->get()) == 0) {
+        ++last;
+    }
+    if (last == checkpoint.end()) {
+        throw std::logic_error(
+                "CheckpointManager::expelUnreferencedCheckpointItems: no "
+                "cursor position found in checkpoint " +
+                std::to_string(checkpoint.getId()) + " vb:" +
+                std::to_string(vbucketId));
+    }
+
+    // Stop at the first item which isn't persisted yet (the persistence
+    // cursor may have read it into a flush batch which isn't committed),
+    // unless the whole checkpoint has been persisted.
+    if (checkpointConfig.isPersistenceEnabled() &&
+        checkpoint.getId() > pCursorPreCheckpointId) {
+        auto it = checkpoint.begin();
+        while (it != last &&
+               uint64_t((*it)->getBySeqno()) <= persistedSeqno) {
+            ++it;
+        }
+        last = it;
+    }
+
+    result.count = checkpoint.expelItems(last, expelled);
+    if (result.count == 0) {
+        return result;
+    }
+
+    for (const auto& qi : expelled) {
+        // Only the items we hold the last reference to are freed; anything
+        // still referenced elsewhere (e.g. a DCP stream's readyQ) isn't
+        // released by expelling it.
+        if (qi.refCount() == 1) {
+            result.memory += qi->size();
+        }
+    }
+    numItems.fetch_sub(result.count);
+    for (auto& cursor : connCursors) {
+        cursor.second.decrOffset(result.count);
+    }
+    releaseCompressedValues_UNLOCKED(checkpoint.getMinimumCursorSeqno());
+    numItemsExpelled += result.count;
+    memFreedByExpel += result.memory;
+
+    return result;
+}
+
 void CheckpointManager::removeInvalidCursorsOnCheckpoint(
                                                      Checkpoint *pCheckpoint) {
     std::list<std::string> invalidCursorNames;
@@ -1011,6 +1140,12 @@ void CheckpointManager::removeInvalidCursorsOnCheckpoint(
 
 void CheckpointManager::collapseClosedCheckpoints(
         CheckpointList& collapsedChks) {
+    // Collapsing modifies the closed checkpoints, which a cursor may be
+    // reading without the lock.
+    if (numUnlockedReads > 0) {
+        return;
+    }
+
     // If there are one open checkpoint and more than one closed checkpoint,
     // collapse those
     // closed checkpoints into one checkpoint to reduce the memory overhead.
@@ -1117,9 +1252,10 @@ std::vector<std::string> CheckpointManager::getListOfCursorsToDrop() {
     return cursorsToDrop;
 }
 
-void CheckpointManager::updateStatsForNewQueuedItem_UNLOCKED(const LockHolder&,
-                                                             VBucket& vb,
-                                                             const queued_item& qi) {
+void CheckpointManager::updateStatsForNewQueuedItem_UNLOCKED(
+        const std::unique_lock<std::mutex>&,
+        VBucket& vb,
+        const queued_item& qi) {
     ++stats.totalEnqueued;
     if (checkpointConfig.isPersistenceEnabled()) {
         ++stats.diskQueueSize;
@@ -1135,7 +1271,10 @@ bool CheckpointManager::queueDirty(
         const GenerateBySeqno generateBySeqno,
         const GenerateCas generateCas,
         PreLinkDocumentContext* preLinkDocumentContext) {
-    LockHolder lh(queueLock);
+    // Declared before the lock so that an item replaced by de-duplication is
+    // released after the lock has been dropped.
+    queued_item replaced;
+    auto lh = lockQueue();
 
     bool canCreateNewCheckpoint = false;
     if (checkpointList.size() < checkpointConfig.getMaxCheckpoints() ||
@@ -1200,11 +1339,16 @@ bool CheckpointManager::queueDirty(
                 " genSeqno:" + to_string(generateBySeqno));
     }
 
-    queue_dirty_t result = checkpointList.back()->queueDirty(qi, this);
+    queue_dirty_t result =
+            checkpointList.back()->queueDirty(qi, this, &replaced);
 
     if (result == NEW_ITEM) {
         ++numItems;
     }
+    if (replaced) {
+        // The de-duplicated seqno is no longer in memory
+        releaseCompressedValue_UNLOCKED(replaced->getBySeqno());
+    }
 
     if (result != EXISTING_ITEM) {
         updateStatsForNewQueuedItem_UNLOCKED(lh, vb, qi);
@@ -1215,7 +1359,7 @@ bool CheckpointManager::queueDirty(
 
 void CheckpointManager::queueSetVBState(VBucket& vb) {
     // Take lock to serialize use of {lastBySeqno} and to queue op.
-    LockHolder lh(queueLock);
+    auto lh = lockQueue();
 
     // Create the setVBState operation, and enqueue it.
     queued_item item = createCheckpointItem(/*id*/0, vbucketId,
@@ -1236,7 +1380,7 @@ void CheckpointManager::queueSetVBState(VBucket& vb) {
 snapshot_range_t CheckpointManager::getAllItemsForCursor(
                                              const std::string& name,
                                              std::vector<queued_item> &items) {
-    LockHolder lh(queueLock);
+    auto lh = lockQueue();
     snapshot_range_t range;
     cursor_index::iterator it = connCursors.find(name);
     if (it == connCursors.end()) {
@@ -1245,9 +1389,31 @@ snapshot_range_t CheckpointManager::getAllItemsForCursor(
         return range;
     }
 
-    bool moreItems;
+    // Size the vector up front (numItems less the items already read is an
+    // upper bound) so it isn't repeatedly grown while holding the lock.
+    const size_t offset = it->second.offset;
+    if (numItems > offset) {
+        items.reserve(items.size() + (numItems - offset));
+    }
+
     range.start = (*it->second.currentCheckpoint)->getSnapshotStartSeqno();
     range.end = (*it->second.currentCheckpoint)->getSnapshotEndSeqno();
+
+    const bool readClosed = readClosedCheckpoints(lh, name, items);
+    // The cursor may have been moved or removed while the lock was released
+    // (in which case nothing was read).
+    it = connCursors.find(name);
+    if (it == connCursors.end()) {
+        range.start = 0;
+        range.end = 0;
+        return range;
+    }
+    if (!readClosed) {
+        range.start = (*it->second.currentCheckpoint)->getSnapshotStartSeqno();
+        range.end = (*it->second.currentCheckpoint)->getSnapshotEndSeqno();
+    }
+
+    bool moreItems;
     while ((moreItems = incrCursor(it->second))) {
         queued_item& qi = *(it->second.currentPos);
         items.push_back(qi);
@@ -1271,9 +1437,129 @@ snapshot_range_t CheckpointManager::getAllItemsForCursor(
     return range;
 }
 
+bool CheckpointManager::readClosedCheckpoints(
+        std::unique_lock<std::mutex>& lh,
+        const std::string& name,
+        std::vector<queued_item>& items) {
+    auto it = connCursors.find(name);
+    // The open checkpoint is always the last one.
+    const auto open = std::prev(checkpointList.end());
+    if (it == connCursors.end() || it->second.currentCheckpoint == open) {
+        return false;
+    }
+
+    // Hold references to the checkpoints, in case they're removed (e.g. by
+    // a clear) while the lock is released.
+    const std::vector<std::shared_ptr<Checkpoint>> checkpoints(
+            it->second.currentCheckpoint, open);
+    const auto startPos = it->second.currentPos;
+    const auto clears = numClears;
+    ++numUnlockedReads;
+    lh.unlock();
+
+    const size_t before = items.size();
+    try {
+        auto pos = startPos;
+        for (const auto& checkpoint : checkpoints) {
+            if (checkpoint != checkpoints.front()) {
+                pos = checkpoint->begin();
+            }
+            while (++pos != checkpoint->end()) {
+                items.push_back(*pos);
+            }
+        }
+    } catch (...) {
+        lh = lockQueue();
+        --numUnlockedReads;
+        throw;
+    }
+
+    lh = lockQueue();
+    --numUnlockedReads;
+    it = connCursors.find(name);
+    if (it == connCursors.end() || numClears != clears ||
+        *it->second.currentCheckpoint != checkpoints.front() ||
+        it->second.currentPos != startPos) {
+        items.resize(before);
+        return false;
+    }
+
+    // Checkpoints are only added after (and removed before) the cursor's,
+    // so the checkpoint following those read is the one which was open.
+    auto& cursor = it->second;
+    (*cursor.currentCheckpoint)->removeCursorName(name);
+    std::advance(cursor.currentCheckpoint, checkpoints.size());
+    cursor.currentPos = (*cursor.currentCheckpoint)->begin();
+    (*cursor.currentCheckpoint)->registerCursorName(name);
+    cursor.setMetaItemOffset(0);
+    cursor.offset += items.size() - before;
+    return true;
+}
+
+CheckpointManager::CompressResult CheckpointManager::compressItemValue(
+        Item& itm) {
+    const uint64_t seqno = itm.getBySeqno();
+    uint64_t releases;
+    {
+        std::lock_guard<std::mutex> lh(compressedValuesLock);
+        auto it = compressedValues.find(seqno);
+        if (it != compressedValues.end()) {
+            itm.setValue(it->second);
+            itm.setDataType(itm.getDataType() |
+                            PROTOCOL_BINARY_DATATYPE_SNAPPY);
+            return CompressResult::Cached;
+        }
+        releases = compressedValuesReleases;
+    }
+
+    // Compress without the lock, so queueDirty (which takes it under the
+    // queueLock to release de-duplicated values) doesn't wait for snappy.
+    if (!itm.compressValue()) {
+        return CompressResult::Failed;
+    }
+    if (!mcbp::datatype::is_snappy(itm.getDataType())) {
+        return CompressResult::Compressed;
+    }
+
+    std::lock_guard<std::mutex> lh(compressedValuesLock);
+    if (seqno < compressedValuesLowSeqno ||
+        releases != compressedValuesReleases) {
+        // The seqno isn't (or may no longer be) held by a checkpoint
+        return CompressResult::Compressed;
+    }
+    auto result = compressedValues.emplace(seqno, itm.getValue());
+    if (result.second) {
+        compressedValuesMemUsage += itm.getValue()->getSize();
+    } else {
+        // Another producer cached its value first; share that one
+        itm.setValue(result.first->second);
+    }
+    return CompressResult::Compressed;
+}
+
+void CheckpointManager::releaseCompressedValues_UNLOCKED(uint64_t lowSeqno) {
+    std::lock_guard<std::mutex> lh(compressedValuesLock);
+    compressedValuesLowSeqno = std::max(compressedValuesLowSeqno, lowSeqno);
+    const auto end = compressedValues.lower_bound(lowSeqno);
+    for (auto it = compressedValues.begin(); it != end; ++it) {
+        compressedValuesMemUsage -= it->second->getSize();
+    }
+    compressedValues.erase(compressedValues.begin(), end);
+}
+
+void CheckpointManager::releaseCompressedValue_UNLOCKED(uint64_t seqno) {
+    std::lock_guard<std::mutex> lh(compressedValuesLock);
+    ++compressedValuesReleases;
+    auto it = compressedValues.find(seqno);
+    if (it != compressedValues.end()) {
+        compressedValuesMemUsage -= it->second->getSize();
+        compressedValues.erase(it);
+    }
+}
+
 queued_item CheckpointManager::nextItem(const std::string &name,
                                         bool &isLastMutationItem) {
-    LockHolder lh(queueLock);
+    auto lh = lockQueue();
     cursor_index::iterator it = connCursors.find(name);
     if (it == connCursors.end()) {
         LOG(EXTENSION_LOG_WARNING,
@@ -1319,6 +1605,19 @@ bool CheckpointManager::incrCursor(CheckpointCursor &cursor) {
     return incrCursor(cursor);
 }
 
+std::unique_lock<std::mutex> CheckpointManager::lockQueue() {
+    std::unique_lock<std::mutex> lh(queueLock, std::try_to_lock);
+    if (!lh.owns_lock()) {
+        const auto start = ProcessClock::now();
+        lh.lock();
+        queueLockWaitHisto.add(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        ProcessClock::now() - start));
+        ++queueLockContended;
+    }
+    return lh;
+}
+
 void CheckpointManager::dump() const {
     std::cerr << *this << std::endl;
 }
@@ -1339,7 +1638,18 @@ void CheckpointManager::clear_UNLOCKED(vbucket_state_t vbState, uint64_t seqno)
     checkpointList.clear();
     numItems = 0;
     lastBySeqno.reset(seqno);
+    {
+        // The seqnos after the new lastBySeqno may be reused (e.g. after a
+        // rollback), with different values.
+        std::lock_guard<std::mutex> lh(compressedValuesLock);
+        compressedValues.clear();
+        compressedValuesLowSeqno = seqno + 1;
+        ++compressedValuesReleases;
+        compressedValuesMemUsage = 0;
+    }
     pCursorPreCheckpointId = 0;
+    persistedSeqno = seqno;
+    ++numClears;
 
     uint64_t checkpointId = vbState == vbucket_state_active ? 1 : 0;
     // Add a new open checkpoint.
@@ -1467,7 +1777,7 @@ size_t CheckpointManager::getNumOfMetaItemsFromCursor(const CheckpointCursor &cu
             std::accumulate(ckpt_it,
                             checkpointList.end(),
                             meta_items,
-                            [](size_t a, const std::unique_ptr<Checkpoint>& b) {
+                            [](size_t a, const std::shared_ptr<Checkpoint>& b) {
                                 return a + b->getNumMetaItems();
                             });
     return result;
@@ -1850,8 +2160,14 @@ uint64_t CheckpointManager::getPersistenceCursorPreChkId() {
     return pCursorPreCheckpointId;
 }
 
-void CheckpointManager::itemsPersisted() {
+uint64_t CheckpointManager::getNumClears() const {
     LockHolder lh(queueLock);
+    return numClears;
+}
+
+void CheckpointManager::itemsPersisted(uint64_t seqno) {
+    LockHolder lh(queueLock);
+    persistedSeqno = seqno;
     auto persistenceCursor = connCursors.find(pCursorName);
     if (persistenceCursor != connCursors.end()) {
         auto itr = persistenceCursor->second.currentCheckpoint;
@@ -1864,7 +2180,7 @@ size_t CheckpointManager::getMemoryUsage_UNLOCKED() const {
         return 0;
     }
 
-    size_t memUsage = 0;
+    size_t memUsage = compressedValuesMemUsage;
     for (const auto& checkpoint : checkpointList) {
         memUsage += checkpoint->getMemConsumption();
     }
@@ -1924,6 +2240,17 @@ void CheckpointManager::addStats(ADD_STAT add_stat, const void *cookie) {
                         add_stat, cookie);
         checked_snprintf(buf, sizeof(buf), "vb_%d:mem_usage", vbucketId);
         add_casted_stat(buf, getMemoryUsage_UNLOCKED(), add_stat, cookie);
+        checked_snprintf(buf, sizeof(buf), "vb_%d:num_items_expelled",
+                         vbucketId);
+        add_casted_stat(buf, numItemsExpelled, add_stat, cookie);
+        checked_snprintf(buf, sizeof(buf), "vb_%d:mem_freed_by_expel",
+                         vbucketId);
+        add_casted_stat(buf, memFreedByExpel, add_stat, cookie);
+        checked_snprintf(buf, sizeof(buf), "vb_%d:queue_lock_contended",
+                         vbucketId);
+        add_casted_stat(buf, queueLockContended, add_stat, cookie);
+        checked_snprintf(buf, sizeof(buf), "vb_%d:queue_lock_wait", vbucketId);
+        add_casted_stat(buf, queueLockWaitHisto, add_stat, cookie);
 
         cursor_index::iterator cur_it = connCursors.begin();
         for (; cur_it != connCursors.end(); ++cur_it) {
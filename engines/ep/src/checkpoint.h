@@ -21,6 +21,7 @@
 #include "config.h"
 
 #include "callbacks.h"
+#include "checkpoint_arena.h"
 #include "ep_types.h"
 #include "item.h"
 #include "monotonic.h"
@@ -60,8 +61,10 @@ enum checkpoint_state {
 const char* to_string(enum checkpoint_state);
 
 // List is used for queueing mutations as vector incurs shift operations for
-// deduplication.
-typedef std::list<queued_item> CheckpointQueue;
+// deduplication (and the cursors and index rely on stable iterators). The
+// nodes are allocated from the owning Checkpoint's arena.
+typedef std::list<queued_item, CheckpointArenaAllocator<queued_item>>
+        CheckpointQueue;
 
 /**
  * A checkpoint index entry.
@@ -82,7 +85,13 @@ enum class MustSendCheckpointEnd {
 /**
  * The checkpoint index maps a key to a checkpoint index_entry.
  */
-typedef std::unordered_map<StoredDocKey, index_entry> checkpoint_index;
+typedef std::unordered_map<
+        StoredDocKey,
+        index_entry,
+        std::hash<StoredDocKey>,
+        std::equal_to<StoredDocKey>,
+        CheckpointArenaAllocator<std::pair<const StoredDocKey, index_entry>>>
+        checkpoint_index;
 
 /**
  * List of pairs containing checkpoint cursor name and corresponding flag
@@ -98,8 +107,9 @@ class PreLinkDocumentContext;
 class VBucket;
 
 // List of Checkpoints used by class CheckpointManager to store Checkpoints for
-// a given vBucket.
-using CheckpointList = std::list<std::unique_ptr<Checkpoint>>;
+// a given vBucket. Shared so that a cursor reading closed checkpoints without
+// the queueLock (see getAllItemsForCursor) can keep them alive.
+using CheckpointList = std::list<std::shared_ptr<Checkpoint>>;
 
 /**
  * A checkpoint cursor, representing the current position in a Checkpoint
@@ -441,11 +451,14 @@ public:
      * Queue an item to be written to persistent layer.
      * @param item the item to be persisted
      * @param checkpointManager the checkpoint manager to which this checkpoint belongs
-     * @param bySeqno the by sequence number assigned to this mutation
+     * @param replaced if non-null, the item de-duplicated by this one (if
+     *        any) is moved here, so the caller can release it after dropping
+     *        the queueLock.
      * @return a result indicating the status of the operation.
      */
     queue_dirty_t queueDirty(const queued_item &qi,
-                             CheckpointManager *checkpointManager);
+                             CheckpointManager *checkpointManager,
+                             queued_item* replaced = nullptr);
 
     uint64_t getLowSeqno() const {
         auto pos = toWrite.begin();
@@ -458,6 +471,30 @@ public:
         return (*pos)->getBySeqno();
     }
 
+    /**
+     * Return the lowest seqno a cursor can be registered at in this
+     * checkpoint without missing any items; i.e. the low seqno unless items
+     * have been expelled, in which case the seqno after the last one
+     * expelled.
+     */
+    uint64_t getMinimumCursorSeqno() const {
+        return highestExpelledSeqno == 0 ? getLowSeqno()
+                                         : highestExpelledSeqno + 1;
+    }
+
+    /**
+     * Expel the items from the start of this checkpoint up to (but not
+     * including) the given position, all of which must already have been
+     * processed by every cursor. Meta items (including the dummy item and
+     * checkpoint_start) are kept.
+     * @param last the first item which must be kept
+     * @param expelled the expelled items are appended here (so the caller
+     *        can release them once the queueLock has been dropped)
+     * @return the number of items expelled
+     */
+    size_t expelItems(CheckpointQueue::iterator last,
+                      std::vector<queued_item>& expelled);
+
     uint64_t getSnapshotStartSeqno() {
         return snapStartSeqno;
     }
@@ -568,6 +605,8 @@ private:
     /// Number of meta items (see Item::isCheckPointMetaItem).
     size_t numMetaItems;
     std::set<std::string>          cursors; // List of cursors with their unique names.
+    // Holds the nodes of toWrite and the indexes (so must outlive them)
+    CheckpointArena                arena;
     CheckpointQueue                toWrite;
     checkpoint_index               keyIndex;
     /* Index for meta keys like "dummy_key" */
@@ -578,6 +617,9 @@ private:
     // the queued items in the given checkpoint.
     size_t                         effectiveMemUsage;
 
+    // Seqno of the last item expelled from this checkpoint (0 if none).
+    uint64_t                       highestExpelledSeqno;
+
     friend std::ostream& operator <<(std::ostream& os, const Checkpoint& m);
 };
 
@@ -718,9 +760,42 @@ public:
      */
     queued_item nextItem(const std::string &name, bool &isLastMutationItem);
 
+    /**
+     * Return all of the items the given cursor hasn't yet read, and move
+     * the cursor past them. The items of the closed checkpoints before the
+     * open one (which are only modified by expelling and collapsing, both
+     * skipped while such a read is in progress) are copied without holding
+     * the queueLock; only the open checkpoint is read under it.
+     */
     snapshot_range_t getAllItemsForCursor(const std::string& name,
                                           std::vector<queued_item> &items);
 
+    /// The outcome of compressItemValue
+    enum class CompressResult {
+        /// The value cached by another DCP producer was used
+        Cached,
+        /// The value was compressed (and cached, if still in memory)
+        Compressed,
+        /// Compressing the value failed
+        Failed
+    };
+
+    /**
+     * Snappy-compress the value of the given item of this vbucket (being
+     * sent by a DCP producer), using the compressed value cached for its
+     * seqno by another producer if there is one. Otherwise the value
+     * compressed here is cached for the others, if the seqno is still held
+     * by a checkpoint (so not e.g. for items backfilled from older seqnos).
+     *
+     * The value is compressed without holding compressedValuesLock (which
+     * queueDirty acquires under the queueLock), so producers streaming the
+     * same item at the same time may both compress it; the first value
+     * cached is the one used. The cached values are released when their
+     * items leave the checkpoints, and a value isn't cached if its seqno
+     * was released while it was being compressed.
+     */
+    CompressResult compressItemValue(Item& itm);
+
     /**
      * Return the total number of items (including meta items) that belong to
      * this checkpoint manager.
@@ -783,9 +858,17 @@ public:
     uint64_t getPersistenceCursorPreChkId();
 
     /**
-     * Update the checkpoint manager persistence cursor checkpoint offset
+     * Get the number of times the checkpoints have been cleared (and hence
+     * the persistence cursor moved back). Items taken from the persistence
+     * cursor before the last clear must not be persisted.
+     */
+    uint64_t getNumClears() const;
+
+    /**
+     * Update the checkpoint manager persistence cursor checkpoint offset,
+     * and record the highest seqno now persisted.
      */
-    void itemsPersisted();
+    void itemsPersisted(uint64_t seqno);
 
     /**
      * Return memory consumption of all the checkpoints managed
@@ -799,6 +882,28 @@ public:
      */
     size_t getMemoryUsageOfUnrefCheckpoints() const;
 
+    /**
+     * The number of items expelled, and the memory released by doing so
+     * (items still referenced elsewhere aren't counted as released).
+     */
+    struct ExpelResult {
+        size_t count = 0;
+        size_t memory = 0;
+    };
+
+    /**
+     * Expel the items at the front of the oldest checkpoint which every
+     * cursor has already processed, releasing their memory without waiting
+     * for the checkpoint to be closed and removed (which a single slow
+     * cursor can hold up indefinitely). The checkpoint itself is kept.
+     *
+     * With persistence enabled only the persisted items are expelled: a
+     * cursor registered in the expelled range backfills them from disk,
+     * so reading them into a flush batch which hasn't been committed yet
+     * isn't enough.
+     */
+    ExpelResult expelUnreferencedCheckpointItems();
+
     /**
      * Function returns a list of cursors to drop so as to unreference
      * certain checkpoints within the manager, invoked by the cursor-dropper.
@@ -865,8 +970,10 @@ protected:
     // stats after queueing a new item to a checkpoint.
     // Must be called with queueLock held (LockHolder passed in as argument to
     // 'prove' this).
-    void updateStatsForNewQueuedItem_UNLOCKED(const LockHolder&,
-                                     VBucket& vb, const queued_item& qi);
+    void updateStatsForNewQueuedItem_UNLOCKED(
+            const std::unique_lock<std::mutex>&,
+            VBucket& vb,
+            const queued_item& qi);
 
     /**
      * Helper method to update disk queue stats after (maybe) changing the
@@ -921,6 +1028,19 @@ private:
 
     bool moveCursorToNextCheckpoint(CheckpointCursor &cursor);
 
+    /**
+     * Append the items of the closed checkpoints from the given cursor's
+     * position up to the open checkpoint to items, releasing the queueLock
+     * (held by lh) while copying them, and move the cursor to the start of
+     * the open checkpoint.
+     * @return false (and nothing copied) if the cursor is in the open
+     *         checkpoint, or was moved (or the checkpoints cleared) while
+     *         the lock was released
+     */
+    bool readClosedCheckpoints(std::unique_lock<std::mutex>& lh,
+                               const std::string& name,
+                               std::vector<queued_item>& items);
+
     /**
      * Check the current open checkpoint to see if we need to create the new open checkpoint.
      * @param forceCreation is to indicate if a new checkpoint is created due to online update or
@@ -960,6 +1080,23 @@ private:
      */
     size_t getNumOfMetaItemsFromCursor(const CheckpointCursor &cursor) const;
 
+    /**
+     * Acquire the queueLock, recording how long we had to wait for it in
+     * queueLockWaitHisto if it was contended. Used by the front-end and
+     * cursor paths whose contention we want to be able to observe.
+     */
+    std::unique_lock<std::mutex> lockQueue();
+
+    /**
+     * Release the compressed values of the seqnos before the given one,
+     * which are no longer held by any checkpoint. Called with the queueLock
+     * held.
+     */
+    void releaseCompressedValues_UNLOCKED(uint64_t lowSeqno);
+
+    /// Release the compressed value of the given (de-duplicated) seqno
+    void releaseCompressedValue_UNLOCKED(uint64_t seqno);
+
     EPStats                 &stats;
     CheckpointConfig        &checkpointConfig;
     mutable std::mutex       queueLock;
@@ -973,8 +1110,38 @@ private:
     bool                     isCollapsedCheckpoint;
     uint64_t                 lastClosedCheckpointId;
     uint64_t                 pCursorPreCheckpointId;
+    // The highest seqno persisted, as of the last itemsPersisted().
+    uint64_t                 persistedSeqno;
+    uint64_t                 numClears;
     cursor_index             connCursors;
 
+    // Time spent waiting for the queueLock by lockQueue() callers which
+    // found it held, and the number of such acquisitions. Guarded by the
+    // queueLock.
+    MicrosecondHistogram     queueLockWaitHisto;
+    size_t                   queueLockContended;
+
+    // Totals of the items expelled by expelUnreferencedCheckpointItems.
+    // Guarded by the queueLock.
+    size_t                   numItemsExpelled;
+    size_t                   memFreedByExpel;
+
+    // The number of readClosedCheckpoints calls copying items without the
+    // queueLock; the closed checkpoints mustn't be modified while non-zero.
+    // Guarded by the queueLock.
+    size_t                   numUnlockedReads;
+
+    // Compressed values of the items in the checkpoints, by seqno (see
+    // compressItemValue), the lowest seqno which may be cached, and the
+    // number of times single seqnos (or all of them) were released. Guarded
+    // by compressedValuesLock, which is acquired after the queueLock when
+    // both are held.
+    std::mutex                   compressedValuesLock;
+    std::map<uint64_t, value_t>  compressedValues;
+    uint64_t                     compressedValuesLowSeqno;
+    uint64_t                     compressedValuesReleases;
+    std::atomic<size_t>          compressedValuesMemUsage;
+
     FlusherCallback          flusherCB;
 
     friend std::ostream& operator<<(std::ostream& os, const CheckpointManager& m);
@@ -0,0 +1,69 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "checkpoint_arena.h"
+
+#include <algorithm>
+#include <new>
+
+const size_t CheckpointArena::MinBlockSize;
+const size_t CheckpointArena::MaxBlockSize;
+const size_t CheckpointArena::MaxAllocSize;
+
+void* CheckpointArena::allocate(size_t bytes) {
+    const size_t size = roundUp(std::max(bytes, sizeof(FreeNode)));
+    if (size > MaxAllocSize) {
+        return ::operator new(bytes);
+    }
+
+    // Reuse a freed allocation of the same size if possible
+    auto& freeList = freeLists[size / Alignment];
+    if (freeList != nullptr) {
+        auto* node = freeList;
+        freeList = node->next;
+        return node;
+    }
+
+    if (size_t(end - next) < size) {
+        // Double the block size each time (up to the maximum); any space
+        // left at the end of the previous block is wasted.
+        lastBlockSize = blocks.empty()
+                                ? MinBlockSize
+                                : std::min(MaxBlockSize, 2 * lastBlockSize);
+        blocks.emplace_back(new char[lastBlockSize]);
+        blocksSize += lastBlockSize;
+        next = blocks.back().get();
+        end = next + lastBlockSize;
+    }
+
+    void* ret = next;
+    next += size;
+    return ret;
+}
+
+void CheckpointArena::deallocate(void* ptr, size_t bytes) {
+    const size_t size = roundUp(std::max(bytes, sizeof(FreeNode)));
+    if (size > MaxAllocSize) {
+        ::operator delete(ptr);
+        return;
+    }
+
+    auto& freeList = freeLists[size / Alignment];
+    auto* node = static_cast<FreeNode*>(ptr);
+    node->next = freeList;
+    freeList = node;
+}
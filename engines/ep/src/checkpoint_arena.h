@@ -0,0 +1,127 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/**
+ * Arena holding the nodes of a Checkpoint's item queue and key indexes.
+ *
+ * Every item queued into a checkpoint needs a queue node and an index node;
+ * allocating them individually costs two trips to the allocator per
+ * mutation and scatters the queue over the heap, so walking it (as the
+ * cursors do) chases pointers all over memory. Instead the nodes are carved
+ * out of blocks owned by the checkpoint: consecutive items end up next to
+ * each other, nodes freed by de-duplication are reused for the following
+ * items, and all of the blocks are released in one go when the checkpoint
+ * is removed.
+ *
+ * Blocks start small (most checkpoints hold few items) and double in size
+ * up to MaxBlockSize. Allocations larger than MaxAllocSize (e.g. the
+ * bucket array of the key index) are passed through to operator new.
+ *
+ * Not thread safe; a Checkpoint is only accessed under its
+ * CheckpointManager's queueLock.
+ */
+class CheckpointArena {
+public:
+    static const size_t MinBlockSize = 1024;
+    static const size_t MaxBlockSize = 64 * 1024;
+    static const size_t MaxAllocSize = 256;
+
+    CheckpointArena() = default;
+
+    CheckpointArena(const CheckpointArena&) = delete;
+    CheckpointArena& operator=(const CheckpointArena&) = delete;
+
+    void* allocate(size_t bytes);
+
+    void deallocate(void* ptr, size_t bytes);
+
+    /// The total size of the blocks owned by the arena
+    size_t getBlocksSize() const {
+        return blocksSize;
+    }
+
+private:
+    static const size_t Alignment = alignof(std::max_align_t);
+
+    static size_t roundUp(size_t bytes) {
+        return (bytes + Alignment - 1) & ~(Alignment - 1);
+    }
+
+    struct FreeNode {
+        FreeNode* next;
+    };
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t blocksSize = 0;
+    size_t lastBlockSize = 0;
+    // The unused part of the most recent block
+    char* next = nullptr;
+    char* end = nullptr;
+    // Freed allocations, by size (in units of Alignment)
+    std::array<FreeNode*, MaxAllocSize / Alignment + 1> freeLists{};
+};
+
+/**
+ * Allocator handing out memory from a CheckpointArena (for use with the
+ * standard containers).
+ */
+template <typename T>
+class CheckpointArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit CheckpointArenaAllocator(CheckpointArena& a) : arena(&a) {
+    }
+
+    template <typename U>
+    CheckpointArenaAllocator(const CheckpointArenaAllocator<U>& other)
+        : arena(other.arena) {
+    }
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        arena->deallocate(ptr, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const CheckpointArenaAllocator<U>& other) const {
+        return arena == other.arena;
+    }
+
+    template <typename U>
+    bool operator!=(const CheckpointArenaAllocator<U>& other) const {
+        return arena != other.arena;
+    }
+
+private:
+    CheckpointArena* arena;
+
+    template <typename U>
+    friend class CheckpointArenaAllocator;
+};
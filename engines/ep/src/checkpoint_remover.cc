@@ -28,6 +28,27 @@
 #include <phosphor/phosphor.h>
 #include <platform/make_unique.h>
 
+/**
+ * Expel the items already processed by every cursor from the given
+ * vbucket's checkpoints.
+ * @return the amount of memory released
+ */
+static size_t expelCheckpointItems(VBucket& vb, EPStats& stats) {
+    const auto result =
+            vb.checkpointManager->expelUnreferencedCheckpointItems();
+    if (result.count > 0) {
+        stats.itemsExpelledFromCheckpoints.fetch_add(result.count);
+        stats.memFreedByCheckpointItemExpel.fetch_add(result.memory);
+        LOG(EXTENSION_LOG_DEBUG,
+            "Expelled %" PRIu64 " items (%" PRIu64 " bytes) from the "
+            "checkpoints of vb:%" PRIu16,
+            uint64_t(result.count),
+            uint64_t(result.memory),
+            vb.getId());
+    }
+    return result.memory;
+}
+
 /**
  * Remove all the closed unreferenced checkpoints for each vbucket.
  */
@@ -60,6 +81,12 @@ public:
                 removed, vb->getId());
         }
         removed = 0;
+
+        // If memory is tight also release the items which every cursor has
+        // processed from checkpoints which can't be removed yet.
+        if (wasHighMemoryUsage) {
+            expelCheckpointItems(*vb, stats);
+        }
     }
 
     void complete() override {
@@ -107,6 +134,13 @@ void ClosedUnrefCheckpointRemoverTask::cursorDroppingIfNeeded(void) {
                 uint16_t vbid = it.first;
                 VBucketPtr vb = kvBucket->getVBucket(vbid);
                 if (vb) {
+                    // First release what we can without dropping any
+                    // cursors (which would force the streams to backfill).
+                    memoryCleared += expelCheckpointItems(*vb, stats);
+                    if (memoryCleared >= amountOfMemoryToClear) {
+                        break;
+                    }
+
                     // Get a list of cursors that can be dropped from the
                     // vbucket's checkpoint manager, so as to unreference
                     // an estimated number of checkpoints.
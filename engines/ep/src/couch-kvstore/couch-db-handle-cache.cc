@@ -0,0 +1,126 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include "couch-kvstore/couch-db-handle-cache.h"
+
+DbHandleCache::DbHandleCache(size_t capacity, uint16_t maxVBuckets)
+    : capacity(capacity), generations(maxVBuckets) {
+}
+
+DbHandleCache::~DbHandleCache() {
+    clear();
+}
+
+DbHandleCache::Handle DbHandleCache::acquire(uint16_t vbid, uint64_t fileRev) {
+    Handle stale;
+    Handle handle;
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        auto it = index.find(vbid);
+        if (it != index.end()) {
+            if (it->second->fileRev == fileRev) {
+                handle = *it->second;
+            } else {
+                // Left over from before compaction
+                stale = *it->second;
+            }
+            lru.erase(it->second);
+            index.erase(it);
+        }
+        handle.vbid = vbid;
+        handle.fileRev = fileRev;
+        handle.generation = generations[vbid];
+    }
+
+    if (stale.db) {
+        close(stale.db);
+    }
+    if (handle.db) {
+        ++hits;
+    } else {
+        ++misses;
+    }
+    return handle;
+}
+
+void DbHandleCache::release(Handle& handle, bool reuse) {
+    if (!handle.db) {
+        return;
+    }
+
+    Db* toClose = handle.db;
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        if (reuse && capacity > 0 &&
+            handle.generation == generations[handle.vbid] &&
+            index.count(handle.vbid) == 0) {
+            lru.push_front(handle);
+            index.emplace(handle.vbid, lru.begin());
+            toClose = nullptr;
+
+            if (lru.size() > capacity) {
+                toClose = lru.back().db;
+                index.erase(lru.back().vbid);
+                lru.pop_back();
+                ++evictions;
+            }
+        }
+    }
+
+    handle.db = nullptr;
+    if (toClose) {
+        close(toClose);
+    }
+}
+
+void DbHandleCache::invalidate(uint16_t vbid) {
+    Db* toClose = nullptr;
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        ++generations[vbid];
+        auto it = index.find(vbid);
+        if (it != index.end()) {
+            toClose = it->second->db;
+            lru.erase(it->second);
+            index.erase(it);
+        }
+    }
+
+    if (toClose) {
+        close(toClose);
+    }
+}
+
+void DbHandleCache::clear() {
+    std::list<Handle> handles;
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        handles.swap(lru);
+        index.clear();
+    }
+
+    for (auto& handle : handles) {
+        close(handle.db);
+    }
+}
+
+void DbHandleCache::close(Db* db) {
+    couchstore_close_file(db);
+    couchstore_free_db(db);
+}
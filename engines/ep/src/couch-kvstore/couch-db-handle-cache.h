@@ -0,0 +1,123 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <libcouchstore/couch_db.h>
+#include <platform/histogram.h>
+#include <platform/platform.h>
+
+/**
+ * LRU cache of open read-only couchstore Db handles, at most one per
+ * vbucket.
+ *
+ * Opening a file reads and parses its header, so reusing handles saves a
+ * number of syscalls for each background fetch. A handle only sees the
+ * file as of the header it was opened with, so the writer must invalidate()
+ * a vbucket's handles whenever it commits to (or removes) the vbucket's
+ * file; handles which are in use at the time are closed (rather than
+ * cached) when they're released.
+ *
+ * A handle can only be used by one thread at a time, so acquire() takes
+ * it out of the cache until it's released again.
+ *
+ * Thread safe; shared by a RW CouchKVStore (which invalidates it) and its
+ * RO sibling (which uses it).
+ */
+class DbHandleCache {
+public:
+    struct Handle {
+        Db* db = nullptr;
+        uint16_t vbid = 0;
+        uint64_t fileRev = 0;
+        /// The vbucket's generation when the handle was acquired
+        uint64_t generation = 0;
+    };
+
+    /**
+     * @param capacity the maximum number of handles cached
+     * @param maxVBuckets the number of vbuckets
+     */
+    DbHandleCache(size_t capacity, uint16_t maxVBuckets);
+
+    ~DbHandleCache();
+
+    /**
+     * Take the cached handle of the given revision of the vbucket's file.
+     * If there's none, the returned handle has no db; the caller should open
+     * the file into it.
+     *
+     * In either case the handle should be passed to release() once finished
+     * with.
+     */
+    Handle acquire(uint16_t vbid, uint64_t fileRev);
+
+    /**
+     * Return a handle to the cache (evicting the least recently used one if
+     * full), or close it if it's no longer valid.
+     *
+     * @param handle the handle to release
+     * @param reuse false if the handle must not be reused (e.g. after an
+     *        error)
+     */
+    void release(Handle& handle, bool reuse);
+
+    /// Close the cached handles of the vbucket, and those in use on release
+    void invalidate(uint16_t vbid);
+
+    /// Close all of the cached handles
+    void clear();
+
+    size_t getHits() const {
+        return hits;
+    }
+
+    size_t getMisses() const {
+        return misses;
+    }
+
+    size_t getEvictions() const {
+        return evictions;
+    }
+
+    /// Time taken to open the handles which weren't cached
+    Histogram<hrtime_t> openHisto;
+
+private:
+    static void close(Db* db);
+
+    const size_t capacity;
+
+    std::mutex mutex;
+    // Most recently used first
+    std::list<Handle> lru;
+    std::unordered_map<uint16_t, std::list<Handle>::iterator> index;
+    // Incremented by each invalidate() of the vbucket
+    std::vector<uint64_t> generations;
+
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+    std::atomic<size_t> evictions{0};
+};
@@ -0,0 +1,239 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include "couch-kvstore/couch-fs-cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+
+const size_t BlockCache::BlockSize;
+const size_t BlockCache::EntrySize;
+
+BlockCache::BlockCache(size_t maxSize) : maxSize(maxSize) {
+}
+
+uint32_t BlockCache::getFileId(const std::string& path) {
+    std::lock_guard<std::mutex> lh(mutex);
+    auto result = fileIds.emplace(path, nextFileId);
+    if (result.second) {
+        ++nextFileId;
+    }
+    return result.first->second;
+}
+
+void BlockCache::removeFile(const std::string& path) {
+    std::lock_guard<std::mutex> lh(mutex);
+    auto it = fileIds.find(path);
+    if (it == fileIds.end()) {
+        return;
+    }
+    const auto fileId = it->second;
+    fileIds.erase(it);
+
+    for (auto entry = lru.begin(); entry != lru.end();) {
+        if (entry->key.fileId == fileId) {
+            index.erase(entry->key);
+            entry = lru.erase(entry);
+            memUsed -= EntrySize;
+        } else {
+            ++entry;
+        }
+    }
+}
+
+bool BlockCache::get(uint32_t fileId, uint64_t block, char* dest) {
+    std::lock_guard<std::mutex> lh(mutex);
+    auto it = index.find(Key{fileId, block});
+    if (it == index.end()) {
+        ++misses;
+        return false;
+    }
+    // Move to the head of the LRU
+    lru.splice(lru.begin(), lru, it->second);
+    std::memcpy(dest, it->second->data.get(), BlockSize);
+    ++hits;
+    return true;
+}
+
+void BlockCache::put(uint32_t fileId, uint64_t block, const char* src) {
+    if (maxSize < EntrySize) {
+        return;
+    }
+    const Key key{fileId, block};
+    std::lock_guard<std::mutex> lh(mutex);
+    if (index.count(key) != 0) {
+        // Added by another reader in the meantime
+        return;
+    }
+
+    std::unique_ptr<char[]> data;
+    if (memUsed + EntrySize > maxSize) {
+        // Reuse the least recently used block's memory
+        data = std::move(lru.back().data);
+        index.erase(lru.back().key);
+        lru.pop_back();
+    } else {
+        data.reset(new char[BlockSize]);
+        memUsed += EntrySize;
+    }
+    std::memcpy(data.get(), src, BlockSize);
+    lru.push_front({key, std::move(data)});
+    index.emplace(key, lru.begin());
+}
+
+std::unique_ptr<FileOpsInterface> getCouchstoreBlockCacheOps(
+        BlockCache& cache, FileOpsInterface& base_ops) {
+    return std::unique_ptr<FileOpsInterface>(
+            new BlockCacheOps(cache, base_ops));
+}
+
+couch_file_handle BlockCacheOps::constructor(couchstore_error_info_t* errinfo) {
+    auto* cf = new CacheFile(wrapped_ops.constructor(errinfo));
+    return reinterpret_cast<couch_file_handle>(cf);
+}
+
+couchstore_error_t BlockCacheOps::open(couchstore_error_info_t* errinfo,
+                                       couch_file_handle* h,
+                                       const char* path,
+                                       int flags) {
+    auto* cf = reinterpret_cast<CacheFile*>(*h);
+    const auto rv = wrapped_ops.open(errinfo, &cf->orig_handle, path, flags);
+    cf->cached = (rv == COUCHSTORE_SUCCESS) &&
+                 ((flags & (O_WRONLY | O_RDWR)) == 0);
+    if (cf->cached) {
+        cf->fileId = cache.getFileId(path);
+    }
+    return rv;
+}
+
+couchstore_error_t BlockCacheOps::close(couchstore_error_info_t* errinfo,
+                                        couch_file_handle h) {
+    auto* cf = reinterpret_cast<CacheFile*>(h);
+    cf->cached = false;
+    return wrapped_ops.close(errinfo, cf->orig_handle);
+}
+
+couchstore_error_t BlockCacheOps::set_periodic_sync(couch_file_handle h,
+                                                    uint64_t period_bytes) {
+    auto* cf = reinterpret_cast<CacheFile*>(h);
+    return wrapped_ops.set_periodic_sync(cf->orig_handle, period_bytes);
+}
+
+ssize_t BlockCacheOps::pread(couchstore_error_info_t* errinfo,
+                             couch_file_handle h,
+                             void* buf,
+                             size_t sz,
+                             cs_off_t off) {
+    auto* cf = reinterpret_cast<CacheFile*>(h);
+    if (!cf->cached || sz == 0) {
+        return wrapped_ops.pread(errinfo, cf->orig_handle, buf, sz, off);
+    }
+
+    const size_t BlockSize = BlockCache::BlockSize;
+    const uint64_t first = off / BlockSize;
+    const uint64_t last = (off + sz - 1) / BlockSize;
+    const size_t size = (last - first + 1) * BlockSize;
+    if (cf->bufferSize < size) {
+        cf->buffer.reset(new char[size]);
+        cf->bufferSize = size;
+    }
+    char* buffer = cf->buffer.get();
+
+    // Take as many of the blocks as possible from the cache; read the
+    // remainder (from the first block missing) with a single read.
+    uint64_t block = first;
+    while (block <= last &&
+           cache.get(cf->fileId,
+                     block,
+                     buffer + (block - first) * BlockSize)) {
+        ++block;
+    }
+
+    size_t available = size;
+    if (block <= last) {
+        const size_t offset = (block - first) * BlockSize;
+        const ssize_t got = wrapped_ops.pread(errinfo,
+                                              cf->orig_handle,
+                                              buffer + offset,
+                                              size - offset,
+                                              block * BlockSize);
+        if (got < 0) {
+            return got;
+        }
+        // Only complete blocks are cached; the last block of the file may
+        // still grow.
+        for (size_t ii = 0; (ii + 1) * BlockSize <= size_t(got); ++ii) {
+            cache.put(cf->fileId,
+                      block + ii,
+                      buffer + offset + ii * BlockSize);
+        }
+        available = offset + got;
+    }
+
+    const size_t skip = off - first * BlockSize;
+    if (available <= skip) {
+        // At (or beyond) the end of the file
+        return 0;
+    }
+    const size_t copied = std::min(sz, available - skip);
+    std::memcpy(buf, buffer + skip, copied);
+    return copied;
+}
+
+ssize_t BlockCacheOps::pwrite(couchstore_error_info_t* errinfo,
+                              couch_file_handle h,
+                              const void* buf,
+                              size_t sz,
+                              cs_off_t off) {
+    auto* cf = reinterpret_cast<CacheFile*>(h);
+    return wrapped_ops.pwrite(errinfo, cf->orig_handle, buf, sz, off);
+}
+
+cs_off_t BlockCacheOps::goto_eof(couchstore_error_info_t* errinfo,
+                                 couch_file_handle h) {
+    auto* cf = reinterpret_cast<CacheFile*>(h);
+    return wrapped_ops.goto_eof(errinfo, cf->orig_handle);
+}
+
+couchstore_error_t BlockCacheOps::sync(couchstore_error_info_t* errinfo,
+                                       couch_file_handle h) {
+    auto* cf = reinterpret_cast<CacheFile*>(h);
+    return wrapped_ops.sync(errinfo, cf->orig_handle);
+}
+
+couchstore_error_t BlockCacheOps::advise(couchstore_error_info_t* errinfo,
+                                         couch_file_handle h,
+                                         cs_off_t offs,
+                                         cs_off_t len,
+                                         couchstore_file_advice_t adv) {
+    auto* cf = reinterpret_cast<CacheFile*>(h);
+    return wrapped_ops.advise(errinfo, cf->orig_handle, offs, len, adv);
+}
+
+FileOpsInterface::FHStats* BlockCacheOps::get_stats(couch_file_handle h) {
+    auto* cf = reinterpret_cast<CacheFile*>(h);
+    return wrapped_ops.get_stats(cf->orig_handle);
+}
+
+void BlockCacheOps::destructor(couch_file_handle h) {
+    auto* cf = reinterpret_cast<CacheFile*>(h);
+    wrapped_ops.destructor(cf->orig_handle);
+    delete cf;
+}
@@ -0,0 +1,207 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <libcouchstore/couch_db.h>
+
+/**
+ * LRU cache of fixed size blocks of couchstore files.
+ *
+ * Couchstore files are append-only (and a new file, with a new revision in
+ * its name, is created by compaction), so the contents of a block never
+ * change once the file has grown past its end; only such complete blocks
+ * are cached, and nothing needs invalidating on commit. The blocks of a
+ * file are removed when it's deleted (after compaction or vbucket
+ * deletion); see removeFile.
+ *
+ * Every point lookup reads the same few interior B-tree nodes near the
+ * root, while the leaf nodes and documents it reads are mostly different
+ * for each key; so the blocks holding the interior nodes stay at the head
+ * of the LRU and most lookups only need to read the leaf and the document
+ * from disk.
+ *
+ * Thread safe.
+ */
+class BlockCache {
+public:
+    static const size_t BlockSize = 4096;
+
+    /**
+     * @param maxSize the maximum memory (in bytes) used by the cached blocks
+     */
+    explicit BlockCache(size_t maxSize);
+
+    /// @return the id identifying blocks of the file at the given path
+    uint32_t getFileId(const std::string& path);
+
+    /**
+     * Forget the file at the given path (which is being deleted), and
+     * remove its blocks. A reader which still has the file open may add
+     * blocks under its old id, but the id is never reused so they just age
+     * out.
+     */
+    void removeFile(const std::string& path);
+
+    /**
+     * Copy the given block into dest, if cached.
+     *
+     * @param fileId the file id (see getFileId)
+     * @param block the index of the block (i.e. its offset / BlockSize)
+     * @param dest buffer of (at least) BlockSize bytes
+     * @return true if the block was cached
+     */
+    bool get(uint32_t fileId, uint64_t block, char* dest);
+
+    /// Add the given (complete) block to the cache
+    void put(uint32_t fileId, uint64_t block, const char* src);
+
+    size_t getMaxSize() const {
+        return maxSize;
+    }
+
+    /// @return the memory used by the cached blocks
+    size_t getMemUsed() const {
+        return memUsed;
+    }
+
+    size_t getHits() const {
+        return hits;
+    }
+
+    size_t getMisses() const {
+        return misses;
+    }
+
+private:
+    /// Approximate memory used by each cached block (including overheads)
+    static const size_t EntrySize = BlockSize + 64;
+
+    struct Key {
+        bool operator==(const Key& other) const {
+            return fileId == other.fileId && block == other.block;
+        }
+
+        uint32_t fileId;
+        uint64_t block;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<uint64_t>()(key.block ^
+                                         (uint64_t(key.fileId) << 40));
+        }
+    };
+
+    struct Entry {
+        Key key;
+        std::unique_ptr<char[]> data;
+    };
+
+    const size_t maxSize;
+
+    std::mutex mutex;
+    // Most recently used first
+    std::list<Entry> lru;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    std::unordered_map<std::string, uint32_t> fileIds;
+    uint32_t nextFileId = 0;
+
+    std::atomic<size_t> memUsed{0};
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+};
+
+/**
+ * Returns an instance of BlockCacheOps using the given cache and wrapping
+ * the given base FileOps implementation.
+ */
+std::unique_ptr<FileOpsInterface> getCouchstoreBlockCacheOps(
+        BlockCache& cache, FileOpsInterface& base_ops);
+
+/**
+ * FileOpsInterface implementation which serves the reads of files opened
+ * read-only from a BlockCache where possible.
+ *
+ * Each read is served from the cache if every block it covers is cached;
+ * otherwise all of those blocks are read from the wrapped FileOps (and the
+ * complete ones added to the cache).
+ */
+class BlockCacheOps : public FileOpsInterface {
+public:
+    BlockCacheOps(BlockCache& _cache, FileOpsInterface& ops)
+        : cache(_cache), wrapped_ops(ops) {
+    }
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+protected:
+    BlockCache& cache;
+    FileOpsInterface& wrapped_ops;
+
+    struct CacheFile {
+        explicit CacheFile(couch_file_handle _orig_handle)
+            : orig_handle(_orig_handle) {
+        }
+
+        couch_file_handle orig_handle;
+        /// True if the file was opened read-only (so its reads are cached)
+        bool cached = false;
+        uint32_t fileId = 0;
+        /// Buffer the blocks covering a read are assembled in
+        std::unique_ptr<char[]> buffer;
+        size_t bufferSize = 0;
+    };
+};
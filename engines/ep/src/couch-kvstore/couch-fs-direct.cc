@@ -0,0 +1,222 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include "couch-kvstore/couch-fs-direct.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+
+#ifdef O_DIRECT
+#include <unistd.h>
+#endif
+
+const size_t DirectReadOps::Alignment;
+
+std::unique_ptr<FileOpsInterface> getCouchstoreDirectReadOps(
+        FileOpsInterface& base_ops) {
+    return std::unique_ptr<FileOpsInterface>(new DirectReadOps(base_ops));
+}
+
+couch_file_handle DirectReadOps::constructor(couchstore_error_info_t* errinfo) {
+    auto* df = new DirectFile(wrapped_ops.constructor(errinfo));
+    return reinterpret_cast<couch_file_handle>(df);
+}
+
+couchstore_error_t DirectReadOps::open(couchstore_error_info_t* errinfo,
+                                       couch_file_handle* h,
+                                       const char* path,
+                                       int flags) {
+    auto* df = reinterpret_cast<DirectFile*>(*h);
+#ifdef O_DIRECT
+    if ((flags & O_ACCMODE) == O_RDONLY) {
+        int fd;
+        do {
+            fd = ::open(path, flags | O_DIRECT);
+        } while (fd == -1 && errno == EINTR);
+        if (fd != -1) {
+            df->fd = fd;
+            return COUCHSTORE_SUCCESS;
+        }
+        // O_DIRECT may not be supported by the filesystem (EINVAL); fall
+        // back to the wrapped ops, which also report any other error.
+    }
+#endif
+    return wrapped_ops.open(errinfo, &df->orig_handle, path, flags);
+}
+
+couchstore_error_t DirectReadOps::close(couchstore_error_info_t* errinfo,
+                                        couch_file_handle h) {
+    auto* df = reinterpret_cast<DirectFile*>(h);
+    if (df->fd == -1) {
+        return wrapped_ops.close(errinfo, df->orig_handle);
+    }
+#ifdef O_DIRECT
+    const int rv = ::close(df->fd);
+    df->fd = -1;
+    df->bufferValid = 0;
+    if (rv == -1) {
+        errinfo->error = errno;
+        return COUCHSTORE_ERROR_FILE_CLOSE;
+    }
+#endif
+    return COUCHSTORE_SUCCESS;
+}
+
+couchstore_error_t DirectReadOps::set_periodic_sync(couch_file_handle h,
+                                                    uint64_t period_bytes) {
+    auto* df = reinterpret_cast<DirectFile*>(h);
+    if (df->fd == -1) {
+        return wrapped_ops.set_periodic_sync(df->orig_handle, period_bytes);
+    }
+    return COUCHSTORE_SUCCESS;
+}
+
+ssize_t DirectReadOps::pread(couchstore_error_info_t* errinfo,
+                             couch_file_handle h,
+                             void* buf,
+                             size_t sz,
+                             cs_off_t off) {
+    auto* df = reinterpret_cast<DirectFile*>(h);
+    if (df->fd == -1) {
+        return wrapped_ops.pread(errinfo, df->orig_handle, buf, sz, off);
+    }
+#ifdef O_DIRECT
+    // Serve the read from the buffer if the previous read already covered it
+    // (couchstore often reads a block's header and then its body).
+    if (off >= df->bufferOffset &&
+        off + cs_off_t(sz) <= df->bufferOffset + cs_off_t(df->bufferValid)) {
+        std::memcpy(buf, df->buffer.get() + (off - df->bufferOffset), sz);
+        return sz;
+    }
+
+    // Read the aligned range covering the requested one into the buffer,
+    // then copy out the requested part.
+    const cs_off_t start = off & ~cs_off_t(Alignment - 1);
+    const size_t skip = off - start;
+    const size_t size = (skip + sz + Alignment - 1) & ~(Alignment - 1);
+    if (df->bufferSize < size) {
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, Alignment, size) != 0) {
+            errinfo->error = ENOMEM;
+            return COUCHSTORE_ERROR_ALLOC_FAIL;
+        }
+        df->buffer.reset(static_cast<char*>(ptr));
+        df->bufferSize = size;
+        df->bufferValid = 0;
+    }
+
+    ssize_t got;
+    do {
+        got = ::pread(df->fd, df->buffer.get(), size, start);
+    } while (got == -1 && errno == EINTR);
+    if (got == -1) {
+        errinfo->error = errno;
+        df->bufferValid = 0;
+        return COUCHSTORE_ERROR_READ;
+    }
+    df->bufferOffset = start;
+    df->bufferValid = got;
+    if (size_t(got) <= skip) {
+        // At (or beyond) the end of the file
+        return 0;
+    }
+    const size_t copied = std::min(sz, size_t(got) - skip);
+    std::memcpy(buf, df->buffer.get() + skip, copied);
+    return copied;
+#else
+    return COUCHSTORE_ERROR_READ;
+#endif
+}
+
+ssize_t DirectReadOps::pwrite(couchstore_error_info_t* errinfo,
+                              couch_file_handle h,
+                              const void* buf,
+                              size_t sz,
+                              cs_off_t off) {
+    auto* df = reinterpret_cast<DirectFile*>(h);
+    if (df->fd == -1) {
+        return wrapped_ops.pwrite(errinfo, df->orig_handle, buf, sz, off);
+    }
+    // Only files opened read-only are read directly
+    errinfo->error = EBADF;
+    return COUCHSTORE_ERROR_WRITE;
+}
+
+cs_off_t DirectReadOps::goto_eof(couchstore_error_info_t* errinfo,
+                                 couch_file_handle h) {
+    auto* df = reinterpret_cast<DirectFile*>(h);
+    if (df->fd == -1) {
+        return wrapped_ops.goto_eof(errinfo, df->orig_handle);
+    }
+#ifdef O_DIRECT
+    const cs_off_t rv = ::lseek(df->fd, 0, SEEK_END);
+    if (rv == -1) {
+        errinfo->error = errno;
+        return COUCHSTORE_ERROR_READ;
+    }
+    return rv;
+#else
+    return COUCHSTORE_ERROR_READ;
+#endif
+}
+
+couchstore_error_t DirectReadOps::sync(couchstore_error_info_t* errinfo,
+                                       couch_file_handle h) {
+    auto* df = reinterpret_cast<DirectFile*>(h);
+    if (df->fd == -1) {
+        return wrapped_ops.sync(errinfo, df->orig_handle);
+    }
+    // Nothing written, so nothing to sync
+    return COUCHSTORE_SUCCESS;
+}
+
+couchstore_error_t DirectReadOps::advise(couchstore_error_info_t* errinfo,
+                                         couch_file_handle h,
+                                         cs_off_t offs,
+                                         cs_off_t len,
+                                         couchstore_file_advice_t adv) {
+    auto* df = reinterpret_cast<DirectFile*>(h);
+    if (df->fd == -1) {
+        return wrapped_ops.advise(errinfo, df->orig_handle, offs, len, adv);
+    }
+    // The page cache isn't used, so there's nothing to advise it about
+    return COUCHSTORE_SUCCESS;
+}
+
+FileOpsInterface::FHStats* DirectReadOps::get_stats(couch_file_handle h) {
+    auto* df = reinterpret_cast<DirectFile*>(h);
+    if (df->fd == -1) {
+        return wrapped_ops.get_stats(df->orig_handle);
+    }
+    return nullptr;
+}
+
+void DirectReadOps::destructor(couch_file_handle h) {
+    auto* df = reinterpret_cast<DirectFile*>(h);
+#ifdef O_DIRECT
+    if (df->fd != -1) {
+        ::close(df->fd);
+    }
+#endif
+    wrapped_ops.destructor(df->orig_handle);
+    delete df;
+}
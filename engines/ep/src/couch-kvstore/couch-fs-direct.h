@@ -0,0 +1,113 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <cstdlib>
+#include <memory>
+
+#include <libcouchstore/couch_db.h>
+
+/**
+ * Returns an instance of DirectReadOps wrapping the given base FileOps
+ * implementation.
+ */
+std::unique_ptr<FileOpsInterface> getCouchstoreDirectReadOps(
+        FileOpsInterface& base_ops);
+
+/**
+ * FileOpsInterface implementation which reads files opened read-only with
+ * O_DIRECT, bypassing the OS page cache.
+ *
+ * Used for the point reads of background fetches: the documents read are
+ * cached in the HashTable, so also keeping them in the page cache wastes
+ * memory (and evicts pages more likely to be used again, e.g. those of the
+ * files being written).
+ *
+ * Files opened for writing, and any file which can't be opened with
+ * O_DIRECT (e.g. because the filesystem doesn't support it, or the
+ * platform doesn't have it), are passed through to the wrapped FileOps.
+ */
+class DirectReadOps : public FileOpsInterface {
+public:
+    /// Alignment of the offset, size and buffer of each read from the file
+    static const size_t Alignment = 4096;
+
+    explicit DirectReadOps(FileOpsInterface& ops) : wrapped_ops(ops) {
+    }
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+protected:
+    FileOpsInterface& wrapped_ops;
+
+    struct FreeDeleter {
+        void operator()(char* ptr) {
+            free(ptr);
+        }
+    };
+
+    struct DirectFile {
+        explicit DirectFile(couch_file_handle _orig_handle)
+            : orig_handle(_orig_handle) {
+        }
+
+        /// Handle of the wrapped FileOps (used if fd is not open)
+        couch_file_handle orig_handle;
+        /// File descriptor opened with O_DIRECT, or -1
+        int fd = -1;
+        /// Aligned buffer the file is read into
+        std::unique_ptr<char, FreeDeleter> buffer;
+        size_t bufferSize = 0;
+        /// Offset in the file of the data in the buffer, and its length
+        /// (couchstore files are append-only, so it stays valid until the
+        /// file is closed)
+        cs_off_t bufferOffset = 0;
+        size_t bufferValid = 0;
+    };
+};
@@ -0,0 +1,169 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include "couch-kvstore/couch-fs-readahead.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+
+const size_t ReadAheadOps::MaxWindows;
+
+/// Windows start on a multiple of this, so they're page aligned
+static const cs_off_t WindowAlignment = 4096;
+
+couch_file_handle ReadAheadOps::constructor(couchstore_error_info_t* errinfo) {
+    auto* rf = new ReadAheadFile(wrapped_ops.constructor(errinfo));
+    return reinterpret_cast<couch_file_handle>(rf);
+}
+
+couchstore_error_t ReadAheadOps::open(couchstore_error_info_t* errinfo,
+                                      couch_file_handle* h,
+                                      const char* path,
+                                      int flags) {
+    auto* rf = reinterpret_cast<ReadAheadFile*>(*h);
+    const auto rv = wrapped_ops.open(errinfo, &rf->orig_handle, path, flags);
+    rf->readAhead = (rv == COUCHSTORE_SUCCESS) &&
+                    ((flags & (O_WRONLY | O_RDWR)) == 0);
+    if (rf->readAhead) {
+        // Only a hint; the reads work regardless
+        wrapped_ops.advise(errinfo,
+                           rf->orig_handle,
+                           0,
+                           0,
+                           COUCHSTORE_FILE_ADVICE_SEQUENTIAL);
+    }
+    return rv;
+}
+
+couchstore_error_t ReadAheadOps::close(couchstore_error_info_t* errinfo,
+                                       couch_file_handle h) {
+    auto* rf = reinterpret_cast<ReadAheadFile*>(h);
+    rf->readAhead = false;
+    rf->windows.clear();
+    return wrapped_ops.close(errinfo, rf->orig_handle);
+}
+
+couchstore_error_t ReadAheadOps::set_periodic_sync(couch_file_handle h,
+                                                   uint64_t period_bytes) {
+    auto* rf = reinterpret_cast<ReadAheadFile*>(h);
+    return wrapped_ops.set_periodic_sync(rf->orig_handle, period_bytes);
+}
+
+ssize_t ReadAheadOps::pread(couchstore_error_info_t* errinfo,
+                            couch_file_handle h,
+                            void* buf,
+                            size_t sz,
+                            cs_off_t off) {
+    auto* rf = reinterpret_cast<ReadAheadFile*>(h);
+    const cs_off_t start = off - (off % WindowAlignment);
+    if (!rf->readAhead || sz == 0 ||
+        size_t(off - start) + sz > readAheadSize) {
+        return wrapped_ops.pread(errinfo, rf->orig_handle, buf, sz, off);
+    }
+
+    auto& windows = rf->windows;
+    for (auto it = windows.begin(); it != windows.end(); ++it) {
+        if (off >= it->offset &&
+            off + cs_off_t(sz) <= it->offset + cs_off_t(it->size)) {
+            std::memcpy(buf, it->data.get() + (off - it->offset), sz);
+            // Move to the front
+            std::rotate(windows.begin(), it, it + 1);
+            ++hits;
+            return sz;
+        }
+    }
+
+    // Refill the least recently used window from the start of the read
+    if (windows.size() < MaxWindows) {
+        windows.emplace_back();
+        windows.back().data.reset(new char[readAheadSize]);
+    }
+    std::rotate(windows.begin(), windows.end() - 1, windows.end());
+    Window& window = windows.front();
+
+    const ssize_t got = wrapped_ops.pread(
+            errinfo, rf->orig_handle, window.data.get(), readAheadSize, start);
+    ++reads;
+    if (got < 0) {
+        window.size = 0;
+        return got;
+    }
+    window.offset = start;
+    window.size = got;
+
+    if (size_t(got) == readAheadSize) {
+        // Have the OS read the following data while this window is used
+        wrapped_ops.advise(errinfo,
+                           rf->orig_handle,
+                           start + got,
+                           readAheadSize,
+                           COUCHSTORE_FILE_ADVICE_WILLNEED);
+    }
+
+    const size_t skip = off - start;
+    if (window.size <= skip) {
+        // At (or beyond) the end of the file
+        return 0;
+    }
+    const size_t copied = std::min(sz, window.size - skip);
+    std::memcpy(buf, window.data.get() + skip, copied);
+    return copied;
+}
+
+ssize_t ReadAheadOps::pwrite(couchstore_error_info_t* errinfo,
+                             couch_file_handle h,
+                             const void* buf,
+                             size_t sz,
+                             cs_off_t off) {
+    auto* rf = reinterpret_cast<ReadAheadFile*>(h);
+    return wrapped_ops.pwrite(errinfo, rf->orig_handle, buf, sz, off);
+}
+
+cs_off_t ReadAheadOps::goto_eof(couchstore_error_info_t* errinfo,
+                                couch_file_handle h) {
+    auto* rf = reinterpret_cast<ReadAheadFile*>(h);
+    return wrapped_ops.goto_eof(errinfo, rf->orig_handle);
+}
+
+couchstore_error_t ReadAheadOps::sync(couchstore_error_info_t* errinfo,
+                                      couch_file_handle h) {
+    auto* rf = reinterpret_cast<ReadAheadFile*>(h);
+    return wrapped_ops.sync(errinfo, rf->orig_handle);
+}
+
+couchstore_error_t ReadAheadOps::advise(couchstore_error_info_t* errinfo,
+                                        couch_file_handle h,
+                                        cs_off_t offs,
+                                        cs_off_t len,
+                                        couchstore_file_advice_t adv) {
+    auto* rf = reinterpret_cast<ReadAheadFile*>(h);
+    return wrapped_ops.advise(errinfo, rf->orig_handle, offs, len, adv);
+}
+
+FileOpsInterface::FHStats* ReadAheadOps::get_stats(couch_file_handle h) {
+    auto* rf = reinterpret_cast<ReadAheadFile*>(h);
+    return wrapped_ops.get_stats(rf->orig_handle);
+}
+
+void ReadAheadOps::destructor(couch_file_handle h) {
+    auto* rf = reinterpret_cast<ReadAheadFile*>(h);
+    wrapped_ops.destructor(rf->orig_handle);
+    delete rf;
+}
@@ -0,0 +1,123 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <libcouchstore/couch_db.h>
+
+/**
+ * FileOpsInterface implementation which serves the (small) reads of files
+ * opened read-only from a few large windows of the file, each filled with a
+ * single read.
+ *
+ * Used for the by-seqno scans of backfills: walking the B-tree reads a node
+ * or a document at a time, but as the file is append-only the documents and
+ * nodes of each commit are laid out next to each other roughly in seqno
+ * order. So the scan reads forward through a handful of regions of the file
+ * (the documents, leaves and interior nodes of the current batch); keeping
+ * a window of each turns most reads into memory copies, and the rest into
+ * large sequential reads. The wrapped FileOps is also advised that the
+ * file is read sequentially, and that the data after each window will be
+ * needed, so the OS can read it ahead while the window is being decoded.
+ *
+ * Files opened for writing are passed through to the wrapped FileOps.
+ */
+class ReadAheadOps : public FileOpsInterface {
+public:
+    /// Maximum number of windows kept for each file
+    static const size_t MaxWindows = 4;
+
+    /**
+     * @param ops the FileOps to wrap
+     * @param readAheadSize the size of each read issued to the wrapped ops
+     */
+    ReadAheadOps(FileOpsInterface& ops, size_t readAheadSize)
+        : wrapped_ops(ops), readAheadSize(readAheadSize) {
+    }
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+    /// @return the number of reads served from a window
+    size_t getHits() const {
+        return hits;
+    }
+
+    /// @return the number of windows read from the wrapped FileOps
+    size_t getReads() const {
+        return reads;
+    }
+
+protected:
+    FileOpsInterface& wrapped_ops;
+    const size_t readAheadSize;
+
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> reads{0};
+
+    struct Window {
+        cs_off_t offset = 0;
+        size_t size = 0;
+        std::unique_ptr<char[]> data;
+    };
+
+    struct ReadAheadFile {
+        explicit ReadAheadFile(couch_file_handle _orig_handle)
+            : orig_handle(_orig_handle) {
+        }
+
+        couch_file_handle orig_handle;
+        /// True if the file was opened read-only (so its reads are windowed)
+        bool readAhead = false;
+        /// Most recently used first
+        std::vector<Window> windows;
+    };
+};
@@ -44,6 +44,9 @@
 #include <platform/dirutils.h>
 
 #include "common.h"
+#include "couch-kvstore/couch-fs-cache.h"
+#include "couch-kvstore/couch-fs-direct.h"
+#include "couch-kvstore/couch-fs-readahead.h"
 #include "couch-kvstore/couch-kvstore.h"
 #include "ep_types.h"
 #include "kvstore_config.h"
@@ -265,7 +268,8 @@ CouchKVStore::CouchKVStore(KVStoreConfig& config,
                            FileOpsInterface& ops,
                            bool readOnly,
                            std::vector<std::atomic<uint64_t>>& dbFileRevMap,
-                           size_t fileRevMapSize)
+                           size_t fileRevMapSize,
+                           std::shared_ptr<BlockCache> sharedBlockCache)
     : KVStore(config, readOnly),
       dbname(config.getDBName()),
       dbFileRevMap(dbFileRevMap),
@@ -278,6 +282,41 @@ CouchKVStore::CouchKVStore(KVStoreConfig& config,
     statCollectingFileOps = getCouchstoreStatsOps(st.fsStats, base_ops);
     statCollectingFileOpsCompaction = getCouchstoreStatsOps(
         st.fsStatsCompaction, base_ops);
+    if (configuration.getDirectReads()) {
+        directReadFileOps = getCouchstoreDirectReadOps(base_ops);
+        statCollectingDirectReadFileOps =
+                getCouchstoreStatsOps(st.fsStats, *directReadFileOps);
+    }
+    // Only the read-only store does background fetches, and so reads
+    // through the cache; it's given the RW store's cache (which removes the
+    // blocks of the files it deletes).
+    if (!isReadOnly() && configuration.getBlockCacheSize() > 0) {
+        blockCache =
+                std::make_shared<BlockCache>(configuration.getBlockCacheSize());
+    } else {
+        blockCache = std::move(sharedBlockCache);
+    }
+    if (isReadOnly() && blockCache) {
+        // Wrap the stat collecting ops, so only the reads which miss the
+        // cache are counted as filesystem reads.
+        blockCacheFileOps = getCouchstoreBlockCacheOps(
+                *blockCache,
+                statCollectingDirectReadFileOps
+                        ? *statCollectingDirectReadFileOps
+                        : *statCollectingFileOps);
+    }
+    if (configuration.getScanReadAheadSize() > 0) {
+        // Wrap the stat collecting ops, so the reads actually issued are
+        // counted.
+        readAheadFileOps = std::make_unique<ReadAheadOps>(
+                *statCollectingFileOps, configuration.getScanReadAheadSize());
+    }
+    // The RO sibling is given the RW store's cache
+    if (!isReadOnly() && configuration.getDbHandleCacheSize() > 0) {
+        dbHandleCache = std::make_shared<DbHandleCache>(
+                configuration.getDbHandleCacheSize(),
+                configuration.getMaxVBuckets());
+    }
 
     // init db file map with default revision number, 1
     numDbFiles = configuration.getMaxVBuckets();
@@ -306,17 +345,21 @@ CouchKVStore::CouchKVStore(KVStoreConfig& config, FileOpsInterface& ops)
  */
 std::unique_ptr<CouchKVStore> CouchKVStore::makeReadOnlyStore() {
     // Not using make_unique due to the private constructor we're calling
-    return std::unique_ptr<CouchKVStore>(
-            new CouchKVStore(configuration, fileRevMap));
+    return std::unique_ptr<CouchKVStore>(new CouchKVStore(
+            configuration, fileRevMap, dbHandleCache, blockCache));
 }
 
 CouchKVStore::CouchKVStore(KVStoreConfig& config,
-                           std::vector<std::atomic<uint64_t>>& dbFileRevMap)
+                           std::vector<std::atomic<uint64_t>>& dbFileRevMap,
+                           std::shared_ptr<DbHandleCache> dbHandleCache,
+                           std::shared_ptr<BlockCache> blockCache)
     : CouchKVStore(config,
                    *couchstore_get_default_file_ops(),
                    true /*readonly*/,
                    dbFileRevMap,
-                   0) {
+                   0,
+                   std::move(blockCache)) {
+    this->dbHandleCache = std::move(dbHandleCache);
 }
 
 void CouchKVStore::initialize() {
@@ -356,6 +399,10 @@ void CouchKVStore::initialize() {
 
 CouchKVStore::~CouchKVStore() {
     close();
+    if (isReadOnly() && dbHandleCache) {
+        // The cached handles were opened with our FileOps
+        dbHandleCache->clear();
+    }
 }
 
 void CouchKVStore::reset(uint16_t vbucketId) {
@@ -414,10 +461,9 @@ void CouchKVStore::set(const Item &itm, Callback<mutation_result> &cb) {
 }
 
 GetValue CouchKVStore::get(const DocKey& key, uint16_t vb, bool fetchDelete) {
-    Db *db = NULL;
+    DbHandleCache::Handle handle;
     uint64_t fileRev = dbFileRevMap[vb];
-    couchstore_error_t errCode = openDB(vb, fileRev, &db,
-                                        COUCHSTORE_OPEN_FLAG_RDONLY);
+    couchstore_error_t errCode = openPointReadDB(vb, fileRev, handle);
     if (errCode != COUCHSTORE_SUCCESS) {
         ++st.numGetFailure;
         logger.log(EXTENSION_LOG_WARNING,
@@ -426,8 +472,11 @@ GetValue CouchKVStore::get(const DocKey& key, uint16_t vb, bool fetchDelete) {
         return GetValue(nullptr, couchErr2EngineErr(errCode));
     }
 
-    GetValue gv = getWithHeader(db, key, vb, GetMetaOnly::No, fetchDelete);
-    closeDatabaseHandle(db);
+    GetValue gv =
+            getWithHeader(handle.db, key, vb, GetMetaOnly::No, fetchDelete);
+    releasePointReadDB(handle,
+                       gv.getStatus() == ENGINE_SUCCESS ||
+                               gv.getStatus() == ENGINE_KEY_ENOENT);
     return gv;
 }
 
@@ -495,9 +544,8 @@ void CouchKVStore::getMulti(uint16_t vb, vb_bgfetch_queue_t &itms) {
     int numItems = itms.size();
     uint64_t fileRev = dbFileRevMap[vb];
 
-    Db *db = NULL;
-    couchstore_error_t errCode = openDB(vb, fileRev, &db,
-                                        COUCHSTORE_OPEN_FLAG_RDONLY);
+    DbHandleCache::Handle handle;
+    couchstore_error_t errCode = openPointReadDB(vb, fileRev, handle);
     if (errCode != COUCHSTORE_SUCCESS) {
         logger.log(EXTENSION_LOG_WARNING,
                    "CouchKVStore::getMulti: openDB error:%s, "
@@ -526,8 +574,13 @@ void CouchKVStore::getMulti(uint16_t vb, vb_bgfetch_queue_t &itms) {
         ++idx;
     }
 
+    Db* db = handle.db;
     GetMultiCbCtx ctx(*this, vb, itms);
 
+    // The handle may have been used before, so count the reads from here.
+    auto* stats = couchstore_get_db_filestats(db);
+    const size_t prevReadCount = stats ? stats->getReadCount() : 0;
+
     errCode = couchstore_docinfos_by_id(db, ids.data(), itms.size(),
                                         0, getMultiCbC, &ctx);
     if (errCode != COUCHSTORE_SUCCESS) {
@@ -543,15 +596,14 @@ void CouchKVStore::getMulti(uint16_t vb, vb_bgfetch_queue_t &itms) {
 
     // If available, record how many reads() we did for this getMulti;
     // and the average reads per document.
-    auto* stats = couchstore_get_db_filestats(db);
     if (stats != nullptr) {
-        const auto readCount = stats->getReadCount();
+        const auto readCount = stats->getReadCount() - prevReadCount;
         st.getMultiFsReadCount += readCount;
         st.getMultiFsReadHisto.add(readCount);
         st.getMultiFsReadPerDocHisto.add(readCount / itms.size());
     }
 
-    closeDatabaseHandle(db);
+    releasePointReadDB(handle, errCode == COUCHSTORE_SUCCESS);
 }
 
 void CouchKVStore::del(const Item &itm,
@@ -1047,6 +1099,7 @@ bool CouchKVStore::setVBucketState(uint16_t vbucketId,
 
         if (options == VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT) {
             errorCode = couchstore_commit(db);
+            invalidateDbHandles(vbucketId);
             if (errorCode != COUCHSTORE_SUCCESS) {
                 ++st.numVbSetFailure;
                 logger.log(EXTENSION_LOG_WARNING,
@@ -1159,11 +1212,90 @@ bool CouchKVStore::getStat(const char* name, size_t& value)  {
     } else if (strcmp("io_bg_fetch_read_count", name) == 0) {
         value = st.getMultiFsReadCount;
         return true;
+    } else if (isReadOnly() && blockCache) {
+        if (strcmp("Block_cache_hits", name) == 0) {
+            value = blockCache->getHits();
+            return true;
+        } else if (strcmp("Block_cache_misses", name) == 0) {
+            value = blockCache->getMisses();
+            return true;
+        } else if (strcmp("Block_cache_mem_used", name) == 0) {
+            value = blockCache->getMemUsed();
+            return true;
+        }
+    }
+    if (readAheadFileOps) {
+        if (strcmp("Scan_read_ahead_hits", name) == 0) {
+            value = readAheadFileOps->getHits();
+            return true;
+        } else if (strcmp("Scan_read_ahead_reads", name) == 0) {
+            value = readAheadFileOps->getReads();
+            return true;
+        }
     }
 
     return false;
 }
 
+void CouchKVStore::addStats(ADD_STAT add_stat, const void* c) {
+    KVStore::addStats(add_stat, c);
+
+    if (isReadOnly() && dbHandleCache) {
+        const auto prefix = getStatsPrefix() + ":";
+        add_casted_stat((prefix + "db_handle_cache_hits").c_str(),
+                        dbHandleCache->getHits(),
+                        add_stat,
+                        c);
+        add_casted_stat((prefix + "db_handle_cache_misses").c_str(),
+                        dbHandleCache->getMisses(),
+                        add_stat,
+                        c);
+        add_casted_stat((prefix + "db_handle_cache_evictions").c_str(),
+                        dbHandleCache->getEvictions(),
+                        add_stat,
+                        c);
+    }
+
+    if (isReadOnly() && blockCache) {
+        const auto prefix = getStatsPrefix() + ":";
+        add_casted_stat((prefix + "block_cache_hits").c_str(),
+                        blockCache->getHits(),
+                        add_stat,
+                        c);
+        add_casted_stat((prefix + "block_cache_misses").c_str(),
+                        blockCache->getMisses(),
+                        add_stat,
+                        c);
+        add_casted_stat((prefix + "block_cache_mem_used").c_str(),
+                        blockCache->getMemUsed(),
+                        add_stat,
+                        c);
+    }
+
+    if (readAheadFileOps) {
+        const auto prefix = getStatsPrefix() + ":";
+        add_casted_stat((prefix + "scan_read_ahead_hits").c_str(),
+                        readAheadFileOps->getHits(),
+                        add_stat,
+                        c);
+        add_casted_stat((prefix + "scan_read_ahead_reads").c_str(),
+                        readAheadFileOps->getReads(),
+                        add_stat,
+                        c);
+    }
+}
+
+void CouchKVStore::addTimingStats(ADD_STAT add_stat, const void* c) {
+    KVStore::addTimingStats(add_stat, c);
+
+    if (isReadOnly() && dbHandleCache) {
+        add_casted_stat((getStatsPrefix() + ":db_handle_open").c_str(),
+                        dbHandleCache->openHisto,
+                        add_stat,
+                        c);
+    }
+}
+
 void CouchKVStore::pendingTasks() {
     if (isReadOnly()) {
         throw std::logic_error("CouchKVStore::pendingTasks: Not valid on a "
@@ -1196,8 +1328,11 @@ ScanContext* CouchKVStore::initScanContext(std::shared_ptr<Callback<GetValue> >
                                            ValueFilter valOptions) {
     Db *db = NULL;
     uint64_t rev = dbFileRevMap[vbid];
-    couchstore_error_t errorCode = openDB(vbid, rev, &db,
-                                          COUCHSTORE_OPEN_FLAG_RDONLY);
+    couchstore_error_t errorCode = openDB(vbid,
+                                          rev,
+                                          &db,
+                                          COUCHSTORE_OPEN_FLAG_RDONLY,
+                                          readAheadFileOps.get());
     if (errorCode != COUCHSTORE_SUCCESS) {
         logger.log(EXTENSION_LOG_WARNING,
                    "CouchKVStore::initScanContext: openDB error:%s, "
@@ -1472,6 +1607,67 @@ couchstore_error_t CouchKVStore::openDB(uint16_t vbucketId,
     return errorCode;
 }
 
+FileOpsInterface* CouchKVStore::getPointReadFileOps() {
+    if (blockCacheFileOps) {
+        return blockCacheFileOps.get();
+    }
+    if (statCollectingDirectReadFileOps) {
+        return statCollectingDirectReadFileOps.get();
+    }
+    return statCollectingFileOps.get();
+}
+
+couchstore_error_t CouchKVStore::openPointReadDB(
+        uint16_t vbucketId, uint64_t fileRev, DbHandleCache::Handle& handle) {
+    // Only the RO store uses the cached handles
+    if (!isReadOnly() || !dbHandleCache) {
+        handle.vbid = vbucketId;
+        handle.fileRev = fileRev;
+        return openDB(vbucketId,
+                      fileRev,
+                      &handle.db,
+                      COUCHSTORE_OPEN_FLAG_RDONLY,
+                      getPointReadFileOps());
+    }
+
+    handle = dbHandleCache->acquire(vbucketId, fileRev);
+    if (handle.db) {
+        return COUCHSTORE_SUCCESS;
+    }
+
+    hrtime_t start = gethrtime();
+    const auto errCode = openDB(vbucketId,
+                                fileRev,
+                                &handle.db,
+                                COUCHSTORE_OPEN_FLAG_RDONLY,
+                                getPointReadFileOps());
+    if (errCode == COUCHSTORE_SUCCESS) {
+        dbHandleCache->openHisto.add((gethrtime() - start) / 1000);
+    } else {
+        handle.db = nullptr;
+    }
+    return errCode;
+}
+
+void CouchKVStore::releasePointReadDB(DbHandleCache::Handle& handle,
+                                      bool reuse) {
+    if (!handle.db) {
+        return;
+    }
+    if (!isReadOnly() || !dbHandleCache) {
+        closeDatabaseHandle(handle.db);
+        handle.db = nullptr;
+        return;
+    }
+    dbHandleCache->release(handle, reuse);
+}
+
+void CouchKVStore::invalidateDbHandles(uint16_t vbucketId) {
+    if (dbHandleCache) {
+        dbHandleCache->invalidate(vbucketId);
+    }
+}
+
 void CouchKVStore::populateFileNameMap(std::vector<std::string> &filenames,
                                        std::vector<uint16_t> *vbids) {
     std::vector<std::string>::iterator fileItr;
@@ -1943,6 +2139,7 @@ couchstore_error_t CouchKVStore::saveDocs(uint16_t vbid,
         hrtime_t cs_begin = gethrtime();
         errCode = couchstore_commit(db.getDb());
         st.commitHisto.add((gethrtime() - cs_begin) / 1000);
+        invalidateDbHandles(vbid);
         if (errCode) {
             logger.log(
                     EXTENSION_LOG_WARNING,
@@ -2586,6 +2783,7 @@ RollbackResult CouchKVStore::rollback(uint16_t vbid, uint64_t rollbackSeqno,
 
     //Append the rewinded header to the database file
     errCode = couchstore_commit(newdb.getDb());
+    invalidateDbHandles(vbid);
 
     if (errCode != COUCHSTORE_SUCCESS) {
         return RollbackResult(false, 0, 0, 0);
@@ -2613,19 +2811,20 @@ CouchKVStore::getAllKeys(uint16_t vbid,
                          const DocKey start_key,
                          uint32_t count,
                          std::shared_ptr<Callback<const DocKey&>> cb) {
-    Db *db = NULL;
+    DbHandleCache::Handle handle;
     uint64_t rev = dbFileRevMap[vbid];
-    couchstore_error_t errCode = openDB(vbid, rev, &db,
-                                        COUCHSTORE_OPEN_FLAG_RDONLY);
+    couchstore_error_t errCode = openPointReadDB(vbid, rev, handle);
     if(errCode == COUCHSTORE_SUCCESS) {
         sized_buf ref = {NULL, 0};
         ref.buf = (char*) start_key.data();
         ref.size = start_key.size();
         AllKeysCtx ctx(cb, count);
-        errCode = couchstore_all_docs(db, &ref, COUCHSTORE_NO_DELETES,
+        errCode = couchstore_all_docs(handle.db, &ref, COUCHSTORE_NO_DELETES,
                                       populateAllKeys,
                                       static_cast<void *>(&ctx));
-        closeDatabaseHandle(db);
+        releasePointReadDB(handle,
+                           errCode == COUCHSTORE_SUCCESS ||
+                                   errCode == COUCHSTORE_ERROR_CANCEL);
         if (errCode == COUCHSTORE_SUCCESS ||
                 errCode == COUCHSTORE_ERROR_CANCEL)  {
             return ENGINE_SUCCESS;
@@ -2662,6 +2861,10 @@ void CouchKVStore::unlinkCouchFile(uint16_t vbucket,
         return;
     }
 
+    invalidateDbHandles(vbucket);
+    if (blockCache) {
+        blockCache->removeFile(fname);
+    }
     if (remove(fname) == -1) {
         logger.log(EXTENSION_LOG_WARNING,
                    "CouchKVStore::unlinkCouchFile: remove error:%u, "
@@ -2738,6 +2941,7 @@ bool CouchKVStore::persistCollectionsManifestItem(uint16_t vbid,
 
     // commit logs error details
     errCode = couchstore_commit(db.getDb());
+    invalidateDbHandles(vbid);
     if (errCode != COUCHSTORE_SUCCESS) {
         return false;
     }
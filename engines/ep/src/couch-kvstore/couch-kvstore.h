@@ -22,6 +22,7 @@
 
 #include "atomicqueue.h"
 #include "configuration.h"
+#include "couch-kvstore/couch-db-handle-cache.h"
 #include "couch-kvstore/couch-fs-stats.h"
 #include "couch-kvstore/couch-kvstore-metadata.h"
 #include "item.h"
@@ -42,7 +43,9 @@
 
 #define COUCHSTORE_NO_OPTIONS 0
 
+class BlockCache;
 class EventuallyPersistentEngine;
+class ReadAheadOps;
 
 /**
  * Class representing a document to be persisted in couchstore.
@@ -410,6 +413,10 @@ public:
 
     bool getStat(const char* name, size_t& value) override;
 
+    void addStats(ADD_STAT add_stat, const void* c) override;
+
+    void addTimingStats(ADD_STAT add_stat, const void* c) override;
+
     static int recordDbDump(Db *db, DocInfo *docinfo, void *ctx);
     static int recordDbStat(Db *db, DocInfo *docinfo, void *ctx);
     static int getMultiCb(Db *db, DocInfo *docinfo, void *ctx);
@@ -502,6 +509,35 @@ protected:
                               couchstore_open_flags options,
                               FileOpsInterface* ops = nullptr);
 
+    /**
+     * The FileOps to open files with for point reads (get and getMulti):
+     * the block cache and/or direct read ops if enabled, otherwise the
+     * default ones.
+     */
+    FileOpsInterface* getPointReadFileOps();
+
+    /**
+     * Open the given revision of the vbucket's file for point reads,
+     * reusing a cached handle if possible. If successful, the handle must be
+     * passed to releasePointReadDB once finished with.
+     */
+    couchstore_error_t openPointReadDB(uint16_t vbucketId,
+                                       uint64_t fileRev,
+                                       DbHandleCache::Handle& handle);
+
+    /**
+     * Return a handle opened by openPointReadDB to the cache, or close it.
+     *
+     * @param reuse false if the handle should be closed (e.g. after an error)
+     */
+    void releasePointReadDB(DbHandleCache::Handle& handle, bool reuse);
+
+    /**
+     * Close any cached handles of the vbucket's file; to be called after
+     * the file is changed (committed to) or removed.
+     */
+    void invalidateDbHandles(uint16_t vbucketId);
+
     /**
      * save the Documents held in docs to the file associated with vbid/rev
      *
@@ -615,6 +651,46 @@ protected:
      */
     std::unique_ptr<FileOpsInterface> statCollectingFileOpsCompaction;
 
+    /**
+     * FileOpsInterface implementation for couchstore which reads files
+     * opened read-only with O_DIRECT; only created if direct reads are
+     * enabled.
+     */
+    std::unique_ptr<FileOpsInterface> directReadFileOps;
+
+    /**
+     * Stat collecting wrapper of directReadFileOps, used for point reads.
+     *
+     * Backed by this->st.fsStats
+     */
+    std::unique_ptr<FileOpsInterface> statCollectingDirectReadFileOps;
+
+    /**
+     * Cache of the file blocks read by point reads, if enabled. Created by
+     * the RW store (which removes the blocks of the files it deletes) and
+     * shared with its RO sibling (which reads through it).
+     */
+    std::shared_ptr<BlockCache> blockCache;
+
+    /**
+     * FileOpsInterface implementation serving point reads from blockCache
+     * where possible.
+     */
+    std::unique_ptr<FileOpsInterface> blockCacheFileOps;
+
+    /**
+     * FileOpsInterface implementation reading ahead for disk scans (of
+     * backfills); only created if enabled.
+     */
+    std::unique_ptr<ReadAheadOps> readAheadFileOps;
+
+    /**
+     * Cache of read-only Db handles, if enabled. Created by the RW store
+     * (which invalidates it when it changes a file) and shared with its RO
+     * sibling (which opens and uses the handles).
+     */
+    std::shared_ptr<DbHandleCache> dbHandleCache;
+
     /* deleted docs in each file, indexed by vBucket. RelaxedAtomic
        to allow stats access witout lock */
     std::vector<Couchbase::RelaxedAtomic<size_t>> cachedDeleteCount;
@@ -649,12 +725,15 @@ private:
      *        read-only constructor is called, it doesn't need to resize the map
      *        as it will use a reference to the RW store's map, so 0 would be
      *        passed.
+     * @param sharedBlockCache the RW store's block cache (if enabled), when
+     *        constructing the read-only store
      */
     CouchKVStore(KVStoreConfig& config,
                  FileOpsInterface& ops,
                  bool readOnly,
                  std::vector<std::atomic<uint64_t>>& dbFileRevMap,
-                 size_t fileRevMapSize);
+                 size_t fileRevMapSize,
+                 std::shared_ptr<BlockCache> sharedBlockCache = {});
 
     /**
      * Construct a read-only store - private as should be called via
@@ -663,9 +742,13 @@ private:
      * @param config configuration data for the store
      * @param dbFileRevMap a reference to the map (which should be data owned by
      *        the RW store).
+     * @param dbHandleCache the RW store's Db handle cache (if enabled)
+     * @param blockCache the RW store's block cache (if enabled)
      */
     CouchKVStore(KVStoreConfig& config,
-                 std::vector<std::atomic<uint64_t>>& dbFileRevMap);
+                 std::vector<std::atomic<uint64_t>>& dbFileRevMap,
+                 std::shared_ptr<DbHandleCache> dbHandleCache,
+                 std::shared_ptr<BlockCache> blockCache);
 
     class DbHolder {
     public:
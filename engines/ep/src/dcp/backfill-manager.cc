@@ -27,6 +27,8 @@
 
 #include <phosphor/phosphor.h>
 
+#include <algorithm>
+
 static const size_t sleepTime = 1;
 
 class BackfillManagerTask : public GlobalTask {
@@ -70,7 +72,7 @@ bool BackfillManagerTask::run() {
         return false;
     }
 
-    backfill_status_t status = manager->backfill();
+    backfill_status_t status = manager->backfill(this);
     if (status == backfill_finished) {
         return false;
     } else if (status == backfill_snooze) {
@@ -95,13 +97,14 @@ std::chrono::microseconds BackfillManagerTask::maxExpectedDuration() {
 }
 
 BackfillManager::BackfillManager(EventuallyPersistentEngine& e)
-    : engine(e), managerTask(NULL) {
+    : numRunning(0),
+      engine(e),
+      maxRunning(e.getConfiguration().getDcpBackfillConcurrency()),
+      diskBackfills(e.getConfiguration().getBucketType() == "persistent") {
     Configuration& config = e.getConfiguration();
 
-    scanBuffer.bytesRead = 0;
-    scanBuffer.itemsRead = 0;
-    scanBuffer.maxBytes = config.getDcpScanByteLimit();
-    scanBuffer.maxItems = config.getDcpScanItemLimit();
+    scanLimits.maxBytes = config.getDcpScanByteLimit();
+    scanLimits.maxItems = config.getDcpScanItemLimit();
 
     buffer.bytesRead = 0;
     buffer.maxBytes = config.getDcpBackfillByteLimit();
@@ -118,13 +121,14 @@ void BackfillManager::addStats(connection_t conn, ADD_STAT add_stat,
     conn->addStat("backfill_num_active", activeBackfills.size(), add_stat, c);
     conn->addStat("backfill_num_snoozing", snoozingBackfills.size(), add_stat, c);
     conn->addStat("backfill_num_pending", pendingBackfills.size(), add_stat, c);
+    conn->addStat("backfill_num_running", numRunning, add_stat, c);
 }
 
 BackfillManager::~BackfillManager() {
-    if (managerTask) {
-        managerTask->cancel();
-        managerTask.reset();
+    for (auto& task : managerTasks) {
+        task->cancel();
     }
+    managerTasks.clear();
 
     while (!activeBackfills.empty()) {
         UniqueDCPBackfillPtr backfill = std::move(activeBackfills.front());
@@ -155,32 +159,71 @@ void BackfillManager::schedule(VBucket& vb,
     LockHolder lh(lock);
     UniqueDCPBackfillPtr backfill =
             vb.createDCPBackfill(engine, stream, start, end);
+    // Takeover streams are waited on to complete the rebalance of the
+    // vbucket, so their backfills go ahead of the others
+    const bool takeover = backfill->isTakeover();
     if (engine.getDcpConnMap().canAddBackfillToActiveQ()) {
-        activeBackfills.push_back(std::move(backfill));
+        if (takeover) {
+            activeBackfills.push_front(std::move(backfill));
+        } else {
+            activeBackfills.push_back(std::move(backfill));
+        }
     } else {
         LOG(EXTENSION_LOG_NOTICE, "Backfill for %s vb:%d is pending",
             stream->getName().c_str(), vb.getId());
-        pendingBackfills.push_back(std::move(backfill));
+        if (takeover) {
+            pendingBackfills.push_front(std::move(backfill));
+        } else {
+            pendingBackfills.push_back(std::move(backfill));
+        }
     }
 
-    if (managerTask && !managerTask->isdead()) {
-        ExecutorPool::get()->wake(managerTask->getId());
-        return;
+    for (auto& task : managerTasks) {
+        ExecutorPool::get()->wake(task->getId());
     }
+    scheduleTasks_UNLOCKED();
+}
+
+void BackfillManager::scheduleTasks_UNLOCKED() {
+    managerTasks.erase(std::remove_if(managerTasks.begin(),
+                                      managerTasks.end(),
+                                      [](const ExTask& task) {
+                                          return task->isdead();
+                                      }),
+                       managerTasks.end());
+
+    // One task is needed to wait for the snoozing and pending backfills;
+    // any more only help while there are active backfills for them to run.
+    const size_t wanted = std::max(
+            size_t(1),
+            std::min(maxRunning, numRunning + activeBackfills.size()));
+    while (managerTasks.size() < wanted) {
+        ExTask task = std::make_shared<BackfillManagerTask>(
+                engine, shared_from_this());
+        ExecutorPool::get()->schedule(task);
+        managerTasks.push_back(task);
+    }
+}
 
-    managerTask.reset(new BackfillManagerTask(engine, shared_from_this()));
-    ExecutorPool::get()->schedule(managerTask);
+void BackfillManager::removeTask_UNLOCKED(GlobalTask* task) {
+    managerTasks.erase(std::remove_if(managerTasks.begin(),
+                                      managerTasks.end(),
+                                      [task](const ExTask& t) {
+                                          return t.get() == task;
+                                      }),
+                       managerTasks.end());
 }
 
-bool BackfillManager::bytesCheckAndRead(size_t bytes) {
+bool BackfillManager::bytesCheckAndRead(uint16_t vbid, size_t bytes) {
     LockHolder lh(lock);
-    if (scanBuffer.itemsRead >= scanBuffer.maxItems) {
+    auto& scanBuffer = scanBuffers[vbid];
+    if (scanBuffer.itemsRead >= scanLimits.maxItems) {
         return false;
     }
 
     // Always allow an item to be backfilled if the scan buffer is empty,
     // otherwise check to see if there is room for the item.
-    if (scanBuffer.bytesRead + bytes <= scanBuffer.maxBytes ||
+    if (scanBuffer.bytesRead + bytes <= scanLimits.maxBytes ||
         scanBuffer.bytesRead == 0) {
         scanBuffer.bytesRead += bytes;
     } else {
@@ -202,11 +245,12 @@ bool BackfillManager::bytesCheckAndRead(size_t bytes) {
     return true;
 }
 
-void BackfillManager::bytesForceRead(size_t bytes) {
+void BackfillManager::bytesForceRead(uint16_t vbid, size_t bytes) {
     LockHolder lh(lock);
 
     /* Irrespective of the scan buffer usage and overall backfill buffer usage
        we want to complete this backfill */
+    auto& scanBuffer = scanBuffers[vbid];
     ++scanBuffer.itemsRead;
     scanBuffer.bytesRead += bytes;
     buffer.bytesRead += bytes;
@@ -246,19 +290,19 @@ void BackfillManager::bytesSent(size_t bytes) {
         if (canFitNext && enoughCleared) {
             buffer.nextReadSize = 0;
             buffer.full = false;
-            if (managerTask) {
-                ExecutorPool::get()->wake(managerTask->getId());
+            for (auto& task : managerTasks) {
+                ExecutorPool::get()->wake(task->getId());
             }
         }
     }
 }
 
-backfill_status_t BackfillManager::backfill() {
+backfill_status_t BackfillManager::backfill(GlobalTask* caller) {
     std::unique_lock<std::mutex> lh(lock);
 
     if (activeBackfills.empty() && snoozingBackfills.empty()
         && pendingBackfills.empty()) {
-        managerTask.reset();
+        removeTask_UNLOCKED(caller);
         return backfill_finished;
     }
 
@@ -271,6 +315,11 @@ backfill_status_t BackfillManager::backfill() {
     moveToActiveQueue();
 
     if (activeBackfills.empty()) {
+        if (caller && managerTasks.size() > 1) {
+            // The other tasks will run the remaining backfills
+            removeTask_UNLOCKED(caller);
+            return backfill_finished;
+        }
         return backfill_snooze;
     }
 
@@ -300,26 +349,40 @@ backfill_status_t BackfillManager::backfill() {
         return reschedule ? backfill_success : backfill_snooze;
     }
 
+    if (diskBackfills &&
+        !engine.getDcpConnMap().isBackfillReadBudgetAvailable()) {
+        // The node's backfills have read as much as they may for now
+        return backfill_snooze;
+    }
+
+    // Have other tasks run the remaining active backfills alongside this one
+    scheduleTasks_UNLOCKED();
+
     UniqueDCPBackfillPtr backfill = std::move(activeBackfills.front());
     activeBackfills.pop_front();
+    const uint16_t vbid = backfill->getVBucketId();
+    ++numRunning;
 
     lh.unlock();
     backfill_status_t status = backfill->run();
     lh.lock();
 
-    scanBuffer.bytesRead = 0;
-    scanBuffer.itemsRead = 0;
+    --numRunning;
+    scanBuffers.erase(vbid);
 
     switch (status) {
         case backfill_success:
-            activeBackfills.push_back(std::move(backfill));
+            if (backfill->isTakeover()) {
+                activeBackfills.push_front(std::move(backfill));
+            } else {
+                activeBackfills.push_back(std::move(backfill));
+            }
             break;
         case backfill_finished:
             lh.unlock();
             engine.getDcpConnMap().decrNumActiveSnoozingBackfills();
             break;
         case backfill_snooze: {
-            uint16_t vbid = backfill->getVBucketId();
             VBucketPtr vb = engine.getVBucket(vbid);
             if (vb) {
                 snoozingBackfills.push_back(
@@ -342,7 +405,9 @@ void BackfillManager::moveToActiveQueue() {
     // Order in below AND is important
     while (!pendingBackfills.empty() &&
            engine.getDcpConnMap().canAddBackfillToActiveQ()) {
-        activeBackfills.splice(activeBackfills.end(),
+        activeBackfills.splice(pendingBackfills.front()->isTakeover()
+                                       ? activeBackfills.begin()
+                                       : activeBackfills.end(),
                                pendingBackfills,
                                pendingBackfills.begin());
     }
@@ -354,7 +419,11 @@ void BackfillManager::moveToActiveQueue() {
         // If snoozing task is found to be sleeping for greater than
         // allowed snoozetime, push into active queue
         if (snoozer.first + sleepTime <= ep_current_time()) {
-            activeBackfills.push_back(std::move(snoozer.second));
+            if (snoozer.second->isTakeover()) {
+                activeBackfills.push_front(std::move(snoozer.second));
+            } else {
+                activeBackfills.push_back(std::move(snoozer.second));
+            }
         } else {
             // Push back the popped snoozing backfill
             snoozingBackfills.push_back(std::move(snoozer));
@@ -365,7 +434,7 @@ void BackfillManager::moveToActiveQueue() {
 
 void BackfillManager::wakeUpTask() {
     LockHolder lh(lock);
-    if (managerTask) {
-        ExecutorPool::get()->wake(managerTask->getId());
+    for (auto& task : managerTasks) {
+        ExecutorPool::get()->wake(task->getId());
     }
 }
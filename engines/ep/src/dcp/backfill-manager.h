@@ -23,7 +23,9 @@
  * - BackfillManager, which acts as the main interface for adding new
  *    streams.
  * - BackfillManagerTask, which runs on a background AUXIO thread and
- *    performs most of the actual backfilling operations.
+ *    performs most of the actual backfilling operations. Up to
+ *    dcp_backfill_concurrency tasks run a connection's backfills
+ *    concurrently, each scanning a different vbucket.
  *
  * One main purpose of the BackfillManager is to impose a limit on the
  * in-memory buffer space a streams' backfills consume - often
@@ -36,10 +38,16 @@
  * sufficiently drained (by sending to the client), backfilling can be
  * resumed.
  *
+ * Backfills of takeover streams are run ahead of the others, and the disk
+ * reads of all of the node's backfills are limited to a shared rate (see
+ * DcpConnMap::isBackfillReadBudgetAvailable).
+ *
  * Significant configuration parameters affecting backfill:
  * - dcp_scan_byte_limit
  * - dcp_scan_item_limit
  * - dcp_backfill_byte_limit
+ * - dcp_backfill_concurrency
+ * - dcp_backfill_read_rate
  */
 
 #ifndef SRC_DCP_BACKFILL_MANAGER_H_
@@ -49,6 +57,8 @@
 #include "dcp/backfill.h"
 
 #include <list>
+#include <unordered_map>
+#include <vector>
 
 class EventuallyPersistentEngine;
 
@@ -69,26 +79,31 @@ public:
      * Checks if the read size can fit into the backfill buffer and scan
      * buffer and reads only if the read can fit.
      *
+     * @param vbid the vbucket being backfilled (whose scan buffer is used)
      * @param bytes read size
      *
      * @return true upon read success
      *         false if the buffer(s) is(are) full
      */
-    bool bytesCheckAndRead(size_t bytes);
+    bool bytesCheckAndRead(uint16_t vbid, size_t bytes);
 
     /**
      * Reads the backfill item irrespective of whether backfill buffer or
      * scan buffer is full.
      *
+     * @param vbid the vbucket being backfilled
      * @param bytes read size
      */
-    void bytesForceRead(size_t bytes);
+    void bytesForceRead(uint16_t vbid, size_t bytes);
 
     void bytesSent(size_t bytes);
 
-    // Called by the managerTask to acutally perform backfilling & manage
+    // Called by the managerTasks to acutally perform backfilling & manage
     // backfills between the different queues.
-    backfill_status_t backfill();
+    // @param caller the task calling, which is removed from managerTasks
+    //        if it isn't needed any more (i.e. when backfill_finished is
+    //        returned)
+    backfill_status_t backfill(GlobalTask* caller = nullptr);
 
     void wakeUpTask();
 
@@ -101,26 +116,44 @@ protected:
         bool full;
     } buffer;
 
-private:
-
     void moveToActiveQueue();
 
+    /**
+     * Schedule (or wake) as many managerTasks as there are backfills which
+     * can be run concurrently.
+     */
+    void scheduleTasks_UNLOCKED();
+
+    void removeTask_UNLOCKED(GlobalTask* task);
+
     std::mutex lock;
     std::list<UniqueDCPBackfillPtr> activeBackfills;
     std::list<std::pair<rel_time_t, UniqueDCPBackfillPtr> > snoozingBackfills;
     //! When the number of (activeBackfills + snoozingBackfills) crosses a
     //!   threshold we use waitingBackfills
     std::list<UniqueDCPBackfillPtr> pendingBackfills;
+    //! Number of backfills taken from activeBackfills and being run
+    size_t numRunning;
     EventuallyPersistentEngine& engine;
-    ExTask managerTask;
+    std::vector<ExTask> managerTasks;
+    //! Maximum number of backfills run concurrently
+    const size_t maxRunning;
+    //! True if the backfills read from disk (and so wait for the read budget)
+    const bool diskBackfills;
 
-    //! The scan buffer is for the current stream being backfilled
+    //! The limits of each scan buffer
     struct {
-        size_t bytesRead;
-        size_t itemsRead;
         size_t maxBytes;
         size_t maxItems;
-    } scanBuffer;
+    } scanLimits;
+
+    struct ScanBuffer {
+        size_t bytesRead = 0;
+        size_t itemsRead = 0;
+    };
+
+    //! The scan buffer of each stream being backfilled, by vbucket
+    std::unordered_map<uint16_t, ScanBuffer> scanBuffers;
 };
 
 #endif  // SRC_DCP_BACKFILL_MANAGER_H_
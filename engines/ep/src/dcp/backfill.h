@@ -68,6 +68,15 @@ public:
         return !stream->isActive();
     }
 
+    /**
+     * Indicates if the backfill is for a takeover stream
+     *
+     * @return true if the stream was requested with the takeover flag
+     */
+    bool isTakeover() const {
+        return stream->getFlags() & DCP_ADD_STREAM_FLAG_TAKEOVER;
+    }
+
     /**
      * Cancels the backfill
      */
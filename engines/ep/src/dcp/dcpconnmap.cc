@@ -23,6 +23,8 @@
 #include "dcpconnmap.h"
 #include "ep_engine.h"
 
+#include <limits>
+
 const uint32_t DcpConnMap::dbFileMem = 10 * 1024;
 const uint16_t DcpConnMap::numBackfillsThreshold = 4096;
 const uint8_t DcpConnMap::numBackfillsMemThreshold = 1;
@@ -43,6 +45,7 @@ DcpConnMap::DcpConnMap(EventuallyPersistentEngine &e)
       aggrDcpConsumerBufferSize(0) {
     backfills.numActiveSnoozing = 0;
     updateMaxActiveSnoozingBackfills(engine.getEpStats().getMaxDataSize());
+    setBackfillReadRate(engine.getConfiguration().getDcpBackfillReadRate());
     minCompressionRatioForProducer.store(
                     engine.getConfiguration().getDcpMinCompressionRatio());
 
@@ -53,6 +56,9 @@ DcpConnMap::DcpConnMap(EventuallyPersistentEngine &e)
     engine.getConfiguration().
         addValueChangedListener("dcp_consumer_process_buffered_messages_batch_size",
                                 new DcpConfigChangeListener(*this));
+    engine.getConfiguration().
+        addValueChangedListener("dcp_backfill_read_rate",
+                                new DcpConfigChangeListener(*this));
 }
 
 DcpConsumer *DcpConnMap::newConsumer(const void* cookie,
@@ -435,6 +441,49 @@ void DcpConnMap::updateMaxActiveSnoozingBackfills(size_t maxDataSize)
         newMaxActive);
 }
 
+void DcpConnMap::recordBackfillBytesRead(size_t bytes) {
+    std::lock_guard<std::mutex> lh(backfills.mutex);
+    if (backfills.readRate != 0) {
+        backfills.readBudget -= bytes;
+    }
+}
+
+bool DcpConnMap::isBackfillReadBudgetAvailable() {
+    std::lock_guard<std::mutex> lh(backfills.mutex);
+    if (backfills.readRate == 0) {
+        return true;
+    }
+
+    // Top up the budget by the rate for the time passed, accumulating at
+    // most a second's worth of reads. The time passed is clamped to a
+    // second first so that the refill can't overflow.
+    const auto now = ProcessClock::now();
+    const auto elapsed = std::min(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                    now - backfills.readBudgetUpdated),
+            std::chrono::microseconds(std::chrono::seconds(1)));
+    const int64_t rate = backfills.readRate;
+    const int64_t refill = rate / 1000000 * elapsed.count() +
+                           rate % 1000000 * elapsed.count() / 1000000;
+    if (refill > 0) {
+        backfills.readBudget = backfills.readBudget < rate - refill
+                                       ? backfills.readBudget + refill
+                                       : rate;
+        backfills.readBudgetUpdated = now;
+    }
+
+    return backfills.readBudget > 0;
+}
+
+void DcpConnMap::setBackfillReadRate(size_t rate) {
+    // The budget is signed (it may be overdrawn)
+    rate = std::min(rate, size_t(std::numeric_limits<int64_t>::max()));
+    std::lock_guard<std::mutex> lh(backfills.mutex);
+    backfills.readRate = rate;
+    backfills.readBudget = rate;
+    backfills.readBudgetUpdated = ProcessClock::now();
+}
+
 void DcpConnMap::addStats(ADD_STAT add_stat, const void *c) {
     LockHolder lh(connsLock);
     add_casted_stat("ep_dcp_dead_conn_count", deadConnections.size(), add_stat,
@@ -458,6 +507,8 @@ void DcpConnMap::DcpConfigChangeListener::sizeValueChanged(const std::string &ke
         myConnMap.consumerYieldConfigChanged(value);
     } else if (key == "dcp_consumer_process_buffered_messages_batch_size") {
         myConnMap.consumerBatchSizeConfigChanged(value);
+    } else if (key == "dcp_backfill_read_rate") {
+        myConnMap.setBackfillReadRate(value);
     }
 }
 
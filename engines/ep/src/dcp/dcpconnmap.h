@@ -21,6 +21,7 @@
 
 #include "connmap.h"
 
+#include <platform/processclock.h>
 #include <platform/sized_buffer.h>
 
 #include <atomic>
@@ -116,6 +117,26 @@ public:
         return backfills.maxActiveSnoozing;
     }
 
+    /**
+     * Record bytes read from disk by a backfill against the node-wide
+     * backfill read rate (dcp_backfill_read_rate).
+     */
+    void recordBackfillBytesRead(size_t bytes);
+
+    /**
+     * @return true if backfills haven't used up their read budget, i.e. may
+     *         start another disk scan
+     */
+    bool isBackfillReadBudgetAvailable();
+
+    /// Set the maximum bytes per second backfills may read (0 = unlimited)
+    void setBackfillReadRate(size_t rate);
+
+    size_t getBackfillReadRate() {
+        std::lock_guard<std::mutex> lh(backfills.mutex);
+        return backfills.readRate;
+    }
+
     ENGINE_ERROR_CODE addPassiveStream(ConnHandler& conn, uint32_t opaque,
                                        uint16_t vbucket, uint32_t flags);
 
@@ -180,11 +201,17 @@ protected:
     /* Db file memory */
     static const uint32_t dbFileMem;
 
-    // Current and maximum number of backfills which are snoozing.
+    // Current and maximum number of backfills which are snoozing, and the
+    // node-wide budget of bytes backfills may read from disk.
     struct {
         std::mutex mutex;
         uint16_t numActiveSnoozing;
         uint16_t maxActiveSnoozing;
+        //! Bytes per second (0 = unlimited)
+        size_t readRate;
+        //! Bytes which may still be read; negative when overdrawn
+        int64_t readBudget;
+        ProcessClock::time_point readBudgetUpdated;
     } backfills;
 
     /* Max num of backfills we want to have irrespective of memory */
@@ -144,6 +144,8 @@ DcpProducer::DcpProducer(EventuallyPersistentEngine& e,
       itemsSent(0),
       totalBytesSent(0),
       totalUncompressedDataSize(0),
+      itemCopies(0),
+      itemCopiesAvoided(0),
       includeValue(((flags & DCP_OPEN_NO_VALUE) != 0) ?
               IncludeValue::No : IncludeValue::Yes),
       includeXattrs(((flags & DCP_OPEN_INCLUDE_XATTRS) != 0) ?
@@ -521,7 +523,10 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
         }
     }
 
-    Item* itmCpy = nullptr;
+    // The item is only copied if it's to be modified (pruned or compressed)
+    // before sending; otherwise a reference to the response's item is sent.
+    std::unique_ptr<Item> itmCpy;
+    Item* itmToSend = nullptr;
     uint32_t sizeBefore = 0;
     uint32_t sizeAfter = 0;
     auto* mutationResponse =
@@ -529,9 +534,14 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
     totalUncompressedDataSize.fetch_add(resp->getMessageSize());
 
     if (mutationResponse) {
+        const queued_item& itm = mutationResponse->getItem();
+        const bool pruned = itm->needsPruning(includeValue, includeXattrs);
         try {
-            itmCpy = mutationResponse->getItemCopy();
-            itmCpy->pruneValueAndOrXattrs(includeValue, includeXattrs);
+            if (pruned ||
+                (enableValueCompression && itm->isCompressible())) {
+                itmCpy.reset(mutationResponse->getItemCopy());
+                itmCpy->pruneValueAndOrXattrs(includeValue, includeXattrs);
+            }
         } catch (const std::bad_alloc&) {
             rejectResp = std::move(resp);
             LOG(EXTENSION_LOG_WARNING,
@@ -550,27 +560,38 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
              * Compression will obviously be done only if the datatype
              * indicates that the value isn't compressed already.
              */
-            sizeBefore = itmCpy->getNBytes();
-            if (!itmCpy->compressValue()) {
-                LOG(EXTENSION_LOG_WARNING,
-                    "%s Failed to snappy compress an uncompressed value!",
-                    logHeader());
+            if (itmCpy) {
+                sizeBefore = itmCpy->getNBytes();
+                compressItemValue(*itmCpy, pruned);
+                sizeAfter = itmCpy->getNBytes();
+            } else {
+                sizeBefore = sizeAfter = itm->getNBytes();
             }
-            sizeAfter = itmCpy->getNBytes();
 
             if (sizeAfter < sizeBefore) {
                 log.acknowledge(sizeBefore - sizeAfter);
             }
 
-            if (mcbp::datatype::is_snappy(itmCpy->getDataType())) {
+            const Item& sent = itmCpy ? *itmCpy : *itm;
+            if (mcbp::datatype::is_snappy(sent.getDataType())) {
                 size_t inflated_length = 0;
-                if (snappy_uncompressed_length(itmCpy->getData(), itmCpy->getNBytes(),
+                if (snappy_uncompressed_length(sent.getData(), sent.getNBytes(),
                                                &inflated_length) == SNAPPY_OK) {
                     totalUncompressedDataSize.fetch_add(inflated_length -
-                                                        itmCpy->getNBytes());
+                                                        sent.getNBytes());
                 }
             }
         }
+
+        // Ownership of the item (or of a reference to it) passes to the
+        // server, which releases it via releaseServerItem().
+        if (itmCpy) {
+            itmToSend = itmCpy.release();
+            itemCopies++;
+        } else {
+            itmToSend = queued_item(itm).release();
+            itemCopiesAvoided++;
+        }
     }
 
     EventuallyPersistentEngine *epe = ObjectRegistry::onSwitchThread(NULL,
@@ -587,9 +608,9 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
         }
         case DcpResponse::Event::Mutation:
         {
-            if (itmCpy == nullptr) {
+            if (itmToSend == nullptr) {
                 throw std::logic_error(
-                    "DcpProducer::step(Mutation): itmCpy must be != nullptr");
+                    "DcpProducer::step(Mutation): itmToSend must be != nullptr");
             }
             std::pair<const char*, uint16_t> meta{nullptr, 0};
             if (mutationResponse->getExtMetaData()) {
@@ -598,7 +619,7 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
             ret = producers->mutation(
                     getCookie(),
                     mutationResponse->getOpaque(),
-                    itmCpy,
+                    itmToSend,
                     mutationResponse->getVBucket(),
                     *mutationResponse->getBySeqno(),
                     mutationResponse->getRevSeqno(),
@@ -611,9 +632,9 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
         }
         case DcpResponse::Event::Deletion:
         {
-            if (itmCpy == nullptr) {
+            if (itmToSend == nullptr) {
                 throw std::logic_error(
-                    "DcpProducer::step(Deletion): itmCpy must be != nullptr");
+                    "DcpProducer::step(Deletion): itmToSend must be != nullptr");
             }
             std::pair<const char*, uint16_t> meta{nullptr, 0};
             if (mutationResponse->getExtMetaData()) {
@@ -621,7 +642,7 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
             }
             ret = producers->deletion(getCookie(),
                                       mutationResponse->getOpaque(),
-                                      itmCpy,
+                                      itmToSend,
                                       mutationResponse->getVBucket(),
                                       *mutationResponse->getBySeqno(),
                                       mutationResponse->getRevSeqno(),
@@ -696,6 +717,41 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
     return (ret == ENGINE_SUCCESS) ? ENGINE_WANT_MORE : ret;
 }
 
+void DcpProducer::compressItemValue(Item& itm, bool pruned) {
+    if (!itm.isCompressible()) {
+        return;
+    }
+
+    // Items of the same vbucket and seqno have the same value, so the value
+    // compressed by one producer can be sent by the others.
+    VBucketPtr vb;
+    if (!pruned) {
+        vb = engine_.getVBucket(itm.getVBucketId());
+    }
+    if (vb) {
+        EPStats& stats = engine_.getEpStats();
+        const size_t uncompressedSize = itm.getNBytes();
+        switch (vb->checkpointManager->compressItemValue(itm)) {
+        case CheckpointManager::CompressResult::Cached:
+            stats.dcpCompressionCacheHits++;
+            stats.dcpCompressionCacheBytesSaved += uncompressedSize;
+            return;
+        case CheckpointManager::CompressResult::Compressed:
+            stats.dcpCompressionCacheMisses++;
+            return;
+        case CheckpointManager::CompressResult::Failed:
+            stats.dcpCompressionCacheMisses++;
+            break;
+        }
+    } else if (itm.compressValue()) {
+        return;
+    }
+
+    LOG(EXTENSION_LOG_WARNING,
+        "%s Failed to snappy compress an uncompressed value!",
+        logHeader());
+}
+
 ENGINE_ERROR_CODE DcpProducer::bufferAcknowledgement(uint32_t opaque,
                                                      uint16_t vbucket,
                                                      uint32_t buffer_bytes) {
@@ -890,12 +946,14 @@ void DcpProducer::notifyBackfillManager() {
     backfillMgr->wakeUpTask();
 }
 
-bool DcpProducer::recordBackfillManagerBytesRead(size_t bytes, bool force) {
+bool DcpProducer::recordBackfillManagerBytesRead(uint16_t vbid,
+                                                 size_t bytes,
+                                                 bool force) {
     if (force) {
-        backfillMgr->bytesForceRead(bytes);
+        backfillMgr->bytesForceRead(vbid, bytes);
         return true;
     }
-    return backfillMgr->bytesCheckAndRead(bytes);
+    return backfillMgr->bytesCheckAndRead(vbid, bytes);
 }
 
 void DcpProducer::recordBackfillManagerBytesSent(size_t bytes) {
@@ -915,6 +973,8 @@ void DcpProducer::addStats(ADD_STAT add_stat, const void *c) {
     addStat("items_sent", getItemsSent(), add_stat, c);
     addStat("items_remaining", getItemsRemaining(), add_stat, c);
     addStat("total_bytes_sent", getTotalBytesSent(), add_stat, c);
+    addStat("item_copies", getItemCopies(), add_stat, c);
+    addStat("item_copies_avoided", getItemCopiesAvoided(), add_stat, c);
     if (enableValueCompression) {
         addStat("total_uncompressed_data_size", getTotalUncompressedDataSize(),
                 add_stat, c);
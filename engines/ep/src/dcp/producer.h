@@ -117,6 +117,16 @@ public:
 
     size_t getTotalUncompressedDataSize();
 
+    /// @return the number of items copied (to be pruned / compressed) to send
+    size_t getItemCopies() const {
+        return itemCopies;
+    }
+
+    /// @return the number of items sent without being copied
+    size_t getItemCopiesAvoided() const {
+        return itemCopiesAvoided;
+    }
+
     std::vector<uint16_t> getVBVector(void);
 
     /**
@@ -131,7 +141,7 @@ public:
     void notifyStreamReady(uint16_t vbucket);
 
     void notifyBackfillManager();
-    bool recordBackfillManagerBytesRead(size_t bytes, bool force);
+    bool recordBackfillManagerBytesRead(uint16_t vbid, size_t bytes, bool force);
     void recordBackfillManagerBytesSent(size_t bytes);
     void scheduleBackfillManager(VBucket& vb,
                                  const active_stream_t& s,
@@ -264,6 +274,18 @@ protected:
      */
     ENGINE_ERROR_CODE maybeSendNoop(struct dcp_message_producers* producers);
 
+    /**
+     * Snappy compress the value of the given item (a copy of the one being
+     * streamed). If the item hasn't been pruned, the compressed value is
+     * shared with the other producers through the vbucket's checkpoint
+     * manager.
+     *
+     * @param itm the item to compress
+     * @param pruned true if the item's value was pruned (so differs from
+     *        the value of the item with the same seqno in the checkpoint)
+     */
+    void compressItemValue(Item& itm, bool pruned);
+
     /**
      * Create the ActiveStreamCheckpointProcessorTask and assign to
      * checkpointCreatorTask
@@ -320,6 +342,8 @@ protected:
     std::atomic<size_t> itemsSent;
     std::atomic<size_t> totalBytesSent;
     std::atomic<size_t> totalUncompressedDataSize;
+    std::atomic<size_t> itemCopies;
+    std::atomic<size_t> itemCopiesAvoided;
 
     ExTask checkpointCreatorTask;
     static const std::chrono::seconds defaultDcpNoopTxInterval;
@@ -22,6 +22,7 @@
 #include "dcp/backfill-manager.h"
 #include "dcp/backfill.h"
 #include "dcp/consumer.h"
+#include "dcp/dcpconnmap.h"
 #include "dcp/producer.h"
 #include "dcp/response.h"
 #include "dcp/stream.h"
@@ -474,13 +475,14 @@ bool ActiveStream::backfillReceived(std::unique_ptr<Item> itm,
             queued_item qi(std::move(itm));
             std::unique_ptr<DcpResponse> resp(makeResponseFromItem(qi));
             if (!producer->recordBackfillManagerBytesRead(
-                        resp->getApproximateSize(), force)) {
+                        vb_, resp->getApproximateSize(), force)) {
                 // Deleting resp may also delete itm (which is owned by resp)
                 resp.reset();
                 return false;
             }
 
-            bufferedBackfill.bytes.fetch_add(resp->getApproximateSize());
+            const size_t bytes = resp->getApproximateSize();
+            bufferedBackfill.bytes.fetch_add(bytes);
             bufferedBackfill.items++;
             lastReadSeqno.store(uint64_t(*resp->getBySeqno()));
 
@@ -496,6 +498,9 @@ bool ActiveStream::backfillReceived(std::unique_ptr<Item> itm,
                 backfillItems.memory++;
             } else {
                 backfillItems.disk++;
+                // Only the items read from disk count against the node's
+                // backfill read rate
+                engine->getDcpConnMap().recordBackfillBytesRead(bytes);
             }
         }
     }
@@ -41,8 +41,8 @@ bool DefragmentVisitor::visit(const HashTable::HashBucketLock& lh,
     // value must be at least non-zero (also covers Items with null Blobs)
     // and no larger than the biggest size class the allocator
     // supports, so it can be successfully reallocated to a run with other
-    // objects of the same size.
-    if (value_len > 0 && value_len <= max_size_class) {
+    // objects of the same size. Inline values have no Blob to reallocate.
+    if (value_len > 0 && value_len <= max_size_class && !v.isValueInline()) {
         // If sufficiently old and if it looks like nothing else holds a
         // reference to the blob reallocate, otherwise increment it's age.
         // It may be possible to add a reference to the blob without holding
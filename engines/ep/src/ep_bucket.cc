@@ -23,6 +23,7 @@
 #include "ep_vb.h"
 #include "failover-table.h"
 #include "flusher.h"
+#include "item_compressor.h"
 #include "replicationthrottle.h"
 #include "tasks.h"
 
@@ -148,6 +149,33 @@ bool BloomFilterCallback::initTempFilter(uint16_t vbucketId) {
     return true;
 }
 
+/**
+ * Callback class used by EPBucket, for adjusting the flushers as their
+ * configuration changes.
+ */
+class EPBucketValueChangeListener : public ValueChangedListener {
+public:
+    EPBucketValueChangeListener(EPBucket& st) : store(st) {
+    }
+
+    virtual void sizeValueChanged(const std::string& key, size_t value) {
+        if (key.compare("flusher_commit_window") == 0) {
+            store.setFlusherCommitWindow(value);
+        } else if (key.compare("flusher_commit_batch_size") == 0) {
+            store.setFlusherCommitBatchSize(value);
+        } else if (key.compare("flusher_pipeline_max_bytes") == 0) {
+            store.setFlusherPipelineMaxBytes(value);
+        } else {
+            LOG(EXTENSION_LOG_WARNING,
+                "Failed to change value for unknown variable, %s\n",
+                key.c_str());
+        }
+    }
+
+private:
+    EPBucket& store;
+};
+
 class ExpiredItemsCallback : public Callback<Item&, time_t&> {
 public:
     ExpiredItemsCallback(KVBucket& store) : epstore(store) {
@@ -174,6 +202,17 @@ EPBucket::EPBucket(EventuallyPersistentEngine& theEngine)
     }
     replicationThrottle = std::make_unique<ReplicationThrottle>(
             engine.getConfiguration(), stats);
+
+    auto& config = engine.getConfiguration();
+    setFlusherCommitWindow(config.getFlusherCommitWindow());
+    config.addValueChangedListener("flusher_commit_window",
+                                   new EPBucketValueChangeListener(*this));
+    setFlusherCommitBatchSize(config.getFlusherCommitBatchSize());
+    config.addValueChangedListener("flusher_commit_batch_size",
+                                   new EPBucketValueChangeListener(*this));
+    setFlusherPipelineMaxBytes(config.getFlusherPipelineMaxBytes());
+    config.addValueChangedListener("flusher_pipeline_max_bytes",
+                                   new EPBucketValueChangeListener(*this));
 }
 
 bool EPBucket::initialize() {
@@ -188,6 +227,10 @@ bool EPBucket::initialize() {
     }
     startFlusher();
 
+    if (engine.getCompressionMode() == BucketCompressionMode::Active) {
+        enableItemCompressor();
+    }
+
     return true;
 }
 
@@ -208,6 +251,54 @@ void EPBucket::reset() {
     vbMap.getShard(EP_PRIMARY_SHARD)->getFlusher()->notifyFlushEvent();
 }
 
+void EPBucket::enableItemCompressor() {
+    LockHolder lh(itemCompressor.mutex);
+    if (!itemCompressor.enabled) {
+        itemCompressor.enabled = true;
+
+        ExTask task = std::make_shared<ItemCompressorTask>(&engine, stats);
+        itemCompressor.task = ExecutorPool::get()->schedule(task);
+    }
+}
+
+void EPBucket::disableItemCompressor() {
+    LockHolder lh(itemCompressor.mutex);
+    if (itemCompressor.enabled) {
+        ExecutorPool::get()->cancel(itemCompressor.task);
+        itemCompressor.enabled = false;
+    }
+}
+
+void EPBucket::deferBgFetcherWakeUps() {
+    for (const auto& shard : vbMap.shards) {
+        shard->getBgFetcher()->deferWakeUps();
+    }
+}
+
+void EPBucket::resumeBgFetcherWakeUps() {
+    for (const auto& shard : vbMap.shards) {
+        shard->getBgFetcher()->resumeWakeUps();
+    }
+}
+
+void EPBucket::setFlusherCommitWindow(size_t ms) {
+    for (const auto& shard : vbMap.shards) {
+        shard->getFlusher()->setCommitWindow(std::chrono::milliseconds(ms));
+    }
+}
+
+void EPBucket::setFlusherCommitBatchSize(size_t size) {
+    for (const auto& shard : vbMap.shards) {
+        shard->getFlusher()->setCommitBatchSize(size);
+    }
+}
+
+void EPBucket::setFlusherPipelineMaxBytes(size_t bytes) {
+    for (const auto& shard : vbMap.shards) {
+        shard->getFlusher()->setPipelineMaxBytes(bytes);
+    }
+}
+
 void EPBucket::startFlusher() {
     for (const auto& shard : vbMap.shards) {
         shard->getFlusher()->start();
@@ -49,6 +49,12 @@ public:
 
     void wakeUpFlusher() override;
 
+    void enableItemCompressor() override;
+    void disableItemCompressor() override;
+
+    void deferBgFetcherWakeUps() override;
+    void resumeBgFetcherWakeUps() override;
+
     /**
      * Starts the background fetcher for each shard.
      * @return true if successful.
@@ -58,6 +64,11 @@ public:
     /// Stops the background fetcher for each shard.
     void stopBgFetcher();
 
+    /// Pass the group commit / pipelined flush settings to the flushers
+    void setFlusherCommitWindow(size_t ms);
+    void setFlusherCommitBatchSize(size_t size);
+    void setFlusherPipelineMaxBytes(size_t bytes);
+
     ENGINE_ERROR_CODE scheduleCompaction(uint16_t vbid,
                                          compaction_ctx c,
                                          const void* ck) override;
@@ -138,4 +149,12 @@ protected:
      *                   case of forestdb
      */
     void updateCompactionTasks(DBFileId db_file_id);
+
+    /// The ItemCompressorTask; only scheduled while compression_mode is
+    /// "active".
+    struct {
+        std::mutex mutex;
+        size_t task = 0;
+        bool enabled = false;
+    } itemCompressor;
 };
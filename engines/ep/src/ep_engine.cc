@@ -56,6 +56,7 @@
 #include <platform/processclock.h>
 #include <xattr/utils.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <fcntl.h>
@@ -63,6 +64,7 @@
 #include <iostream>
 #include <limits>
 #include <mutex>
+#include <numeric>
 #include <stdarg.h>
 #include <string>
 #include <vector>
@@ -271,6 +273,13 @@ static cb::EngineErrorItemPair EvpGet(ENGINE_HANDLE* handle,
     return cb::makeEngineErrorItemPair(cb::engine_errc(ret), itm, handle);
 }
 
+static std::vector<cb::EngineErrorItemPair> EvpGetMulti(
+        ENGINE_HANDLE* handle,
+        const void* cookie,
+        const std::vector<cb::KeyAndVBucket>& keys) {
+    return acquireEngine(handle)->get_multi(cookie, keys);
+}
+
 static cb::EngineErrorItemPair EvpGetIf(ENGINE_HANDLE* handle,
                                         const void* cookie,
                                         const DocKey& key,
@@ -562,6 +571,21 @@ protocol_binary_response_status EventuallyPersistentEngine::setFlushParam(
             getConfiguration().setDefragmenterChunkDuration(std::stoull(valz));
         } else if (strcmp(keyz, "defragmenter_run") == 0) {
             runDefragmenterTask();
+        } else if (strcmp(keyz, "compression_mode") == 0) {
+            getConfiguration().setCompressionMode(valz);
+        } else if (strcmp(keyz, "min_compression_ratio") == 0) {
+            getConfiguration().setMinCompressionRatio(std::stof(valz));
+        } else if (strcmp(keyz, "item_compressor_interval") == 0) {
+            getConfiguration().setItemCompressorInterval(std::stoull(valz));
+        } else if (strcmp(keyz, "item_compressor_chunk_duration") == 0) {
+            getConfiguration().setItemCompressorChunkDuration(
+                    std::stoull(valz));
+        } else if (strcmp(keyz, "flusher_commit_window") == 0) {
+            getConfiguration().setFlusherCommitWindow(std::stoull(valz));
+        } else if (strcmp(keyz, "flusher_commit_batch_size") == 0) {
+            getConfiguration().setFlusherCommitBatchSize(std::stoull(valz));
+        } else if (strcmp(keyz, "flusher_pipeline_max_bytes") == 0) {
+            getConfiguration().setFlusherPipelineMaxBytes(std::stoull(valz));
         } else if (strcmp(keyz, "compaction_write_queue_cap") == 0) {
             getConfiguration().setCompactionWriteQueueCap(std::stoull(valz));
         } else if (strcmp(keyz, "dcp_min_compression_ratio") == 0) {
@@ -645,6 +669,12 @@ protocol_binary_response_status EventuallyPersistentEngine::setDcpParam(
             validate(v, size_t(1), std::numeric_limits<size_t>::max());
             getConfiguration().setDcpConsumerProcessBufferedMessagesBatchSize(
                     v);
+        } else if (strcmp(keyz, "dcp_backfill_read_rate") == 0) {
+            checkNumeric(valz);
+            // The read budget is tracked as a signed value
+            int64_t v = std::stoll(valz);
+            validate(v, int64_t(0), std::numeric_limits<int64_t>::max());
+            getConfiguration().setDcpBackfillReadRate(v);
         } else {
             msg = "Unknown config param";
             rv = PROTOCOL_BINARY_RESPONSE_KEY_ENOENT;
@@ -652,6 +682,9 @@ protocol_binary_response_status EventuallyPersistentEngine::setDcpParam(
     } catch (std::runtime_error& ex) {
         msg = "Value out of range.";
         rv = PROTOCOL_BINARY_RESPONSE_EINVAL;
+    } catch (std::out_of_range&) {
+        msg = "Argument was out of range";
+        rv = PROTOCOL_BINARY_RESPONSE_EINVAL;
     }
 
     return rv;
@@ -1707,6 +1740,7 @@ EventuallyPersistentEngine::EventuallyPersistentEngine(
       checkpointConfig(NULL),
       trafficEnabled(false),
       deleteAllEnabled(false),
+      compressionMode(BucketCompressionMode::Passive),
       startupTime(0),
       taskable(this) {
     interface.interface = 1;
@@ -1718,6 +1752,7 @@ EventuallyPersistentEngine::EventuallyPersistentEngine(
     ENGINE_HANDLE_V1::remove = EvpItemDelete;
     ENGINE_HANDLE_V1::release = EvpItemRelease;
     ENGINE_HANDLE_V1::get = EvpGet;
+    ENGINE_HANDLE_V1::get_multi = EvpGetMulti;
     ENGINE_HANDLE_V1::get_if = EvpGetIf;
     ENGINE_HANDLE_V1::get_and_touch = EvpGetAndTouch;
     ENGINE_HANDLE_V1::get_locked = EvpGetLocked;
@@ -1834,6 +1869,13 @@ public:
             engine.setDeleteAll(value);
         }
     }
+
+    virtual void stringValueChanged(const std::string& key,
+                                    const char* value) {
+        if (key.compare("compression_mode") == 0) {
+            engine.setCompressionMode(value);
+        }
+    }
 private:
     EventuallyPersistentEngine &engine;
 };
@@ -1910,6 +1952,10 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::initialize(const char* config) {
     configuration.addValueChangedListener("flushall_enabled",
                                        new EpEngineValueChangeListener(*this));
 
+    setCompressionMode(configuration.getCompressionMode());
+    configuration.addValueChangedListener(
+            "compression_mode", new EpEngineValueChangeListener(*this));
+
     workload = new WorkLoadPolicy(configuration.getMaxNumWorkers(),
                                   configuration.getMaxNumShards());
     if ((unsigned int)workload->getNumShards() >
@@ -2021,7 +2067,7 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::itemAllocate(
 }
 
 void EventuallyPersistentEngine::itemRelease(const void* cookie, item* itm) {
-    delete reinterpret_cast<Item*>(itm);
+    releaseServerItem(reinterpret_cast<Item*>(itm));
 }
 
 ENGINE_ERROR_CODE EventuallyPersistentEngine::flush(const void *cookie){
@@ -2101,6 +2147,132 @@ cb::EngineErrorItemPair EventuallyPersistentEngine::get_and_touch(const void* co
     return cb::makeEngineErrorItemPair(cb::engine_errc(rv));
 }
 
+std::vector<cb::EngineErrorItemPair> EventuallyPersistentEngine::get_multi(
+        const void* cookie, const std::vector<cb::KeyAndVBucket>& keys) {
+    auto* handle = reinterpret_cast<ENGINE_HANDLE*>(this);
+    const auto options = static_cast<get_options_t>(
+            QUEUE_BG_FETCH | HONOR_STATES | TRACK_REFERENCE | DELETE_TEMP |
+            HIDE_LOCKED_CAS | TRACK_STATISTICS);
+
+    std::vector<cb::EngineErrorItemPair> ret;
+    ret.reserve(keys.size());
+    for (size_t ii = 0; ii < keys.size(); ++ii) {
+        ret.emplace_back(
+                cb::makeEngineErrorItemPair(cb::engine_errc::would_block));
+    }
+
+    // Look the keys up a vbucket at a time, so each vbucket's background
+    // fetches are queued together.
+    std::vector<size_t> pending(keys.size());
+    std::iota(pending.begin(), pending.end(), 0);
+    std::stable_sort(pending.begin(),
+                     pending.end(),
+                     [&keys](size_t a, size_t b) {
+                         return keys[a].vbucket < keys[b].vbucket;
+                     });
+
+    while (!pending.empty()) {
+        // The cookie is notified once, when the last of the keys which
+        // block completes. We hold one extra count while issuing the
+        // lookups so that early completions can't notify before we're
+        // done, and keep the BgFetchers asleep so that all of the fetches
+        // go to disk as one batch per shard.
+        beginIONotifyGroup(cookie, pending.size() + 1);
+        kvBucket->deferBgFetcherWakeUps();
+
+        std::vector<size_t> blocked;
+        try {
+            for (const auto idx : pending) {
+                item* itm = nullptr;
+                const auto status = get(cookie,
+                                        &itm,
+                                        keys[idx].key,
+                                        keys[idx].vbucket,
+                                        options);
+                if (status == ENGINE_EWOULDBLOCK) {
+                    blocked.push_back(idx);
+                } else {
+                    ret[idx] = cb::makeEngineErrorItemPair(
+                            cb::engine_errc(status), itm, handle);
+                }
+            }
+        } catch (...) {
+            // Don't leave the BgFetchers asleep; any keys which did block
+            // go back to notifying individually.
+            kvBucket->resumeBgFetcherWakeUps();
+            {
+                std::lock_guard<std::mutex> lh(ioNotifyGroupsMutex);
+                if (ioNotifyGroups.erase(cookie)) {
+                    --numIONotifyGroups;
+                }
+            }
+            throw;
+        }
+
+        kvBucket->resumeBgFetcherWakeUps();
+        if (!endIONotifyGroup(cookie, pending.size() + 1 - blocked.size())) {
+            // Still waiting for some of the blocked keys; the last of them
+            // notifies the cookie.
+            break;
+        }
+
+        // Every blocked key has already completed (and its notification
+        // was swallowed by the group), so nobody will notify the cookie.
+        // We can't notify it from within the call, so simply look those
+        // keys up again.
+        pending.swap(blocked);
+    }
+
+    return ret;
+}
+
+void EventuallyPersistentEngine::beginIONotifyGroup(const void* cookie,
+                                                    size_t count) {
+    std::lock_guard<std::mutex> lh(ioNotifyGroupsMutex);
+    if (ioNotifyGroups.emplace(cookie, count).second) {
+        ++numIONotifyGroups;
+    } else {
+        throw std::logic_error(
+                "EventuallyPersistentEngine::beginIONotifyGroup: cookie "
+                "already has a group");
+    }
+}
+
+bool EventuallyPersistentEngine::endIONotifyGroup(const void* cookie,
+                                                  size_t completed) {
+    std::lock_guard<std::mutex> lh(ioNotifyGroupsMutex);
+    auto it = ioNotifyGroups.find(cookie);
+    if (it == ioNotifyGroups.end() || it->second < completed) {
+        throw std::logic_error(
+                "EventuallyPersistentEngine::endIONotifyGroup: no group "
+                "for cookie, or too many completions (" +
+                std::to_string(completed) + ")");
+    }
+    it->second -= completed;
+    if (it->second != 0) {
+        return false;
+    }
+    ioNotifyGroups.erase(it);
+    --numIONotifyGroups;
+    return true;
+}
+
+bool EventuallyPersistentEngine::consumeIONotification(
+        const void* cookie, ENGINE_ERROR_CODE& status) {
+    std::lock_guard<std::mutex> lh(ioNotifyGroupsMutex);
+    auto it = ioNotifyGroups.find(cookie);
+    if (it == ioNotifyGroups.end()) {
+        return true;
+    }
+    if (--it->second != 0) {
+        return false;
+    }
+    ioNotifyGroups.erase(it);
+    --numIONotifyGroups;
+    status = ENGINE_SUCCESS;
+    return true;
+}
+
 cb::EngineErrorItemPair EventuallyPersistentEngine::get_if(const void* cookie,
                                                        const DocKey& key,
                                                        uint16_t vbucket,
@@ -2222,6 +2394,13 @@ cb::EngineErrorCasPair EventuallyPersistentEngine::store_if(
         cb::StoreIfPredicate predicate) {
     BlockTimer timer(&stats.storeCmdHisto);
     ENGINE_ERROR_CODE status;
+
+    // With compression disabled values are held uncompressed in memory.
+    if (compressionMode == BucketCompressionMode::Off &&
+        !item.decompressValue()) {
+        return {cb::engine_errc::invalid_arguments, cas};
+    }
+
     switch (operation) {
     case OPERATION_CAS:
         if (item.getCas() == 0) {
@@ -2380,6 +2559,10 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
                         flusher->stateName(), add_stat, cookie);
         add_casted_stat("ep_flusher_todo",
                         epstats.flusher_todo, add_stat, cookie);
+        add_casted_stat("ep_flusher_prepared_bytes",
+                        epstats.flusherPreparedBytes, add_stat, cookie);
+        add_casted_stat("ep_flusher_prepared_flushes",
+                        epstats.flusherPreparedFlushes, add_stat, cookie);
         add_casted_stat("ep_total_persisted",
                         epstats.totalPersisted, add_stat, cookie);
         add_casted_stat("ep_uncommitted_items",
@@ -2451,6 +2634,12 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
     add_casted_stat("ep_items_rm_from_checkpoints",
                     epstats.itemsRemovedFromCheckpoints,
                     add_stat, cookie);
+    add_casted_stat("ep_items_expelled_from_checkpoints",
+                    epstats.itemsExpelledFromCheckpoints,
+                    add_stat, cookie);
+    add_casted_stat("ep_mem_freed_by_checkpoint_item_expel",
+                    epstats.memFreedByCheckpointItemExpel,
+                    add_stat, cookie);
     add_casted_stat("ep_num_value_ejects", epstats.numValueEjects,
                     add_stat, cookie);
     add_casted_stat("ep_num_eject_failures", epstats.numFailedEjects,
@@ -2605,6 +2794,11 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
     add_casted_stat("ep_defragmenter_num_moved", epstats.defragNumMoved,
                     add_stat, cookie);
 
+    add_casted_stat("ep_item_compressor_num_visited",
+                    epstats.compressorNumVisited, add_stat, cookie);
+    add_casted_stat("ep_item_compressor_num_compressed",
+                    epstats.compressorNumCompressed, add_stat, cookie);
+
     add_casted_stat("ep_cursor_dropping_lower_threshold",
                     epstats.cursorDroppingLThreshold, add_stat, cookie);
     add_casted_stat("ep_cursor_dropping_upper_threshold",
@@ -2654,15 +2848,20 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
                 cookie);
     }
 
-    // Specific to ForestDB:
+    // Only if the couchstore block cache is enabled (for the read-only
+    // stores, which do the background fetches):
     if (kvBucket->getKVStoreStat("Block_cache_hits", value,
-                                 KVBucketIface::KVSOption::RW)) {
+                                 KVBucketIface::KVSOption::RO)) {
         add_casted_stat("ep_block_cache_hits", value, add_stat, cookie);
     }
     if (kvBucket->getKVStoreStat("Block_cache_misses", value,
-                                 KVBucketIface::KVSOption::RW)) {
+                                 KVBucketIface::KVSOption::RO)) {
         add_casted_stat("ep_block_cache_misses", value, add_stat, cookie);
     }
+    if (kvBucket->getKVStoreStat("Block_cache_mem_used", value,
+                                 KVBucketIface::KVSOption::RO)) {
+        add_casted_stat("ep_block_cache_mem_used", value, add_stat, cookie);
+    }
 
     return ENGINE_SUCCESS;
 }
@@ -2832,6 +3031,27 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doHashStats(const void *cookie,
                 add_casted_stat(buf, depthVisitor.size, add_stat, cookie);
                 checked_snprintf(buf, sizeof(buf), "vb_%d:resized", vbid);
                 add_casted_stat(buf, vb->ht.getNumResizes(), add_stat, cookie);
+                checked_snprintf(buf, sizeof(buf),
+                                 "vb_%d:resize_pending_buckets", vbid);
+                add_casted_stat(buf, vb->ht.getNumResizePendingBuckets(),
+                                add_stat, cookie);
+                checked_snprintf(buf, sizeof(buf),
+                                 "vb_%d:resize_migrated_items", vbid);
+                add_casted_stat(buf, vb->ht.getNumResizeMigratedItems(),
+                                add_stat, cookie);
+                checked_snprintf(buf, sizeof(buf),
+                                 "vb_%d:resize_fe_migrations", vbid);
+                add_casted_stat(buf,
+                                vb->ht.getNumResizeOpportunisticMigrations(),
+                                add_stat, cookie);
+                checked_snprintf(buf, sizeof(buf),
+                                 "vb_%d:tag_filtered_lookups", vbid);
+                add_casted_stat(buf, vb->ht.getNumTagFilteredLookups(),
+                                add_stat, cookie);
+                checked_snprintf(buf, sizeof(buf), "vb_%d:read_only_finds",
+                                 vbid);
+                add_casted_stat(buf, vb->ht.getNumReadOnlyFinds(), add_stat,
+                                cookie);
                 checked_snprintf(buf, sizeof(buf), "vb_%d:mem_size", vbid);
                 add_casted_stat(buf, vb->ht.getItemMemory(), add_stat, cookie);
                 checked_snprintf(buf, sizeof(buf), "vb_%d:mem_size_counted",
@@ -3135,6 +3355,18 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doDcpStats(const void *cookie,
     add_casted_stat("ep_dcp_total_bytes", aggregator.conn_totalBytes, add_stat, cookie);
     add_casted_stat("ep_dcp_total_uncompressed_data_size", aggregator.conn_totalUncompressedDataSize,
                     add_stat, cookie);
+    add_casted_stat("ep_dcp_compression_cache_hits",
+                    stats.dcpCompressionCacheHits,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_dcp_compression_cache_misses",
+                    stats.dcpCompressionCacheMisses,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_dcp_compression_cache_bytes_saved",
+                    stats.dcpCompressionCacheBytesSaved,
+                    add_stat,
+                    cookie);
     add_casted_stat("ep_dcp_total_queue", aggregator.conn_queue,
                     add_stat, cookie);
     add_casted_stat("ep_dcp_queue_fill", aggregator.conn_queueFill,
@@ -3251,6 +3483,8 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doTimingStats(const void *cookie,
                                                            ADD_STAT add_stat) {
     add_casted_stat("bg_wait", stats.bgWaitHisto, add_stat, cookie);
     add_casted_stat("bg_load", stats.bgLoadHisto, add_stat, cookie);
+    add_casted_stat("bg_queue", stats.bgFetchQueueHisto, add_stat, cookie);
+    add_casted_stat("bg_disk", stats.bgFetchDiskHisto, add_stat, cookie);
     add_casted_stat("set_with_meta", stats.setWithMetaHisto, add_stat, cookie);
     add_casted_stat("pending_ops", stats.pendingOpsHisto, add_stat, cookie);
 
@@ -3283,6 +3517,14 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doTimingStats(const void *cookie,
     add_casted_stat("disk_del", stats.diskDelHisto, add_stat, cookie);
     add_casted_stat("disk_vb_del", stats.diskVBDelHisto, add_stat, cookie);
     add_casted_stat("disk_commit", stats.diskCommitHisto, add_stat, cookie);
+    add_casted_stat("disk_commit_batch_size",
+                    stats.diskCommitBatchSizeHisto,
+                    add_stat,
+                    cookie);
+    add_casted_stat("disk_commit_per_item",
+                    stats.diskCommitPerItemHisto,
+                    add_stat,
+                    cookie);
 
     add_casted_stat("item_alloc_sizes", stats.itemAllocSizeHisto,
                     add_stat, cookie);
@@ -3526,6 +3768,19 @@ void EventuallyPersistentEngine::runDefragmenterTask(void) {
     kvBucket->runDefragmenterTask();
 }
 
+void EventuallyPersistentEngine::setCompressionMode(const std::string& mode) {
+    compressionMode = parseCompressionMode(mode);
+    if (!kvBucket) {
+        // Still initializing; the bucket checks the mode itself.
+        return;
+    }
+    if (compressionMode == BucketCompressionMode::Active) {
+        kvBucket->enableItemCompressor();
+    } else {
+        kvBucket->disableItemCompressor();
+    }
+}
+
 bool EventuallyPersistentEngine::runAccessScannerTask(void) {
     return kvBucket->runAccessScannerTask();
 }
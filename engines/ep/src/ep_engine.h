@@ -169,6 +169,16 @@ public:
         return ret;
     }
 
+    /**
+     * Fetch a batch of items. Each key is looked up as per get(); any keys
+     * which require a background fetch have their fetches queued before
+     * the first is scheduled, so the BgFetcher services them together.
+     *
+     * @return one result per key, in the same order as `keys`.
+     */
+    std::vector<cb::EngineErrorItemPair> get_multi(
+            const void* cookie, const std::vector<cb::KeyAndVBucket>& keys);
+
     /**
      * Fetch an item only if the specified filter predicate returns true.
      *
@@ -283,6 +293,10 @@ public:
         if (cookie == NULL) {
             LOG(EXTENSION_LOG_WARNING, "Tried to signal a NULL cookie!");
         } else {
+            if (numIONotifyGroups.load() != 0 &&
+                !consumeIONotification(cookie, status)) {
+                return;
+            }
             BlockTimer bt(&stats.notifyIOHisto);
             EventuallyPersistentEngine *epe = ObjectRegistry::onSwitchThread(NULL, true);
             serverApi->cookie->notify_io_complete(cookie, status);
@@ -604,9 +618,19 @@ public:
      */
     item_info getItemInfo(const Item& item);
 
+    BucketCompressionMode getCompressionMode() const {
+        return compressionMode;
+    }
+
 protected:
     friend class EpEngineValueChangeListener;
 
+    /**
+     * Set the bucket's compression_mode, starting / stopping the item
+     * compressor as it changes to / from "active".
+     */
+    void setCompressionMode(const std::string& mode);
+
     void setMaxItemSize(size_t value) {
         maxItemSize = value;
     }
@@ -843,6 +867,34 @@ protected:
                                      GenerateCas genCas,
                                      cb::const_byte_buffer emd);
 
+    /**
+     * Register a cookie which is about to block on (up to) count
+     * operations, so that it is notified once when they have all completed
+     * rather than once per operation.
+     */
+    void beginIONotifyGroup(const void* cookie, size_t count);
+
+    /**
+     * Account for operations of the cookie's group which completed without
+     * blocking (and so will never notify).
+     *
+     * @return true if that completed the group (i.e. every blocked
+     *         operation has already notified); the group is removed and
+     *         nobody will notify the cookie.
+     */
+    bool endIONotifyGroup(const void* cookie, size_t completed);
+
+    /**
+     * Account for a notification of the given cookie.
+     *
+     * @return true if the notification should be passed on to the server
+     *         (the cookie isn't in a group, or this was the group's last
+     *         outstanding operation, in which case status is reset to
+     *         success: the request retries each operation to get its
+     *         individual result).
+     */
+    bool consumeIONotification(const void* cookie, ENGINE_ERROR_CODE& status);
+
     SERVER_HANDLE_V1 *serverApi;
     std::unique_ptr<KVBucket> kvBucket;
     WorkLoadPolicy *workload;
@@ -851,6 +903,12 @@ protected:
     std::map<const void*, std::unique_ptr<Item>> lookups;
     std::unordered_map<const void*, ENGINE_ERROR_CODE> allKeysLookups;
     std::mutex lookupMutex;
+    // Cookies which are only notified once all of their outstanding
+    // operations have completed (see beginIONotifyGroup), and how many
+    // operations that still is.
+    std::unordered_map<const void*, size_t> ioNotifyGroups;
+    std::mutex ioNotifyGroupsMutex;
+    std::atomic<size_t> numIONotifyGroups{0};
     GET_SERVER_API getServerApiFunc;
     union {
         engine_info info;
@@ -871,6 +929,7 @@ protected:
     std::atomic<bool> trafficEnabled;
 
     bool deleteAllEnabled;
+    std::atomic<BucketCompressionMode> compressionMode;
     // a unique system generated token initialized at each time
     // ep_engine starts up.
     std::atomic<time_t> startupTime;
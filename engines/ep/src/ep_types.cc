@@ -76,3 +76,32 @@ std::string to_string(HighPriorityVBNotify hpNotifyType) {
             std::to_string(
                     static_cast<HighPriorityVBNotifyUType>(hpNotifyType)));
 }
+
+std::string to_string(BucketCompressionMode mode) {
+    using BucketCompressionModeUType =
+            std::underlying_type<BucketCompressionMode>::type;
+
+    switch (mode) {
+    case BucketCompressionMode::Off:
+        return "off";
+    case BucketCompressionMode::Passive:
+        return "passive";
+    case BucketCompressionMode::Active:
+        return "active";
+    }
+    throw std::invalid_argument(
+            "to_string(BucketCompressionMode) unknown " +
+            std::to_string(static_cast<BucketCompressionModeUType>(mode)));
+}
+
+BucketCompressionMode parseCompressionMode(const std::string& mode) {
+    if (mode == "off") {
+        return BucketCompressionMode::Off;
+    } else if (mode == "passive") {
+        return BucketCompressionMode::Passive;
+    } else if (mode == "active") {
+        return BucketCompressionMode::Active;
+    }
+    throw std::invalid_argument("parseCompressionMode: unknown mode '" +
+                                mode + "'");
+}
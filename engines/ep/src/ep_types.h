@@ -128,6 +128,28 @@ enum class HighPriorityVBReqStatus {
  */
 const int64_t HlcCasSeqnoUninitialised = -1;
 
+/**
+ * Compression mode of a bucket - how values are stored in memory.
+ */
+enum class BucketCompressionMode {
+    Off, // Values are stored uncompressed; Snappy values inflated on store.
+    Passive, // Values are stored as received from the client.
+    Active // As Passive, and the ItemCompressorTask compresses values.
+};
+
+/**
+ * Overloads the to_string method to give the string format of a member of the
+ * class BucketCompressionMode (as used in the configuration)
+ */
+std::string to_string(BucketCompressionMode mode);
+
+/**
+ * Parse a BucketCompressionMode from its configuration string
+ * ("off", "passive" or "active").
+ * @throws std::invalid_argument if the string is not a valid mode.
+ */
+BucketCompressionMode parseCompressionMode(const std::string& mode);
+
 /**
  * Item eviction policy
  */
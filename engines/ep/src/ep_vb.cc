@@ -56,7 +56,8 @@ EPVBucket::EPVBucket(id_type i,
               lastSnapEnd,
               std::move(table),
               flusherCb,
-              std::make_unique<StoredValueFactory>(st),
+              std::make_unique<StoredValueFactory>(
+                      st, config.getHtInlineValueMaxSize()),
               std::move(newSeqnoCb),
               config,
               evictionPolicy,
@@ -231,25 +232,29 @@ void EPVBucket::notifyAllPendingConnsFailed(EventuallyPersistentEngine& e) {
         shard->highPriorityCount.fetch_sub(toNotify.size());
     }
 
-    // Add all the pendingBGFetches to the toNotify map
+    // Fail all the pendingBGFetches. Each fetch is notified on its own (a
+    // GET_MULTI cookie may have several and expects one notification for
+    // each).
+    std::vector<const void*> failedFetches;
     {
         LockHolder lh(pendingBGFetchesLock);
-        size_t num_of_deleted_pending_fetches = 0;
         for (auto& bgf : pendingBGFetches) {
             vb_bgfetch_item_ctx_t& bg_itm_ctx = bgf.second;
             for (auto& bgitem : bg_itm_ctx.bgfetched_list) {
-                toNotify[bgitem->cookie] = ENGINE_NOT_MY_VBUCKET;
+                failedFetches.push_back(bgitem->cookie);
                 e.storeEngineSpecific(bgitem->cookie, nullptr);
-                ++num_of_deleted_pending_fetches;
             }
         }
-        stats.numRemainingBgItems.fetch_sub(num_of_deleted_pending_fetches);
+        stats.numRemainingBgItems.fetch_sub(failedFetches.size());
         pendingBGFetches.clear();
     }
 
     for (auto& notify : toNotify) {
         e.notifyIOComplete(notify.first, notify.second);
     }
+    for (const auto* cookie : failedFetches) {
+        e.notifyIOComplete(cookie, ENGINE_NOT_MY_VBUCKET);
+    }
 
     fireAllOps(e);
 }
@@ -52,7 +52,8 @@ EphemeralVBucket::EphemeralVBucket(id_type i,
               lastSnapEnd,
               std::move(table),
               /*flusherCb*/ nullptr,
-              std::make_unique<OrderedStoredValueFactory>(st),
+              std::make_unique<OrderedStoredValueFactory>(
+                      st, config.getHtInlineValueMaxSize()),
               std::move(newSeqnoCb),
               config,
               evictionPolicy,
@@ -92,7 +93,7 @@ bool EphemeralVBucket::pageOut(const HashTable::HashBucketLock& lh,
     if (getState() != vbucket_state_active) {
         return false;
     }
-    if (v->isDeleted() && !v->getValue()) {
+    if (v->isDeleted() && !v->hasValue()) {
         // If the item has already been deleted (and doesn't have a value
         // associated with it) then there's no further deletion possible,
         // until the deletion marker (tombstone) is later purged at the
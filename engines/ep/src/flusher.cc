@@ -216,6 +216,19 @@ bool Flusher::step(GlobalTask *task) {
 }
 
 void Flusher::completeFlush() {
+    if (cancelPrepareTask()) {
+        // The vbuckets prepared by the pipeline may not be queued; flush
+        // everything.
+        bool inverse = false;
+        pendingMutation.compare_exchange_strong(inverse, true);
+    }
+
+    // Don't hold anything back; we're shutting down
+    for (const auto& deferred : deferredVbs) {
+        lpVbs.push_back(deferred.first);
+    }
+    deferredVbs.clear();
+
     while(!canSnooze()) {
         flushVB();
     }
@@ -227,7 +240,54 @@ double Flusher::computeMinSleepTime() {
         return 0;
     }
     minSleepTime *= 2;
-    return std::min(minSleepTime, DEFAULT_MAX_SLEEP_TIME);
+    double tosleep = std::min(minSleepTime, DEFAULT_MAX_SLEEP_TIME);
+    if (!deferredVbs.empty()) {
+        // Wake up in time to flush the vbuckets we've been holding back
+        tosleep = std::min(tosleep, secondsUntilDeferredFlush());
+    }
+    return tosleep;
+}
+
+double Flusher::secondsUntilDeferredFlush() const {
+    auto first = ProcessClock::time_point::max();
+    for (const auto& deferred : deferredVbs) {
+        first = std::min(first, deferred.second);
+    }
+    const auto remaining =
+            (first + commitWindow.load()) - ProcessClock::now();
+    return std::max(
+            0.0, std::chrono::duration<double>(remaining).count());
+}
+
+bool Flusher::deferFlush(uint16_t vbid) {
+    auto it = deferredVbs.find(vbid);
+    const auto window = commitWindow.load();
+    if (window.count() == 0 || _state != State::Running) {
+        if (it != deferredVbs.end()) {
+            deferredVbs.erase(it);
+        }
+        return false;
+    }
+
+    VBucketPtr vb = store->getVBucket(vbid);
+    const auto now = ProcessClock::now();
+    // Flush right away if there's nothing to batch up, the batch is large
+    // enough, someone is waiting for the vbucket to be persisted or
+    // we've already held it back for the whole window.
+    if (!vb || vb->dirtyQueueSize.load() == 0 ||
+        vb->dirtyQueueSize.load() >= commitBatchSize ||
+        vb->getHighPriorityChkSize() > 0 ||
+        (it != deferredVbs.end() && now - it->second >= window)) {
+        if (it != deferredVbs.end()) {
+            deferredVbs.erase(it);
+        }
+        return false;
+    }
+
+    if (it == deferredVbs.end()) {
+        deferredVbs.emplace(vbid, now);
+    }
+    return true;
 }
 
 void Flusher::flushVB(void) {
@@ -245,7 +305,12 @@ void Flusher::flushVB(void) {
         bool inverse = true;
         if (pendingMutation.compare_exchange_strong(inverse, false)) {
             for (auto vbid : shard->getVBucketsSortedByState()) {
-                lpVbs.push(vbid);
+                lpVbs.push_back(vbid);
+            }
+        } else if (!deferredVbs.empty() &&
+                   secondsUntilDeferredFlush() == 0) {
+            for (const auto& deferred : deferredVbs) {
+                lpVbs.push_back(deferred.first);
             }
         }
     }
@@ -254,7 +319,7 @@ void Flusher::flushVB(void) {
         for (auto vbid : shard->getVBuckets()) {
             VBucketPtr vb = store->getVBucket(vbid);
             if (vb && vb->getHighPriorityChkSize() > 0) {
-                hpVbs.push(vbid);
+                hpVbs.push_back(vbid);
             }
         }
         numHighPriority = hpVbs.size();
@@ -269,18 +334,85 @@ void Flusher::flushVB(void) {
         return;
     } else if (!hpVbs.empty()) {
         uint16_t vbid = hpVbs.front();
-        hpVbs.pop();
+        hpVbs.pop_front();
+        wakePrepareTask();
         if (store->flushVBucket(vbid) == RETRY_FLUSH_VBUCKET) {
-            hpVbs.push(vbid);
+            hpVbs.push_back(vbid);
         }
     } else {
+        // Skip past the vbuckets which are still accumulating a batch
+        while (!lpVbs.empty() && deferFlush(lpVbs.front())) {
+            lpVbs.pop_front();
+        }
+        if (lpVbs.empty()) {
+            return;
+        }
+
         if (doHighPriority && --numHighPriority == 0) {
             doHighPriority = false;
         }
         uint16_t vbid = lpVbs.front();
-        lpVbs.pop();
+        lpVbs.pop_front();
+        wakePrepareTask();
         if (store->flushVBucket(vbid) == RETRY_FLUSH_VBUCKET) {
-            lpVbs.push(vbid);
+            lpVbs.push_back(vbid);
+        }
+    }
+}
+
+void Flusher::wakePrepareTask() {
+    if (pipelineMaxBytes == 0 || lpVbs.empty() || _state != State::Running) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lh(upcomingMutex);
+        upcoming.assign(lpVbs.begin(), lpVbs.end());
+    }
+
+    if (prepareTaskId == 0) {
+        prepareLink = std::make_shared<FlushPrepareLink>(this);
+        ExTask task = std::make_shared<FlushPrepareTask>(
+                ObjectRegistry::getCurrentEngine(),
+                prepareLink,
+                shard->getId());
+        prepareTaskId = task->getId();
+        ExecutorPool::get()->schedule(task);
+    }
+    ExecutorPool::get()->wake(prepareTaskId);
+}
+
+bool Flusher::cancelPrepareTask() {
+    const size_t id = prepareTaskId.exchange(0);
+    if (id == 0) {
+        return false;
+    }
+    ExecutorPool::get()->cancel(id);
+
+    // The task may be running (or be about to run) regardless; detach it,
+    // which waits for any prepare in progress to finish.
+    {
+        std::lock_guard<std::mutex> lh(prepareLink->mutex);
+        prepareLink->flusher = nullptr;
+    }
+    prepareLink.reset();
+    return true;
+}
+
+void Flusher::prepareUpcoming() {
+    auto& stats = store->getEPEngine().getEpStats();
+    const size_t maxBytes = pipelineMaxBytes;
+
+    while (_state == State::Running && stats.flusherPreparedBytes < maxBytes) {
+        uint16_t vbid;
+        {
+            std::lock_guard<std::mutex> lh(upcomingMutex);
+            if (upcoming.empty()) {
+                break;
+            }
+            vbid = upcoming.front();
+            upcoming.pop_front();
         }
+        store->prepareFlushBatch(vbid);
     }
 }
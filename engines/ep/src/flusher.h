@@ -20,8 +20,13 @@
 
 #include "config.h"
 
+#include <platform/processclock.h>
+
+#include <chrono>
+#include <deque>
 #include <list>
 #include <map>
+#include <mutex>
 #include <queue>
 #include <string>
 
@@ -36,6 +41,7 @@ const double DEFAULT_MIN_SLEEP_TIME = MIN_SLEEP_TIME;
 const double DEFAULT_MAX_SLEEP_TIME = 10.0;
 
 class KVShard;
+struct FlushPrepareLink;
 
 /**
  * Manage persistence of data for an EPBucket.
@@ -61,6 +67,7 @@ public:
                 stateName(_state));
             stop(true);
         }
+        cancelPrepareTask();
     }
 
     bool stop(bool isForceShutdown = false);
@@ -84,6 +91,23 @@ public:
     }
     void setTaskId(size_t newId) { taskId = newId; }
 
+    /**
+     * Prepare the flush of the upcoming vbuckets (up to the pipeline's
+     * byte budget). Called by the FlushPrepareTask.
+     */
+    void prepareUpcoming();
+
+    /// Update the group commit and pipelined flush settings (see below)
+    void setCommitWindow(std::chrono::milliseconds window) {
+        commitWindow = window;
+    }
+    void setCommitBatchSize(size_t size) {
+        commitBatchSize = size;
+    }
+    void setPipelineMaxBytes(size_t bytes) {
+        pipelineMaxBytes = bytes;
+    }
+
 private:
     enum class State {
         Initializing,
@@ -97,7 +121,11 @@ private:
     bool transitionState(State to);
     bool validTransition(State to) const;
     void flushVB();
+    bool deferFlush(uint16_t vbid);
+    double secondsUntilDeferredFlush() const;
     void completeFlush();
+    void wakePrepareTask();
+    bool cancelPrepareTask();
     void initialize();
     void schedule_UNLOCKED();
     double computeMinSleepTime();
@@ -118,12 +146,39 @@ private:
 
     double                   minSleepTime;
     std::atomic<bool> forceShutdownReceived;
-    std::queue<uint16_t> hpVbs;
-    std::queue<uint16_t> lpVbs;
+    std::deque<uint16_t> hpVbs;
+    std::deque<uint16_t> lpVbs;
     bool doHighPriority;
     size_t numHighPriority;
     std::atomic<bool> pendingMutation;
 
+    /*
+     * Group commit: with a non-zero flusher_commit_window a vbucket with
+     * less than flusher_commit_batch_size outstanding items isn't flushed
+     * (committed) until the window has passed since we first skipped it,
+     * so each commit (and fsync) covers a larger batch of items.
+     */
+    std::atomic<std::chrono::milliseconds> commitWindow{
+            std::chrono::milliseconds(0)};
+    std::atomic<size_t> commitBatchSize{0};
+    // The vbuckets currently being held back, and when we first did so
+    std::map<uint16_t, ProcessClock::time_point> deferredVbs;
+
+    /*
+     * Pipelined flush: with a non-zero flusher_pipeline_max_bytes the
+     * FlushPrepareTask takes the items of the vbuckets queued behind the
+     * one being flushed out of their checkpoints (and sorts them) while
+     * this task is writing, so the disk isn't left idle while the flusher
+     * does CPU work. The prepared items are held by the VBucket until its
+     * next flush; the total held is bounded by the byte budget.
+     */
+    std::atomic<size_t> pipelineMaxBytes{0};
+    std::atomic<size_t> prepareTaskId{0};
+    std::shared_ptr<FlushPrepareLink> prepareLink;
+    // The vbuckets for the FlushPrepareTask to prepare, in flush order
+    std::mutex upcomingMutex;
+    std::deque<uint16_t> upcoming;
+
     KVShard *shard;
 
     DISALLOW_COPY_AND_ASSIGN(Flusher);
@@ -23,6 +23,7 @@
 
 #include <phosphor/phosphor.h>
 
+#include <algorithm>
 #include <cstring>
 
 static const ssize_t prime_size_table[] = {
@@ -33,6 +34,33 @@ static const ssize_t prime_size_table[] = {
 };
 
 
+/*
+ * Bucket tag helpers - see HashTable::bucketTags.
+ */
+static const size_t tagsPerBucket = 8;
+static const uint8_t wildcardTag = 0xff;
+static const uint64_t tagLowBits = 0x0101010101010101ULL;
+static const uint64_t tagHighBit = 0x80;
+
+/// Tag for a key hash. Always has the top bit set, so is never 0x00 ("no
+/// element"). Uses the top bits of the hash, which are least related to the
+/// hash bucket (the low bits).
+static uint8_t tagForHash(uint32_t hash) {
+    return 0x80 | (hash >> 25);
+}
+
+/**
+ * Compare all eight tags packed in `tags` with `tag` at once.
+ *
+ * @return a word with the top bit of byte N set if byte N of tags equals tag.
+ *         May report false positives (in bytes following a true match),
+ *         never false negatives.
+ */
+static uint64_t matchTag(uint64_t tags, uint8_t tag) {
+    const uint64_t x = tags ^ (tagLowBits * tag);
+    return (x - tagLowBits) & ~x & (tagLowBits * tagHighBit);
+}
+
 std::ostream& operator<<(std::ostream& os, const HashTable::Position& pos) {
     os << "{lock:" << pos.lock << " bucket:" << pos.hash_bucket << "/" << pos.ht_size << "}";
     return os;
@@ -41,12 +69,22 @@ std::ostream& operator<<(std::ostream& os, const HashTable::Position& pos) {
 HashTable::HashTable(EPStats& st,
                      std::unique_ptr<AbstractStoredValueFactory> svFactory,
                      size_t initialSize,
-                     size_t locks)
+                     size_t locks,
+                     bool incrementalResize,
+                     bool useBucketTags)
     : datatypeCounts(),
       cacheSize(0),
       metaDataMemory(0),
       initialSize(initialSize),
       size(initialSize),
+      incrementalResize(incrementalResize),
+      oldSize(0),
+      nextResizeBucket(0),
+      numResizeMigratedBuckets(0),
+      numResizeMigratedItems(0),
+      numResizeOpportunisticMigrations(0),
+      useBucketTags(useBucketTags),
+      numTagFilteredLookups(0),
       mutexes(locks),
       stats(st),
       valFact(std::move(svFactory)),
@@ -57,10 +95,14 @@ HashTable::HashTable(EPStats& st,
       numDeletedItems(0),
       numEjects(0),
       numResizes(0),
+      numReadOnlyFinds(0),
       numTempItems(0),
       memSize(0),
       maxDeletedRevSeqno(0) {
     values.resize(size);
+    if (useBucketTags) {
+        bucketTags.resize(size);
+    }
     activeState = true;
 }
 
@@ -93,7 +135,7 @@ void HashTable::clear(bool deactivate) {
                     "non-active object");
         }
     }
-    MultiLockHolder mlh(mutexes);
+    MultiWriterLockHolder mlh(mutexes);
     clear_UNLOCKED(deactivate);
 }
 
@@ -101,20 +143,28 @@ void HashTable::clear_UNLOCKED(bool deactivate) {
     if (deactivate) {
         setActiveState(false);
     }
-    size_t clearedMemSize = 0;
-    size_t clearedValSize = 0;
-    for (int i = 0; i < (int)size; i++) {
-        while (values[i]) {
+    size_t clearedMetaDataSize = 0;
+    auto clearChain = [&clearedMetaDataSize](StoredValue::UniquePtr& chain) {
+        while (chain) {
             // Take ownership of the StoredValue from the vector, update
             // statistics and release it.
-            auto v = std::move(values[i]);
-            clearedMemSize += v->size();
-            clearedValSize += v->valuelen();
-            values[i] = std::move(v->getNext());
+            auto v = std::move(chain);
+            clearedMetaDataSize += v->metaDataSize();
+            chain = std::move(v->getNext());
         }
+    };
+    for (int i = 0; i < (int)size; i++) {
+        clearChain(values[i]);
+    }
+    std::fill(bucketTags.begin(), bucketTags.end(), 0);
+    // Any not-yet-migrated buckets of an in-progress incremental resize.
+    // The (now empty) old array is discarded by the migrating thread as
+    // normal.
+    for (auto& chain : oldValues) {
+        clearChain(chain);
     }
 
-    stats.currentSize.fetch_sub(clearedMemSize - clearedValSize);
+    stats.currentSize.fetch_sub(clearedMetaDataSize);
 
     datatypeCounts.fill(0);
     numTotalItems.store(0);
@@ -157,7 +207,9 @@ void HashTable::resize() {
         new_size = initialSize;
     } else if (0 == i) {
         new_size = prime_size_table[i];
-    }else if (isCurrently(size, prime_size_table[i-1], prime_size_table[i])) {
+    } else if (isCurrently(size,
+                           alignToLocks(prime_size_table[i - 1]),
+                           alignToLocks(prime_size_table[i]))) {
         // If one of the candidate sizes is the current size, maintain
         // the current size in order to remain stable.
         new_size = size;
@@ -175,6 +227,11 @@ void HashTable::resize(size_t newSize) {
                 "non-active object");
     }
 
+    // Finish off any previous incremental resize before considering another.
+    completeResize();
+
+    newSize = alignToLocks(newSize);
+
     // Due to the way hashing works, we can't fit anything larger than
     // an int.
     if (newSize > static_cast<size_t>(std::numeric_limits<int>::max())) {
@@ -189,7 +246,46 @@ void HashTable::resize(size_t newSize) {
     TRACE_EVENT2(
             "HashTable", "resize", "size", size.load(), "newSize", newSize);
 
-    MultiLockHolder mlh(mutexes);
+    // Incremental resizing requires the current size to also be a multiple
+    // of the number of locks (see oldValues); if it isn't (e.g. ht_size not
+    // a multiple of ht_locks) fall back to a one-off full rehash, which
+    // will leave the table suitably sized for subsequent resizes.
+    if (incrementalResize && (size % mutexes.size()) == 0) {
+        // Allocate the new bucket array before acquiring any locks.
+        table_type newValues(newSize);
+        std::vector<uint64_t> newTags(useBucketTags ? newSize : 0);
+        {
+            std::lock_guard<std::mutex> guard(resizeMigrationMutex);
+            MultiWriterLockHolder mlh(mutexes);
+            if (visitors.load() > 0 || oldSize != 0) {
+                // Visitors in progress (see below), or raced with another
+                // resize.
+                return;
+            }
+
+            stats.memOverhead->fetch_sub(memorySize());
+            ++numResizes;
+
+            // Just swap in the new (empty) bucket array; items are migrated
+            // from the old one after the locks are released.
+            oldValues = std::move(values);
+            values = std::move(newValues);
+            bucketTags = std::move(newTags);
+            oldSize.store(size);
+            size.store(newSize);
+            nextResizeBucket = 0;
+
+            stats.memOverhead->fetch_add(memorySize());
+        }
+        completeResize();
+        return;
+    }
+
+    MultiWriterLockHolder mlh(mutexes);
+    if (oldSize != 0) {
+        // Raced with an incremental resize.
+        return;
+    }
     if (visitors.load() > 0) {
         // Do not allow a resize while any visitors are actually
         // processing.  The next attempt will have to pick it up.  New
@@ -200,34 +296,100 @@ void HashTable::resize(size_t newSize) {
 
     // Get a place for the new items.
     table_type newValues(newSize);
+    std::vector<uint64_t> newTags(useBucketTags ? newSize : 0);
 
     stats.memOverhead->fetch_sub(memorySize());
     ++numResizes;
 
     // Set the new size so all the hashy stuff works.
-    size_t oldSize = size;
+    size_t prevSize = size;
     size.store(newSize);
 
     // Move existing records into the new space.
-    for (size_t i = 0; i < oldSize; i++) {
+    for (size_t i = 0; i < prevSize; i++) {
         while (values[i]) {
             // unlink the front element from the hash chain at values[i].
             auto v = std::move(values[i]);
             values[i] = std::move(v->getNext());
 
             // And re-link it into the correct place in newValues.
-            int newBucket = getBucketForHash(v->getKey().hash());
+            const auto hash = v->getKey().hash();
+            int newBucket = getBucketForHash(hash);
             v->setNext(std::move(newValues[newBucket]));
             newValues[newBucket] = std::move(v);
+            if (useBucketTags) {
+                newTags[newBucket] =
+                        (newTags[newBucket] << 8) | tagForHash(hash);
+            }
         }
     }
 
     // Finally assign the new table to values.
     values = std::move(newValues);
+    bucketTags = std::move(newTags);
 
     stats.memOverhead->fetch_add(memorySize());
 }
 
+void HashTable::completeResize() {
+    if (oldSize == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(resizeMigrationMutex);
+    while (nextResizeBucket < oldSize) {
+        const int oldBucket = nextResizeBucket++;
+        // Due to size alignment, the old bucket's lock is the same one which
+        // guards all of the new buckets its items will be moved to.
+        HashBucketLock lh(oldBucket,
+                          mutexes[oldBucket % mutexes.size()]);
+        unlocked_migrateOldBucket(oldBucket);
+        ++numResizeMigratedBuckets;
+    }
+    if (oldSize != 0) {
+        finishResize();
+    }
+}
+
+void HashTable::finishResize() {
+    MultiWriterLockHolder mlh(mutexes);
+    stats.memOverhead->fetch_sub(memorySize());
+    table_type().swap(oldValues);
+    // Reset the migrated count before oldSize, so a concurrent stats read
+    // of getNumResizePendingBuckets() never underflows.
+    numResizeMigratedBuckets.store(0);
+    oldSize.store(0);
+    nextResizeBucket = 0;
+    stats.memOverhead->fetch_add(memorySize());
+}
+
+size_t HashTable::unlocked_migrateOldBucket(int oldBucket) {
+    size_t moved = 0;
+    while (oldValues[oldBucket]) {
+        // unlink the front element from the old hash chain, and re-link it
+        // into the correct place in the new one.
+        auto v = std::move(oldValues[oldBucket]);
+        oldValues[oldBucket] = std::move(v->getNext());
+
+        const auto hash = v->getKey().hash();
+        int newBucket = getBucketForHash(hash);
+        v->setNext(std::move(values[newBucket]));
+        values[newBucket] = std::move(v);
+        unlocked_pushTag(newBucket, hash);
+        ++moved;
+    }
+    numResizeMigratedItems.fetch_add(moved);
+    return moved;
+}
+
+size_t HashTable::alignToLocks(size_t s) const {
+    if (!incrementalResize) {
+        return s;
+    }
+    const size_t numLocks = mutexes.size();
+    return ((s + numLocks - 1) / numLocks) * numLocks;
+}
+
 StoredValue* HashTable::find(const DocKey& key,
                              TrackReference trackReference,
                              WantsDeleted wantsDeleted) {
@@ -239,6 +401,49 @@ StoredValue* HashTable::find(const DocKey& key,
     return unlocked_find(key, hbl.getBucketNum(), wantsDeleted, trackReference);
 }
 
+HashTable::FindROResult HashTable::findForRead(const DocKey& key,
+                                               TrackReference trackReference,
+                                               WantsDeleted wantsDeleted) {
+    if (!isActive()) {
+        throw std::logic_error("HashTable::findForRead: Cannot call on a "
+                "non-active object");
+    }
+    const int hash = key.hash();
+    while (true) {
+        int bucket = getBucketForHash(hash);
+        std::unique_lock<cb::ReaderLock> lh(
+                mutexes[mutexForBucket(bucket)].reader());
+        if (bucket != getBucketForHash(hash)) {
+            // Raced with a resize; retry with the new bucket.
+            continue;
+        }
+
+        StoredValue* v = unlocked_find(
+                key, bucket, wantsDeleted, TrackReference::No);
+        if (v && trackReference == TrackReference::Yes && !v->isDeleted() &&
+            v->getNRUValue() > MIN_NRU_VALUE) {
+            // Recording the reference modifies the StoredValue, which isn't
+            // permitted under the shared lock. Upgrade to exclusive just for
+            // that, then retry the shared lookup. Frequently accessed
+            // (i.e. hot) items are already at MIN_NRU_VALUE so will normally
+            // not take this path.
+            lh.unlock();
+            {
+                auto hbl = getLockedBucket(key);
+                unlocked_find(key,
+                              hbl.getBucketNum(),
+                              wantsDeleted,
+                              TrackReference::Yes);
+            }
+            trackReference = TrackReference::No;
+            continue;
+        }
+
+        ++numReadOnlyFinds;
+        return FindROResult(v, std::move(lh));
+    }
+}
+
 std::unique_ptr<Item> HashTable::getRandomKey(long rnd) {
     /* Try to locate a partition */
     size_t start = rnd % size;
@@ -270,7 +475,7 @@ MutationStatus HashTable::set(Item& val) {
 }
 
 MutationStatus HashTable::unlocked_updateStoredValue(
-        const std::unique_lock<std::mutex>& htLock,
+        const std::unique_lock<cb::WriterLock>& htLock,
         StoredValue& v,
         const Item& itm) {
     if (!htLock) {
@@ -350,6 +555,7 @@ StoredValue* HashTable::unlocked_addNewStoredValue(const HashBucketLock& hbl,
         ++datatypeCounts[v->getDatatype()];
     }
     values[hbl.getBucketNum()] = std::move(v);
+    unlocked_pushTag(hbl.getBucketNum(), itm.getKey().hash());
 
     return values[hbl.getBucketNum()].get();
 }
@@ -390,13 +596,15 @@ HashTable::unlocked_replaceByCopy(const HashBucketLock& hbl,
         ++datatypeCounts[newSv->getDatatype()];
     }
     values[hbl.getBucketNum()] = std::move(newSv);
+    unlocked_pushTag(hbl.getBucketNum(), vToCopy.getKey().hash());
 
     return {values[hbl.getBucketNum()].get(), std::move(releasedSv)};
 }
 
-void HashTable::unlocked_softDelete(const std::unique_lock<std::mutex>& htLock,
-                                    StoredValue& v,
-                                    bool onlyMarkDeleted) {
+void HashTable::unlocked_softDelete(
+        const std::unique_lock<cb::WriterLock>& htLock,
+        StoredValue& v,
+        bool onlyMarkDeleted) {
     const bool alreadyDeleted = v.isDeleted();
     if (!v.isResident() && !v.isDeleted() && !v.isTempItem()) {
         decrNumNonResidentItems();
@@ -414,9 +622,11 @@ void HashTable::unlocked_softDelete(const std::unique_lock<std::mutex>& htLock,
             ++numItems;
             ++numTotalItems;
         }
-        size_t len = v.valuelen();
+        // Account by the change in size, as an inline value's storage
+        // remains allocated after deletion.
+        const size_t prevSize = v.size();
         if (v.del()) {
-            reduceCacheSize(len);
+            reduceCacheSize(prevSize - v.size());
         }
     }
     if (!alreadyDeleted) {
@@ -424,20 +634,91 @@ void HashTable::unlocked_softDelete(const std::unique_lock<std::mutex>& htLock,
     }
 }
 
+StoredValue* HashTable::findInChain(StoredValue* chain, const DocKey& key) {
+    for (StoredValue* v = chain; v; v = v->getNext().get()) {
+        if (v->hasKey(key)) {
+            return v;
+        }
+    }
+    return nullptr;
+}
+
+StoredValue* HashTable::unlocked_findInBucket(int bucket, const DocKey& key) {
+    if (!useBucketTags) {
+        return findInChain(values[bucket].get(), key);
+    }
+
+    const uint64_t tags = bucketTags[bucket];
+    const uint64_t candidates =
+            matchTag(tags, tagForHash(key.hash())) | matchTag(tags, wildcardTag);
+    if (candidates == 0 && (tags >> 56) == 0) {
+        // Fewer than eight elements in the chain (so all are tagged), and
+        // none of them match - no need to look at any StoredValue.
+        ++numTagFilteredLookups;
+        return nullptr;
+    }
+
+    size_t position = 0;
+    for (StoredValue* v = values[bucket].get(); v;
+         v = v->getNext().get(), ++position) {
+        if (position < tagsPerBucket &&
+            (candidates & (tagHighBit << (position * 8))) == 0) {
+            // Tag doesn't match; cannot be this element.
+            continue;
+        }
+        if (v->hasKey(key)) {
+            return v;
+        }
+    }
+    return nullptr;
+}
+
+void HashTable::unlocked_pushTag(int bucket, uint32_t hash) {
+    if (useBucketTags) {
+        // Existing elements move one position down the chain; the tag of
+        // what was the eighth element (if any) falls off the end.
+        bucketTags[bucket] = (bucketTags[bucket] << 8) | tagForHash(hash);
+    }
+}
+
+void HashTable::unlocked_removeTag(int bucket, size_t position) {
+    if (!useBucketTags || position >= tagsPerBucket) {
+        return;
+    }
+    const uint64_t tags = bucketTags[bucket];
+    // If the last tag slot is in use there may be untagged elements further
+    // down the chain; the first of those moves into the last slot.
+    const bool mayHaveUntagged = (tags >> 56) != 0;
+
+    const uint64_t below = tags & ((uint64_t(1) << (position * 8)) - 1);
+    const uint64_t above =
+            (position == tagsPerBucket - 1)
+                    ? 0
+                    : (tags >> ((position + 1) * 8)) << (position * 8);
+    uint64_t newTags = below | above;
+    if (mayHaveUntagged) {
+        newTags |= uint64_t(wildcardTag) << 56;
+    }
+    bucketTags[bucket] = newTags;
+}
+
 StoredValue* HashTable::unlocked_find(const DocKey& key,
                                       int bucket_num,
                                       WantsDeleted wantsDeleted,
                                       TrackReference trackReference) {
-    for (StoredValue* v = values[bucket_num].get(); v; v = v->getNext().get()) {
-        if (v->hasKey(key)) {
-            if (trackReference == TrackReference::Yes && !v->isDeleted()) {
-                v->referenced();
-            }
-            if (wantsDeleted == WantsDeleted::Yes || !v->isDeleted()) {
-                return v;
-            } else {
-                return NULL;
-            }
+    StoredValue* v = unlocked_findInBucket(bucket_num, key);
+    if (!v && oldSize != 0) {
+        // Incremental resize in progress; the key's old bucket may not have
+        // been migrated yet (callers holding the lock in shared mode cannot
+        // migrate it themselves).
+        v = findInChain(oldValues[getOldBucketForHash(key.hash())].get(), key);
+    }
+    if (v) {
+        if (trackReference == TrackReference::Yes && !v->isDeleted()) {
+            v->referenced();
+        }
+        if (wantsDeleted == WantsDeleted::Yes || !v->isDeleted()) {
+            return v;
         }
     }
     return NULL;
@@ -463,7 +744,7 @@ StoredValue::UniquePtr HashTable::unlocked_release(
 
     // Remove the first (should only be one) StoredValue with the given key.
     auto released = hashChainRemoveFirst(
-            values[hbl.getBucketNum()],
+            hbl.getBucketNum(),
             [key](const StoredValue* v) { return v->hasKey(key); });
 
     if (!released) {
@@ -557,10 +838,14 @@ void HashTable::visit(HashTableVisitor &visitor) {
     // Acquire one (any) of the mutexes before incrementing {visitors}, this
     // prevents any race between this visitor and the HashTable resizer.
     // See comments in pauseResumeVisit() for further details.
-    std::unique_lock<std::mutex> lh(mutexes[0]);
+    std::unique_lock<cb::WriterLock> lh(mutexes[0].writer());
     VisitorTracker vt(&visitors);
     lh.unlock();
 
+    // Visiting only walks `values`; make sure there's nothing left in the
+    // old bucket array. No new resize can start now visitors is non-zero.
+    completeResize();
+
     size_t visited = 0;
     for (int l = 0; isActive() && l < static_cast<int>(mutexes.size()); l++) {
         for (int i = l; i < static_cast<int>(size); i+= mutexes.size()) {
@@ -597,9 +882,11 @@ void HashTable::visitDepth(HashTableDepthVisitor &visitor) {
     }
     size_t visited = 0;
     VisitorTracker vt(&visitors);
+    completeResize();
 
     for (int l = 0; l < static_cast<int>(mutexes.size()); l++) {
-        LockHolder lh(mutexes[l]);
+        // Depth visiting doesn't modify anything, shared access is sufficient.
+        std::lock_guard<cb::ReaderLock> lh(mutexes[l].reader());
         for (int i = l; i < static_cast<int>(size); i+= mutexes.size()) {
             size_t depth = 0;
             StoredValue* p = values[i].get();
@@ -647,9 +934,10 @@ HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
     // inside the inner for() loop. To prevent this race, we explicitly acquire
     // (any) mutex, increment {visitors} and then release the mutex. This
     //avoids the race as if visitors >0 then Resizer will not attempt to resize.
-    std::unique_lock<std::mutex> lh(mutexes[0]);
+    std::unique_lock<cb::WriterLock> lh(mutexes[0].writer());
     VisitorTracker vt(&visitors);
     lh.unlock();
+    completeResize();
 
     // Start from the requested lock number if in range.
     size_t lock = (start_pos.lock < mutexes.size()) ? start_pos.lock : 0;
@@ -726,7 +1014,7 @@ bool HashTable::unlocked_ejectItem(StoredValue*& vptr,
 
             // Remove the item from the hash table.
             auto removed = hashChainRemoveFirst(
-                    values[bucket_num],
+                    bucket_num,
                     [vptr](const StoredValue* v) { return v == vptr; });
 
             if (removed->isResident()) {
@@ -756,12 +1044,21 @@ std::unique_ptr<Item> HashTable::getRandomKeyFromSlot(int slot) {
             return v->toItem(false, 0);
         }
     }
+    // Old bucket `slot` (if any) is guarded by the same lock.
+    if (static_cast<size_t>(slot) < oldSize) {
+        for (StoredValue* v = oldValues[slot].get(); v;
+             v = v->getNext().get()) {
+            if (!v->isTempItem() && !v->isDeleted() && v->isResident()) {
+                return v->toItem(false, 0);
+            }
+        }
+    }
 
     return nullptr;
 }
 
 bool HashTable::unlocked_restoreValue(
-        const std::unique_lock<std::mutex>& htLock,
+        const std::unique_lock<cb::WriterLock>& htLock,
         const Item& itm,
         StoredValue& v) {
     if (!htLock || !isActive() || v.isResident()) {
@@ -779,6 +1076,7 @@ bool HashTable::unlocked_restoreValue(
         decrNumNonResidentItems();
     }
 
+    const size_t prevSize = v.size();
     v.restoreValue(itm);
 
     if (v.isDeleted()) {
@@ -791,13 +1089,40 @@ bool HashTable::unlocked_restoreValue(
         ++numTotalItems;
     }
 
-    increaseCacheSize(v.getValue()->valueSize());
+    // Inline values are already accounted for in the object size.
+    increaseCacheSize(v.size() - prevSize);
     return true;
 }
 
-void HashTable::unlocked_restoreMeta(const std::unique_lock<std::mutex>& htLock,
-                                     const Item& itm,
-                                     StoredValue& v) {
+bool HashTable::unlocked_compressValue(
+        const std::unique_lock<cb::WriterLock>& htLock,
+        StoredValue& v,
+        float minCompressionRatio) {
+    if (!htLock) {
+        throw std::invalid_argument(
+                "HashTable::unlocked_compressValue: htLock not held");
+    }
+
+    if (!isActive() || v.isTempItem() || v.isDeleted() || !v.isResident()) {
+        return false;
+    }
+
+    const auto prevDatatype = v.getDatatype();
+    const size_t prevSize = v.size();
+    if (!v.compressValue(minCompressionRatio)) {
+        return false;
+    }
+
+    reduceCacheSize(prevSize - v.size());
+    --datatypeCounts[prevDatatype];
+    ++datatypeCounts[v.getDatatype()];
+    return true;
+}
+
+void HashTable::unlocked_restoreMeta(
+        const std::unique_lock<cb::WriterLock>& htLock,
+        const Item& itm,
+        StoredValue& v) {
     if (!htLock) {
         throw std::invalid_argument(
                 "HashTable::unlocked_restoreMeta: htLock "
@@ -853,11 +1178,13 @@ std::ostream& operator<<(std::ostream& os, const HashTable& ht) {
        << " numNonResident:" << ht.getNumInMemoryNonResItems()
        << " numTemp:" << ht.getNumTempItems()
        << " values: " << std::endl;
-    for (const auto& chain : ht.values) {
-        if (chain) {
-            for (StoredValue* sv = chain.get(); sv != nullptr;
-                 sv = sv->getNext().get()) {
-                os << "    " << *sv << std::endl;
+    for (const auto* table : {&ht.values, &ht.oldValues}) {
+        for (const auto& chain : *table) {
+            if (chain) {
+                for (StoredValue* sv = chain.get(); sv != nullptr;
+                     sv = sv->getNext().get()) {
+                    os << "    " << *sv << std::endl;
+                }
             }
         }
     }
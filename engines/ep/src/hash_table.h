@@ -18,6 +18,7 @@
 #pragma once
 
 #include "config.h"
+#include "locks.h"
 #include "storeddockey.h"
 #include "stored-value.h"
 
@@ -139,14 +140,17 @@ public:
      *
      * A simple container which holds a lock and the bucket_num of the
      * hashtable bucket it has the lock for.
+     *
+     * The lock is held in exclusive (writer) mode; see FindROResult for
+     * the shared (reader) equivalent used by read-only lookups.
      */
     class HashBucketLock {
     public:
         HashBucketLock()
             : bucketNum(-1) {}
 
-        HashBucketLock(int bucketNum, std::mutex& mutex)
-            : bucketNum(bucketNum), htLock(mutex) {
+        HashBucketLock(int bucketNum, cb::RWLock& mutex)
+            : bucketNum(bucketNum), htLock(mutex.writer()) {
         }
 
         HashBucketLock(HashBucketLock&& other)
@@ -159,17 +163,44 @@ public:
             return bucketNum;
         }
 
-        const std::unique_lock<std::mutex>& getHTLock() const {
+        const std::unique_lock<cb::WriterLock>& getHTLock() const {
             return htLock;
         }
 
-        std::unique_lock<std::mutex>& getHTLock() {
+        std::unique_lock<cb::WriterLock>& getHTLock() {
             return htLock;
         }
 
     private:
         int bucketNum;
-        std::unique_lock<std::mutex> htLock;
+        std::unique_lock<cb::WriterLock> htLock;
+    };
+
+    /**
+     * Result of a read-only lookup (see findForRead()).
+     *
+     * Holds the lock of the hash bucket the key maps to in shared (reader)
+     * mode for as long as the result is alive, so storedValue can be safely
+     * read (but not modified) by the caller. Any number of readers can hold
+     * the same hash bucket concurrently; writers still get exclusive access
+     * via HashBucketLock.
+     */
+    class FindROResult {
+    public:
+        FindROResult(const StoredValue* sv,
+                     std::unique_lock<cb::ReaderLock>&& lock)
+            : storedValue(sv), lock(std::move(lock)) {
+        }
+
+        FindROResult(FindROResult&& other) = default;
+
+        FindROResult(const FindROResult& other) = delete;
+
+        /// The StoredValue found, or nullptr if not present.
+        const StoredValue* const storedValue;
+
+    private:
+        std::unique_lock<cb::ReaderLock> lock;
     };
 
     /**
@@ -179,18 +210,27 @@ public:
      * @param svFactory Factory to use for constructing stored values
      * @param initialSize the number of hash table buckets to initially create.
      * @param locks the number of locks in the hash table
+     * @param incrementalResize if true, resizes migrate items from the old
+     *        to the new bucket array one hash bucket at a time instead of
+     *        rehashing the whole table while holding all locks.
+     * @param useBucketTags if true, maintain packed per-bucket key tags so
+     *        lookups can skip StoredValues which cannot match (see
+     *        bucketTags).
      */
     HashTable(EPStats& st,
               std::unique_ptr<AbstractStoredValueFactory> svFactory,
               size_t initialSize,
-              size_t locks);
+              size_t locks,
+              bool incrementalResize = false,
+              bool useBucketTags = false);
 
     ~HashTable();
 
     size_t memorySize() {
         return sizeof(HashTable)
-            + (size * sizeof(StoredValue*))
-            + (mutexes.size() * sizeof(std::mutex));
+            + ((size + oldValues.size()) * sizeof(StoredValue*))
+            + (bucketTags.size() * sizeof(uint64_t))
+            + (mutexes.size() * sizeof(cb::RWLock));
     }
 
     /**
@@ -285,6 +325,55 @@ public:
      */
     size_t getNumResizes() { return numResizes; }
 
+    /**
+     * Is an incremental resize currently in progress (i.e. are there items
+     * which still need migrating from the old bucket array)?
+     */
+    bool isResizeInProgress() const {
+        return oldSize != 0;
+    }
+
+    /**
+     * Get the number of old hash buckets which still need to be visited by
+     * the in-progress incremental resize (zero if none in progress).
+     */
+    size_t getNumResizePendingBuckets() const {
+        return oldSize - numResizeMigratedBuckets;
+    }
+
+    /**
+     * Get the number of items moved between bucket arrays by incremental
+     * resizes.
+     */
+    size_t getNumResizeMigratedItems() const {
+        return numResizeMigratedItems;
+    }
+
+    /**
+     * Get the number of old hash buckets migrated opportunistically by
+     * front-end operations (instead of by the resizer) during incremental
+     * resizes.
+     */
+    size_t getNumResizeOpportunisticMigrations() const {
+        return numResizeOpportunisticMigrations;
+    }
+
+    /**
+     * Get the number of lookups which the bucket tags determined to be
+     * misses without examining any StoredValue.
+     */
+    size_t getNumTagFilteredLookups() const {
+        return numTagFilteredLookups;
+    }
+
+    /**
+     * Get the number of lookups which were served under the shared (reader)
+     * hash bucket lock by findForRead().
+     */
+    size_t getNumReadOnlyFinds() const {
+        return numReadOnlyFinds;
+    }
+
     /**
      * Get the number of temp. items within this hash table.
      */
@@ -299,9 +388,21 @@ public:
 
     /**
      * Resize to the specified size.
+     *
+     * In incremental mode this only swaps in the new bucket array (holding
+     * all locks for O(1) time) and then migrates the old buckets one at a
+     * time, each under just its own lock. Front-end operations which touch a
+     * not yet migrated bucket migrate it themselves.
      */
     void resize(size_t to);
 
+    /**
+     * Finish any in-progress incremental resize, migrating all remaining old
+     * hash buckets. Each bucket is migrated under its own lock, so this
+     * doesn't block front-end operations for the whole duration.
+     */
+    void completeResize();
+
     /**
      * Find the item with the given key.
      *
@@ -315,6 +416,29 @@ public:
                       TrackReference trackReference,
                       WantsDeleted wantsDeleted);
 
+    /**
+     * Find the item with the given key, for read-only access.
+     *
+     * Unlike find() / unlocked_find(), the hash bucket lock is only acquired
+     * in shared mode, so concurrent readers of the same hash bucket (e.g. GETs
+     * of a hot key) do not serialise against each other. The lock is held
+     * until the returned FindROResult is destroyed; the StoredValue must not
+     * be modified through it.
+     *
+     * If trackReference is Yes and the item's NRU value needs updating, the
+     * lock is briefly upgraded to exclusive to record the reference.
+     *
+     * @param key the key to find
+     * @param trackReference whether to track the reference or not
+     * @param wantsDeleted whether a deleted value needs to be returned
+     *                     or not
+     * @return a FindROResult holding the (shared) bucket lock and a pointer to
+     *         the StoredValue (nullptr if not found).
+     */
+    FindROResult findForRead(const DocKey& key,
+                             TrackReference trackReference,
+                             WantsDeleted wantsDeleted);
+
     /**
      * Find a resident item
      *
@@ -343,7 +467,7 @@ public:
      * @return Result indicating the status of the operation
      */
     MutationStatus unlocked_updateStoredValue(
-            const std::unique_lock<std::mutex>& htLock,
+            const std::unique_lock<cb::WriterLock>& htLock,
             StoredValue& v,
             const Item& itm);
 
@@ -388,7 +512,7 @@ public:
      * @param onlyMarkDeleted indicates if we must reset the StoredValue or
      *                        just mark deleted
      */
-    void unlocked_softDelete(const std::unique_lock<std::mutex>& htLock,
+    void unlocked_softDelete(const std::unique_lock<cb::WriterLock>& htLock,
                              StoredValue& v,
                              bool onlyMarkDeleted);
 
@@ -433,6 +557,13 @@ public:
             int bucket = getBucketForHash(h);
             HashBucketLock rv(bucket, mutexes[mutexForBucket(bucket)]);
             if (bucket == getBucketForHash(h)) {
+                // If an incremental resize is in progress, ensure any items
+                // for this hash have been moved into the new bucket array,
+                // so callers only need to consider `values`.
+                if (oldSize != 0 &&
+                    unlocked_migrateOldBucket(getOldBucketForHash(h)) > 0) {
+                    ++numResizeOpportunisticMigrations;
+                }
                 return rv;
             }
         }
@@ -561,10 +692,26 @@ public:
      *
      * @return true if restored; else false
      */
-    bool unlocked_restoreValue(const std::unique_lock<std::mutex>& htLock,
+    bool unlocked_restoreValue(const std::unique_lock<cb::WriterLock>& htLock,
                                const Item& itm,
                                StoredValue& v);
 
+    /**
+     * Compress the (resident) value of the given item in memory, updating
+     * the memory accounting and datatype counts to match.
+     * See StoredValue::compressValue().
+     *
+     * @param htLock Hash table lock that must be held
+     * @param v the StoredValue whose value should be compressed
+     * @param minCompressionRatio minimum uncompressed/compressed size ratio
+     *        for the compressed value to be kept
+     *
+     * @return true if the value was compressed; else false
+     */
+    bool unlocked_compressValue(const std::unique_lock<cb::WriterLock>& htLock,
+                                StoredValue& v,
+                                float minCompressionRatio);
+
     /**
      * Restore the metadata of of a temporary item upon completion of a
      * background fetch.
@@ -574,7 +721,7 @@ public:
      * @param itm the Item whose metadata is being restored
      * @param v corresponding StoredValue
      */
-    void unlocked_restoreMeta(const std::unique_lock<std::mutex>& htLock,
+    void unlocked_restoreMeta(const std::unique_lock<cb::WriterLock>& htLock,
                               const Item& itm,
                               StoredValue& v);
 
@@ -661,7 +808,51 @@ private:
     // in `values`
     std::atomic<size_t> size;
     table_type values;
-    std::vector<std::mutex> mutexes;
+
+    /*
+     * Incremental resize state.
+     *
+     * While an incremental resize is in progress, items may be in either
+     * `values` (the new bucket array) or `oldValues` (the previous one, with
+     * `oldSize` buckets). Both sizes are kept multiples of the number of
+     * locks, so a given hash maps to the same lock in either array - old
+     * bucket B and every new bucket its items rehash to are guarded by the
+     * same lock, and a bucket can be migrated holding only that lock.
+     * oldSize / oldValues only change while holding all locks.
+     */
+    const bool incrementalResize;
+    table_type oldValues;
+    std::atomic<size_t> oldSize;
+    // Serialises the migrating threads (resizer / visitors). Must be acquired
+    // before any hash bucket lock.
+    std::mutex resizeMigrationMutex;
+    // Next old bucket to migrate; guarded by resizeMigrationMutex.
+    size_t nextResizeBucket;
+    std::atomic<size_t> numResizeMigratedBuckets;
+    std::atomic<size_t> numResizeMigratedItems;
+    std::atomic<size_t> numResizeOpportunisticMigrations;
+
+    /*
+     * Optional per-bucket key tags.
+     *
+     * Following each hash chain costs a likely cache miss per StoredValue.
+     * To avoid most of them, each bucket of `values` has a 64bit word
+     * packing an 8bit tag (derived from the key hash) for each of the first
+     * eight StoredValues in the chain - byte N for chain position N, 0x00 for
+     * "no element". A lookup compares all eight tags at once (SWAR) and only
+     * examines StoredValues whose tag matches; if the chain is fully tagged
+     * and nothing matches it completes without touching any StoredValue.
+     * A byte of 0xff is a wildcard - the tag of that element isn't known.
+     * Not maintained for oldValues (which only shrinks) during an
+     * incremental resize.
+     * Empty if useBucketTags is false, otherwise the same size as `values`.
+     */
+    const bool useBucketTags;
+    std::vector<uint64_t> bucketTags;
+    std::atomic<size_t> numTagFilteredLookups;
+    // Per-lock-stripe reader/writer locks. Mutators take the writer side
+    // (HashBucketLock); read-only lookups (findForRead) take the reader side.
+    std::vector<cb::RWLock> mutexes;
     EPStats&             stats;
     std::unique_ptr<AbstractStoredValueFactory> valFact;
     std::atomic<size_t>       visitors;
@@ -675,6 +866,7 @@ private:
     cb::NonNegativeCounter<size_t> numDeletedItems;
     std::atomic<size_t> numEjects;
     std::atomic<size_t>       numResizes;
+    std::atomic<size_t> numReadOnlyFinds;
 
     /// Count of items where StoredValue::isTempItem() is true.
     cb::NonNegativeCounter<size_t> numTempItems;
@@ -689,6 +881,53 @@ private:
         return abs(h % static_cast<int>(size));
     }
 
+    // Bucket in oldValues for the given hash. Only valid while an incremental
+    // resize is in progress.
+    int getOldBucketForHash(int h) {
+        return abs(h % static_cast<int>(oldSize));
+    }
+
+    /**
+     * Round the given size up to a multiple of the number of locks, if
+     * incremental resizing is enabled (see oldValues).
+     */
+    size_t alignToLocks(size_t s) const;
+
+    /**
+     * Move all items in the given bucket of oldValues to their bucket in
+     * values. The lock for oldBucket must be held (in exclusive mode).
+     *
+     * @return the number of items moved.
+     */
+    size_t unlocked_migrateOldBucket(int oldBucket);
+
+    /// Search a single hash chain for key; returns nullptr if not found.
+    static StoredValue* findInChain(StoredValue* chain, const DocKey& key);
+
+    /**
+     * Search the given bucket of `values` for key, using the bucket tags
+     * (if enabled) to skip non-matching elements.
+     */
+    StoredValue* unlocked_findInBucket(int bucket, const DocKey& key);
+
+    /**
+     * Record that an element with the given key hash was linked at the head
+     * of the given bucket's chain. No-op if bucket tags are disabled.
+     */
+    void unlocked_pushTag(int bucket, uint32_t hash);
+
+    /**
+     * Record that the element at the given chain position was unlinked from
+     * the given bucket's chain. No-op if bucket tags are disabled.
+     */
+    void unlocked_removeTag(int bucket, size_t position);
+
+    /**
+     * Discard oldValues once all of its buckets have been migrated.
+     * resizeMigrationMutex must be held.
+     */
+    void finishResize();
+
     inline size_t mutexForBucket(size_t bucket_num) {
         if (!isActive()) {
             throw std::logic_error("HashTable::mutexForBucket: Cannot call on a "
@@ -699,10 +938,10 @@ private:
 
     std::unique_ptr<Item> getRandomKeyFromSlot(int slot);
 
-    /** Searches for the first element in the specified hashChain which matches
-     * predicate p, and unlinks it from the chain.
+    /** Searches for the first element in the specified hash bucket's chain
+     * which matches predicate p, and unlinks it from the chain.
      *
-     * @param chain Linked list of StoredValues to scan.
+     * @param bucket Hash bucket (of `values`) whose chain to scan.
      * @param p Predicate to test each element against.
      *          The signature of the predicate function should be equivalent
      *          to the following:
@@ -711,22 +950,25 @@ private:
      * @return The removed element, or NULL if no matching element was found.
      */
     template <typename Pred>
-    StoredValue::UniquePtr hashChainRemoveFirst(StoredValue::UniquePtr& chain,
-                                                Pred p) {
+    StoredValue::UniquePtr hashChainRemoveFirst(int bucket, Pred p) {
+        StoredValue::UniquePtr& chain = values[bucket];
         if (p(chain.get())) {
             // Head element:
             auto removed = std::move(chain);
             chain = std::move(removed->getNext());
+            unlocked_removeTag(bucket, 0);
             return removed;
         }
 
         // Not head element, start searching.
+        size_t position = 1;
         for (StoredValue::UniquePtr* curr = &chain; curr->get()->getNext();
-             curr = &curr->get()->getNext()) {
+             curr = &curr->get()->getNext(), ++position) {
             if (p(curr->get()->getNext().get())) {
                 // next element matches predicate - splice it out of the list.
                 auto removed = std::move(curr->get()->getNext());
                 curr->get()->setNext(std::move(removed->getNext()));
+                unlocked_removeTag(bucket, position);
                 return removed;
             }
         }
@@ -55,6 +55,8 @@ bool HashtableResizerTask::run(void) {
     // acquire all HT locks). As such we are sensitive to the duration
     // of this task - we want to log anything which has a
     // non-negligible impact on frontend operations.
+    // (With ht_incremental_resize all locks are only held to swap in the
+    // new bucket array; items are then migrated one hash bucket at a time.)
     const auto maxExpectedDuration = std::chrono::milliseconds(50);
 
     store->visit(std::move(pv),
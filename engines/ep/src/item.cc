@@ -245,6 +245,10 @@ bool Item::compressValue() {
     return true;
 }
 
+bool Item::isCompressible() const {
+    return getNBytes() > 0 && !mcbp::datatype::is_snappy(getDataType());
+}
+
 bool Item::decompressValue() {
     uint8_t datatype = getDataType();
     if (mcbp::datatype::is_snappy(datatype)) {
@@ -289,22 +293,25 @@ item_info Item::toItemInfo(uint64_t vb_uuid, int64_t hlcEpoch) const {
     return info;
 }
 
-void Item::pruneValueAndOrXattrs(IncludeValue includeVal,
-                                 IncludeXattrs includeXattrs) {
+bool Item::needsPruning(IncludeValue includeVal,
+                        IncludeXattrs includeXattrs) const {
     if (!value) {
         // If the item does not have value (i.e. data and/or xattrs) then no
         // pruning is required.
-        return;
+        return false;
     }
 
-    if (includeVal == IncludeValue::Yes) {
-        if ((includeXattrs == IncludeXattrs::Yes) ||
-                !(mcbp::datatype::is_xattr(getDataType()))) {
-            // If we want to include the value and either, we want to include
-            // the xattrs or there are no xattrs, then no pruning is required
-            // and we can just return.
-            return;
-        }
+    // If we want to include the value and either, we want to include the
+    // xattrs or there are no xattrs, then no pruning is required.
+    return includeVal != IncludeValue::Yes ||
+           (includeXattrs != IncludeXattrs::Yes &&
+            mcbp::datatype::is_xattr(getDataType()));
+}
+
+void Item::pruneValueAndOrXattrs(IncludeValue includeVal,
+                                 IncludeXattrs includeXattrs) {
+    if (!needsPruning(includeVal, includeXattrs)) {
+        return;
     }
 
     auto root = reinterpret_cast<const char*>(value->getData());
@@ -351,3 +358,11 @@ item_info to_item_info(const ItemMetaData& itemMeta,
 
     return info;
 }
+
+void releaseServerItem(Item* itm) {
+    auto ref = queued_item::adopt(itm);
+    if (ref.refCount() == 0) {
+        // Not reference counted, so owned outright by the server
+        delete ref.release();
+    }
+}
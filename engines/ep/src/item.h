@@ -407,6 +407,19 @@ public:
      */
     item_info toItemInfo(uint64_t vb_uuid, int64_t hlcEpoch) const;
 
+    /**
+     * @return true if pruneValueAndOrXattrs() with the given arguments would
+     *         modify the item.
+     */
+    bool needsPruning(IncludeValue includeVal,
+                      IncludeXattrs includeXattrs) const;
+
+    /**
+     * @return true if compressValue() may modify the item (i.e. it has a
+     *         value which isn't compressed already).
+     */
+    bool isCompressible() const;
+
     /**
      * Removes the value and / or the xattributes from the item if they
      * are not to be sent over the wire to the consumer.
@@ -468,6 +481,14 @@ std::ostream& operator<<(std::ostream& os, const Item& item);
 typedef SingleThreadedRCPtr<Item> queued_item;
 using UniqueItemPtr = std::unique_ptr<Item>;
 
+/**
+ * Free an Item which was handed to the server (as an item*). Most such items
+ * are owned outright by the server, but a DCP producer may instead hand over
+ * a reference (see SingleThreadedRCPtr::release) to an Item it shares with a
+ * checkpoint, in which case only the reference is dropped.
+ */
+void releaseServerItem(Item* itm);
+
 // If you're reading this because this assert has failed because you've
 // increased Item, ask yourself do you really need to? Can you use padding or
 // bit-fields to reduce the size?
@@ -0,0 +1,150 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "item_compressor.h"
+
+#include <phosphor/phosphor.h>
+
+#include "ep_engine.h"
+#include "stored-value.h"
+#include "vbucket.h"
+
+// ItemCompressorVisitor implementation ///////////////////////////////////////
+
+ItemCompressorVisitor::ItemCompressorVisitor(float minCompressionRatio)
+    : minCompressionRatio(minCompressionRatio) {
+}
+
+void ItemCompressorVisitor::setDeadline(ProcessClock::time_point deadline) {
+    progressTracker.setDeadline(deadline);
+}
+
+void ItemCompressorVisitor::setCurrentVBucket(VBucket& vb) {
+    currentVb = &vb;
+}
+
+bool ItemCompressorVisitor::visit(const HashTable::HashBucketLock& lh,
+                                  StoredValue& v) {
+    if (currentVb &&
+        currentVb->ht.unlocked_compressValue(
+                lh.getHTLock(), v, minCompressionRatio)) {
+        compressed_count++;
+    }
+    visited_count++;
+
+    // See if we have done enough work for this chunk. If so
+    // stop visiting (for now).
+    return progressTracker.shouldContinueVisiting(visited_count);
+}
+
+void ItemCompressorVisitor::clearStats() {
+    compressed_count = 0;
+    visited_count = 0;
+}
+
+// ItemCompressorTask implementation //////////////////////////////////////////
+
+ItemCompressorTask::ItemCompressorTask(EventuallyPersistentEngine* e,
+                                       EPStats& stats_)
+    : GlobalTask(e, TaskId::ItemCompressorTask, 0, false),
+      stats(stats_),
+      epstore_position(engine->getKVBucket()->startPosition()) {
+}
+
+bool ItemCompressorTask::run() {
+    TRACE_EVENT0("ep-engine/task", "ItemCompressorTask");
+    if (engine->getCompressionMode() != BucketCompressionMode::Active) {
+        // Being disabled (see EPBucket::disableItemCompressor); a new task
+        // is scheduled if the mode becomes active again.
+        return false;
+    }
+
+    // Resume from where we last were if we didn't finish the previous
+    // pass, otherwise start a new pass from the beginning.
+    if (!prAdapter) {
+        prAdapter = std::make_unique<PauseResumeVBAdapter>(
+                std::make_unique<ItemCompressorVisitor>(
+                        engine->getConfiguration().getMinCompressionRatio()));
+        epstore_position = engine->getKVBucket()->startPosition();
+    }
+
+    auto& visitor = getCompressorVisitor();
+    const auto start = ProcessClock::now();
+    visitor.setDeadline(start + getChunkDuration());
+    visitor.clearStats();
+
+    epstore_position = engine->getKVBucket()->pauseResumeVisit(
+            *prAdapter, epstore_position);
+    const auto end = ProcessClock::now();
+
+    stats.compressorNumCompressed.fetch_add(visitor.getCompressedCount());
+    stats.compressorNumVisited.fetch_add(visitor.getVisitedCount());
+
+    const bool completed =
+            (epstore_position == engine->getKVBucket()->endPosition());
+
+    LOG(EXTENSION_LOG_DEBUG,
+        "%s for bucket '%s' %s. Took %" PRIu64 " us, compressed %" PRIu64
+        "/%" PRIu64 " visited documents.",
+        to_string(getDescription()).c_str(),
+        engine->getName().c_str(),
+        completed ? "finished" : "paused",
+        uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                         end - start)
+                         .count()),
+        uint64_t(visitor.getCompressedCount()),
+        uint64_t(visitor.getVisitedCount()));
+
+    if (completed) {
+        prAdapter.reset();
+    }
+
+    snooze(getSleepTime());
+    if (engine->getEpStats().isShutdown) {
+        return false;
+    }
+    return true;
+}
+
+void ItemCompressorTask::stop() {
+    if (uid) {
+        ExecutorPool::get()->cancel(uid);
+    }
+}
+
+cb::const_char_buffer ItemCompressorTask::getDescription() {
+    return "Item Compressor";
+}
+
+std::chrono::microseconds ItemCompressorTask::maxExpectedDuration() {
+    // As for the DefragmenterTask, each run is bounded by the chunk
+    // duration; allow headroom for the ProgressTracker's estimation.
+    return getChunkDuration() * 10;
+}
+
+double ItemCompressorTask::getSleepTime() const {
+    return engine->getConfiguration().getItemCompressorInterval() / 1000.0;
+}
+
+std::chrono::milliseconds ItemCompressorTask::getChunkDuration() const {
+    return std::chrono::milliseconds(
+            engine->getConfiguration().getItemCompressorChunkDuration());
+}
+
+ItemCompressorVisitor& ItemCompressorTask::getCompressorVisitor() {
+    return dynamic_cast<ItemCompressorVisitor&>(prAdapter->getHTVisitor());
+}
@@ -0,0 +1,127 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include "globaltask.h"
+#include "kv_bucket_iface.h"
+#include "progress_tracker.h"
+#include "vb_visitors.h"
+
+class EPStats;
+
+/**
+ * Item compressor visitor - visit all objects in a VBucket, and compress
+ * (with Snappy) the values of any which are not already compressed, where
+ * doing so saves enough memory.
+ */
+class ItemCompressorVisitor : public VBucketAwareHTVisitor {
+public:
+    ItemCompressorVisitor(float minCompressionRatio);
+
+    // Set the deadline at which point the visitor will pause visiting.
+    void setDeadline(ProcessClock::time_point deadline);
+
+    void setCurrentVBucket(VBucket& vb) override;
+
+    bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) override;
+
+    // Resets any held stats to zero.
+    void clearStats();
+
+    // Returns the number of documents that have been compressed.
+    size_t getCompressedCount() const {
+        return compressed_count;
+    }
+
+    // Returns the number of documents that have been visited.
+    size_t getVisitedCount() const {
+        return visited_count;
+    }
+
+private:
+    // Minimum uncompressed/compressed size ratio for a value to be kept
+    // compressed.
+    const float minCompressionRatio;
+
+    // VBucket being visited.
+    VBucket* currentVb = nullptr;
+
+    // Estimates how far we have got, and when we should pause.
+    ProgressTracker progressTracker;
+
+    // Count of how many documents have been compressed.
+    size_t compressed_count = 0;
+    // How many documents have been visited.
+    size_t visited_count = 0;
+};
+
+/**
+ * Task responsible for compressing item values in memory, when the bucket's
+ * compression_mode is "active".
+ *
+ * Values are stored in the HashTable as sent by the client. For documents
+ * written by clients which don't negotiate Snappy (or with compression_mode
+ * "off" in the past) that means uncompressed, which for typical JSON wastes
+ * 2-3x the memory. This task walks the HashTables in the same chunked,
+ * pause/resume fashion as the DefragmenterTask, replacing uncompressed
+ * values with their Snappy-compressed form (and setting the Snappy datatype
+ * bit). Compressed values are returned as-is to Snappy-aware clients, and
+ * inflated by the front-end for others.
+ *
+ * Only run for persistent buckets; Ephemeral range reads access values under
+ * the sequence list lock rather than the HashTable lock. Only scheduled
+ * while the mode is "active" (see EPBucket::enableItemCompressor).
+ */
+class ItemCompressorTask : public GlobalTask {
+public:
+    ItemCompressorTask(EventuallyPersistentEngine* e, EPStats& stats_);
+
+    bool run() override;
+
+    void stop();
+
+    cb::const_char_buffer getDescription() override;
+
+    std::chrono::microseconds maxExpectedDuration() override;
+
+private:
+    /// Duration (in seconds) the compressor should sleep for between
+    /// iterations.
+    double getSleepTime() const;
+
+    // Upper limit on how long each compression chunk can run for, before
+    // being paused.
+    std::chrono::milliseconds getChunkDuration() const;
+
+    /// Returns the underlying ItemCompressorVisitor instance.
+    ItemCompressorVisitor& getCompressorVisitor();
+
+    EPStats& stats;
+
+    // Opaque marker indicating how far through the epStore we have visited.
+    KVBucketIface::Position epstore_position;
+
+    /**
+     * Visitor adapter which supports pausing & resuming (records how far
+     * though a VBucket is has got). unique_ptr as we re-create it for each
+     * complete pass.
+     */
+    std::unique_ptr<PauseResumeVBAdapter> prAdapter;
+};
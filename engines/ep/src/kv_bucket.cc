@@ -51,6 +51,7 @@
 #include "kvstore.h"
 #include "locks.h"
 #include "mutation_log.h"
+#include "persistence_callback.h"
 #include "replicationthrottle.h"
 #include "statwriter.h"
 #include "tasks.h"
@@ -674,6 +675,12 @@ ENGINE_ERROR_CODE KVBucket::addBackfillItem(Item& itm,
         return ENGINE_KEY_EEXISTS;
     }
 
+    // With compression disabled values are held uncompressed in memory.
+    if (engine.getCompressionMode() == BucketCompressionMode::Off &&
+        !itm.decompressValue()) {
+        return ENGINE_EINVAL;
+    }
+
     return vb->addBackfillItem(itm, genBySeqno);
 }
 
@@ -1386,6 +1393,12 @@ ENGINE_ERROR_CODE KVBucket::setWithMeta(Item& itm,
         return ENGINE_KEY_EEXISTS;
     }
 
+    // With compression disabled values are held uncompressed in memory.
+    if (engine.getCompressionMode() == BucketCompressionMode::Off &&
+        !itm.decompressValue()) {
+        return ENGINE_EINVAL;
+    }
+
     { // collections read scope
         auto collectionsRHandle = vb->lockCollections();
         if (!collectionsRHandle.doesKeyContainValidCollection(itm.getKey())) {
@@ -1546,13 +1559,19 @@ std::string KVBucket::validateKey(const DocKey& key, uint16_t vbucket,
 
         if (diskItem.getFlags() != v->getFlags()) {
             return "flags_mismatch";
-        } else if (v->isResident() && memcmp(diskItem.getData(),
-                                             v->getValue()->getData(),
-                                             diskItem.getNBytes())) {
-            return "data_mismatch";
-        } else {
-            return "valid";
+        } else if (v->isResident()) {
+            // Either copy may be held Snappy compressed (see
+            // compression_mode); compare the uncompressed documents.
+            auto memItem = v->toItem(false, vbucket);
+            if (!memItem->decompressValue() || !diskItem.decompressValue() ||
+                memItem->getNBytes() != diskItem.getNBytes() ||
+                memcmp(diskItem.getData(),
+                       memItem->getData(),
+                       diskItem.getNBytes())) {
+                return "data_mismatch";
+            }
         }
+        return "valid";
     } else {
         return "item_deleted";
     }
@@ -1675,142 +1694,6 @@ void KVBucket::reset() {
     LOG(EXTENSION_LOG_NOTICE, "KVBucket::reset(): Successfully flushed bucket");
 }
 
-/**
- * Callback invoked after persisting an item from memory to disk.
- *
- * This class exists to create a closure around a few variables within
- * KVBucket::flushOne so that an object can be
- * requeued in case of failure to store in the underlying layer.
- */
-class PersistenceCallback : public Callback<mutation_result>,
-                            public Callback<int> {
-public:
-
-    PersistenceCallback(const queued_item &qi, VBucketPtr &vb,
-                        EPStats& s, uint64_t c)
-        : queuedItem(qi), vbucket(vb), stats(s), cas(c) {
-        if (!vb) {
-            throw std::invalid_argument("PersistenceCallback(): vb is NULL");
-        }
-    }
-
-    // This callback is invoked for set only.
-    void callback(mutation_result &value) {
-        if (value.first == 1) {
-            auto hbl = vbucket->ht.getLockedBucket(queuedItem->getKey());
-            StoredValue* v = vbucket->fetchValidValue(hbl,
-                                                      queuedItem->getKey(),
-                                                      WantsDeleted::Yes,
-                                                      TrackReference::No,
-                                                      QueueExpired::Yes);
-            if (v) {
-                if (v->getCas() == cas) {
-                    // mark this item clean only if current and stored cas
-                    // value match
-                    v->markClean();
-                }
-                if (v->isNewCacheItem()) {
-                    if (value.second) {
-                        // Insert in value-only or full eviction mode.
-                        ++vbucket->opsCreate;
-                        vbucket->incrMetaDataDisk(*queuedItem);
-                    } else { // Update in full eviction mode.
-                        vbucket->ht.decrNumTotalItems();
-                        ++vbucket->opsUpdate;
-                    }
-
-                    v->setNewCacheItem(false);
-                } else { // Update in value-only or full eviction mode.
-                    ++vbucket->opsUpdate;
-                }
-            }
-
-            vbucket->doStatsForFlushing(*queuedItem, queuedItem->size());
-            --stats.diskQueueSize;
-            stats.totalPersisted++;
-        } else {
-            // If the return was 0 here, we're in a bad state because
-            // we do not know the rowid of this object.
-            if (value.first == 0) {
-                auto hbl = vbucket->ht.getLockedBucket(queuedItem->getKey());
-                StoredValue* v = vbucket->fetchValidValue(hbl,
-                                                          queuedItem->getKey(),
-                                                          WantsDeleted::Yes,
-                                                          TrackReference::No,
-                                                          QueueExpired::Yes);
-                if (v) {
-                    LOG(EXTENSION_LOG_WARNING,
-                        "PersistenceCallback::callback: Persisting on "
-                        "vb:%" PRIu16 ", seqno:%" PRIu64 " returned 0 updates",
-                        queuedItem->getVBucketId(), v->getBySeqno());
-                } else {
-                    LOG(EXTENSION_LOG_WARNING,
-                        "PersistenceCallback::callback: Error persisting, a key"
-                        "is missing from vb:%" PRIu16,
-                        queuedItem->getVBucketId());
-                }
-
-                vbucket->doStatsForFlushing(*queuedItem, queuedItem->size());
-                --stats.diskQueueSize;
-            } else {
-                LOG(EXTENSION_LOG_WARNING,
-                    "PersistenceCallback::callback: Fatal error in persisting "
-                    "SET on vb:%" PRIu16, queuedItem->getVBucketId());
-                redirty();
-            }
-        }
-    }
-
-    // This callback is invoked for deletions only.
-    //
-    // The boolean indicates whether the underlying storage
-    // successfully deleted the item.
-    void callback(int &value) {
-        // > 1 would be bad.  We were only trying to delete one row.
-        if (value > 1) {
-            throw std::logic_error("PersistenceCallback::callback: value "
-                    "(which is " + std::to_string(value) +
-                    ") should be <= 1 for deletions");
-        }
-        // -1 means fail
-        // 1 means we deleted one row
-        // 0 means we did not delete a row, but did not fail (did not exist)
-        if (value >= 0) {
-            // We have successfully removed an item from the disk, we
-            // may now remove it from the hash table.
-            vbucket->deletedOnDiskCbk(*queuedItem, (value > 0));
-        } else {
-            LOG(EXTENSION_LOG_WARNING,
-                "PersistenceCallback::callback: Fatal error in persisting "
-                "DELETE on vb:%" PRIu16, queuedItem->getVBucketId());
-            redirty();
-        }
-    }
-
-private:
-
-    void redirty() {
-        if (vbucket->isDeletionDeferred()) {
-            // updating the member stats for the vbucket is not really necessary
-            // as the vbucket is about to be deleted
-            vbucket->doStatsForFlushing(*queuedItem, queuedItem->size());
-            // the following is a global stat and so is worth updating
-            --stats.diskQueueSize;
-            return;
-        }
-        ++stats.flushFailed;
-        vbucket->markDirty(queuedItem->getKey());
-        vbucket->rejectQueue.push(queuedItem);
-        ++vbucket->opsReject;
-    }
-
-    const queued_item queuedItem;
-    VBucketPtr vbucket;
-    EPStats& stats;
-    uint64_t cas;
-    DISALLOW_COPY_AND_ASSIGN(PersistenceCallback);
-};
-
 bool KVBucket::scheduleDeleteAllTask(const void* cookie) {
     bool inverse = false;
     if (diskDeleteAll.compare_exchange_strong(inverse, true)) {
@@ -1875,16 +1758,43 @@ int KVBucket::flushVBucket(uint16_t vbid) {
             items.push_back(vb->rejectQueue.front());
             vb->rejectQueue.pop();
         }
+        const bool rejected = !items.empty();
 
-        // Append any 'backfill' items (mutations added by a DCP stream).
-        vb->getBackfillItems(items);
-
-        // Append all items outstanding for the persistence cursor.
         snapshot_range_t range;
-        hrtime_t _begin_ = gethrtime();
-        range = vb->checkpointManager->getAllItemsForCursor(
-                CheckpointManager::pCursorName, items);
-        stats.persistenceCursorGetItemsHisto.add((gethrtime() - _begin_) / 1000);
+        bool prepared = false;
+        if (vb->preparedFlush) {
+            // The flusher has already taken (and sorted) the items; unless
+            // the checkpoints have been cleared since, in which case they're
+            // stale and are dropped.
+            auto batch = std::move(vb->preparedFlush);
+            stats.flusherPreparedBytes.fetch_sub(batch->bytes);
+            if (batch->numClears == vb->checkpointManager->getNumClears()) {
+                ++stats.flusherPreparedFlushes;
+                items.insert(items.end(),
+                             std::make_move_iterator(batch->items.begin()),
+                             std::make_move_iterator(batch->items.end()));
+                range = batch->range;
+                prepared = true;
+            } else {
+                LOG(EXTENSION_LOG_NOTICE,
+                    "KVBucket::flushVBucket: vb:%" PRIu16 " dropping %" PRIu64
+                    " prepared items as the checkpoints have been cleared",
+                    vbid,
+                    uint64_t(batch->items.size()));
+            }
+        }
+
+        if (!prepared) {
+            // Append any 'backfill' items (mutations added by a DCP stream).
+            vb->getBackfillItems(items);
+
+            // Append all items outstanding for the persistence cursor.
+            hrtime_t _begin_ = gethrtime();
+            range = vb->checkpointManager->getAllItemsForCursor(
+                    CheckpointManager::pCursorName, items);
+            stats.persistenceCursorGetItemsHisto.add((gethrtime() - _begin_) /
+                                                     1000);
+        }
 
         if (!items.empty()) {
             while (!rwUnderlying->begin()) {
@@ -1893,7 +1803,11 @@ int KVBucket::flushVBucket(uint16_t vbid) {
                     "Retry in 1 sec ...");
                 sleep(1);
             }
-            rwUnderlying->optimizeWrites(items);
+            // Prepared items are already sorted, but any rejected (older)
+            // items need merging in.
+            if (!prepared || rejected) {
+                rwUnderlying->optimizeWrites(items);
+            }
 
             Item *prev = NULL;
             auto vbstate = vb->getVBucketState();
@@ -1901,7 +1815,7 @@ int KVBucket::flushVBucket(uint16_t vbid) {
             range.start = std::max(range.start, vbstate.lastSnapStart);
 
             bool mustCheckpointVBState = false;
-            std::list<PersistenceCallback*>& pcbs = rwUnderlying->getPersistenceCbList();
+            auto& pcbs = shard->getPersistenceCallbacks();
 
             SystemEventFlush sef;
 
@@ -1937,11 +1851,7 @@ int KVBucket::flushVBucket(uint16_t vbid) {
                 } else if (!prev || prev->getKey() != item->getKey()) {
                     prev = item.get();
                     ++items_flushed;
-                    PersistenceCallback* cb =
-                            flushOneDelOrSet(item, vb.getVB());
-                    if (cb) {
-                        pcbs.push_back(cb);
-                    }
+                    flushOneDelOrSet(item, vb.getVB(), pcbs);
 
                     maxSeqno = std::max(maxSeqno, (uint64_t)item->getBySeqno());
                     vbstate.maxCas = std::max(vbstate.maxCas, item->getCas());
@@ -2018,7 +1928,14 @@ int KVBucket::flushVBucket(uint16_t vbid) {
              * Or if there is a manifest item
              */
             if (items_flushed > 0 || sef.getCollectionsManifestItem()) {
-                commit(*rwUnderlying, sef.getCollectionsManifestItem());
+                const hrtime_t commit_start = gethrtime();
+                commit(*shard, sef.getCollectionsManifestItem());
+                if (items_flushed > 0) {
+                    stats.diskCommitBatchSizeHisto.add(items_flushed);
+                    stats.diskCommitPerItemHisto.add(
+                            (gethrtime() - commit_start) / 1000 /
+                            items_flushed);
+                }
 
                 // Now the commit is complete, vBucket file must exist.
                 if (vb->setBucketCreation(false)) {
@@ -2053,8 +1970,8 @@ int KVBucket::flushVBucket(uint16_t vbid) {
         }
 
         if (vb->rejectQueue.empty()) {
-            vb->checkpointManager->itemsPersisted();
             uint64_t seqno = vb->getPersistenceSeqno();
+            vb->checkpointManager->itemsPersisted(seqno);
             uint64_t chkid =
                     vb->checkpointManager->getPersistenceCursorPreChkId();
             vb->notifyHighPriorityRequests(
@@ -2072,8 +1989,42 @@ int KVBucket::flushVBucket(uint16_t vbid) {
     return items_flushed;
 }
 
-void KVBucket::commit(KVStore& kvstore, const Item* collectionsManifest) {
-    std::list<PersistenceCallback*>& pcbs = kvstore.getPersistenceCbList();
+size_t KVBucket::prepareFlushBatch(uint16_t vbid) {
+    auto vb = getLockedVBucket(vbid, std::try_to_lock);
+    // Skip the vbucket if it's locked (e.g. being flushed) or if the items
+    // of its next flush have already been prepared.
+    if (!vb.owns_lock() || !vb || vb->preparedFlush) {
+        return 0;
+    }
+
+    auto batch = std::make_unique<VBucket::PreparedFlush>();
+    batch->numClears = vb->checkpointManager->getNumClears();
+
+    vb->getBackfillItems(batch->items);
+    hrtime_t _begin_ = gethrtime();
+    batch->range = vb->checkpointManager->getAllItemsForCursor(
+            CheckpointManager::pCursorName, batch->items);
+    stats.persistenceCursorGetItemsHisto.add((gethrtime() - _begin_) / 1000);
+    if (batch->items.empty()) {
+        return 0;
+    }
+
+    // optimizeWrites only sorts the items so is safe to call from outside
+    // of the flusher.
+    getRWUnderlying(vbid)->optimizeWrites(batch->items);
+
+    batch->bytes = 0;
+    for (const auto& item : batch->items) {
+        batch->bytes += item->size();
+    }
+    stats.flusherPreparedBytes.fetch_add(batch->bytes);
+
+    vb->preparedFlush = std::move(batch);
+    return vb->preparedFlush->bytes;
+}
+
+void KVBucket::commit(KVShard& shard, const Item* collectionsManifest) {
+    KVStore& kvstore = *shard.getRWUnderlying();
     BlockTimer timer(&stats.diskCommitHisto, "disk_commit", stats.timingLog);
     hrtime_t commit_start = gethrtime();
 
@@ -2084,10 +2035,9 @@ void KVBucket::commit(KVStore& kvstore, const Item* collectionsManifest) {
         sleep(1);
     }
 
-    while (!pcbs.empty()) {
-         delete pcbs.front();
-         pcbs.pop_front();
-    }
+    // All of the callbacks have been invoked by the commit; destroy them
+    // (keeping their memory for the next flush).
+    shard.getPersistenceCallbacks().clear();
 
     ++stats.flusherCommits;
     hrtime_t commit_end = gethrtime();
@@ -2096,12 +2046,12 @@ void KVBucket::commit(KVStore& kvstore, const Item* collectionsManifest) {
     stats.cumulativeCommitTime.fetch_add(commit_time);
 }
 
-PersistenceCallback* KVBucket::flushOneDelOrSet(const queued_item &qi,
-                                                VBucketPtr &vb) {
-
+void KVBucket::flushOneDelOrSet(const queued_item& qi,
+                                VBucketPtr& vb,
+                                PersistenceCallbackArena& pcbs) {
     if (!vb) {
         --stats.diskQueueSize;
-        return NULL;
+        return;
     }
 
     int64_t bySeqno = qi->getBySeqno();
@@ -2122,17 +2072,11 @@ PersistenceCallback* KVBucket::flushOneDelOrSet(const queued_item &qi,
                          &stats.diskInsertHisto : &stats.diskUpdateHisto,
                          bySeqno == -1 ? "disk_insert" : "disk_update",
                          stats.timingLog);
-        PersistenceCallback *cb =
-            new PersistenceCallback(qi, vb, stats, qi->getCas());
-        rwUnderlying->set(*qi, *cb);
-        return cb;
+        rwUnderlying->set(*qi, pcbs.emplace(qi, vb, stats, qi->getCas()));
     } else {
         BlockTimer timer(&stats.diskDelHisto, "disk_delete",
                          stats.timingLog);
-        PersistenceCallback *cb =
-            new PersistenceCallback(qi, vb, stats, 0);
-        rwUnderlying->del(*qi, *cb);
-        return cb;
+        rwUnderlying->del(*qi, pcbs.emplace(qi, vb, stats, uint64_t(0)));
     }
 }
 
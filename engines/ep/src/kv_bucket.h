@@ -680,7 +680,9 @@ public:
      */
     int flushVBucket(uint16_t vbid);
 
-    void commit(KVStore& kvstore, const Item* collectionsManifest);
+    size_t prepareFlushBatch(uint16_t vbid);
+
+    void commit(KVShard& shard, const Item* collectionsManifest);
 
     void addKVStoreStats(ADD_STAT add_stat, const void* cookie);
 
@@ -737,6 +739,19 @@ public:
 
     void runDefragmenterTask();
 
+    /// Values are only compressed in memory by persistent buckets (see
+    /// EPBucket), so nothing to do by default.
+    virtual void enableItemCompressor() {
+    }
+    virtual void disableItemCompressor() {
+    }
+
+    /// Only persistent buckets (see EPBucket) have background fetchers.
+    virtual void deferBgFetcherWakeUps() {
+    }
+    virtual void resumeBgFetcherWakeUps() {
+    }
+
     bool runAccessScannerTask();
 
     void runVbStatePersistTask(int vbid);
@@ -828,8 +843,9 @@ protected:
     void stopWarmup(void);
 
     void flushOneDeleteAll(void);
-    PersistenceCallback* flushOneDelOrSet(const queued_item &qi,
-                                          VBucketPtr &vb);
+    void flushOneDelOrSet(const queued_item& qi,
+                          VBucketPtr& vb,
+                          PersistenceCallbackArena& pcbs);
 
     /**
      * Get metadata and value for a given key
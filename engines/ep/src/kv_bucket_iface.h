@@ -33,6 +33,7 @@ class KVBucket;
 class MutationLog;
 class PauseResumeVBVisitor;
 class PersistenceCallback;
+class PersistenceCallbackArena;
 class VBucketMap;
 class VBucketVisitor;
 class Warmup;
@@ -649,7 +650,16 @@ public:
      */
     virtual int flushVBucket(uint16_t vbid) = 0;
 
-    virtual void commit(KVStore& kvstore, const Item* collectionsManifest) = 0;
+    /**
+     * Take the items waiting for persistence in a given vbucket from its
+     * checkpoints (and sort them) ahead of the vbucket's next flush, so the
+     * flusher can overlap this work with writing another vbucket.
+     * @param vbid The id of the vbucket to prepare
+     * @return The number of bytes prepared
+     */
+    virtual size_t prepareFlushBatch(uint16_t vbid) = 0;
+
+    virtual void commit(KVShard& shard, const Item* collectionsManifest) = 0;
 
     virtual void addKVStoreStats(ADD_STAT add_stat, const void* cookie) = 0;
 
@@ -697,6 +707,20 @@ public:
 
     virtual void runDefragmenterTask() = 0;
 
+    /**
+     * Start (stop) compressing item values in memory; called as the bucket's
+     * compression_mode changes to (from) "active".
+     */
+    virtual void enableItemCompressor() = 0;
+    virtual void disableItemCompressor() = 0;
+
+    /**
+     * Hold back (release) waking the background fetchers, so that the
+     * fetches for a batch of keys are issued together.
+     */
+    virtual void deferBgFetcherWakeUps() = 0;
+    virtual void resumeBgFetcherWakeUps() = 0;
+
     virtual bool runAccessScannerTask() = 0;
 
     virtual void runVbStatePersistTask(int vbid) = 0;
@@ -788,8 +812,9 @@ protected:
     virtual void stopWarmup(void) = 0;
 
     virtual void flushOneDeleteAll(void) = 0;
-    virtual PersistenceCallback* flushOneDelOrSet(const queued_item &qi,
-                                                  VBucketPtr &vb) = 0;
+    virtual void flushOneDelOrSet(const queued_item& qi,
+                                  VBucketPtr& vb,
+                                  PersistenceCallbackArena& pcbs) = 0;
 
     virtual GetValue getInternal(const DocKey& key, uint16_t vbucket,
                                  const void *cookie,
@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include "kvstore_config.h"
+#include "persistence_callback.h"
 #include "utility.h"
 #include "vbucket.h"
 
@@ -75,6 +76,24 @@ public:
         return rwStore.get();
     }
 
+    /**
+     * Replace the underlying KVStore of the shard (used by tests and
+     * benchmarks to run against a mock store). Both reads and writes go
+     * to the new store.
+     */
+    void setRWUnderlying(std::unique_ptr<KVStore> store) {
+        rwStore = std::move(store);
+        roStore.reset();
+    }
+
+    /**
+     * @return the callbacks of the items written by the shard's flusher
+     *         since the last commit (only used by the flusher)
+     */
+    PersistenceCallbackArena& getPersistenceCallbacks() {
+        return persistenceCallbacks;
+    }
+
     Flusher *getFlusher();
     BgFetcher *getBgFetcher();
 
@@ -193,6 +212,8 @@ private:
     std::unique_ptr<KVStore> rwStore;
     std::unique_ptr<KVStore> roStore;
 
+    PersistenceCallbackArena persistenceCallbacks;
+
     std::unique_ptr<Flusher> flusher;
     std::unique_ptr<BgFetcher> bgFetcher;
 
@@ -221,17 +221,7 @@ void KVStore::addStat(const std::string &prefix, const char *stat, T &val,
 
 void KVStore::addStats(ADD_STAT add_stat, const void *c) {
     const char* backend = configuration.getBackend().c_str();
-
-    uint16_t shardId = configuration.getShardId();
-    std::stringstream prefixStream;
-
-    if (isReadOnly()) {
-        prefixStream << "ro_" << shardId;
-    } else {
-        prefixStream << "rw_" << shardId;
-    }
-
-    const std::string& prefix = prefixStream.str();
+    const std::string prefix = getStatsPrefix();
 
     /* stats for both read-only and read-write threads */
     addStat(prefix, "backend_type",   backend,            add_stat, c);
@@ -279,17 +269,20 @@ void KVStore::addStats(ADD_STAT add_stat, const void *c) {
             st.fsStatsCompaction.totalBytesWritten, add_stat, c);
 }
 
-void KVStore::addTimingStats(ADD_STAT add_stat, const void *c) {
-    uint16_t shardId = configuration.getShardId();
+std::string KVStore::getStatsPrefix() const {
     std::stringstream prefixStream;
 
-    if (isReadOnly()) {
-        prefixStream << "ro_" << shardId;
+    if (readOnly) {
+        prefixStream << "ro_" << configuration.getShardId();
     } else {
-        prefixStream << "rw_" << shardId;
+        prefixStream << "rw_" << configuration.getShardId();
     }
 
-    const std::string& prefix = prefixStream.str();
+    return prefixStream.str();
+}
+
+void KVStore::addTimingStats(ADD_STAT add_stat, const void *c) {
+    const std::string prefix = getStatsPrefix();
 
     addStat(prefix, "commit",      st.commitHisto,      add_stat, c);
     addStat(prefix, "compact",     st.compactHisto,     add_stat, c);
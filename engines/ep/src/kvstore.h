@@ -41,7 +41,6 @@ class Item;
 class KVStore;
 class KVStoreConfig;
 class Logger;
-class PersistenceCallback;
 class RollbackCB;
 class RollbackResult;
 
@@ -451,7 +450,7 @@ public:
      * @param add_stat the callback function to add statistics
      * @param c the cookie to pass to the callback function
      */
-    void addStats(ADD_STAT add_stat, const void *c);
+    virtual void addStats(ADD_STAT add_stat, const void *c);
 
     /**
      * Request the specified statistic name from the kvstore.
@@ -651,10 +650,6 @@ public:
      */
     void optimizeWrites(std::vector<queued_item>& items);
 
-    std::list<PersistenceCallback *>& getPersistenceCbList() {
-        return pcbs;
-    }
-
     /**
      * This method is called after persisting a batch of data to perform any
      * pending tasks on the underlying KVStore instance.
@@ -739,9 +734,12 @@ protected:
        RelaxedAtomic to allow stats access without lock. */
     std::vector<Couchbase::RelaxedAtomic<size_t>> cachedDocCount;
     Couchbase::RelaxedAtomic<uint16_t> cachedValidVBCount;
-    std::list<PersistenceCallback *> pcbs;
 
     void createDataDir(const std::string& dbname);
+
+    /// @return the prefix of this store's stats ("ro_<shard>"/"rw_<shard>")
+    std::string getStatsPrefix() const;
+
     template <typename T>
     void addStat(const std::string& prefix, const char* nm, T& val,
                  ADD_STAT add_stat, const void* c);
@@ -44,6 +44,14 @@ KVStoreConfig::KVStoreConfig(Configuration& config, uint16_t shardid)
                     config.getRocksdbCfOptions(),
                     config.getRocksdbBbtOptions()) {
     setPeriodicSyncBytes(config.getFsyncAfterEveryNBytesWritten());
+    setDirectReads(config.isCouchstoreDirectReads());
+    setBlockCacheSize(config.getCouchstoreBlockCacheSize() /
+                      config.getMaxNumShards());
+    // Round up, so each shard gets at least one handle if enabled
+    setDbHandleCacheSize((config.getCouchstoreDbHandleCacheSize() +
+                          config.getMaxNumShards() - 1) /
+                         config.getMaxNumShards());
+    setScanReadAheadSize(config.getCouchstoreScanReadAheadSize());
     config.addValueChangedListener("fsync_after_every_n_bytes_written",
                                    new ConfigChangeListener(*this));
 }
@@ -64,6 +72,10 @@ KVStoreConfig::KVStoreConfig(uint16_t _maxVBuckets,
       shardId(_shardId),
       logger(&global_logger),
       buffered(true),
+      directReads(false),
+      blockCacheSize(0),
+      dbHandleCacheSize(0),
+      scanReadAheadSize(0),
       persistDocNamespace(_persistDocNamespace),
       rocksDBOptions(rocksDBOptions_),
       rocksDBCFOptions(rocksDBCFOptions_),
@@ -87,3 +99,23 @@ KVStoreConfig& KVStoreConfig::setBuffered(bool _buffered) {
     buffered = _buffered;
     return *this;
 }
+
+KVStoreConfig& KVStoreConfig::setDirectReads(bool _directReads) {
+    directReads = _directReads;
+    return *this;
+}
+
+KVStoreConfig& KVStoreConfig::setBlockCacheSize(size_t size) {
+    blockCacheSize = size;
+    return *this;
+}
+
+KVStoreConfig& KVStoreConfig::setDbHandleCacheSize(size_t size) {
+    dbHandleCacheSize = size;
+    return *this;
+}
+
+KVStoreConfig& KVStoreConfig::setScanReadAheadSize(size_t size) {
+    scanReadAheadSize = size;
+    return *this;
+}
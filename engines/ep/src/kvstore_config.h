@@ -95,6 +95,60 @@ public:
      */
     KVStoreConfig& setBuffered(bool _buffered);
 
+    /**
+     * Indicates whether point reads (background fetches) should bypass the
+     * OS page cache.
+     *
+     * Only recognised by CouchKVStore
+     */
+    bool getDirectReads() const {
+        return directReads;
+    }
+
+    /**
+     * Used to override the default (buffered) read behaviour of background
+     * fetches.
+     *
+     * Only recognised by CouchKVStore
+     */
+    KVStoreConfig& setDirectReads(bool _directReads);
+
+    /**
+     * The maximum memory used by the cache of file blocks read by point
+     * reads (background fetches); 0 if disabled.
+     *
+     * Only recognised by CouchKVStore
+     */
+    size_t getBlockCacheSize() const {
+        return blockCacheSize;
+    }
+
+    KVStoreConfig& setBlockCacheSize(size_t size);
+
+    /**
+     * The maximum number of open file handles kept for reuse by point
+     * reads; 0 if disabled.
+     *
+     * Only recognised by CouchKVStore
+     */
+    size_t getDbHandleCacheSize() const {
+        return dbHandleCacheSize;
+    }
+
+    KVStoreConfig& setDbHandleCacheSize(size_t size);
+
+    /**
+     * The size of each read issued by disk scans (backfills), which read
+     * ahead of the data requested; 0 if disabled.
+     *
+     * Only recognised by CouchKVStore
+     */
+    size_t getScanReadAheadSize() const {
+        return scanReadAheadSize;
+    }
+
+    KVStoreConfig& setScanReadAheadSize(size_t size);
+
     bool shouldPersistDocNamespace() const {
         return persistDocNamespace;
     }
@@ -142,6 +196,10 @@ private:
     uint16_t shardId;
     Logger* logger;
     bool buffered;
+    bool directReads;
+    size_t blockCacheSize;
+    size_t dbHandleCacheSize;
+    size_t scanReadAheadSize;
     bool persistDocNamespace;
 
     /**
@@ -26,6 +26,7 @@
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
+#include <vector>
 
 #include "utility.h"
 
@@ -77,6 +78,38 @@ private:
 #define MultiLockHolder(x) \
     static_assert(false, "MultiLockHolder: missing variable name for scoped lock.")
 
+/**
+ * RAII lock holder acquiring the writer side of multiple reader/writer locks.
+ */
+class MultiWriterLockHolder {
+public:
+
+    /**
+     * Acquire (in writer mode) a series of locks.
+     *
+     * @param l reference to a vector of reader/writer locks
+     */
+    MultiWriterLockHolder(std::vector<cb::RWLock>& l)
+        : locks(l) {
+        for (auto& rw : locks) {
+            rw.writer().lock();
+        }
+    }
+
+    ~MultiWriterLockHolder() {
+        for (auto& rw : locks) {
+            rw.writer().unlock();
+        }
+    }
+
+private:
+    std::vector<cb::RWLock>& locks;
+
+    DISALLOW_COPY_AND_ASSIGN(MultiWriterLockHolder);
+};
+#define MultiWriterLockHolder(x) \
+    static_assert(false, "MultiWriterLockHolder: missing variable name for scoped lock.")
+
 // RAII Reader lock
 // deprecated, prefer std::lock_guard<ReaderLock> rlh(rwLock.reader())
 class ReaderLockHolder {
@@ -0,0 +1,121 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include "callbacks.h"
+#include "item.h"
+#include "kvstore.h"
+#include "vbucket.h"
+
+#include <vector>
+
+class EPStats;
+
+/**
+ * Callback invoked after persisting an item from memory to disk.
+ *
+ * This class exists to create a closure around a few variables within
+ * KVBucket::flushOneDelOrSet so that an object can be
+ * requeued in case of failure to store in the underlying layer.
+ */
+class PersistenceCallback : public Callback<mutation_result>,
+                            public Callback<int> {
+public:
+    PersistenceCallback(const queued_item& qi,
+                        VBucketPtr& vb,
+                        EPStats& s,
+                        uint64_t c);
+
+    // Movable (so it may live in a std::vector), but not copyable
+    PersistenceCallback(PersistenceCallback&&) = default;
+    PersistenceCallback(const PersistenceCallback&) = delete;
+    PersistenceCallback& operator=(const PersistenceCallback&) = delete;
+
+    // This callback is invoked for set only.
+    void callback(mutation_result& value) override;
+
+    // This callback is invoked for deletions only.
+    //
+    // The boolean indicates whether the underlying storage
+    // successfully deleted the item.
+    void callback(int& value) override;
+
+private:
+    void redirty();
+
+    const queued_item queuedItem;
+    VBucketPtr vbucket;
+    EPStats& stats;
+    uint64_t cas;
+};
+
+/**
+ * Storage for the PersistenceCallbacks of the items written (but not yet
+ * committed) by a shard's flusher.
+ *
+ * The KVStore keeps a reference to each callback until the commit, so the
+ * callbacks must not move once created. Rather than allocating each one
+ * individually they're stored in fixed capacity chunks; clear() destroys
+ * the callbacks but keeps the chunks around for the next flush, so in the
+ * steady state flushing doesn't need to allocate any memory for them.
+ */
+class PersistenceCallbackArena {
+public:
+    /// Number of callbacks stored in each chunk
+    static const size_t ChunkSize = 1024;
+
+    /**
+     * Create a new callback.
+     *
+     * @return a reference to the callback, which stays valid until clear()
+     */
+    template <typename... Args>
+    PersistenceCallback& emplace(Args&&... args) {
+        if (chunks.empty() || chunks[current].size() == ChunkSize) {
+            if (!chunks.empty()) {
+                ++current;
+            }
+            if (current == chunks.size()) {
+                chunks.emplace_back();
+                chunks.back().reserve(ChunkSize);
+            }
+        }
+        // Never exceeds the reserved capacity; existing elements don't move
+        chunks[current].emplace_back(std::forward<Args>(args)...);
+        return chunks[current].back();
+    }
+
+    /// Destroy all of the callbacks (keeping the memory for reuse)
+    void clear() {
+        for (auto& chunk : chunks) {
+            chunk.clear();
+        }
+        current = 0;
+    }
+
+    bool empty() const {
+        return chunks.empty() || chunks.front().empty();
+    }
+
+private:
+    std::vector<std::vector<PersistenceCallback>> chunks;
+    // Index of the chunk currently being filled
+    size_t current = 0;
+};
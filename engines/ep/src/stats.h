@@ -64,6 +64,8 @@ public:
         vbBackfillQueueSize(0),
         flusher_todo(0),
         flusherCommits(0),
+        flusherPreparedBytes(0),
+        flusherPreparedFlushes(0),
         cumulativeFlushTime(0),
         cumulativeCommitTime(0),
         tooYoung(0),
@@ -93,6 +95,11 @@ public:
         pagerRuns(0),
         expiryPagerRuns(0),
         itemsRemovedFromCheckpoints(0),
+        itemsExpelledFromCheckpoints(0),
+        memFreedByCheckpointItemExpel(0),
+        dcpCompressionCacheHits(0),
+        dcpCompressionCacheMisses(0),
+        dcpCompressionCacheBytesSaved(0),
         numValueEjects(0),
         numFailedEjects(0),
         numNotMyVBuckets(0),
@@ -152,6 +159,8 @@ public:
         rollbackCount(0),
         defragNumVisited(0),
         defragNumMoved(0),
+        compressorNumVisited(0),
+        compressorNumCompressed(0),
         dirtyAgeHisto(GrowingWidthGenerator<hrtime_t>(0, ONE_SECOND, 1.4), 25),
         diskCommitHisto(GrowingWidthGenerator<hrtime_t>(0, ONE_SECOND, 1.4), 25),
         mlogCompactorHisto(GrowingWidthGenerator<hrtime_t>(0, ONE_SECOND, 1.4), 25),
@@ -229,6 +238,10 @@ public:
     Counter flusher_todo;
     //! Number of transaction commits.
     Counter flusherCommits;
+    //! Size of the items taken ahead of their flush by the flush pipeline.
+    cb::NonNegativeCounter<size_t> flusherPreparedBytes;
+    //! Number of vbucket flushes which used items prepared by the pipeline.
+    Counter flusherPreparedFlushes;
     //! Total time spent flushing.
     Counter cumulativeFlushTime;
     //! Total time spent committing.
@@ -297,6 +310,19 @@ public:
     Counter expiryPagerRuns;
     //! Number of items removed from closed unreferenced checkpoints.
     Counter itemsRemovedFromCheckpoints;
+    //! Number of items expelled from checkpoints (after being processed by
+    //! every cursor) before the checkpoint itself was removed.
+    Counter itemsExpelledFromCheckpoints;
+    //! Memory released by expelling items from checkpoints.
+    Counter memFreedByCheckpointItemExpel;
+    //! Number of values DCP producers sent compressed using the compressed
+    //! value cached in the checkpoint by another producer.
+    Counter dcpCompressionCacheHits;
+    //! Number of values DCP producers compressed which weren't cached.
+    Counter dcpCompressionCacheMisses;
+    //! Number of (uncompressed) bytes DCP producers didn't need to compress
+    //! due to the cached compressed values.
+    Counter dcpCompressionCacheBytesSaved;
     //! Number of times a value is ejected
     Counter numValueEjects;
     //! Number of times a value could not be ejected
@@ -386,6 +412,13 @@ public:
     //! Histogram of background wait loads.
     Histogram<hrtime_t> bgLoadHisto;
 
+    //! Histogram of the time a vbucket with outstanding background fetches
+    //! waits (behind other vbuckets) before a BgFetcher picks it up.
+    MicrosecondHistogram bgFetchQueueHisto;
+    //! Histogram of the time spent reading a vbucket's batch of background
+    //! fetches from disk (KVStore::getMulti).
+    MicrosecondHistogram bgFetchDiskHisto;
+
     //! Max wall time of deleting a vbucket
     std::atomic<hrtime_t> vbucketDelMaxWalltime;
     //! Total wall time of deleting vbuckets
@@ -460,6 +493,16 @@ public:
      */
     Counter defragNumMoved;
 
+    /** The number of items that have been visited (considered for
+     * compression) by the item compressor task.
+     */
+    Counter compressorNumVisited;
+
+    /** The number of items whose value has been compressed by the item
+     * compressor task.
+     */
+    Counter compressorNumCompressed;
+
     //! Histogram of queue processing dirty age.
     Histogram<hrtime_t> dirtyAgeHisto;
 
@@ -521,6 +564,12 @@ public:
     //! Histogram of disk commits
     Histogram<hrtime_t> diskCommitHisto;
 
+    //! Histogram of the number of items written by each disk commit
+    Histogram<size_t> diskCommitBatchSizeHisto;
+
+    //! Histogram of disk commit time divided by the items in the commit
+    Histogram<hrtime_t> diskCommitPerItemHisto;
+
     //! Histogram of mutation log compactor
     Histogram<hrtime_t> mlogCompactorHisto;
 
@@ -548,6 +597,11 @@ public:
         cursorsDropped.store(0);
         pagerRuns.store(0);
         itemsRemovedFromCheckpoints.store(0);
+        itemsExpelledFromCheckpoints.store(0);
+        memFreedByCheckpointItemExpel.store(0);
+        dcpCompressionCacheHits.store(0);
+        dcpCompressionCacheMisses.store(0);
+        dcpCompressionCacheBytesSaved.store(0);
         numValueEjects.store(0);
         numFailedEjects.store(0);
         numNotMyVBuckets.store(0);
@@ -573,10 +627,14 @@ public:
         accessScannerSkips.store(0),
         defragNumVisited.store(0),
         defragNumMoved.store(0);
+        compressorNumVisited.store(0);
+        compressorNumCompressed.store(0);
 
         pendingOpsHisto.reset();
         bgWaitHisto.reset();
         bgLoadHisto.reset();
+        bgFetchQueueHisto.reset();
+        bgFetchDiskHisto.reset();
         setWithMetaHisto.reset();
         accessScannerHisto.reset();
         checkpointRemoverHisto.reset();
@@ -596,6 +654,8 @@ public:
         diskDelHisto.reset();
         diskVBDelHisto.reset();
         diskCommitHisto.reset();
+        diskCommitBatchSizeHisto.reset();
+        diskCommitPerItemHisto.reset();
         itemAllocSizeHisto.reset();
         getMultiBatchSizeHisto.reset();
         dirtyAgeHisto.reset();
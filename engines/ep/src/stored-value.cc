@@ -25,35 +25,54 @@
 #include "stats.h"
 
 #include <platform/cb_malloc.h>
+#include <platform/compress.h>
+
+#include <cstring>
 
 const int64_t StoredValue::state_deleted_key = -3;
 const int64_t StoredValue::state_non_existent_key = -4;
 const int64_t StoredValue::state_temp_init = -5;
 const int64_t StoredValue::state_collection_open = -6;
 
+const int64_t PackedInt48::max = (int64_t(1) << 47) - 1;
+const int64_t PackedInt48::min = -(int64_t(1) << 47);
+
 StoredValue::StoredValue(const Item& itm,
                          UniquePtr n,
                          EPStats& stats,
-                         bool isOrdered)
+                         bool isOrdered,
+                         bool inlineValue)
     : value(itm.getValue()),
       chain_next_or_replacement(std::move(n)),
       cas(itm.getCas()),
       revSeqno(itm.getRevSeqno()),
       bySeqno(itm.getBySeqno()),
-      lock_expiry_or_delete_time(0),
-      exptime(itm.getExptime()),
-      flags(itm.getFlags()),
       datatype(itm.getDataType()),
       deleted(itm.isDeleted()),
       newCacheItem(true),
       isOrdered(isOrdered),
       nru(itm.getNRUValue()),
       resident(!isTempItem()),
-      stale(false) {
+      hasInlineStorage(inlineValue),
+      exptime(itm.getExptime()),
+      flags(itm.getFlags()) {
+    if (!isOrdered) {
+        // Trailing lock expiry; OrderedStoredValue initialises its own.
+        lockExpiryOrDeleteTime() = 0;
+    }
+
     // Placement-new the key which lives in memory directly after this
     // object.
     new (key()) SerialisedDocKey(itm.getKey());
 
+    if (hasInlineStorage) {
+        // Inline storage is sized to exactly fit the initial value.
+        inlineStorage()[inlineCapacityOffset] =
+                uint8_t(itm.getValue()->valueSize());
+        inlineStorage()[inlineLengthOffset] = noInlineValue;
+        assignValue(itm.getValue());
+    }
+
     if (isTempInitialItem()) {
         markClean();
     } else {
@@ -79,9 +98,6 @@ StoredValue::StoredValue(const StoredValue& other,
       cas(other.cas),
       revSeqno(other.revSeqno),
       bySeqno(other.bySeqno),
-      lock_expiry_or_delete_time(other.lock_expiry_or_delete_time),
-      exptime(other.exptime),
-      flags(other.flags),
       datatype(other.datatype),
       _isDirty(other._isDirty),
       deleted(other.deleted),
@@ -89,12 +105,24 @@ StoredValue::StoredValue(const StoredValue& other,
       isOrdered(other.isOrdered),
       nru(other.nru),
       resident(other.resident),
-      stale(false) {
+      hasInlineStorage(other.hasInlineStorage),
+      exptime(other.exptime),
+      flags(other.flags) {
+    if (!isOrdered) {
+        lockExpiryOrDeleteTime() = other.lockExpiryOrDeleteTime();
+    }
+
     // Placement-new the key which lives in memory directly after this
     // object.
     StoredDocKey sKey(other.getKey());
     new (key()) SerialisedDocKey(sKey);
 
+    if (hasInlineStorage) {
+        std::memcpy(inlineStorage(),
+                    other.inlineStorage(),
+                    other.getInlineStorageSize());
+    }
+
     ObjectRegistry::onCreateStoredValue(this);
 }
 
@@ -149,7 +177,7 @@ void StoredValue::restoreValue(const Item& itm) {
     }
     datatype = itm.getDataType();
     deleted = itm.isDeleted();
-    value = itm.getValue();
+    assignValue(itm.getValue());
     resident = true;
 }
 
@@ -180,9 +208,49 @@ bool StoredValue::del() {
     }
 }
 
-size_t StoredValue::getRequiredStorage(const Item& item) {
-    return sizeof(StoredValue) +
-           SerialisedDocKey::getObjectSize(item.getKey().size());
+size_t StoredValue::getRequiredStorage(const Item& item,
+                                       size_t inlineValueMaxSize) {
+    return getFixedSize() +
+           SerialisedDocKey::getObjectSize(item.getKey().size()) +
+           (canInlineValue(item, inlineValueMaxSize)
+                    ? getInlineStorageSize(item)
+                    : 0);
+}
+
+bool StoredValue::canInlineValue(const Item& item,
+                                 size_t inlineValueMaxSize) {
+    const auto& val = item.getValue();
+    return val && val->valueSize() <= inlineValueMaxSize &&
+           val->valueSize() <= maxInlineValueSize;
+}
+
+size_t StoredValue::getInlineStorageSize(const Item& itm) {
+    return inlineHeaderSize + itm.getValue()->valueSize();
+}
+
+void StoredValue::assignValue(const value_t& newValue) {
+    if (hasInlineStorage) {
+        uint8_t* storage = inlineStorage();
+        if (newValue &&
+            newValue->valueSize() <= storage[inlineCapacityOffset]) {
+            std::memcpy(storage + inlineHeaderSize,
+                        newValue->getData(),
+                        newValue->valueSize());
+            storage[inlineLengthOffset] = uint8_t(newValue->valueSize());
+            value.reset();
+            return;
+        }
+        // Doesn't fit (or no value) - fall back to referencing the Blob.
+        storage[inlineLengthOffset] = noInlineValue;
+    }
+    value = newValue;
+}
+
+value_t StoredValue::getValueAsBlob() const {
+    if (isValueInline()) {
+        return value_t(Blob::New(getValueData(), valuelen()));
+    }
+    return value;
 }
 
 std::unique_ptr<Item> StoredValue::toItem(bool lck, uint16_t vbucket) const {
@@ -190,7 +258,7 @@ std::unique_ptr<Item> StoredValue::toItem(bool lck, uint16_t vbucket) const {
             std::make_unique<Item>(getKey(),
                                    getFlags(),
                                    getExptime(),
-                                   value,
+                                   getValueAsBlob(),
                                    datatype,
                                    lck ? static_cast<uint64_t>(-1) : getCas(),
                                    bySeqno,
@@ -228,12 +296,43 @@ std::unique_ptr<Item> StoredValue::toItemKeyOnly(uint16_t vbucket) const {
 }
 
 void StoredValue::reallocate() {
+    if (!value) {
+        // No Blob (no value, or stored inline) - nothing to reallocate.
+        return;
+    }
     // Allocate a new Blob for this stored value; copy the existing Blob to
     // the new one and free the old.
     value_t new_val(Blob::Copy(*value));
     value.reset(new_val);
 }
 
+bool StoredValue::compressValue(float minCompressionRatio) {
+    if (!value || value->valueSize() == 0 ||
+        mcbp::datatype::is_snappy(datatype)) {
+        // No Blob (no value, or stored inline), or already compressed.
+        return false;
+    }
+
+    cb::compression::Buffer deflated;
+    if (!cb::compression::deflate(cb::compression::Algorithm::Snappy,
+                                  value->getData(),
+                                  value->valueSize(),
+                                  deflated)) {
+        return false;
+    }
+
+    if (deflated.len == 0 ||
+        (float(value->valueSize()) / deflated.len) < minCompressionRatio) {
+        // Not worth keeping; the saving doesn't justify inflating on read.
+        return false;
+    }
+
+    value_t new_val(Blob::New(deflated.data.get(), deflated.len));
+    value.reset(new_val);
+    datatype |= PROTOCOL_BINARY_DATATYPE_SNAPPY;
+    return true;
+}
+
 void StoredValue::Deleter::operator()(StoredValue* val) {
     if (val->isOrdered) {
         delete static_cast<OrderedStoredValue*>(val);
@@ -259,7 +358,7 @@ const OrderedStoredValue* StoredValue::toOrderedStoredValue() const {
 bool StoredValue::operator==(const StoredValue& other) const {
     return (cas == other.cas && revSeqno == other.revSeqno &&
             bySeqno == other.bySeqno &&
-            lock_expiry_or_delete_time == other.lock_expiry_or_delete_time &&
+            lockExpiryOrDeleteTime() == other.lockExpiryOrDeleteTime() &&
             exptime == other.exptime && flags == other.flags &&
             _isDirty == other._isDirty && deleted == other.deleted &&
             newCacheItem == other.newCacheItem &&
@@ -269,7 +368,7 @@ bool StoredValue::operator==(const StoredValue& other) const {
 }
 
 bool StoredValue::deleteImpl() {
-    if (isDeleted() && !getValue()) {
+    if (isDeleted() && !hasValue()) {
         // SV is already marked as deleted and has no value - no further
         // deletion possible.
         return false;
@@ -291,7 +390,7 @@ void StoredValue::setValueImpl(const Item& itm) {
     bySeqno = itm.getBySeqno();
 
     cas = itm.getCas();
-    lock_expiry_or_delete_time = 0;
+    lockExpiryOrDeleteTime() = 0;
     exptime = itm.getExptime();
     revSeqno = itm.getRevSeqno();
 
@@ -307,7 +406,7 @@ void StoredValue::setValueImpl(const Item& itm) {
         resident = false;
     } else {
         resident = true;
-        value = itm.getValue();
+        assignValue(itm.getValue());
     }
 }
 
@@ -331,9 +430,9 @@ boost::optional<item_info> StoredValue::getItemInfo(uint64_t vbuuid) const {
             isDeleted() ? DocumentState::Deleted : DocumentState::Alive;
     info.nkey = getKey().size();
     info.key = getKey().data();
-    if (getValue()) {
-        info.value[0].iov_base = const_cast<char*>(getValue()->getData());
-        info.value[0].iov_len = getValue()->valueSize();
+    if (hasValue()) {
+        info.value[0].iov_base = const_cast<char*>(getValueData());
+        info.value[0].iov_len = valuelen();
     }
     return info;
 }
@@ -372,21 +471,21 @@ std::ostream& operator<<(std::ostream& os, const StoredValue& sv) {
     os << "seq:" << sv.getBySeqno() << " rev:" << sv.getRevSeqno();
     os << " key:\"" << sv.getKey() << "\"";
     if (sv.isOrdered && sv.isDeleted()) {
-        os << " del_time:" << sv.lock_expiry_or_delete_time;
+        os << " del_time:" << sv.lockExpiryOrDeleteTime();
     } else {
         os << " exp:" << sv.getExptime();
     }
 
     os << " vallen:" << sv.valuelen();
-    if (sv.getValue().get()) {
-        os << " val:\"";
-        const char* data = sv.getValue()->getData();
+    if (sv.hasValue()) {
+        os << (sv.isValueInline() ? " inline" : "") << " val:\"";
+        const char* data = sv.getValueData();
         // print up to first 40 bytes of value.
-        const size_t limit = std::min(size_t(40), sv.getValue()->valueSize());
+        const size_t limit = std::min(size_t(40), sv.valuelen());
         for (size_t ii = 0; ii < limit; ii++) {
             os << data[ii];
         }
-        if (limit < sv.getValue()->valueSize()) {
+        if (limit < sv.valuelen()) {
             os << " <cut>";
         }
         os << "\"";
@@ -398,9 +497,12 @@ bool OrderedStoredValue::operator==(const OrderedStoredValue& other) const {
     return StoredValue::operator==(other);
 }
 
-size_t OrderedStoredValue::getRequiredStorage(const Item& item) {
-    return sizeof(OrderedStoredValue) +
-           SerialisedDocKey::getObjectSize(item.getKey());
+size_t OrderedStoredValue::getRequiredStorage(const Item& item,
+                                              size_t inlineValueMaxSize) {
+    return getFixedSize() + SerialisedDocKey::getObjectSize(item.getKey()) +
+           (canInlineValue(item, inlineValueMaxSize)
+                    ? getInlineStorageSize(item)
+                    : 0);
 }
 
 /**
@@ -26,9 +26,62 @@
 
 #include <boost/intrusive/list.hpp>
 
+#include <stdexcept>
+#include <string>
+
 class Item;
 class OrderedStoredValue;
 
+/**
+ * A signed 48-bit integer stored in 6 bytes (with 2-byte alignment).
+ *
+ * Used by StoredValue to hold the by-sequence number in less than a full
+ * word; leaving space for the datatype and flag bits in the same 8 bytes.
+ * Seqnos are limited to 2^47 - 1, which even at 10M mutations per second
+ * on a single vBucket would take ~160 days to reach. Seqnos supplied from
+ * outside (replication, SetWithMeta) are range checked by VBucket before
+ * being stored, so the exception below is only for a broken invariant.
+ */
+class PackedInt48 {
+public:
+    static const int64_t max;
+    static const int64_t min;
+
+    PackedInt48(int64_t v) {
+        store(v);
+    }
+
+    PackedInt48& operator=(int64_t v) {
+        store(v);
+        return *this;
+    }
+
+    operator int64_t() const {
+        uint64_t u = uint64_t(parts[0]) | (uint64_t(parts[1]) << 16) |
+                     (uint64_t(parts[2]) << 32);
+        // Sign-extend from bit 47.
+        if (u & (uint64_t(1) << 47)) {
+            u |= uint64_t(0xffff) << 48;
+        }
+        return int64_t(u);
+    }
+
+private:
+    void store(int64_t v) {
+        if (v > max || v < min) {
+            throw std::overflow_error("PackedInt48: value (which is " +
+                                      std::to_string(v) +
+                                      ") does not fit in 48 bits");
+        }
+        const uint64_t u = uint64_t(v);
+        parts[0] = uint16_t(u);
+        parts[1] = uint16_t(u >> 16);
+        parts[2] = uint16_t(u >> 32);
+    }
+
+    uint16_t parts[3];
+};
+
 /**
  * In-memory storage for an item.
  *
@@ -65,14 +118,21 @@ class OrderedStoredValue;
  *           {   | next  [ptr]       | ======> StoredValue (next in hash chain).
  *     fixed {   | CAS               |
  *    length {   | revSeqno          |
- *           {   | ...               |
+ *           {   | bySeqno (48 bit)  |
  *           {   | datatype          |
  *           {   | internal flags: isDirty, deleted, isOrderedStoredValue ...
+ *           {   | exptime, flags    |
  *               + - - - - - - - - - +
+ *  trailing {   | lock expiry       |
  *  variable {   | key[]             |
  *   length  {   | ...               |
  *               +-------------------+
  *
+ * The fixed part is packed to exactly 48 bytes (no padding). The GETL lock
+ * expiry (4 bytes) would push it to 56 with alignment, so it is instead
+ * allocated in the trailing storage immediately after the fixed part, before
+ * the key.
+ *
  * OrderedStoredValue is a "subclass" of StoredValue, which is used by
  * Ephemeral buckets as it supports maintaining a seqno ordering of items in
  * memory (for Persistent buckets this ordering is maintained on-disk).
@@ -82,7 +142,9 @@ class OrderedStoredValue;
  *
  * OrderedStoredValue has the fixed length members of StoredValue, then it's
  * own fixed length fields (seqno list), followed finally by the variable
- * length key (again, allocated contiguously):
+ * length key (again, allocated contiguously). OrderedStoredValue already has
+ * spare padding after the seqno list, so it holds the lock expiry (and
+ * stale flag) as regular members:
  *
  *              StoredValue::UniquePtr
  *                          |
@@ -96,6 +158,8 @@ class OrderedStoredValue;
  *    length {   + - - - - - - - - - -+
  *           {   | seqno next [ptr]   |
  *           {   | seqno prev [ptr]   |
+ *           {   | lock expiry / delete time
+ *           {   | stale              |
  *               + - - - - - - - - - -+
  *  variable {   | key[]              |
  *   length  {   | ...                |
@@ -158,7 +222,10 @@ public:
 
     bool eligibleForEviction(item_eviction_policy_t policy) {
         if (policy == VALUE_ONLY) {
-            return isResident() && !isDirty() && !isDeleted();
+            // Inline values share the StoredValue's allocation, so there is
+            // no memory to be freed by ejecting them.
+            return isResident() && !isDirty() && !isDeleted() &&
+                   !isValueInline();
         } else {
             return !isDirty() && !isDeleted();
         }
@@ -206,12 +273,42 @@ public:
     }
 
     /**
-     * Get this item's value.
+     * Get this item's value Blob.
+     *
+     * Note: Null if the value is not resident, or if it is stored inline (see
+     * isValueInline()); use hasValue() / getValueData() / valuelen() to
+     * access the value irrespective of where it is stored.
      */
     const value_t &getValue() const {
         return value;
     }
 
+    /**
+     * True if this item's value is stored inline in the StoredValue
+     * allocation (after the key) instead of in a separate Blob.
+     */
+    bool isValueInline() const {
+        return hasInlineStorage &&
+               inlineStorage()[inlineLengthOffset] != noInlineValue;
+    }
+
+    /// True if this item has a value (either as a Blob or inline).
+    bool hasValue() const {
+        return value || isValueInline();
+    }
+
+    /**
+     * Get a pointer to this item's value bytes (valuelen() bytes long),
+     * wherever they are stored. Returns nullptr if there is no value.
+     */
+    const char* getValueData() const {
+        if (isValueInline()) {
+            return reinterpret_cast<const char*>(inlineStorage() +
+                                                 inlineHeaderSize);
+        }
+        return value ? value->getData() : nullptr;
+    }
+
     /**
      * Get the expiration time of this item.
      *
@@ -313,7 +410,7 @@ public:
             throw std::logic_error(
                     "StoredValue::lock: Called on Deleted item");
         }
-        lock_expiry_or_delete_time = expiry;
+        lockExpiryOrDeleteTime() = expiry;
     }
 
     /**
@@ -324,7 +421,7 @@ public:
             // Deleted items are not locked - just skip.
             return;
         }
-        lock_expiry_or_delete_time = 0;
+        lockExpiryOrDeleteTime() = 0;
     }
 
     /**
@@ -404,6 +501,9 @@ public:
      }
 
     size_t valuelen() const {
+        if (isValueInline()) {
+            return inlineStorage()[inlineLengthOffset];
+        }
         if (!value) {
             return 0;
         }
@@ -416,11 +516,12 @@ public:
      * @return the amount of memory used by this item.
      */
     size_t size() const {
-        return getObjectSize() + valuelen();
+        // Inline values are already included in the object size.
+        return getObjectSize() + (value ? value->valueSize() : 0);
     }
 
     size_t metaDataSize() const {
-        return getObjectSize();
+        return getObjectSize() - getInlineStorageSize();
     }
 
     /**
@@ -435,8 +536,8 @@ public:
             return false;
         }
 
-        if (lock_expiry_or_delete_time == 0 ||
-            (curtime > lock_expiry_or_delete_time)) {
+        const auto lockExpiry = lockExpiryOrDeleteTime();
+        if (lockExpiry == 0 || (curtime > lockExpiry)) {
             return false;
         }
         return true;
@@ -457,6 +558,9 @@ public:
     /// Discard the value from this document.
     void resetValue() {
         value.reset();
+        if (hasInlineStorage) {
+            inlineStorage()[inlineLengthOffset] = noInlineValue;
+        }
     }
 
     /**
@@ -525,7 +629,7 @@ public:
     boost::optional<item_info> getItemInfo(uint64_t vbuuid) const;
 
     void setNext(UniquePtr&& nextSv) {
-        if (stale) {
+        if (isStale()) {
             throw std::logic_error(
                     "StoredValue::setNext: StoredValue is stale,"
                     "cannot set chain next value");
@@ -534,7 +638,7 @@ public:
     }
 
     UniquePtr& getNext() {
-        if (stale) {
+        if (isStale()) {
             throw std::logic_error(
                     "StoredValue::getNext: StoredValue is stale,"
                     "cannot get chain next value");
@@ -564,16 +668,38 @@ public:
 
     /**
      * Return the size in byte of this object; both the fixed fields and the
-     * variable-length key. Doesn't include value size (allocated externally).
+     * variable-length key (plus any inline value storage). Doesn't include
+     * the size of a value Blob (allocated externally).
      */
     inline size_t getObjectSize() const;
 
+    /**
+     * Return the number of bytes of a StoredValue preceding its key; the
+     * fixed fields plus any trailing (non-key) fields.
+     */
+    static size_t getFixedSize() {
+        return sizeof(StoredValue) + sizeof(rel_time_t);
+    }
+
     /**
      * Reallocates the dynamic members of StoredValue. Used as part of
      * defragmentation.
      */
     void reallocate();
 
+    /**
+     * Compresses the value of this item with Snappy, replacing the Blob with
+     * the compressed one and setting the Snappy datatype bit.
+     *
+     * Only uncompressed values held in a Blob are considered (inline values
+     * are too small to benefit); the compressed form is only kept if the
+     * ratio of uncompressed to compressed size is at least
+     * minCompressionRatio.
+     *
+     * @return true if the value was compressed.
+     */
+    bool compressValue(float minCompressionRatio);
+
     /**
      * Returns pointer to the subclass OrderedStoredValue if it the object is
      * of the type, if not throws a bad_cast.
@@ -592,8 +718,22 @@ public:
      */
     bool operator==(const StoredValue& other) const;
 
-    /// Return how many bytes are need to store Item as a StoredValue
-    static size_t getRequiredStorage(const Item& item);
+    /**
+     * Return how many bytes are need to store Item as a StoredValue
+     *
+     * @param inlineValueMaxSize Values up to this size are stored inline.
+     */
+    static size_t getRequiredStorage(const Item& item,
+                                     size_t inlineValueMaxSize = 0);
+
+    /**
+     * Return true if the value of the given Item would be stored inline in a
+     * StoredValue, given the maximum inline value size.
+     */
+    static bool canInlineValue(const Item& item, size_t inlineValueMaxSize);
+
+    /// Largest value which can ever be stored inline.
+    static const size_t maxInlineValueSize = 254;
 
 protected:
     /**
@@ -607,11 +747,15 @@ protected:
      *           which the new item is being inserted).
      * @param stats EPStats to update for this new StoredValue
      * @param isOrdered Are we constructing an OrderedStoredValue?
+     * @param inlineValue Store the item's value inline, after the key. The
+     *        caller must have allocated getInlineStorageSize(itm) bytes for
+     *        it (see canInlineValue()).
      */
     StoredValue(const Item& itm,
                 UniquePtr n,
                 EPStats& stats,
-                bool isOrdered);
+                bool isOrdered,
+                bool inlineValue);
 
     // Destructor. protected, as needs to be carefully deleted (via
     // StoredValue::Destructor) depending on the value of isOrdered flag.
@@ -640,6 +784,57 @@ protected:
      */
     inline SerialisedDocKey* key();
 
+    /**
+     * Get the address of the inline value storage, located directly after
+     * the key. Only valid if hasInlineStorage is set.
+     *
+     * Layout: capacity (1 byte), length of the current inline value (1 byte;
+     * noInlineValue if the value isn't inline), followed by `capacity`
+     * bytes of value.
+     */
+    inline uint8_t* inlineStorage();
+    inline const uint8_t* inlineStorage() const;
+
+    /// Return the number of bytes used by the inline value storage.
+    size_t getInlineStorageSize() const {
+        if (!hasInlineStorage) {
+            return 0;
+        }
+        return inlineHeaderSize + inlineStorage()[inlineCapacityOffset];
+    }
+
+    /// Return the number of bytes required to store the value of itm inline.
+    static size_t getInlineStorageSize(const Item& itm);
+
+    /**
+     * Set the value of this item to the given Blob; copying it into the
+     * inline storage if it fits, otherwise referencing the Blob.
+     */
+    void assignValue(const value_t& newValue);
+
+    /**
+     * Return the value of this item as a Blob; allocating a Blob for an
+     * inline value.
+     */
+    value_t getValueAsBlob() const;
+
+    static const size_t inlineCapacityOffset = 0;
+    static const size_t inlineLengthOffset = 1;
+    static const size_t inlineHeaderSize = 2;
+    static const uint8_t noInlineValue = 0xff;
+
+    /**
+     * Get the lock expiry (alive items) / delete time (deleted items).
+     * Located in the trailing storage for StoredValue, and as a member of
+     * OrderedStoredValue.
+     */
+    inline rel_time_t& lockExpiryOrDeleteTime();
+    inline rel_time_t lockExpiryOrDeleteTime() const;
+
+    /// @return true if this is an OrderedStoredValue which has been marked
+    ///         stale.
+    inline bool isStale() const;
+
     /**
      * Logically mark this SV as deleted.
      * Implementation for StoredValue instances (dispatched to by del() based
@@ -667,11 +862,7 @@ protected:
     UniquePtr chain_next_or_replacement; // 8 bytes
     uint64_t           cas;            //!< CAS identifier.
     uint64_t           revSeqno;       //!< Revision id sequence number
-    int64_t            bySeqno;        //!< By sequence id number
-    /// For alive items: GETL lock expiration. For deleted items: delete time.
-    rel_time_t         lock_expiry_or_delete_time;
-    uint32_t           exptime;        //!< Expiration time of this item.
-    uint32_t           flags;          // 4 bytes
+    PackedInt48        bySeqno;        //!< By sequence id number (6 bytes)
     protocol_binary_datatype_t datatype; // 1 byte
     bool               _isDirty  :  1; // 1 bit
     bool               deleted   :  1;
@@ -679,20 +870,10 @@ protected:
     const bool isOrdered : 1; //!< Is this an instance of OrderedStoredValue?
     uint8_t            nru       :  2; //!< True if referenced since last sweep
     bool               resident :  1;
-    bool unused : 1; // Unused bits in first byte of bitfields.
-
-    // Indicates if a newer instance of the item is added. Logically part of
-    // OSV, but is physically located in SV as there are spare bytes here.
-    // Guarded by the SequenceList's writeLock.
-    // NOTE: As this is guarded by a different lock to the rest of the SV,
-    // it *must* be in a different byte than any other data not guarded by
-    // writeLock (Hence why this isn't in the same byte as _isDirty, deleted,
-    // newCacheItem etc). To achieve this std::atomic is used to ensure accesses
-    // are not "optimized" and merged with the previous byte. The thread-safety
-    // of std::atomic is not actually used/needed; we just need the no-merge
-    // guarantee.
-    // Note (2): Only 1 bit of this is currently used; rest is "spare".
-    std::atomic<bool> stale;
+    /// Is there inline value storage after the key? (Fixed at creation.)
+    const bool hasInlineStorage : 1;
+    uint32_t           exptime;        //!< Expiration time of this item.
+    uint32_t           flags;          // 4 bytes
 
     friend std::ostream& operator<<(std::ostream& os, const StoredValue& sv);
 };
@@ -763,7 +944,17 @@ public:
     bool operator==(const OrderedStoredValue& other) const;
 
     /// Return how many bytes are need to store Item as an OrderedStoredValue
-    static size_t getRequiredStorage(const Item& item);
+    static size_t getRequiredStorage(const Item& item,
+                                     size_t inlineValueMaxSize = 0);
+
+    /**
+     * Return the number of bytes of an OrderedStoredValue preceding its key.
+     * There are no trailing fields; lock expiry lives in the padding after
+     * seqno_hook.
+     */
+    static size_t getFixedSize() {
+        return sizeof(OrderedStoredValue);
+    }
 
     /**
      * Return the time the item was deleted. Only valid for deleted items.
@@ -793,13 +984,35 @@ protected:
      */
     inline void setDeletedTime(rel_time_t time);
 
+    /// For alive items: GETL lock expiration. For deleted items: delete time.
+    /// Guarded by the HashBucketLock, as per the rest of the StoredValue.
+    rel_time_t lock_expiry_or_delete_time;
+
+    // Indicates if a newer instance of the item is added.
+    // Guarded by the SequenceList's writeLock.
+    // NOTE: As this is guarded by a different lock to the rest of the OSV,
+    // it *must* be in a different byte than any other data not guarded by
+    // writeLock. To achieve this std::atomic is used to ensure accesses
+    // are not "optimized" and merged with the neighbouring bytes. The
+    // thread-safety of std::atomic is not actually used/needed; we just need
+    // the no-merge guarantee.
+    // Note (2): Only 1 bit of this is currently used; rest is "spare".
+    std::atomic<bool> stale;
+
 private:
     // Constructor. Private, as needs to be carefully created via
     // OrderedStoredValueFactory.
     OrderedStoredValue(const Item& itm,
                        UniquePtr n,
-                       EPStats& stats)
-        : StoredValue(itm, std::move(n), stats, /*isOrdered*/ true) {
+                       EPStats& stats,
+                       bool inlineValue)
+        : StoredValue(itm,
+                      std::move(n),
+                      stats,
+                      /*isOrdered*/ true,
+                      inlineValue),
+          lock_expiry_or_delete_time(0),
+          stale(false) {
     }
 
     // Copy Constructor. Private, as needs to be carefully created via
@@ -811,7 +1024,9 @@ private:
     OrderedStoredValue(const StoredValue& other,
                        UniquePtr n,
                        EPStats& stats)
-        : StoredValue(other, std::move(n), stats) {
+        : StoredValue(other, std::move(n), stats),
+          lock_expiry_or_delete_time(other.lockExpiryOrDeleteTime()),
+          stale(false) {
     }
 
     /* Do not allow assignment */
@@ -826,19 +1041,49 @@ private:
 };
 
 SerialisedDocKey* StoredValue::key() {
-    // key is located immediately following the object.
+    // key is located immediately following the object (and for StoredValue,
+    // after the trailing lock expiry).
     if (isOrdered) {
         return static_cast<OrderedStoredValue*>(this)->key();
     } else {
-        return reinterpret_cast<SerialisedDocKey*>(this + 1);
+        return reinterpret_cast<SerialisedDocKey*>(
+                reinterpret_cast<uint8_t*>(this) + getFixedSize());
     }
 }
 
+uint8_t* StoredValue::inlineStorage() {
+    auto* k = key();
+    return reinterpret_cast<uint8_t*>(k) + k->getObjectSize();
+}
+
+const uint8_t* StoredValue::inlineStorage() const {
+    return const_cast<StoredValue&>(*this).inlineStorage();
+}
+
+rel_time_t& StoredValue::lockExpiryOrDeleteTime() {
+    if (isOrdered) {
+        return static_cast<OrderedStoredValue*>(this)
+                ->lock_expiry_or_delete_time;
+    }
+    // Trailing field; directly after the fixed part. As sizeof(StoredValue)
+    // is a multiple of 8 this is suitably aligned.
+    return *reinterpret_cast<rel_time_t*>(this + 1);
+}
+
+rel_time_t StoredValue::lockExpiryOrDeleteTime() const {
+    return const_cast<StoredValue&>(*this).lockExpiryOrDeleteTime();
+}
+
+bool StoredValue::isStale() const {
+    return isOrdered && static_cast<const OrderedStoredValue*>(this)->stale;
+}
+
 size_t StoredValue::getObjectSize() const {
     // Size of fixed part of OrderedStoredValue or StoredValue, plus size of
     // (variable) key.
     if (isOrdered) {
-        return sizeof(OrderedStoredValue) + getKey().getObjectSize();
+        return OrderedStoredValue::getFixedSize() + getKey().getObjectSize() +
+               getInlineStorageSize();
     }
-    return sizeof(*this) + getKey().getObjectSize();
+    return getFixedSize() + getKey().getObjectSize() + getInlineStorageSize();
 }
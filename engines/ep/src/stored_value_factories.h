@@ -63,7 +63,13 @@ class StoredValueFactory : public AbstractStoredValueFactory {
 public:
     using value_type = StoredValue;
 
-    StoredValueFactory(EPStats& s) : stats(&s) {
+    /**
+     * @param s EPStats for created StoredValues
+     * @param inlineValueMaxSize Values up to this size are stored inline in
+     *        the StoredValue allocation (0 to disable).
+     */
+    StoredValueFactory(EPStats& s, size_t inlineValueMaxSize = 0)
+        : stats(&s), inlineValueMaxSize(inlineValueMaxSize) {
     }
 
     /**
@@ -74,11 +80,14 @@ public:
         // Allocate a buffer to store the StoredValue and any trailing bytes
         // that maybe required.
         return StoredValue::UniquePtr(
-                new (::operator new(StoredValue::getRequiredStorage(itm)))
+                new (::operator new(StoredValue::getRequiredStorage(
+                        itm, inlineValueMaxSize)))
                         StoredValue(itm,
                                     std::move(next),
                                     *stats,
-                                    /*isOrdered*/ false));
+                                    /*isOrdered*/ false,
+                                    StoredValue::canInlineValue(
+                                            itm, inlineValueMaxSize)));
     }
 
     StoredValue::UniquePtr copyStoredValue(const StoredValue& other,
@@ -88,6 +97,7 @@ public:
 
 private:
     EPStats* stats;
+    const size_t inlineValueMaxSize;
 };
 
 /**
@@ -97,7 +107,13 @@ class OrderedStoredValueFactory : public AbstractStoredValueFactory {
 public:
     using value_type = OrderedStoredValue;
 
-    OrderedStoredValueFactory(EPStats& s) : stats(&s) {
+    /**
+     * @param s EPStats for created OrderedStoredValues
+     * @param inlineValueMaxSize Values up to this size are stored inline in
+     *        the OrderedStoredValue allocation (0 to disable).
+     */
+    OrderedStoredValueFactory(EPStats& s, size_t inlineValueMaxSize = 0)
+        : stats(&s), inlineValueMaxSize(inlineValueMaxSize) {
     }
 
     /**
@@ -108,9 +124,13 @@ public:
         // Allocate a buffer to store the OrderStoredValue and any trailing
         // bytes required for the key.
         return StoredValue::UniquePtr(
-                new (::operator new(
-                        OrderedStoredValue::getRequiredStorage(itm)))
-                        OrderedStoredValue(itm, std::move(next), *stats));
+                new (::operator new(OrderedStoredValue::getRequiredStorage(
+                        itm, inlineValueMaxSize)))
+                        OrderedStoredValue(itm,
+                                           std::move(next),
+                                           *stats,
+                                           StoredValue::canInlineValue(
+                                                   itm, inlineValueMaxSize)));
     }
 
     /**
@@ -127,4 +147,5 @@ public:
 
 private:
     EPStats* stats;
+    const size_t inlineValueMaxSize;
 };
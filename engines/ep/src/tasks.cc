@@ -36,6 +36,21 @@ bool FlusherTask::run() {
     return flusher->step(this);
 }
 
+bool FlushPrepareTask::run() {
+    TRACE_EVENT0("ep-engine/task", "FlushPrepareTask");
+    // Sleep until the flusher has more vbuckets for us. Snooze before
+    // preparing so that a wake() while we're running isn't lost.
+    snooze(INT_MAX);
+
+    std::lock_guard<std::mutex> lh(link->mutex);
+    if (link->flusher == nullptr) {
+        // Cancelled; the flusher may no longer exist
+        return false;
+    }
+    link->flusher->prepareUpcoming();
+    return true;
+}
+
 CompactTask::CompactTask(EPBucket& bucket,
                          compaction_ctx c,
                          const void* ck,
@@ -63,6 +63,7 @@ TASK(PendingOpsNotification, NONIO_TASK_IDX, 0)
 TASK(NotifyHighPriorityReqTask, NONIO_TASK_IDX, 0)
 TASK(Processor, NONIO_TASK_IDX, 0)
 TASK(FlushAllTask, NONIO_TASK_IDX, 3)
+TASK(FlushPrepareTask, NONIO_TASK_IDX, 4)
 TASK(ConnNotifierCallback, NONIO_TASK_IDX, 5)
 TASK(ClosedUnrefCheckpointRemoverTask, NONIO_TASK_IDX, 6)
 TASK(ClosedUnrefCheckpointRemoverVisitorTask, NONIO_TASK_IDX, 6)
@@ -73,6 +74,7 @@ TASK(ExpiredItemPager, NONIO_TASK_IDX, 7)
 TASK(ItemPagerVisitor, NONIO_TASK_IDX, 7)
 TASK(ExpiredItemPagerVisitor, NONIO_TASK_IDX, 7)
 TASK(DefragmenterTask, NONIO_TASK_IDX, 7)
+TASK(ItemCompressorTask, NONIO_TASK_IDX, 7)
 TASK(EphTombstoneHTCleaner, NONIO_TASK_IDX, 7)
 TASK(EphTombstoneStaleItemDeleter, NONIO_TASK_IDX, 7)
 TASK(ConnManager, NONIO_TASK_IDX, 8)
@@ -24,6 +24,9 @@
 #include <platform/processclock.h>
 
 #include <array>
+#include <climits>
+#include <memory>
+#include <mutex>
 #include <string>
 
 class EPBucket;
@@ -65,6 +68,52 @@ private:
     std::string desc;
 };
 
+/**
+ * The link between a Flusher and its FlushPrepareTask. A cancelled task may
+ * still be run (or be running) after the Flusher has gone, so the task only
+ * calls into the Flusher while holding the mutex, and only while the
+ * Flusher hasn't detached itself (see Flusher::cancelPrepareTask).
+ */
+struct FlushPrepareLink {
+    explicit FlushPrepareLink(Flusher* f) : flusher(f) {
+    }
+
+    std::mutex mutex;
+    Flusher* flusher;
+};
+
+/**
+ * A task which takes the items of the vbuckets the flusher of a shard is
+ * about to flush from their checkpoints (and sorts them) while the flusher
+ * is busy writing; see flusher_pipeline_max_bytes.
+ */
+class FlushPrepareTask : public GlobalTask {
+public:
+    FlushPrepareTask(EventuallyPersistentEngine* e,
+                     std::shared_ptr<FlushPrepareLink> link,
+                     uint16_t shardid)
+        : GlobalTask(e, TaskId::FlushPrepareTask, INT_MAX, false),
+          link(std::move(link)) {
+        desc = "Preparing flush batches: shard " + std::to_string(shardid);
+    }
+
+    bool run();
+
+    cb::const_char_buffer getDescription() {
+        return desc;
+    }
+
+    std::chrono::microseconds maxExpectedDuration() {
+        // Only collects and sorts items in memory (up to
+        // flusher_pipeline_max_bytes of them).
+        return std::chrono::milliseconds(50);
+    }
+
+private:
+    std::shared_ptr<FlushPrepareLink> link;
+    std::string desc;
+};
+
 /**
  * A task for compacting a vbucket db file
  */
@@ -72,6 +72,16 @@ VBucketFilter VBucketFilter::filter_intersection(const VBucketFilter &other)
     return VBucketFilter(std::vector<uint16_t>(tmp.begin(), end));
 }
 
+/**
+ * @return true if an item's seqno can be stored in a StoredValue; i.e. it's
+ *         to be generated by the vBucket, or if supplied with the item
+ *         (replication, backfill) it fits in the (48-bit) bySeqno.
+ */
+static bool isStorableSeqno(GenerateBySeqno genBySeqno, uint64_t seqno) {
+    return genBySeqno == GenerateBySeqno::Yes ||
+           seqno <= uint64_t(PackedInt48::max);
+}
+
 static bool isRange(std::set<uint16_t>::const_iterator it,
                     const std::set<uint16_t>::const_iterator &end,
                     size_t &length)
@@ -151,7 +161,12 @@ VBucket::VBucket(id_type i,
                  int64_t hlcEpochSeqno,
                  bool mightContainXattrs,
                  const std::string& collectionsManifest)
-    : ht(st, std::move(valFact), config.getHtSize(), config.getHtLocks()),
+    : ht(st,
+         std::move(valFact),
+         config.getHtSize(),
+         config.getHtLocks(),
+         config.isHtIncrementalResize(),
+         config.isHtBucketTags()),
       checkpointManager(std::make_unique<CheckpointManager>(st,
                                                             i,
                                                             chkConfig,
@@ -234,6 +249,9 @@ VBucket::~VBucket() {
 
     stats.diskQueueSize.fetch_sub(dirtyQueueSize.load());
     stats.vbBackfillQueueSize.fetch_sub(getBackfillSize());
+    if (preparedFlush) {
+        stats.flusherPreparedBytes.fetch_sub(preparedFlush->bytes);
+    }
 
     // Clear out the bloomfilter(s)
     clearFilter();
@@ -415,18 +433,22 @@ void VBucket::addStat(const char *nm, const T &val, ADD_STAT add_stat,
     }
 }
 
-void VBucket::handlePreExpiry(const std::unique_lock<std::mutex>& hbl,
+void VBucket::handlePreExpiry(const std::unique_lock<cb::WriterLock>& hbl,
                               StoredValue& v) {
-    value_t value = v.getValue();
-    if (value) {
+    if (v.hasValue()) {
         std::unique_ptr<Item> itm(v.toItem(false, id));
-        item_info itm_info;
         EventuallyPersistentEngine* engine = ObjectRegistry::getCurrentEngine();
-        itm_info =
-                itm->toItemInfo(failovers->getLatestUUID(), getHLCEpochSeqno());
-        value_t new_val(Blob::Copy(*value));
+        value_t new_val(Blob::New(v.getValueData(), v.valuelen()));
         itm->setValue(new_val);
         itm->setDataType(v.getDatatype());
+        // The value may be held compressed in memory; pre_expiry operates
+        // on the uncompressed document.
+        if (!itm->decompressValue()) {
+            throw std::logic_error(
+                    "VBucket::handlePreExpiry: failed to inflate value");
+        }
+        item_info itm_info =
+                itm->toItemInfo(failovers->getLatestUUID(), getHLCEpochSeqno());
 
         SERVER_HANDLE_V1* sapi = engine->getServerApi();
         /* TODO: In order to minimize allocations, the callback needs to
@@ -984,6 +1006,10 @@ ENGINE_ERROR_CODE VBucket::replace(Item& itm,
 
 ENGINE_ERROR_CODE VBucket::addBackfillItem(Item& itm,
                                            const GenerateBySeqno genBySeqno) {
+    if (!isStorableSeqno(genBySeqno, itm.getBySeqno())) {
+        return ENGINE_ERANGE;
+    }
+
     auto hbl = ht.getLockedBucket(itm.getKey());
     StoredValue* v = ht.unlocked_find(itm.getKey(),
                                       hbl.getBucketNum(),
@@ -1054,6 +1080,10 @@ ENGINE_ERROR_CODE VBucket::setWithMeta(Item& itm,
                                        GenerateBySeqno genBySeqno,
                                        GenerateCas genCas,
                                        bool isReplication) {
+    if (!isStorableSeqno(genBySeqno, itm.getBySeqno())) {
+        return ENGINE_ERANGE;
+    }
+
     auto hbl = ht.getLockedBucket(itm.getKey());
     StoredValue* v = ht.unlocked_find(itm.getKey(),
                                       hbl.getBucketNum(),
@@ -1300,6 +1330,10 @@ ENGINE_ERROR_CODE VBucket::deleteWithMeta(const DocKey& key,
                                           GenerateCas generateCas,
                                           uint64_t bySeqno,
                                           bool isReplication) {
+    if (!isStorableSeqno(genBySeqno, bySeqno)) {
+        return ENGINE_ERANGE;
+    }
+
     auto hbl = ht.getLockedBucket(key);
     StoredValue* v = ht.unlocked_find(
             key, hbl.getBucketNum(), WantsDeleted::Yes, TrackReference::No);
@@ -1664,9 +1698,53 @@ GetValue VBucket::getInternal(const DocKey& key,
     const bool metadataOnly = (options & ALLOW_META_ONLY);
     const bool getDeletedValue = (options & GET_DELETED_VALUE);
     const bool bgFetchRequired = (options & QUEUE_BG_FETCH);
+
+    // Fast path: an alive, unexpired document which has everything the
+    // caller asked for in memory can be returned while holding the hash
+    // bucket lock in shared mode - concurrent readers of the same bucket
+    // don't serialise. Anything else (temp items, expiry, bg fetches...)
+    // may need to modify the HashTable so falls through to the exclusively
+    // locked path below.
+    TrackReference lockedTrackReference = trackReference;
+    {
+        auto res = ht.findForRead(key, trackReference, WantsDeleted::No);
+        const StoredValue* v = res.storedValue;
+        if (!v) {
+            // Nothing alive in memory. Unless the locked path has something
+            // to do for a deleted / temp item or a bg fetch, the answer is
+            // ENOENT - don't look the key up a second time.
+            if (!getDeletedValue && !(options & DELETE_TEMP) &&
+                (eviction == VALUE_ONLY || diskFlushAll)) {
+                return GetValue();
+            }
+        } else {
+            // findForRead has already recorded the reference.
+            lockedTrackReference = TrackReference::No;
+        }
+        if (v && !v->isTempItem() && (v->isResident() || metadataOnly) &&
+            !v->isExpired(ep_real_time())) {
+            const bool hideCas = (options & HIDE_LOCKED_CAS) &&
+                                 v->isLocked(ep_current_time());
+            std::unique_ptr<Item> item;
+            if (getKeyOnly == GetKeyOnly::Yes) {
+                item = v->toItemKeyOnly(getId());
+            } else {
+                item = v->toItem(hideCas, getId());
+            }
+            return GetValue(std::move(item),
+                            ENGINE_SUCCESS,
+                            v->getBySeqno(),
+                            !v->isResident(),
+                            v->getNRUValue());
+        }
+    }
+
     auto hbl = ht.getLockedBucket(key);
-    StoredValue* v = fetchValidValue(
-            hbl, key, WantsDeleted::Yes, trackReference, QueueExpired::Yes);
+    StoredValue* v = fetchValidValue(hbl,
+                                     key,
+                                     WantsDeleted::Yes,
+                                     lockedTrackReference,
+                                     QueueExpired::Yes);
     if (v) {
         // If SV is deleted and user didn't request deleted items then return
         // ENOENT.
@@ -1739,6 +1817,26 @@ GetValue VBucket::getInternal(const DocKey& key,
     }
 }
 
+void VBucket::populateMetaData(const StoredValue& v,
+                               ItemMetaData& metadata,
+                               uint32_t& deleted,
+                               uint8_t& datatype) const {
+    if (v.isTempDeletedItem() || v.isDeleted() ||
+        v.isExpired(ep_real_time())) {
+        deleted |= GET_META_ITEM_DELETED_FLAG;
+    }
+
+    if (v.isLocked(ep_current_time())) {
+        metadata.cas = static_cast<uint64_t>(-1);
+    } else {
+        metadata.cas = v.getCas();
+    }
+    metadata.flags = v.getFlags();
+    metadata.exptime = v.getExptime();
+    metadata.revSeqno = v.getRevSeqno();
+    datatype = v.getDatatype();
+}
+
 ENGINE_ERROR_CODE VBucket::getMetaData(const DocKey& key,
                                        const void* cookie,
                                        EventuallyPersistentEngine& engine,
@@ -1747,6 +1845,19 @@ ENGINE_ERROR_CODE VBucket::getMetaData(const DocKey& key,
                                        uint32_t& deleted,
                                        uint8_t& datatype) {
     deleted = 0;
+
+    // Fast path: metadata of non-temporary items can be read under the shared
+    // hash bucket lock.
+    {
+        auto res = ht.findForRead(key, TrackReference::No, WantsDeleted::Yes);
+        const StoredValue* v = res.storedValue;
+        if (v && !v->isTempItem()) {
+            stats.numOpsGetMeta++;
+            populateMetaData(*v, metadata, deleted, datatype);
+            return ENGINE_SUCCESS;
+        }
+    }
+
     auto hbl = ht.getLockedBucket(key);
     StoredValue* v = ht.unlocked_find(
             key, hbl.getBucketNum(), WantsDeleted::Yes, TrackReference::No);
@@ -1761,21 +1872,7 @@ ENGINE_ERROR_CODE VBucket::getMetaData(const DocKey& key,
             metadata.cas = v->getCas();
             return ENGINE_KEY_ENOENT;
         } else {
-            if (v->isTempDeletedItem() || v->isDeleted() ||
-                v->isExpired(ep_real_time())) {
-                deleted |= GET_META_ITEM_DELETED_FLAG;
-            }
-
-            if (v->isLocked(ep_current_time())) {
-                metadata.cas = static_cast<uint64_t>(-1);
-            } else {
-                metadata.cas = v->getCas();
-            }
-            metadata.flags = v->getFlags();
-            metadata.exptime = v->getExptime();
-            metadata.revSeqno = v->getRevSeqno();
-            datatype = v->getDatatype();
-
+            populateMetaData(*v, metadata, deleted, datatype);
             return ENGINE_SUCCESS;
         }
     } else {
@@ -2348,8 +2445,8 @@ VBucket::processExpiredItem(const HashTable::HashBucketLock& hbl,
      * but functionally correct and for performance reasons
      * only the system xattrs need to be stored.
      */
-    value_t value = v.getValue();
-    bool onlyMarkDeleted = value && mcbp::datatype::is_xattr(v.getDatatype());
+    bool onlyMarkDeleted =
+            v.hasValue() && mcbp::datatype::is_xattr(v.getDatatype());
     v.setRevSeqno(v.getRevSeqno() + 1);
     VBNotifyCtx notifyCtx;
     StoredValue* newSv;
@@ -2577,11 +2674,22 @@ std::unique_ptr<Item> VBucket::pruneXattrDocument(
         StoredValue& v, const ItemMetaData& itemMeta) {
     // Need to take a copy of the value, prune it, and add it back
 
-    // Create work-space document
-    std::vector<uint8_t> workspace(v.getValue()->valueSize());
-    std::copy_n(v.getValue()->getData(),
-                v.getValue()->valueSize(),
-                workspace.begin());
+    // Create work-space document (inflating it if held compressed)
+    std::vector<uint8_t> workspace;
+    if (mcbp::datatype::is_snappy(v.getDatatype())) {
+        cb::compression::Buffer inflated;
+        if (!cb::compression::inflate(cb::compression::Algorithm::Snappy,
+                                      v.getValueData(),
+                                      v.valuelen(),
+                                      inflated)) {
+            throw std::logic_error(
+                    "VBucket::pruneXattrDocument: failed to inflate value");
+        }
+        workspace.assign(inflated.data.get(),
+                         inflated.data.get() + inflated.len);
+    } else {
+        workspace.assign(v.getValueData(), v.getValueData() + v.valuelen());
+    }
 
     // Now attach to the XATTRs in the document
     auto sz = cb::xattr::get_body_offset(
@@ -348,7 +348,7 @@ public:
      *
      * @param v the stored value
      */
-    void handlePreExpiry(const std::unique_lock<std::mutex>& hbl,
+    void handlePreExpiry(const std::unique_lock<cb::WriterLock>& hbl,
                          StoredValue& v);
 
     bool addPendingOp(const void *cookie);
@@ -1128,6 +1128,22 @@ public:
     static void setMutationMemoryThreshold(double memThreshold);
 
     std::queue<queued_item> rejectQueue;
+
+    /**
+     * Items taken from the persistence cursor (and sorted) ahead of the next
+     * flush of this vbucket; see KVBucket::prepareFlushBatch. Like the
+     * rejectQueue, only accessed with the vbucket locked.
+     */
+    struct PreparedFlush {
+        std::vector<queued_item> items;
+        snapshot_range_t range;
+        // CheckpointManager::getNumClears() when the items were taken
+        uint64_t numClears;
+        // Sum of the sizes of the items
+        size_t bytes;
+    };
+    std::unique_ptr<PreparedFlush> preparedFlush;
+
     std::unique_ptr<FailoverTable> failovers;
 
     std::atomic<size_t>  opsCreate;
@@ -1430,6 +1446,21 @@ private:
 
     void decrDirtyQueuePendingWrites(size_t decrementBy);
 
+    /**
+     * Fill in the GET_META response fields from the given (non-temporary)
+     * StoredValue. Requires the hash bucket to be locked (shared or
+     * exclusive).
+     *
+     * @param v StoredValue to read the metadata from
+     * @param[out] metadata meta information returned to the caller
+     * @param[out] deleted GET_META_ITEM_DELETED_FLAG set if deleted / expired
+     * @param[out] datatype the datatype of the item
+     */
+    void populateMetaData(const StoredValue& v,
+                          ItemMetaData& metadata,
+                          uint32_t& deleted,
+                          uint8_t& datatype) const;
+
     /**
      * Updates an existing StoredValue in in-memory data structures like HT.
      * Assumes that HT bucket lock is grabbed.
@@ -6273,6 +6273,9 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
         },
         {"dcp",
             {
+                "ep_dcp_compression_cache_bytes_saved",
+                "ep_dcp_compression_cache_hits",
+                "ep_dcp_compression_cache_misses",
                 "ep_dcp_count",
                 "ep_dcp_dead_conn_count",
                 "ep_dcp_items_remaining",
@@ -6294,10 +6297,15 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "vb_0:mem_size",
                 "vb_0:mem_size_counted",
                 "vb_0:min_depth",
+                "vb_0:read_only_finds",
                 "vb_0:reported",
+                "vb_0:resize_fe_migrations",
+                "vb_0:resize_migrated_items",
+                "vb_0:resize_pending_buckets",
                 "vb_0:resized",
                 "vb_0:size",
-                "vb_0:state"
+                "vb_0:state",
+                "vb_0:tag_filtered_lookups"
             }},
         {"vbucket",
             {
@@ -6381,26 +6389,32 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
         {"checkpoint",
             {
                 "vb_0:last_closed_checkpoint_id",
+                "vb_0:mem_freed_by_expel",
                 "vb_0:mem_usage",
                 "vb_0:num_checkpoint_items",
                 "vb_0:num_checkpoints",
                 "vb_0:num_conn_cursors",
+                "vb_0:num_items_expelled",
                 "vb_0:num_items_for_persistence",
                 "vb_0:num_open_checkpoint_items",
                 "vb_0:open_checkpoint_id",
+                "vb_0:queue_lock_contended",
                 "vb_0:state"
             }
         },
         {"checkpoint 0",
             {
                 "vb_0:last_closed_checkpoint_id",
+                "vb_0:mem_freed_by_expel",
                 "vb_0:mem_usage",
                 "vb_0:num_checkpoint_items",
                 "vb_0:num_checkpoints",
                 "vb_0:num_conn_cursors",
+                "vb_0:num_items_expelled",
                 "vb_0:num_items_for_persistence",
                 "vb_0:num_open_checkpoint_items",
                 "vb_0:open_checkpoint_id",
+                "vb_0:queue_lock_contended",
                 "vb_0:state"
             }
         },
@@ -6439,6 +6453,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_collections_prototype_enabled",
                 "ep_compaction_exp_mem_threshold",
                 "ep_compaction_write_queue_cap",
+                "ep_compression_mode",
                 "ep_config_file",
                 "ep_conflict_resolution_type",
                 "ep_connection_manager_interval",
@@ -6448,6 +6463,8 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_data_traffic_enabled",
                 "ep_dbname",
                 "ep_dcp_backfill_byte_limit",
+                "ep_dcp_backfill_concurrency",
+                "ep_dcp_backfill_read_rate",
                 "ep_dcp_conn_buffer_size",
                 "ep_dcp_conn_buffer_size_aggr_mem_threshold",
                 "ep_dcp_conn_buffer_size_aggressive_perc",
@@ -6478,15 +6495,23 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_exp_pager_stime",
                 "ep_failpartialwarmup",
                 "ep_flushall_enabled",
+                "ep_flusher_commit_batch_size",
+                "ep_flusher_commit_window",
+                "ep_flusher_pipeline_max_bytes",
                 "ep_fsync_after_every_n_bytes_written",
                 "ep_getl_default_timeout",
                 "ep_getl_max_timeout",
                 "ep_hlc_drift_ahead_threshold_us",
                 "ep_hlc_drift_behind_threshold_us",
+                "ep_ht_bucket_tags",
+                "ep_ht_incremental_resize",
+                "ep_ht_inline_value_max_size",
                 "ep_ht_locks",
                 "ep_ht_resize_interval",
                 "ep_ht_size",
                 "ep_initfile",
+                "ep_item_compressor_chunk_duration",
+                "ep_item_compressor_interval",
                 "ep_item_num_based_new_chk",
                 "ep_keep_closed_chks",
                 "ep_max_checkpoints",
@@ -6506,6 +6531,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_mem_low_wat",
                 "ep_mem_merge_bytes_threshold",
                 "ep_mem_merge_count_threshold",
+                "ep_min_compression_ratio",
                 "ep_mutation_mem_threshold",
                 "ep_num_auxio_threads",
                 "ep_num_nonio_threads",
@@ -6615,6 +6641,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_collections_prototype_enabled",
                 "ep_compaction_exp_mem_threshold",
                 "ep_compaction_write_queue_cap",
+                "ep_compression_mode",
                 "ep_config_file",
                 "ep_conflict_resolution_type",
                 "ep_connection_manager_interval",
@@ -6627,6 +6654,8 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_data_traffic_enabled",
                 "ep_dbname",
                 "ep_dcp_backfill_byte_limit",
+                "ep_dcp_backfill_concurrency",
+                "ep_dcp_backfill_read_rate",
                 "ep_dcp_conn_buffer_size",
                 "ep_dcp_conn_buffer_size_aggr_mem_threshold",
                 "ep_dcp_conn_buffer_size_aggressive_perc",
@@ -6671,11 +6700,17 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_flush_all",
                 "ep_flush_duration_total",
                 "ep_flushall_enabled",
+                "ep_flusher_commit_batch_size",
+                "ep_flusher_commit_window",
+                "ep_flusher_pipeline_max_bytes",
                 "ep_fsync_after_every_n_bytes_written",
                 "ep_getl_default_timeout",
                 "ep_getl_max_timeout",
                 "ep_hlc_drift_ahead_threshold_us",
                 "ep_hlc_drift_behind_threshold_us",
+                "ep_ht_bucket_tags",
+                "ep_ht_incremental_resize",
+                "ep_ht_inline_value_max_size",
                 "ep_ht_locks",
                 "ep_ht_resize_interval",
                 "ep_ht_size",
@@ -6685,8 +6720,13 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_io_compaction_write_bytes",
                 "ep_io_total_read_bytes",
                 "ep_io_total_write_bytes",
+                "ep_item_compressor_chunk_duration",
+                "ep_item_compressor_interval",
+                "ep_item_compressor_num_compressed",
+                "ep_item_compressor_num_visited",
                 "ep_item_num",
                 "ep_item_num_based_new_chk",
+                "ep_items_expelled_from_checkpoints",
                 "ep_items_rm_from_checkpoints",
                 "ep_keep_closed_chks",
                 "ep_kv_size",
@@ -6704,6 +6744,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_max_size",
                 "ep_max_threads",
                 "ep_max_vbuckets",
+                "ep_mem_freed_by_checkpoint_item_expel",
                 "ep_mem_high_wat",
                 "ep_mem_high_wat_percent",
                 "ep_mem_low_wat",
@@ -6713,6 +6754,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_mem_tracker_enabled",
                 "ep_meta_data_disk",
                 "ep_meta_data_memory",
+                "ep_min_compression_ratio",
                 "ep_mlog_compactor_runs",
                 "ep_mutation_mem_threshold",
                 "ep_num_access_scanner_runs",
@@ -6890,6 +6932,9 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
         eng_stats.insert(eng_stats.end(),
                          std::initializer_list<std::string>{"ep_flusher_state",
                                                             "ep_flusher_todo"});
+        eng_stats.insert(eng_stats.end(),
+                         {"ep_flusher_prepared_bytes",
+                          "ep_flusher_prepared_flushes"});
         eng_stats.insert(eng_stats.end(),
                          {"ep_commit_num",
                           "ep_commit_time",
@@ -6911,6 +6956,11 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                           "ep_alog_resident_ratio_threshold",
                           "ep_alog_sleep_time",
                           "ep_alog_task_time",
+                          "ep_bg_fetcher_concurrency",
+                          "ep_couchstore_block_cache_size",
+                          "ep_couchstore_db_handle_cache_size",
+                          "ep_couchstore_direct_reads",
+                          "ep_couchstore_scan_read_ahead_size",
                           "ep_item_eviction_policy"});
 
         // 'diskinfo and 'diskinfo detail' keys should be present now.
@@ -6943,6 +6993,11 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                              "ep_alog_resident_ratio_threshold",
                              "ep_alog_sleep_time",
                              "ep_alog_task_time",
+                             "ep_bg_fetcher_concurrency",
+                             "ep_couchstore_block_cache_size",
+                             "ep_couchstore_db_handle_cache_size",
+                             "ep_couchstore_direct_reads",
+                             "ep_couchstore_scan_read_ahead_size",
                              "ep_item_eviction_policy"});
     }
 
@@ -7015,6 +7070,9 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
     // for variable keys:
     std::map<std::string, std::vector<std::regex> > statsPatterns{
             {"hash", {std::regex{"vb_0:histo_\\d+,\\d+"}}},
+            {"checkpoint", {std::regex{"vb_0:queue_lock_wait_\\d+,\\d+"}}},
+            {"checkpoint 0",
+             {std::regex{"vb_0:queue_lock_wait_\\d+,\\d+"}}},
             {"kvstore",
              {std::regex{"ro_[0-3]:readTime_\\d+,\\d+"},
               std::regex{"ro_[0-3]:readSize_\\d+,\\d+"},
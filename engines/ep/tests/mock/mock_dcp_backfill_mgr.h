@@ -19,6 +19,8 @@
 
 #include "dcp/backfill-manager.h"
 
+#include <vector>
+
 /*
  * Mock of the BackfillManager class.  Wraps the real BackfillManager, but
  * exposes normally protected methods publically for test purposes.
@@ -36,4 +38,32 @@ public:
     bool getBackfillBufferFullStatus() {
         return buffer.full;
     }
+
+    size_t getNumManagerTasks() {
+        LockHolder lh(lock);
+        return managerTasks.size();
+    }
+
+    std::vector<uint16_t> getActiveBackfillVBuckets() {
+        LockHolder lh(lock);
+        std::vector<uint16_t> vbids;
+        for (const auto& backfill : activeBackfills) {
+            vbids.push_back(backfill->getVBucketId());
+        }
+        return vbids;
+    }
+
+    std::vector<uint16_t> getPendingBackfillVBuckets() {
+        LockHolder lh(lock);
+        std::vector<uint16_t> vbids;
+        for (const auto& backfill : pendingBackfills) {
+            vbids.push_back(backfill->getVBucketId());
+        }
+        return vbids;
+    }
+
+    void public_moveToActiveQueue() {
+        LockHolder lh(lock);
+        moveToActiveQueue();
+    }
 };
@@ -122,8 +122,8 @@ public:
         return *filter;
     }
 
-    void bytesForceRead(size_t bytes) {
-        backfillMgr->bytesForceRead(bytes);
+    void bytesForceRead(uint16_t vbid, size_t bytes) {
+        backfillMgr->bytesForceRead(vbid, bytes);
     }
 
     BackfillManager& getBFM() {
@@ -0,0 +1,203 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "ep_types.h"
+#include "item.h"
+#include "kvstore.h"
+
+#include <vector>
+
+/**
+ * A KVStore which doesn't store anything. set() and del() remember the
+ * callback and commit() invokes them as if the writes had succeeded; the
+ * vbucket states are only cached in memory.
+ *
+ * Used to measure the cost of the flusher itself (independent of the
+ * underlying storage).
+ */
+class MockKVStore : public KVStore {
+public:
+    explicit MockKVStore(KVStoreConfig& config) : KVStore(config) {
+        cachedVBStates.resize(config.getMaxVBuckets());
+        cachedDocCount.assign(config.getMaxVBuckets(),
+                              Couchbase::RelaxedAtomic<size_t>(0));
+    }
+
+    void reset(uint16_t vbid) override {
+        cachedVBStates[vbid].reset();
+    }
+
+    bool begin() override {
+        return true;
+    }
+
+    bool commit(const Item* collectionsManifest) override {
+        for (auto* cb : setCallbacks) {
+            mutation_result result{1, true};
+            cb->callback(result);
+        }
+        setCallbacks.clear();
+        for (auto* cb : delCallbacks) {
+            int result = 1;
+            cb->callback(result);
+        }
+        delCallbacks.clear();
+        return true;
+    }
+
+    void rollback() override {
+        setCallbacks.clear();
+        delCallbacks.clear();
+    }
+
+    StorageProperties getStorageProperties() override {
+        return StorageProperties(StorageProperties::EfficientVBDump::Yes,
+                                 StorageProperties::EfficientVBDeletion::Yes,
+                                 StorageProperties::PersistedDeletion::No,
+                                 StorageProperties::EfficientGet::No,
+                                 StorageProperties::ConcurrentWriteCompact::No);
+    }
+
+    void set(const Item& item, Callback<mutation_result>& cb) override {
+        setCallbacks.push_back(&cb);
+    }
+
+    GetValue get(const DocKey& key,
+                 uint16_t vb,
+                 bool fetchDelete = false) override {
+        return GetValue(nullptr, ENGINE_KEY_ENOENT);
+    }
+
+    GetValue getWithHeader(void* dbHandle,
+                           const DocKey& key,
+                           uint16_t vb,
+                           GetMetaOnly getMetaOnly,
+                           bool fetchDelete = false) override {
+        return GetValue(nullptr, ENGINE_KEY_ENOENT);
+    }
+
+    uint16_t getNumVbsPerFile() override {
+        return 1;
+    }
+
+    void del(const Item& itm, Callback<int>& cb) override {
+        delCallbacks.push_back(&cb);
+    }
+
+    void delVBucket(uint16_t vbucket, uint64_t fileRev) override {
+    }
+
+    std::vector<vbucket_state*> listPersistedVbuckets() override {
+        std::vector<vbucket_state*> ret;
+        for (auto& state : cachedVBStates) {
+            ret.push_back(state.get());
+        }
+        return ret;
+    }
+
+    bool snapshotVBucket(uint16_t vbucketId,
+                         const vbucket_state& vbstate,
+                         VBStatePersist options) override {
+        updateCachedVBState(vbucketId, vbstate);
+        return true;
+    }
+
+    bool compactDB(compaction_ctx* c) override {
+        return true;
+    }
+
+    uint16_t getDBFileId(
+            const protocol_binary_request_compact_db& req) override {
+        return 0;
+    }
+
+    vbucket_state* getVBucketState(uint16_t vbid) override {
+        return cachedVBStates[vbid].get();
+    }
+
+    size_t getNumPersistedDeletes(uint16_t vbid) override {
+        return 0;
+    }
+
+    DBFileInfo getDbFileInfo(uint16_t dbFileId) override {
+        return DBFileInfo();
+    }
+
+    DBFileInfo getAggrDbFileInfo() override {
+        return DBFileInfo();
+    }
+
+    size_t getItemCount(uint16_t vbid) override {
+        return cachedDocCount[vbid];
+    }
+
+    RollbackResult rollback(uint16_t vbid,
+                            uint64_t rollbackseqno,
+                            std::shared_ptr<RollbackCB> cb) override {
+        return RollbackResult(false, 0, 0, 0);
+    }
+
+    void pendingTasks() override {
+    }
+
+    ENGINE_ERROR_CODE getAllKeys(
+            uint16_t vbid,
+            const DocKey start_key,
+            uint32_t count,
+            std::shared_ptr<Callback<const DocKey&>> cb) override {
+        return ENGINE_SUCCESS;
+    }
+
+    ScanContext* initScanContext(std::shared_ptr<Callback<GetValue>> cb,
+                                 std::shared_ptr<Callback<CacheLookup>> cl,
+                                 uint16_t vbid,
+                                 uint64_t startSeqno,
+                                 DocumentFilter options,
+                                 ValueFilter valOptions) override {
+        return nullptr;
+    }
+
+    scan_error_t scan(ScanContext* sctx) override {
+        return scan_failed;
+    }
+
+    void destroyScanContext(ScanContext* ctx) override {
+    }
+
+    bool persistCollectionsManifestItem(uint16_t vbid,
+                                        const Item& manifestItem) override {
+        return true;
+    }
+
+    std::string getCollectionsManifest(uint16_t vbid) override {
+        return {};
+    }
+
+    void incrementRevision(uint16_t vbid) override {
+    }
+
+    uint64_t prepareToDelete(uint16_t vbid) override {
+        return 0;
+    }
+
+private:
+    // The callbacks of the writes since the last commit
+    std::vector<Callback<mutation_result>*> setCallbacks;
+    std::vector<Callback<int>*> delCallbacks;
+};
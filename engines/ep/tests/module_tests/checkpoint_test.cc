@@ -18,11 +18,13 @@
 #include "config.h"
 
 #include <algorithm>
+#include <map>
 #include <set>
 #include <thread>
 #include <vector>
 
 #include "checkpoint.h"
+#include "checkpoint_arena.h"
 #include "configuration.h"
 #include "failover-table.h"
 #include "item_pager.h"
@@ -460,6 +462,262 @@ TYPED_TEST(CheckpointTest, OneOpenCkpt) {
                                      HasOperation(queue_op::mutation)));
 }
 
+// Check that an item de-duplicated by a later mutation of the same key is
+// released by queueDirty (rather than kept alive by the checkpoint).
+TYPED_TEST(CheckpointTest, DedupReleasesReplacedItem) {
+    queued_item qi(new Item(makeStoredDocKey("key1"),
+                            this->vbucket->getId(),
+                            queue_op::mutation,
+                            /*revSeq*/ 20,
+                            /*bySeq*/ 0));
+    EXPECT_TRUE(this->manager->queueDirty(*this->vbucket,
+                                          qi,
+                                          GenerateBySeqno::Yes,
+                                          GenerateCas::Yes,
+                                          /*preLinkDocCtx*/ nullptr));
+    // Referenced by us and the checkpoint.
+    EXPECT_EQ(2, qi.refCount());
+
+    queued_item qi2(new Item(makeStoredDocKey("key1"),
+                             this->vbucket->getId(),
+                             queue_op::mutation,
+                             /*revSeq*/ 21,
+                             /*bySeq*/ 0));
+    EXPECT_FALSE(this->manager->queueDirty(*this->vbucket,
+                                           qi2,
+                                           GenerateBySeqno::Yes,
+                                           GenerateCas::Yes,
+                                           /*preLinkDocCtx*/ nullptr));
+    EXPECT_EQ(1, qi.refCount());
+    EXPECT_EQ(2, qi2.refCount());
+}
+
+// Check the queueLock contention stats are reported.
+TYPED_TEST(CheckpointTest, QueueLockStats) {
+    std::map<std::string, std::string> stats;
+    auto addStat = [](const char* key,
+                      const uint16_t klen,
+                      const char* val,
+                      const uint32_t vlen,
+                      const void* cookie) {
+        auto* map = reinterpret_cast<std::map<std::string, std::string>*>(
+                const_cast<void*>(cookie));
+        (*map)[std::string(key, klen)] = std::string(val, vlen);
+    };
+
+    ASSERT_TRUE(this->queueNewItem("key"));
+    this->manager->addStats(addStat, &stats);
+
+    // Nothing else is using the manager so the lock can't have been
+    // contended.
+    ASSERT_EQ(1, stats.count("vb_0:queue_lock_contended"));
+    EXPECT_EQ("0", stats["vb_0:queue_lock_contended"]);
+}
+
+// Check that reading the closed checkpoints (which is done without holding
+// the queueLock) returns their items in order, and moves the cursor into the
+// open checkpoint so that the closed ones can be removed.
+TYPED_TEST(CheckpointTest, ReadClosedCheckpoints) {
+    for (int ckpt = 0; ckpt < 3; ++ckpt) {
+        for (int ii = 0; ii < 2; ++ii) {
+            ASSERT_TRUE(this->queueNewItem("key" +
+                                           std::to_string(ckpt * 2 + ii)));
+        }
+        this->manager->createNewCheckpoint();
+    }
+    ASSERT_TRUE(this->queueNewItem("key6"));
+    ASSERT_EQ(4, this->manager->getNumCheckpoints());
+
+    // Three closed checkpoints of start, 2 mutations and end, then the
+    // start and mutation of the open checkpoint.
+    std::vector<queued_item> items;
+    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    ASSERT_EQ(3 * 4 + 2, items.size());
+    int64_t seqno = 1000;
+    for (const auto& qi : items) {
+        if (qi->getOperation() == queue_op::mutation) {
+            EXPECT_EQ(++seqno, qi->getBySeqno());
+        }
+    }
+    EXPECT_EQ(1007, seqno);
+    EXPECT_EQ(0,
+              this->manager->getNumItemsForCursor(
+                      CheckpointManager::pCursorName));
+
+    this->manager->itemsPersisted(1007);
+    bool newOpenCheckpointCreated;
+    EXPECT_EQ(6,
+              this->manager->removeClosedUnrefCheckpoints(
+                      *this->vbucket, newOpenCheckpointCreated));
+    EXPECT_EQ(1, this->manager->getNumCheckpoints());
+
+    ASSERT_TRUE(this->queueNewItem("key7"));
+    items.clear();
+    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    ASSERT_EQ(1, items.size());
+    EXPECT_EQ(1008, items.front()->getBySeqno());
+}
+
+// Check that items which every cursor has processed can be expelled from
+// the open checkpoint, and that a cursor registered in the expelled range
+// is told to backfill.
+TYPED_TEST(CheckpointTest, ExpelCheckpointItems) {
+    for (int ii = 0; ii < 10; ++ii) {
+        ASSERT_TRUE(this->queueNewItem("key" + std::to_string(ii)));
+    }
+    ASSERT_EQ(10, this->manager->getNumOpenChkItems());
+
+    // Persistence cursor processes (and persists) everything; the DCP cursor
+    // has processed up to (and including) seqno 1005.
+    std::vector<queued_item> items;
+    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    this->manager->itemsPersisted(1010);
+    const std::string dcpCursor(DCP_CURSOR_PREFIX + std::to_string(1));
+    this->manager->registerCursorBySeqno(
+            dcpCursor, 1005, MustSendCheckpointEnd::NO);
+
+    // Items 1001..1004 are before both cursors. (Drop our references to the
+    // items so that expelling them releases their memory.)
+    items.clear();
+    const auto result = this->manager->expelUnreferencedCheckpointItems();
+    EXPECT_EQ(4, result.count);
+    EXPECT_LT(0, result.memory);
+    EXPECT_EQ(6, this->manager->getNumOpenChkItems());
+    EXPECT_EQ(0,
+              this->manager->getNumItemsForCursor(
+                      CheckpointManager::pCursorName));
+    EXPECT_EQ(5, this->manager->getNumItemsForCursor(dcpCursor));
+
+    // Nothing more to expel until the DCP cursor moves.
+    EXPECT_EQ(0, this->manager->expelUnreferencedCheckpointItems().count);
+
+    items.clear();
+    this->manager->getAllItemsForCursor(dcpCursor, items);
+    ASSERT_EQ(5, items.size());
+    EXPECT_EQ(1006, items.front()->getBySeqno());
+
+    // A new cursor wanting an expelled seqno starts at the first item still
+    // in memory, and must backfill the rest.
+    auto reg = this->manager->registerCursorBySeqno(
+            DCP_CURSOR_PREFIX + std::to_string(2),
+            1002,
+            MustSendCheckpointEnd::NO);
+    EXPECT_EQ(1005, reg.first);
+    EXPECT_TRUE(reg.second);
+
+    // Likewise for a cursor wanting a seqno before the checkpoint.
+    reg = this->manager->registerCursorBySeqno(
+            DCP_CURSOR_PREFIX + std::to_string(3),
+            1000,
+            MustSendCheckpointEnd::NO);
+    EXPECT_EQ(1005, reg.first);
+    EXPECT_TRUE(reg.second);
+
+    // An expelled key is a new item (not a de-duplication) if mutated again.
+    EXPECT_TRUE(this->queueNewItem("key1"));
+    EXPECT_EQ(7, this->manager->getNumOpenChkItems());
+}
+
+// Check that items the persistence cursor has read into a flush batch aren't
+// expelled until the batch is committed, so that a cursor registered in the
+// meantime doesn't need to backfill them (they aren't on disk yet).
+TYPED_TEST(CheckpointTest, ExpelOnlyPersistedItems) {
+    for (int ii = 0; ii < 10; ++ii) {
+        ASSERT_TRUE(this->queueNewItem("key" + std::to_string(ii)));
+    }
+
+    // The persistence cursor reads everything, but the flush hasn't been
+    // committed; the DCP cursor has processed up to seqno 1005.
+    std::vector<queued_item> items;
+    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    this->manager->registerCursorBySeqno(DCP_CURSOR_PREFIX + std::to_string(1),
+                                         1005,
+                                         MustSendCheckpointEnd::NO);
+    EXPECT_EQ(0, this->manager->expelUnreferencedCheckpointItems().count);
+
+    // A new cursor can still start at the seqno it asked for.
+    auto reg = this->manager->registerCursorBySeqno(
+            DCP_CURSOR_PREFIX + std::to_string(2),
+            1002,
+            MustSendCheckpointEnd::NO);
+    EXPECT_EQ(1003, reg.first);
+    EXPECT_FALSE(reg.second);
+    this->manager->removeCursor(DCP_CURSOR_PREFIX + std::to_string(2));
+
+    // Once the flush has persisted up to seqno 1003 those items (and only
+    // those) can be expelled.
+    this->manager->itemsPersisted(1003);
+    EXPECT_EQ(3, this->manager->expelUnreferencedCheckpointItems().count);
+    reg = this->manager->registerCursorBySeqno(
+            DCP_CURSOR_PREFIX + std::to_string(3),
+            1000,
+            MustSendCheckpointEnd::NO);
+    EXPECT_EQ(1004, reg.first);
+    EXPECT_TRUE(reg.second);
+}
+
+// Compressed values are cached for the items in the checkpoints, and are
+// released once the items leave them.
+TYPED_TEST(CheckpointTest, CompressedValueCache) {
+    for (int ii = 0; ii < 3; ++ii) {
+        ASSERT_TRUE(this->queueNewItem("key" + std::to_string(ii)));
+    }
+    const auto memUsage = this->manager->getMemoryUsage();
+
+    // A copy of the item with the given seqno, as a DCP producer sends it
+    const std::string value(1000, 'x');
+    auto makeItem = [&value](int64_t seqno) {
+        Item item(makeStoredDocKey("key"),
+                  0,
+                  0,
+                  value.data(),
+                  value.size(),
+                  PROTOCOL_BINARY_RAW_BYTES,
+                  0,
+                  seqno);
+        return item;
+    };
+    using Result = CheckpointManager::CompressResult;
+
+    auto first = makeItem(1002);
+    EXPECT_EQ(Result::Compressed, this->manager->compressItemValue(first));
+    ASSERT_TRUE(mcbp::datatype::is_snappy(first.getDataType()));
+    EXPECT_EQ(memUsage + first.getValue()->getSize(),
+              this->manager->getMemoryUsage());
+
+    auto second = makeItem(1002);
+    EXPECT_EQ(Result::Cached, this->manager->compressItemValue(second));
+    EXPECT_EQ(first.getValue().get(), second.getValue().get());
+    EXPECT_TRUE(mcbp::datatype::is_snappy(second.getDataType()));
+
+    // Seqnos from before the checkpoints (e.g. backfilled from disk) aren't
+    // cached.
+    for (int ii = 0; ii < 2; ++ii) {
+        auto backfilled = makeItem(1);
+        EXPECT_EQ(Result::Compressed,
+                  this->manager->compressItemValue(backfilled));
+    }
+
+    // De-duplicating the item releases its compressed value.
+    ASSERT_FALSE(this->queueNewItem("key1"));
+    EXPECT_EQ(memUsage, this->manager->getMemoryUsage());
+    auto deduped = makeItem(1002);
+    EXPECT_EQ(Result::Compressed, this->manager->compressItemValue(deduped));
+
+    // As does expelling it.
+    auto expelled = makeItem(1001);
+    EXPECT_EQ(Result::Compressed, this->manager->compressItemValue(expelled));
+    std::vector<queued_item> items;
+    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    this->manager->itemsPersisted(1003);
+    this->manager->registerCursorBySeqno(DCP_CURSOR_PREFIX + std::to_string(1),
+                                         1003,
+                                         MustSendCheckpointEnd::NO);
+    EXPECT_EQ(1, this->manager->expelUnreferencedCheckpointItems().count);
+    expelled = makeItem(1001);
+    EXPECT_EQ(Result::Compressed, this->manager->compressItemValue(expelled));
+}
+
 // Test that enqueuing a single delete works.
 TYPED_TEST(CheckpointTest, Delete) {
     // Enqueue a single delete.
@@ -703,7 +961,7 @@ TYPED_TEST(CheckpointTest, CursorOffsetOnCheckpointClose) {
     // Tell Checkpoint manager the items have been persisted, so it advances
     // pCursorPreCheckpointId, which will allow us to remove the closed
     // unreferenced checkpoints.
-    this->manager->itemsPersisted();
+    this->manager->itemsPersisted(1003);
 
     // Both previous checkpoints are unreferenced. Close them. This will
     // cause the offset of this cursor to be recalculated.
@@ -1206,3 +1464,59 @@ TYPED_TEST(CheckpointTest,
     // Test - second item (duplicate key) should return false.
     EXPECT_FALSE(this->queueNewItem("key"));
 }
+
+// Check that the CheckpointArena reuses freed allocations of the same size
+// and grows its blocks as more memory is needed.
+TEST(CheckpointArenaTest, ReuseAndGrowth) {
+    CheckpointArena arena;
+    EXPECT_EQ(0, arena.getBlocksSize());
+
+    void* first = arena.allocate(48);
+    EXPECT_EQ(CheckpointArena::MinBlockSize, arena.getBlocksSize());
+    arena.deallocate(first, 48);
+    EXPECT_EQ(first, arena.allocate(48));
+
+    // Fill up more than the first block; it should be followed by a
+    // larger one.
+    std::vector<void*> ptrs;
+    for (size_t ii = 0; ii < CheckpointArena::MinBlockSize / 48 + 1; ++ii) {
+        ptrs.push_back(arena.allocate(48));
+    }
+    EXPECT_EQ(3 * CheckpointArena::MinBlockSize, arena.getBlocksSize());
+
+    // Large allocations don't come from the arena
+    void* large = arena.allocate(CheckpointArena::MaxAllocSize + 1);
+    EXPECT_EQ(3 * CheckpointArena::MinBlockSize, arena.getBlocksSize());
+    arena.deallocate(large, CheckpointArena::MaxAllocSize + 1);
+}
+
+// Check the containers of a checkpoint work on top of the arena; in
+// particular that de-duplication (erasing from the middle of the queue)
+// and re-queuing behave.
+TEST(CheckpointArenaTest, Queue) {
+    CheckpointArena arena;
+    CheckpointQueue queue{CheckpointQueue::allocator_type(arena)};
+    checkpoint_index index{checkpoint_index::allocator_type(arena)};
+
+    for (int ii = 0; ii < 1000; ++ii) {
+        const auto key = makeStoredDocKey("key" + std::to_string(ii % 10));
+        queued_item qi(new Item(key, 0, 0, "value", 5));
+        qi->setBySeqno(ii + 1);
+        queue.push_back(qi);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            queue.erase(it->second.position);
+        }
+        index[key] = {std::prev(queue.end()), ii + 1};
+    }
+
+    EXPECT_EQ(10, queue.size());
+    EXPECT_EQ(10, index.size());
+    int64_t seqno = 990;
+    for (const auto& qi : queue) {
+        EXPECT_EQ(++seqno, qi->getBySeqno());
+    }
+    // Nodes freed by the de-duplication are reused so we shouldn't need
+    // more than the first block or two.
+    EXPECT_LE(arena.getBlocksSize(), 3 * CheckpointArena::MinBlockSize);
+}
@@ -243,6 +243,9 @@ TEST_P(StreamTest, test_streamIsKeyOnlyTrue) {
     destroy_dcp_stream();
 }
 
+extern std::string dcp_last_key;
+extern std::string dcp_last_value;
+
 ENGINE_ERROR_CODE mock_mutation_return_engine_e2big(const void* cookie,
                                                     uint32_t opaque,
                                                     item* itm,
@@ -254,8 +257,7 @@ ENGINE_ERROR_CODE mock_mutation_return_engine_e2big(const void* cookie,
                                                     uint16_t nmeta,
                                                     uint8_t nru,
                                                     uint8_t collection_len) {
-    Item* item = reinterpret_cast<Item*>(itm);
-    delete item;
+    releaseServerItem(reinterpret_cast<Item*>(itm));
     return ENGINE_E2BIG;
 }
 
@@ -370,6 +372,120 @@ TEST_P(StreamTest, test_verifyProducerCompressionStats) {
     destroy_dcp_stream();
 }
 
+/*
+ * Test that the value one producer compresses is cached and sent by a
+ * second producer streaming the same item, rather than compressed again.
+ */
+TEST_P(StreamTest, CompressedValueSharedBetweenProducers) {
+    VBucketPtr vb = engine->getKVBucket()->getVBucket(vbid);
+    setup_dcp_stream();
+    mock_dcp_producer_t producer2 = new MockDcpProducer(*engine,
+                                                        /*cookie*/ nullptr,
+                                                        "test_producer2",
+                                                        /*flags*/ 0,
+                                                        {/*no json*/},
+                                                        /*startTask*/ true);
+
+    const std::string compressibleValue(1000, 'x');
+    store_item(vbid, "key1", compressibleValue.c_str());
+
+    auto producers = get_dcp_producers(reinterpret_cast<ENGINE_HANDLE*>(engine),
+                                       reinterpret_cast<ENGINE_HANDLE_V1*>(engine));
+    auto& stats = engine->getEpStats();
+
+    // Stream the item (after its snapshot marker) from the given producer.
+    auto streamItem = [this, &vb, &producers](MockDcpProducer& p) {
+        std::string compressCtrlMsg("enable_value_compression");
+        std::string compressCtrlValue("true");
+        ASSERT_EQ(ENGINE_SUCCESS,
+                  p.control(0,
+                            compressCtrlMsg.c_str(),
+                            compressCtrlMsg.size(),
+                            compressCtrlValue.c_str(),
+                            compressCtrlValue.size()));
+
+        uint64_t rollbackSeqno;
+        ASSERT_EQ(ENGINE_SUCCESS,
+                  p.streamRequest(/*flags*/ 0,
+                                  /*opaque*/ 0,
+                                  /*vbucket*/ 0,
+                                  /*start_seqno*/ 0,
+                                  /*end_seqno*/ ~0,
+                                  /*vb_uuid*/ 0,
+                                  /*snap_start*/ 0,
+                                  /*snap_end*/ ~0,
+                                  &rollbackSeqno,
+                                  StreamTest::fakeDcpAddFailoverLog));
+        p.notifySeqnoAvailable(vbid, vb->getHighSeqno());
+        ASSERT_EQ(ENGINE_SUCCESS, p.step(producers.get()));
+        ASSERT_EQ(1, p.getCheckpointSnapshotTask().queueSize());
+        p.getCheckpointSnapshotTask().run();
+
+        EXPECT_EQ(ENGINE_WANT_MORE, p.step(producers.get()));
+        EXPECT_EQ(ENGINE_WANT_MORE, p.step(producers.get()));
+        EXPECT_EQ(1, p.getItemsSent());
+        EXPECT_LT(p.getTotalBytesSent(), p.getTotalUncompressedDataSize());
+    };
+
+    // The first producer compresses the value...
+    streamItem(*producer);
+    EXPECT_EQ(0, stats.dcpCompressionCacheHits);
+    EXPECT_EQ(1, stats.dcpCompressionCacheMisses);
+    const auto bytesSent = producer->getTotalBytesSent();
+
+    // ... and the second sends the cached one.
+    streamItem(*producer2);
+    EXPECT_EQ(1, stats.dcpCompressionCacheHits);
+    EXPECT_EQ(1, stats.dcpCompressionCacheMisses);
+    EXPECT_EQ(compressibleValue.size(), stats.dcpCompressionCacheBytesSaved);
+    EXPECT_EQ(bytesSent, producer2->getTotalBytesSent());
+
+    producer2->closeStream(/*opaque*/ 0, vbid);
+    producer2->clearCheckpointProcessorTaskQueues();
+    destroy_dcp_stream();
+}
+
+/*
+ * Test that items are only copied before sending if they need to be pruned,
+ * and otherwise the stream's own item is sent.
+ */
+TEST_P(StreamTest, ItemCopiedOnlyIfModified) {
+    VBucketPtr vb = engine->getKVBucket()->getVBucket(vbid);
+    setup_dcp_stream();
+    store_item(vbid, "key1", "value1");
+    store_item(vbid, "key2", "value2");
+    auto producers = get_dcp_producers(reinterpret_cast<ENGINE_HANDLE*>(engine),
+                                       reinterpret_cast<ENGINE_HANDLE_V1*>(engine));
+    uint64_t rollbackSeqno;
+    ASSERT_EQ(ENGINE_SUCCESS,
+              producer->streamRequest(/*flags*/0,
+                                      /*opaque*/0,
+                                      /*vbucket*/0,
+                                      /*start_seqno*/0,
+                                      /*end_seqno*/~0,
+                                      /*vb_uuid*/0,
+                                      /*snap_start*/0,
+                                      /*snap_end*/~0,
+                                      &rollbackSeqno,
+                                      StreamTest::fakeDcpAddFailoverLog));
+    producer->notifySeqnoAvailable(vbid, vb->getHighSeqno());
+    ASSERT_EQ(ENGINE_SUCCESS, producer->step(producers.get()));
+    producer->getCheckpointSnapshotTask().run();
+
+    // Snapshot marker, then the mutations; which are sent unchanged.
+    EXPECT_EQ(ENGINE_WANT_MORE, producer->step(producers.get()));
+    EXPECT_EQ(ENGINE_WANT_MORE, producer->step(producers.get()));
+    EXPECT_EQ("key1", dcp_last_key);
+    EXPECT_EQ("value1", dcp_last_value);
+    EXPECT_EQ(ENGINE_WANT_MORE, producer->step(producers.get()));
+    EXPECT_EQ("key2", dcp_last_key);
+    EXPECT_EQ("value2", dcp_last_value);
+    EXPECT_EQ(0, producer->getItemCopies());
+    EXPECT_EQ(2, producer->getItemCopiesAvoided());
+
+    destroy_dcp_stream();
+}
+
 /*
  * Test to verify the number of items and the total bytes sent
  * by the producer under normal and error conditions
@@ -823,6 +939,66 @@ TEST_P(StreamTest, BackfillOnly) {
                items are read correctly */
 }
 
+/* Items expelled from the open checkpoint must be backfilled by a stream
+   which starts before them */
+TEST_P(StreamTest, BackfillExpelledItems) {
+    if (bucketType == "ephemeral") {
+        /* Relies on the items being persisted (and the persistence cursor
+           moving past them) before they can be expelled */
+        return;
+    }
+
+    const int numItems = 5;
+    for (int i = 0; i < numItems; ++i) {
+        store_item(vbid, "key" + std::to_string(i), "value");
+    }
+
+    /* Wait for the items to be persisted */
+    auto vb = engine->getVBucket(vbid);
+    auto& ckpt_mgr = *vb->checkpointManager;
+    {
+        std::chrono::microseconds uSleepTime(128);
+        while (ckpt_mgr.getNumItemsForCursor(CheckpointManager::pCursorName) !=
+               0) {
+            uSleepTime = decayingSleep(uSleepTime);
+        }
+    }
+
+    /* Another cursor has processed up to seqno 3, so seqnos 1 and 2 can be
+       expelled (once the flush reading them has been committed) */
+    const std::string otherCursor("other_cursor");
+    ckpt_mgr.registerCursorBySeqno(otherCursor, 3, MustSendCheckpointEnd::NO);
+    const int numExpelled = 2;
+    {
+        int expelled = 0;
+        std::chrono::microseconds uSleepTime(128);
+        while ((expelled += ckpt_mgr.expelUnreferencedCheckpointItems()
+                                    .count) < numExpelled) {
+            uSleepTime = decayingSleep(uSleepTime);
+        }
+        ASSERT_EQ(numExpelled, expelled);
+    }
+
+    /* A stream from seqno 0 must backfill the expelled items from disk */
+    setup_dcp_stream();
+    MockActiveStream* mock_stream =
+            static_cast<MockActiveStream*>(stream.get());
+    ExecutorPool::get()->setNumAuxIO(1);
+    mock_stream->transitionStateToBackfilling();
+    ASSERT_TRUE(mock_stream->isBackfilling());
+
+    {
+        std::chrono::microseconds uSleepTime(128);
+        while (numExpelled != mock_stream->getLastReadSeqno()) {
+            uSleepTime = decayingSleep(uSleepTime);
+        }
+    }
+    EXPECT_EQ(numExpelled, mock_stream->getNumBackfillItems());
+
+    ckpt_mgr.removeCursor(otherCursor);
+    destroy_dcp_stream();
+}
+
 /* Stream items from a DCP backfill with very small backfill buffer.
    However small the backfill buffer is, backfill must not stop, it must
    proceed to completion eventually */
@@ -1223,7 +1399,7 @@ TEST_P(CacheCallbackTest, CacheCallback_engine_enomem) {
      * to one.
      */
     dynamic_cast<MockDcpProducer*>(producer.get())->setBackfillBufferSize(0);
-    dynamic_cast<MockDcpProducer*>(producer.get())->bytesForceRead(1);
+    dynamic_cast<MockDcpProducer*>(producer.get())->bytesForceRead(vbid, 1);
 
     MockActiveStream* mockStream = static_cast<MockActiveStream*>(stream.get());
     active_stream_t activeStream(mockStream);
@@ -2467,6 +2643,31 @@ TEST_P(ConnectionTest,
     processConsumerMutationsNearThreshold(false);
 }
 
+/* Checks that backfills may only read from disk while within the node-wide
+   dcp_backfill_read_rate */
+TEST_P(ConnectionTest, BackfillReadBudget) {
+    auto& connMap = engine->getDcpConnMap();
+
+    // Unlimited by default
+    EXPECT_EQ(0, connMap.getBackfillReadRate());
+    connMap.recordBackfillBytesRead(1024 * 1024);
+    EXPECT_TRUE(connMap.isBackfillReadBudgetAvailable());
+
+    engine->getConfiguration().setDcpBackfillReadRate(1000);
+    EXPECT_EQ(1000, connMap.getBackfillReadRate());
+    EXPECT_TRUE(connMap.isBackfillReadBudgetAvailable());
+
+    // The budget may be overdrawn by the scan in progress, but then no more
+    // scans may start until it's topped up again.
+    connMap.recordBackfillBytesRead(999);
+    EXPECT_TRUE(connMap.isBackfillReadBudgetAvailable());
+    connMap.recordBackfillBytesRead(1000 * 60);
+    EXPECT_FALSE(connMap.isBackfillReadBudgetAvailable());
+
+    engine->getConfiguration().setDcpBackfillReadRate(0);
+    EXPECT_TRUE(connMap.isBackfillReadBudgetAvailable());
+}
+
 // Test cases which run in both Full and Value eviction
 INSTANTIATE_TEST_CASE_P(PersistentAndEphemeral,
                         StreamTest,
@@ -141,7 +141,7 @@ TEST_F(SingleThreadedEphemeralBackfillTest, RangeIteratorVBDeleteRaceTest) {
      * iterator, but DCPBackfillMemoryBuffered::scan /not/ complete the
      * backfill immediately - we pretend the buffer is full. This is
      * reset in manager->backfill() */
-    manager.bytesCheckAndRead(byteLimit + 1);
+    manager.bytesCheckAndRead(vbid, byteLimit + 1);
 
     // Directly run backfill once, to create the range iterator
     manager.backfill();
@@ -27,6 +27,9 @@
 #include "ep_time.h"
 #include "evp_store_test.h"
 #include "fakes/fake_executorpool.h"
+#include "flusher.h"
+#include "item_compressor.h"
+#include "kvshard.h"
 #include "programs/engine_testapp/mock_server.h"
 #include "taskqueue.h"
 #include "tests/module_tests/test_helpers.h"
@@ -980,6 +983,201 @@ TEST_F(SingleThreadedEPBucketTest, MB19892_BackfillNotDeleted) {
                       dummy_dcp_add_failover_cb));
 }
 
+/*
+ * Fixture for the BackfillManager tests: four active vbuckets, each with a
+ * single item on disk, and a producer to create the streams from.
+ */
+class BackfillManagerTest : public SingleThreadedEPBucketTest {
+protected:
+    void SetUp() override {
+        SingleThreadedEPBucketTest::SetUp();
+        for (uint16_t id = 0; id < numVBuckets; ++id) {
+            setVBucketStateAndRunPersistTask(id, vbucket_state_active);
+            store_item(id, makeStoredDocKey("key"), "value");
+            flush_vbucket_to_disk(id);
+        }
+        producer = new MockDcpProducer(*engine,
+                                       cookie,
+                                       "test_producer",
+                                       /*flags*/ 0,
+                                       {/*no json*/},
+                                       /*startTask*/ false);
+    }
+
+    void TearDown() override {
+        producer.reset();
+        SingleThreadedEPBucketTest::TearDown();
+    }
+
+    /// Schedule a backfill of the item on the given vbucket
+    void schedule(BackfillManager& manager, uint16_t id, uint32_t flags = 0) {
+        auto vb = store->getVBucket(id);
+        ASSERT_NE(nullptr, vb.get());
+        active_stream_t stream = new MockActiveStream(
+                static_cast<EventuallyPersistentEngine*>(engine.get()),
+                producer,
+                flags,
+                /*opaque*/ 0,
+                *vb,
+                /*st_seqno*/ 0,
+                /*en_seqno*/ ~0,
+                /*vb_uuid*/ 0xabcd,
+                /*snap_start_seqno*/ 0,
+                /*snap_end_seqno*/ ~0);
+        manager.schedule(*vb, stream, 1, 1);
+    }
+
+    static const uint16_t numVBuckets = 4;
+    mock_dcp_producer_t producer;
+};
+
+/*
+ * Test that the manager adds a task for each backfill it may run
+ * concurrently, and that the tasks go away once the backfills are done.
+ */
+TEST_F(BackfillManagerTest, TaskPerConcurrentBackfill) {
+    engine->getConfiguration().setDcpBackfillConcurrency(2);
+    auto manager = std::make_shared<MockDcpBackfillManager>(*engine);
+    auto& lpAuxioQ = *task_executor->getLpTaskQ()[AUXIO_TASK_IDX];
+
+    schedule(*manager, 0);
+    EXPECT_EQ(1, manager->getNumManagerTasks());
+    schedule(*manager, 1);
+    EXPECT_EQ(2, manager->getNumManagerTasks());
+    // No more than dcp_backfill_concurrency tasks
+    schedule(*manager, 2);
+    EXPECT_EQ(2, manager->getNumManagerTasks());
+    EXPECT_EQ(2, lpAuxioQ.getFutureQueueSize());
+
+    // Each backfill is created, scanned and completed (the streams aren't
+    // backfilling, so they don't take any of the items); then the tasks find
+    // there's nothing left to do and exit.
+    for (int ii = 0; ii < 30 && lpAuxioQ.getFutureQueueSize() > 0; ++ii) {
+        runNextTask(lpAuxioQ, "Backfilling items for a DCP Connection");
+        EXPECT_LE(manager->getNumManagerTasks(), size_t(2));
+    }
+    EXPECT_EQ(0, lpAuxioQ.getFutureQueueSize());
+    EXPECT_EQ(0, manager->getNumManagerTasks());
+    EXPECT_TRUE(manager->getActiveBackfillVBuckets().empty());
+}
+
+/*
+ * Test that backfills of takeover streams go ahead of the others, in both
+ * the pending and the active queue.
+ */
+TEST_F(BackfillManagerTest, TakeoverBackfillsGoFirst) {
+    auto& connMap = engine->getDcpConnMap();
+    auto manager = std::make_shared<MockDcpBackfillManager>(*engine);
+
+    // Allow only a single active/snoozing backfill, so the rest are pending
+    connMap.updateMaxActiveSnoozingBackfills(0);
+    schedule(*manager, 0);
+    schedule(*manager, 1);
+    schedule(*manager, 2, DCP_ADD_STREAM_FLAG_TAKEOVER);
+    EXPECT_EQ(std::vector<uint16_t>({0}),
+              manager->getActiveBackfillVBuckets());
+    EXPECT_EQ(std::vector<uint16_t>({2, 1}),
+              manager->getPendingBackfillVBuckets());
+
+    connMap.updateMaxActiveSnoozingBackfills(
+            engine->getEpStats().getMaxDataSize());
+    manager->public_moveToActiveQueue();
+    EXPECT_EQ(std::vector<uint16_t>({2, 0, 1}),
+              manager->getActiveBackfillVBuckets());
+    EXPECT_TRUE(manager->getPendingBackfillVBuckets().empty());
+
+    schedule(*manager, 3, DCP_ADD_STREAM_FLAG_TAKEOVER);
+    EXPECT_EQ(std::vector<uint16_t>({3, 2, 0, 1}),
+              manager->getActiveBackfillVBuckets());
+}
+
+/*
+ * Test that each vbucket's backfill has a scan buffer of its own.
+ */
+TEST_F(BackfillManagerTest, ScanBufferPerVBucket) {
+    auto manager = std::make_shared<MockDcpBackfillManager>(*engine);
+    const size_t scanLimit = engine->getConfiguration().getDcpScanByteLimit();
+    manager->setBackfillBufferSize(scanLimit * 2);
+
+    EXPECT_TRUE(manager->bytesCheckAndRead(0, scanLimit));
+    // vb:0's scan buffer is full ...
+    EXPECT_FALSE(manager->bytesCheckAndRead(0, 1));
+    // ... but not vb:1's
+    EXPECT_TRUE(manager->bytesCheckAndRead(1, 1));
+    EXPECT_FALSE(manager->getBackfillBufferFullStatus());
+
+    manager->bytesSent(scanLimit + 1);
+}
+
+/*
+ * Test that backfill_num_running counts the backfills being run.
+ */
+TEST_F(BackfillManagerTest, NumRunningStat) {
+    auto vb = store->getVBucket(vbid);
+    ASSERT_NE(nullptr, vb.get());
+    auto& ckpt_mgr = *vb->checkpointManager;
+
+    // Remove the checkpoint holding the item, so the stream has to
+    // backfill it from disk
+    ckpt_mgr.createNewCheckpoint();
+    bool new_ckpt_created;
+    ASSERT_EQ(1, ckpt_mgr.removeClosedUnrefCheckpoints(*vb, new_ckpt_created));
+
+    auto numRunning = [this]() {
+        std::map<std::string, std::string> stats;
+        producer->getBFM().addStats(
+                producer,
+                [](const char* key,
+                   const uint16_t klen,
+                   const char* val,
+                   const uint32_t vlen,
+                   const void* cookie) {
+                    auto& stats = *reinterpret_cast<
+                            std::map<std::string, std::string>*>(
+                            const_cast<void*>(cookie));
+                    stats[std::string(key, klen)] = std::string(val, vlen);
+                },
+                &stats);
+        return stats.at(producer->getName() + ":backfill_num_running");
+    };
+
+    stream_t stream = new MockActiveStreamWithOverloadedRegisterCursor(
+            static_cast<EventuallyPersistentEngine*>(engine.get()),
+            producer,
+            /*flags*/ 0,
+            /*opaque*/ 0,
+            *vb,
+            /*st_seqno*/ 0,
+            /*en_seqno*/ ~0,
+            /*vb_uuid*/ 0xabcd,
+            /*snap_start_seqno*/ 0,
+            /*snap_end_seqno*/ ~0,
+            IncludeValue::Yes,
+            IncludeXattrs::Yes);
+    auto* mock_stream =
+            static_cast<MockActiveStreamWithOverloadedRegisterCursor*>(
+                    stream.get());
+
+    // The cursor is registered when the backfill has found what it is going
+    // to read from disk, so while the backfill is being run.
+    std::vector<std::string> running;
+    mock_stream->setCallbackBeforeRegisterCursor(
+            [&running, &numRunning]() { running.push_back(numRunning()); });
+    mock_stream->setCallbackAfterRegisterCursor([]() {});
+
+    EXPECT_EQ("0", numRunning());
+    mock_stream->transitionStateToBackfilling();
+    // schedule the backfill
+    mock_stream->next();
+
+    auto& lpAuxioQ = *task_executor->getLpTaskQ()[AUXIO_TASK_IDX];
+    runNextTask(lpAuxioQ, "Backfilling items for a DCP Connection");
+    EXPECT_EQ(std::vector<std::string>({"1"}), running);
+    EXPECT_EQ("0", numRunning());
+
+    producer->closeAllStreams();
+}
+
 /*
  * Test that the DCP processor returns a 'yield' return code when
  * working on a large enough buffer size.
@@ -1364,6 +1562,80 @@ TEST_F(SingleThreadedEPBucketTest, stream_from_active_vbucket_only) {
     }
 }
 
+/*
+ * Check the ItemCompressorTask is only scheduled once compression_mode is
+ * "active", that it compresses values in memory, and that it stops when the
+ * mode is changed back.
+ */
+TEST_F(SingleThreadedEPBucketTest, ItemCompressorTask) {
+    auto& lpNonioQ = *task_executor->getLpTaskQ()[NONIO_TASK_IDX];
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+
+    // Not scheduled in the default (passive) mode.
+    const auto numTasks = lpNonioQ.getFutureQueueSize();
+    engine->getConfiguration().setCompressionMode("active");
+    EXPECT_EQ(numTasks + 1, lpNonioQ.getFutureQueueSize());
+
+    auto key = makeStoredDocKey("key");
+    const std::string value(1000, 'x');
+    store_item(vbid, key, value);
+
+    ItemCompressorTask task(engine.get(), engine->getEpStats());
+    EXPECT_TRUE(task.run());
+    EXPECT_EQ(1, engine->getEpStats().compressorNumCompressed);
+
+    auto vb = store->getVBucket(vbid);
+    {
+        auto hbl = vb->ht.getLockedBucket(key);
+        StoredValue* v = vb->ht.unlocked_find(
+                key, hbl.getBucketNum(), WantsDeleted::No, TrackReference::No);
+        ASSERT_NE(nullptr, v);
+        EXPECT_TRUE(mcbp::datatype::is_snappy(v->getDatatype()));
+        EXPECT_LT(v->valuelen(), value.size());
+    }
+
+    // The compressed value matches the (uncompressed) copy on disk.
+    auto diskItem = make_item(vbid, key, value);
+    EXPECT_EQ("valid", store->validateKey(key, vbid, diskItem));
+
+    engine->getConfiguration().setCompressionMode("passive");
+    EXPECT_FALSE(task.run());
+}
+
+/*
+ * Check that with compression_mode "off" a Snappy value received via
+ * SetWithMeta (as from a DCP consumer) is stored uncompressed.
+ */
+TEST_F(SingleThreadedEPBucketTest, CompressionModeOffInflatesWithMeta) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+    engine->getConfiguration().setCompressionMode("off");
+
+    auto key = makeStoredDocKey("key");
+    const std::string value(1000, 'x');
+    auto item = make_item(vbid, key, value);
+    item.setCas();
+    ASSERT_TRUE(item.compressValue());
+    ASSERT_TRUE(mcbp::datatype::is_snappy(item.getDataType()));
+
+    uint64_t seqno;
+    ASSERT_EQ(ENGINE_SUCCESS,
+              store->setWithMeta(item,
+                                 0,
+                                 &seqno,
+                                 cookie,
+                                 {vbucket_state_active},
+                                 CheckConflicts::No,
+                                 /*allowExisting*/ false));
+
+    auto vb = store->getVBucket(vbid);
+    auto hbl = vb->ht.getLockedBucket(key);
+    StoredValue* v = vb->ht.unlocked_find(
+            key, hbl.getBucketNum(), WantsDeleted::No, TrackReference::No);
+    ASSERT_NE(nullptr, v);
+    EXPECT_FALSE(mcbp::datatype::is_snappy(v->getDatatype()));
+    EXPECT_EQ(value.size(), v->valuelen());
+}
+
 TEST_F(SingleThreadedEPBucketTest, pre_expiry_xattrs) {
     auto& kvbucket = *engine->getKVBucket();
 
@@ -1421,6 +1693,85 @@ TEST_F(SingleThreadedEPBucketTest, pre_expiry_xattrs) {
 
 }
 
+/**
+ * Test fixture for the flusher's group commit (flusher_commit_window /
+ * flusher_commit_batch_size). Uses a single shard, so that there's a single
+ * flusher task, which the tests drive by hand.
+ */
+class FlusherGroupCommitTest : public SingleThreadedEPBucketTest {
+protected:
+    void SetUp() override {
+        config_string +=
+                "max_num_shards=1;flusher_commit_window=60000;"
+                "flusher_commit_batch_size=3";
+        SingleThreadedEPBucketTest::SetUp();
+        setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+
+        // The first run of the flusher task just initialises it
+        runFlusher();
+    }
+
+    /// Run one step of the flusher (i.e. flush at most one vbucket)
+    void runFlusher() {
+        store->getVBucket(vbid)->getShard()->getFlusher()->wake();
+        runNextTask(*task_executor->getLpTaskQ()[WRITER_TASK_IDX],
+                    "Running a flusher loop: shard 0");
+    }
+};
+
+// A vbucket with fewer outstanding items than the batch size is held back,
+// and flushed as soon as it has a full batch.
+TEST_F(FlusherGroupCommitTest, FlushOnceBatchIsFull) {
+    auto& stats = engine->getEpStats();
+    const size_t persisted = stats.totalPersisted;
+    store_item(vbid, makeStoredDocKey("key1"), "value");
+    runFlusher();
+    EXPECT_EQ(1, stats.diskQueueSize);
+
+    store_item(vbid, makeStoredDocKey("key2"), "value");
+    runFlusher();
+    EXPECT_EQ(2, stats.diskQueueSize);
+
+    store_item(vbid, makeStoredDocKey("key3"), "value");
+    runFlusher();
+    EXPECT_EQ(0, stats.diskQueueSize);
+    EXPECT_EQ(persisted + 3, stats.totalPersisted);
+}
+
+// A held back vbucket is flushed once the window has passed, without any
+// further mutations to prompt the flusher; changes to the window take effect
+// on the running flusher.
+TEST_F(FlusherGroupCommitTest, FlushDeferredOnceWindowPasses) {
+    auto& stats = engine->getEpStats();
+    const size_t persisted = stats.totalPersisted;
+    store_item(vbid, makeStoredDocKey("key1"), "value");
+    runFlusher();
+    EXPECT_EQ(1, stats.diskQueueSize);
+
+    // Still within the window
+    runFlusher();
+    EXPECT_EQ(1, stats.diskQueueSize);
+
+    engine->getConfiguration().setFlusherCommitWindow(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    runFlusher();
+    EXPECT_EQ(0, stats.diskQueueSize);
+    EXPECT_EQ(persisted + 1, stats.totalPersisted);
+}
+
+// Disabling group commit flushes held back vbuckets straight away.
+TEST_F(FlusherGroupCommitTest, DisableFlushesDeferred) {
+    auto& stats = engine->getEpStats();
+    store_item(vbid, makeStoredDocKey("key1"), "value");
+    runFlusher();
+    EXPECT_EQ(1, stats.diskQueueSize);
+
+    engine->getConfiguration().setFlusherCommitWindow(0);
+    store_item(vbid, makeStoredDocKey("key2"), "value");
+    runFlusher();
+    EXPECT_EQ(0, stats.diskQueueSize);
+}
+
 class WarmupTest : public SingleThreadedKVBucketTest {
 public:
     /**
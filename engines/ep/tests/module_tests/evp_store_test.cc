@@ -31,6 +31,7 @@
 #include "checkpoint_remover.h"
 #include "dcp/dcpconnmap.h"
 #include "flusher.h"
+#include "tasks.h"
 #include "tests/mock/mock_global_task.h"
 #include "tests/module_tests/test_helpers.h"
 #include "vbucketdeletiontask.h"
@@ -82,6 +83,55 @@ TEST_F(EPBucketTest, test_mb20751_deadlock_on_disconnect_delete) {
     frontend_thread_handling_disconnect.join();
 }
 
+// Check that items prepared ahead of a flush (by the flush pipeline) are
+// written by the next flush of the vbucket, and that items queued after the
+// preparation are left for the following flush.
+TEST_F(EPBucketTest, FlushPreparedItems) {
+    store->setVBucketState(vbid, vbucket_state_active, false);
+    store_item(vbid, makeStoredDocKey("key1"), "value");
+    store_item(vbid, makeStoredDocKey("key2"), "value");
+
+    auto& stats = engine->getEpStats();
+    EXPECT_NE(0, store->prepareFlushBatch(vbid));
+    EXPECT_NE(0, stats.flusherPreparedBytes);
+    // Already prepared
+    EXPECT_EQ(0, store->prepareFlushBatch(vbid));
+
+    store_item(vbid, makeStoredDocKey("key3"), "value");
+
+    flush_vbucket_to_disk(vbid, 2);
+    EXPECT_EQ(1, stats.flusherPreparedFlushes);
+    EXPECT_EQ(0, stats.flusherPreparedBytes);
+
+    flush_vbucket_to_disk(vbid, 1);
+    EXPECT_EQ(1, stats.flusherPreparedFlushes);
+    EXPECT_EQ(0, stats.diskQueueSize);
+}
+
+// Check that prepared items are dropped if the vbucket's checkpoints are
+// cleared (e.g. by a rollback) before they're flushed.
+TEST_F(EPBucketTest, FlushPreparedItemsAfterClear) {
+    store->setVBucketState(vbid, vbucket_state_active, false);
+    store_item(vbid, makeStoredDocKey("key1"), "value");
+    EXPECT_NE(0, store->prepareFlushBatch(vbid));
+
+    auto vb = store->getVBucket(vbid);
+    vb->checkpointManager->clear(*vb, vb->getHighSeqno());
+
+    flush_vbucket_to_disk(vbid, 0);
+    EXPECT_EQ(0, engine->getEpStats().flusherPreparedFlushes);
+    EXPECT_EQ(0, engine->getEpStats().flusherPreparedBytes);
+}
+
+// A FlushPrepareTask which runs after its flusher has detached it (i.e. was
+// cancelled, and the flusher may be gone) must not call into the flusher,
+// and must not be rescheduled.
+TEST_F(EPBucketTest, FlushPrepareTaskAfterCancel) {
+    auto link = std::make_shared<FlushPrepareLink>(nullptr);
+    FlushPrepareTask task(engine.get(), link, 0);
+    EXPECT_FALSE(task.run());
+}
+
 class EPStoreEvictionTest : public EPBucketTest,
                              public ::testing::WithParamInterface<std::string> {
     void SetUp() override {
@@ -364,6 +414,45 @@ TEST_P(EPStoreEvictionTest, DeletedValue) {
     EXPECT_EQ("deleted value", result.item->getValue()->to_s());
 }
 
+// Test that a BgFetcher task fetches the outstanding items of every pending
+// vbucket (not just the first one it takes), recording how long each
+// vbucket was queued and how long its disk read took.
+TEST_P(EPStoreEvictionTest, BgFetchDrainsAllPendingVBuckets) {
+    // A second vbucket in the same shard as vbid.
+    const uint16_t vbid2 = vbid + engine->getWorkLoadPolicy().getNumShards();
+    store->setVBucketState(vbid2, vbucket_state_active, false);
+
+    auto key = makeStoredDocKey("key");
+    for (const auto vb : {vbid, vbid2}) {
+        auto item = make_item(vb, key, "value");
+        ASSERT_EQ(ENGINE_SUCCESS, store->set(item, nullptr));
+        flush_vbucket_to_disk(vb);
+        evict_key(vb, key);
+    }
+    ASSERT_EQ(store->getVBucket(vbid)->getShard(),
+              store->getVBucket(vbid2)->getShard());
+
+    auto options = get_options_t(QUEUE_BG_FETCH);
+    for (const auto vb : {vbid, vbid2}) {
+        ASSERT_EQ(ENGINE_EWOULDBLOCK,
+                  store->get(key, vb, cookie, options).getStatus());
+    }
+
+    auto& stats = engine->getEpStats();
+    stats.bgFetchQueueHisto.reset();
+    stats.bgFetchDiskHisto.reset();
+
+    MockGlobalTask mockTask(engine->getTaskable(), TaskId::MultiBGFetcherTask);
+    store->getVBucket(vbid)->getShard()->getBgFetcher()->run(&mockTask);
+
+    EXPECT_EQ(2, stats.bgFetchQueueHisto.total());
+    EXPECT_EQ(2, stats.bgFetchDiskHisto.total());
+    for (const auto vb : {vbid, vbid2}) {
+        EXPECT_EQ(ENGINE_SUCCESS,
+                  store->get(key, vb, cookie, options).getStatus());
+    }
+}
+
 // Test to ensure all pendingBGfetches are deleted when the
 // VBucketMemoryDeletionTask is run
 TEST_P(EPStoreEvictionTest, MB_21976) {
@@ -485,6 +574,43 @@ TEST_P(EPStoreEvictionTest, checkIfResidentAfterBgFetch) {
     EXPECT_TRUE(v->isResident());
 }
 
+// A get of a non-resident item falls through the shared-lock fast path of
+// VBucket::getInternal; check the reference is only recorded once.
+TEST_P(EPStoreEvictionTest, GetNonResidentTracksReferenceOnce) {
+    if (GetParam() == "full_eviction") {
+        // The evicted item isn't in the HashTable to be referenced.
+        return;
+    }
+    const DocKey dockey("key", DocNamespace::DefaultCollection);
+    store_item(vbid, dockey, "value");
+    flush_vbucket_to_disk(vbid);
+    evict_key(vbid, dockey);
+
+    VBucketPtr vb = store->getVBucket(vbid);
+    {
+        auto hbl = vb->ht.getLockedBucket(dockey);
+        StoredValue* v = vb->ht.unlocked_find(dockey,
+                                              hbl.getBucketNum(),
+                                              WantsDeleted::No,
+                                              TrackReference::No);
+        ASSERT_NE(nullptr, v);
+        v->setNRUValue(INITIAL_NRU_VALUE);
+    }
+
+    get_options_t options = static_cast<get_options_t>(
+            QUEUE_BG_FETCH | TRACK_REFERENCE);
+    GetValue gv = store->get(makeStoredDocKey("key"), vbid, cookie, options);
+    EXPECT_EQ(ENGINE_EWOULDBLOCK, gv.getStatus());
+
+    auto hbl = vb->ht.getLockedBucket(dockey);
+    StoredValue* v = vb->ht.unlocked_find(dockey,
+                                          hbl.getBucketNum(),
+                                          WantsDeleted::No,
+                                          TrackReference::No);
+    ASSERT_NE(nullptr, v);
+    EXPECT_EQ(INITIAL_NRU_VALUE - 1, v->getNRUValue());
+}
+
 TEST_P(EPStoreEvictionTest, xattrExpiryOnFullyEvictedItem) {
     if (GetParam() == "value_only") {
         return;
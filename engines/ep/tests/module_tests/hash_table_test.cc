@@ -251,6 +251,193 @@ TEST_F(HashTableTest, Resize) {
     verifyFound(h, keys);
 }
 
+// Check lookups and removals with bucket tags, including chains longer than
+// the number of tagged positions.
+TEST_F(HashTableTest, BucketTags) {
+    HashTable h(global_stats,
+                makeFactory(),
+                5,
+                1,
+                /*incrementalResize*/ false,
+                /*useBucketTags*/ true);
+
+    auto keys = generateKeys(100);
+    storeMany(h, keys);
+    verifyFound(h, keys);
+
+    // Remove every other key, from the middle / ends of the chains.
+    std::vector<StoredDocKey> remaining;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i % 2) {
+            EXPECT_TRUE(del(h, keys[i]));
+        } else {
+            remaining.push_back(keys[i]);
+        }
+    }
+    verifyFound(h, remaining);
+    for (size_t i = 1; i < keys.size(); i += 2) {
+        EXPECT_FALSE(h.find(keys[i], TrackReference::No, WantsDeleted::Yes));
+    }
+
+    h.resize(97);
+    verifyFound(h, remaining);
+    EXPECT_EQ(remaining.size(), size_t(count(h)));
+}
+
+// Check that bucket tags avoid examining chains for most misses.
+TEST_F(HashTableTest, BucketTagsFilterMisses) {
+    HashTable h(global_stats,
+                makeFactory(),
+                1031,
+                1,
+                /*incrementalResize*/ false,
+                /*useBucketTags*/ true);
+
+    auto keys = generateKeys(10);
+    storeMany(h, keys);
+
+    for (const auto& key : generateKeys(1010, 10)) {
+        EXPECT_FALSE(h.find(key, TrackReference::No, WantsDeleted::Yes));
+    }
+    EXPECT_GT(h.getNumTagFilteredLookups(), 900);
+    verifyFound(h, keys);
+}
+
+TEST_F(HashTableTest, IncrementalResize) {
+    HashTable h(global_stats, makeFactory(), 6, 3, /*incrementalResize*/ true);
+
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+
+    // Sizes are rounded up to a multiple of the lock count.
+    h.resize(6143);
+    EXPECT_EQ(6144, h.getSize());
+    EXPECT_FALSE(h.isResizeInProgress());
+    EXPECT_EQ(0, h.getNumResizePendingBuckets());
+    EXPECT_EQ(1000, h.getNumResizeMigratedItems());
+    EXPECT_EQ(1000, count(h));
+    verifyFound(h, keys);
+
+    h.resize(769);
+    EXPECT_EQ(771, h.getSize());
+    EXPECT_EQ(2000, h.getNumResizeMigratedItems());
+    EXPECT_EQ(1000, count(h));
+    verifyFound(h, keys);
+}
+
+// If the initial size isn't a multiple of the number of locks, the first
+// resize has to rehash everything in one go.
+TEST_F(HashTableTest, IncrementalResizeUnalignedInitialSize) {
+    HashTable h(global_stats, makeFactory(), 5, 3, /*incrementalResize*/ true);
+
+    auto keys = generateKeys(100);
+    storeMany(h, keys);
+
+    h.resize(100);
+    EXPECT_EQ(102, h.getSize());
+    EXPECT_EQ(0, h.getNumResizeMigratedItems());
+    verifyFound(h, keys);
+
+    h.resize(200);
+    EXPECT_EQ(201, h.getSize());
+    EXPECT_EQ(100, h.getNumResizeMigratedItems());
+    verifyFound(h, keys);
+}
+
+// Check HashTable memory accounting with inline values, including when the
+// value changes between being stored inline and in a Blob.
+TEST_F(HashTableTest, InlineValueMemoryAccounting) {
+    EPStats stats;
+    HashTable ht(stats,
+                 std::make_unique<StoredValueFactory>(stats,
+                                                      /*inlineMaxSize*/ 64),
+                 5,
+                 1);
+    const size_t initialSize = stats.currentSize.load();
+    const auto key = makeStoredDocKey("key");
+
+    Item small(key, 0, 0, "small", 5);
+    small.setBySeqno(1);
+    EXPECT_EQ(MutationStatus::WasClean, ht.set(small));
+    auto* v = ht.find(key, TrackReference::No, WantsDeleted::No);
+    ASSERT_TRUE(v);
+    EXPECT_TRUE(v->isValueInline());
+    EXPECT_FALSE(v->getValue());
+    EXPECT_EQ(v->size(), ht.getItemMemory());
+
+    // Too large for the inline storage; should switch to a Blob.
+    const std::string bigValue(100, 'x');
+    Item big(key, 0, 0, bigValue.data(), bigValue.size());
+    big.setBySeqno(2);
+    EXPECT_EQ(MutationStatus::WasDirty, ht.set(big));
+    v = ht.find(key, TrackReference::No, WantsDeleted::No);
+    ASSERT_TRUE(v);
+    EXPECT_FALSE(v->isValueInline());
+    EXPECT_EQ(bigValue.size(), v->valuelen());
+    EXPECT_EQ(v->size(), ht.getItemMemory());
+
+    // And back to inline.
+    small.setBySeqno(3);
+    EXPECT_EQ(MutationStatus::WasDirty, ht.set(small));
+    v = ht.find(key, TrackReference::No, WantsDeleted::No);
+    ASSERT_TRUE(v);
+    EXPECT_TRUE(v->isValueInline());
+    EXPECT_EQ(v->size(), ht.getItemMemory());
+
+    EXPECT_TRUE(del(ht, key));
+    EXPECT_EQ(0, ht.getItemMemory());
+    EXPECT_EQ(initialSize, stats.currentSize.load());
+}
+
+// Check that compressing a value in memory replaces it with the Snappy form
+// and updates the memory accounting and datatype counts.
+TEST_F(HashTableTest, CompressValue) {
+    HashTable ht(global_stats, makeFactory(), 5, 1);
+    const auto key = makeStoredDocKey("key");
+
+    const std::string value(1000, 'x');
+    Item item(key, 0, 0, value.data(), value.size());
+    item.setBySeqno(1);
+    ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+    EXPECT_EQ(1, ht.datatypeCounts[PROTOCOL_BINARY_RAW_BYTES]);
+    const size_t uncompressedMemory = ht.getItemMemory();
+
+    {
+        auto hbl = ht.getLockedBucket(key);
+        auto* v = ht.unlocked_find(
+                key, hbl.getBucketNum(), WantsDeleted::No, TrackReference::No);
+        ASSERT_TRUE(v);
+        const bool wasDirty = v->isDirty();
+
+        // An unachievable ratio leaves the value untouched.
+        EXPECT_FALSE(ht.unlocked_compressValue(hbl.getHTLock(), *v, 1000.0));
+        EXPECT_EQ(value.size(), v->valuelen());
+
+        EXPECT_TRUE(ht.unlocked_compressValue(hbl.getHTLock(), *v, 1.2));
+        EXPECT_TRUE(mcbp::datatype::is_snappy(v->getDatatype()));
+        EXPECT_LT(v->valuelen(), value.size());
+        EXPECT_EQ(v->size(), ht.getItemMemory());
+        EXPECT_EQ(wasDirty, v->isDirty())
+                << "Compression shouldn't change the dirty state";
+
+        // Already compressed - nothing more to do.
+        EXPECT_FALSE(ht.unlocked_compressValue(hbl.getHTLock(), *v, 1.2));
+    }
+    EXPECT_LT(ht.getItemMemory(), uncompressedMemory);
+    EXPECT_EQ(0, ht.datatypeCounts[PROTOCOL_BINARY_RAW_BYTES]);
+    EXPECT_EQ(1, ht.datatypeCounts[PROTOCOL_BINARY_DATATYPE_SNAPPY]);
+
+    // The value inflates back to the original.
+    auto* v = ht.find(key, TrackReference::No, WantsDeleted::No);
+    ASSERT_TRUE(v);
+    auto fetched = v->toItem(false, 0);
+    ASSERT_TRUE(fetched->decompressValue());
+    EXPECT_EQ(value, std::string(fetched->getData(), fetched->getNBytes()));
+
+    EXPECT_TRUE(del(ht, key));
+    EXPECT_EQ(0, ht.getItemMemory());
+}
+
 class AccessGenerator : public Generator<bool> {
 public:
 
@@ -295,6 +482,20 @@ TEST_F(HashTableTest, ConcurrentAccessResize) {
     getCompletedThreads(4, &gen);
 }
 
+TEST_F(HashTableTest, ConcurrentAccessIncrementalResize) {
+    HashTable h(global_stats, makeFactory(), 6, 3, /*incrementalResize*/ true);
+
+    auto keys = generateKeys(2000);
+    h.resize(keys.size());
+    storeMany(h, keys);
+
+    verifyFound(h, keys);
+
+    srand(918475);
+    AccessGenerator gen(keys, h);
+    getCompletedThreads(4, &gen);
+}
+
 TEST_F(HashTableTest, AutoResize) {
     HashTable h(global_stats, makeFactory(), 5, 3);
 
@@ -613,6 +814,70 @@ TEST_F(HashTableTest, NRUMinimum) {
     EXPECT_EQ(MIN_NRU_VALUE, v->getNRUValue());
 }
 
+// Check findForRead() returns the expected StoredValue, and that the hash
+// bucket lock is shared - multiple read-only lookups of the same bucket can be
+// in progress at once.
+TEST_F(HashTableTest, FindForReadIsShared) {
+    // One lock, so all keys share the same lock.
+    HashTable ht(global_stats, makeFactory(), 5, 1);
+    StoredDocKey key = makeStoredDocKey("key");
+    store(ht, key);
+
+    auto res1 = ht.findForRead(key, TrackReference::No, WantsDeleted::No);
+    ASSERT_NE(nullptr, res1.storedValue);
+    EXPECT_EQ(key, res1.storedValue->getKey());
+
+    // Would deadlock if findForRead() acquired the lock exclusively.
+    auto res2 = ht.findForRead(key, TrackReference::No, WantsDeleted::No);
+    EXPECT_EQ(res1.storedValue, res2.storedValue);
+
+    auto missing = ht.findForRead(
+            makeStoredDocKey("missing"), TrackReference::No, WantsDeleted::No);
+    EXPECT_EQ(nullptr, missing.storedValue);
+    EXPECT_EQ(3, ht.getNumReadOnlyFinds());
+}
+
+// Check findForRead() still records references (updates the NRU value).
+TEST_F(HashTableTest, FindForReadTracksReference) {
+    HashTable ht(global_stats, makeFactory(), 5, 1);
+    StoredDocKey key = makeStoredDocKey("key");
+
+    Item item(key, 0, 0, "value", strlen("value"));
+    ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+
+    {
+        auto res = ht.findForRead(key, TrackReference::No, WantsDeleted::No);
+        ASSERT_NE(nullptr, res.storedValue);
+        EXPECT_EQ(INITIAL_NRU_VALUE, res.storedValue->getNRUValue());
+    }
+    {
+        auto res = ht.findForRead(key, TrackReference::Yes, WantsDeleted::No);
+        ASSERT_NE(nullptr, res.storedValue);
+        EXPECT_EQ(INITIAL_NRU_VALUE - 1, res.storedValue->getNRUValue());
+    }
+}
+
+// Check findForRead() honours WantsDeleted.
+TEST_F(HashTableTest, FindForReadDeleted) {
+    HashTable ht(global_stats, makeFactory(), 5, 1);
+    StoredDocKey key = makeStoredDocKey("key");
+    store(ht, key);
+    {
+        auto hbl = ht.getLockedBucket(key);
+        auto* v = ht.unlocked_find(
+                key, hbl.getBucketNum(), WantsDeleted::No, TrackReference::No);
+        ASSERT_NE(nullptr, v);
+        ht.unlocked_softDelete(hbl.getHTLock(), *v, /*onlyMarkDeleted*/ true);
+    }
+
+    EXPECT_EQ(nullptr,
+              ht.findForRead(key, TrackReference::No, WantsDeleted::No)
+                      .storedValue);
+    auto res = ht.findForRead(key, TrackReference::No, WantsDeleted::Yes);
+    ASSERT_NE(nullptr, res.storedValue);
+    EXPECT_TRUE(res.storedValue->isDeleted());
+}
+
 /* Test release from HT (but not deletion) of an (HT) element */
 TEST_F(HashTableTest, ReleaseItem) {
     /* Setup with 2 hash buckets and 1 lock */
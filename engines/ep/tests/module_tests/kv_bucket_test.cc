@@ -651,6 +651,36 @@ TEST_P(KVBucketParamTest, SetWithMeta_Forced) {
                                  /*allowExisting*/ false));
 }
 
+// Test setWithMeta with a supplied seqno too large for a StoredValue is
+// rejected (rather than throwing).
+TEST_P(KVBucketParamTest, SetWithMeta_SeqnoOutOfRange) {
+    auto item = make_item(vbid, makeStoredDocKey("key"), "value");
+    item.setCas();
+    item.setBySeqno(PackedInt48::max + 1);
+    uint64_t seqno;
+    EXPECT_EQ(ENGINE_ERANGE,
+              store->setWithMeta(item,
+                                 0,
+                                 &seqno,
+                                 cookie,
+                                 {vbucket_state_active},
+                                 CheckConflicts::No,
+                                 /*allowExisting*/ false,
+                                 GenerateBySeqno::No));
+    EXPECT_EQ(0, store->getVBucket(vbid)->getNumItems());
+
+    item.setBySeqno(PackedInt48::max);
+    EXPECT_EQ(ENGINE_SUCCESS,
+              store->setWithMeta(item,
+                                 0,
+                                 &seqno,
+                                 cookie,
+                                 {vbucket_state_active},
+                                 CheckConflicts::No,
+                                 /*allowExisting*/ false,
+                                 GenerateBySeqno::No));
+}
+
 // MB and test was raised because a few commits back this was broken but no
 // existing test covered the case. I.e. run this test  against 0810540 and it
 // fails, but now fixed
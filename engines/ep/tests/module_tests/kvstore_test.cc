@@ -20,6 +20,7 @@
 #include <platform/dirutils.h>
 
 #include "callbacks.h"
+#include "couch-kvstore/couch-fs-cache.h"
 #include "couch-kvstore/couch-kvstore.h"
 #include "kvstore.h"
 #include "kvstore_config.h"
@@ -386,6 +387,287 @@ TEST_F(CouchKVStoreTest, MB_18580_ENOENT) {
     EXPECT_THROW(kvstore.ro->getDbFileInfo(0), std::system_error);
 }
 
+// Verify that get and getMulti return the same documents when the files are
+// read with O_DIRECT (falling back to buffered reads if the filesystem of
+// the test directory doesn't support it), including documents which don't
+// start or end on an aligned offset.
+TEST_F(CouchKVStoreTest, DirectReads) {
+    KVStoreConfig config(
+            1024, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    config.setDirectReads(true);
+    auto kvstore = setup_kv_store(config);
+
+    std::vector<std::string> values;
+    kvstore->begin();
+    WriteCallback wc;
+    for (const size_t size : {1, 100, 4095, 4096, 4097, 10000}) {
+        values.emplace_back(size, 'a' + (values.size() % 26));
+        Item item(makeStoredDocKey("key" + std::to_string(values.size())),
+                  0,
+                  0,
+                  values.back().data(),
+                  values.back().size());
+        kvstore->set(item, wc);
+    }
+    ASSERT_TRUE(kvstore->commit(nullptr /*no collections manifest*/));
+
+    vb_bgfetch_queue_t itms;
+    for (size_t ii = 1; ii <= values.size(); ++ii) {
+        const auto key = makeStoredDocKey("key" + std::to_string(ii));
+        auto gv = kvstore->get(key, 0);
+        ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+        EXPECT_EQ(values[ii - 1], gv.item->getValue()->to_s());
+
+        vb_bgfetch_item_ctx_t ctx;
+        ctx.isMetaOnly = GetMetaOnly::No;
+        itms[key] = std::move(ctx);
+    }
+
+    kvstore->getMulti(0, itms);
+    for (size_t ii = 1; ii <= values.size(); ++ii) {
+        const auto& gv =
+                itms[makeStoredDocKey("key" + std::to_string(ii))].value;
+        ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+        EXPECT_EQ(values[ii - 1], gv.item->getValue()->to_s());
+    }
+}
+
+// Verify that the read-only store serves repeated background fetches from
+// its block cache (when enabled), and returns the same documents.
+TEST_F(CouchKVStoreTest, BlockCache) {
+    KVStoreConfig config(
+            1024, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    config.setBlockCacheSize(1024 * 1024);
+    auto kvstore = KVStoreFactory::create(config);
+    initialize_kv_store(kvstore.rw.get());
+
+    // Enough documents to span a good number of blocks
+    const std::string value(1000, 'x');
+    kvstore.rw->begin();
+    WriteCallback wc;
+    for (int ii = 0; ii < 100; ++ii) {
+        Item item(makeStoredDocKey("key" + std::to_string(ii)),
+                  0,
+                  0,
+                  value.data(),
+                  value.size());
+        kvstore.rw->set(item, wc);
+    }
+    ASSERT_TRUE(kvstore.rw->commit(nullptr /*no collections manifest*/));
+
+    auto fetchAll = [&kvstore, &value]() {
+        vb_bgfetch_queue_t itms;
+        for (int ii = 0; ii < 100; ++ii) {
+            vb_bgfetch_item_ctx_t ctx;
+            ctx.isMetaOnly = GetMetaOnly::No;
+            itms[makeStoredDocKey("key" + std::to_string(ii))] =
+                    std::move(ctx);
+        }
+        kvstore.ro->getMulti(0, itms);
+        for (auto& item : itms) {
+            ASSERT_EQ(ENGINE_SUCCESS, item.second.value.getStatus());
+            EXPECT_EQ(value, item.second.value.item->getValue()->to_s());
+        }
+    };
+
+    // Only the read-only store (which does the background fetches) has a
+    // cache.
+    size_t hits = 0;
+    EXPECT_FALSE(kvstore.rw->getStat("Block_cache_hits", hits));
+
+    fetchAll();
+    ASSERT_TRUE(kvstore.ro->getStat("Block_cache_hits", hits));
+    size_t misses = 0;
+    ASSERT_TRUE(kvstore.ro->getStat("Block_cache_misses", misses));
+    EXPECT_GT(misses, 0);
+    size_t memUsed = 0;
+    ASSERT_TRUE(kvstore.ro->getStat("Block_cache_mem_used", memUsed));
+    EXPECT_GT(memUsed, 0);
+    EXPECT_LE(memUsed, 1024 * 1024);
+
+    fetchAll();
+    size_t hitsAfter = 0;
+    ASSERT_TRUE(kvstore.ro->getStat("Block_cache_hits", hitsAfter));
+    EXPECT_GT(hitsAfter, hits);
+}
+
+// Verify that a scan with read-ahead enabled returns every document, and
+// serves most of its reads from the read-ahead buffers.
+TEST_F(CouchKVStoreTest, ScanReadAhead) {
+    KVStoreConfig config(
+            1024, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    config.setScanReadAheadSize(64 * 1024);
+    auto kvstore = setup_kv_store(config);
+
+    // Several commits, so the documents and B-tree nodes are interleaved
+    const std::string value(1000, 'x');
+    WriteCallback wc;
+    for (int batch = 0; batch < 10; ++batch) {
+        kvstore->begin();
+        for (int ii = 0; ii < 100; ++ii) {
+            Item item(makeStoredDocKey("key" +
+                                       std::to_string(batch * 100 + ii)),
+                      0,
+                      0,
+                      value.data(),
+                      value.size());
+            kvstore->set(item, wc);
+        }
+        ASSERT_TRUE(kvstore->commit(nullptr /*no collections manifest*/));
+    }
+
+    size_t scanned = 0;
+    auto cb(std::make_shared<CustomCallback<GetValue>>(
+            [&scanned, &value](GetValue result) {
+                ASSERT_EQ(ENGINE_SUCCESS, result.getStatus());
+                EXPECT_EQ(value, result.item->getValue()->to_s());
+                ++scanned;
+            }));
+    auto cl(std::make_shared<CustomCallback<CacheLookup>>());
+    auto* scanCtx = kvstore->initScanContext(cb,
+                                             cl,
+                                             0,
+                                             1,
+                                             DocumentFilter::ALL_ITEMS,
+                                             ValueFilter::VALUES_DECOMPRESSED);
+    ASSERT_NE(nullptr, scanCtx);
+    EXPECT_EQ(scan_success, kvstore->scan(scanCtx));
+    kvstore->destroyScanContext(scanCtx);
+    EXPECT_EQ(1000, scanned);
+
+    size_t hits = 0;
+    ASSERT_TRUE(kvstore->getStat("Scan_read_ahead_hits", hits));
+    size_t reads = 0;
+    ASSERT_TRUE(kvstore->getStat("Scan_read_ahead_reads", reads));
+    EXPECT_GT(reads, 0);
+    EXPECT_GT(hits, reads);
+}
+
+// Verify the least recently used blocks are evicted from a BlockCache once
+// it's full.
+TEST(BlockCacheTest, LRUEviction) {
+    // Room for a few blocks (including their overheads)
+    BlockCache cache(4 * BlockCache::BlockSize);
+    const auto fileId = cache.getFileId("file");
+    EXPECT_EQ(fileId, cache.getFileId("file"));
+    EXPECT_NE(fileId, cache.getFileId("other"));
+
+    std::vector<char> block(BlockCache::BlockSize);
+    for (uint64_t ii = 0; ii < 10; ++ii) {
+        std::fill(block.begin(), block.end(), char(ii));
+        cache.put(fileId, ii, block.data());
+        // Keep block 0 recently used
+        EXPECT_TRUE(cache.get(fileId, 0, block.data()));
+        EXPECT_EQ(0, block.front());
+    }
+    EXPECT_LE(cache.getMemUsed(), cache.getMaxSize());
+
+    // The most recent blocks (and block 0) are still cached; the older ones
+    // were evicted.
+    EXPECT_TRUE(cache.get(fileId, 9, block.data()));
+    EXPECT_EQ(9, block.back());
+    EXPECT_FALSE(cache.get(fileId, 1, block.data()));
+    EXPECT_TRUE(cache.get(fileId, 0, block.data()));
+}
+
+// Verify that blocks of different files are kept apart, and that removing
+// a file removes (only) its blocks.
+TEST(BlockCacheTest, RemoveFile) {
+    BlockCache cache(16 * BlockCache::BlockSize);
+    std::vector<char> block(BlockCache::BlockSize, 'a');
+
+    // Same block of files whose ids differ only in their high bits
+    const uint32_t highId = 1u << 24;
+    cache.put(0, 1, block.data());
+    EXPECT_FALSE(cache.get(highId, 1, block.data()));
+    std::fill(block.begin(), block.end(), 'b');
+    cache.put(highId, 1, block.data());
+    EXPECT_TRUE(cache.get(0, 1, block.data()));
+    EXPECT_EQ('a', block.front());
+
+    const auto fileId = cache.getFileId("file");
+    const auto otherId = cache.getFileId("other");
+    cache.put(fileId, 0, block.data());
+    cache.put(otherId, 0, block.data());
+    const auto memUsed = cache.getMemUsed();
+
+    cache.removeFile("file");
+    EXPECT_FALSE(cache.get(fileId, 0, block.data()));
+    EXPECT_TRUE(cache.get(otherId, 0, block.data()));
+    EXPECT_LT(cache.getMemUsed(), memUsed);
+
+    // A file created again at the same path (e.g. the same revision after
+    // vbucket deletion) gets a new id.
+    const auto newId = cache.getFileId("file");
+    EXPECT_NE(fileId, newId);
+    EXPECT_NE(otherId, newId);
+    EXPECT_FALSE(cache.get(newId, 0, block.data()));
+}
+
+// Verify the Db handle cache is split between the shards rounding up, so
+// every shard has a cache if it's enabled.
+TEST(KVStoreConfigTest, DbHandleCacheSizePerShard) {
+    Configuration config;
+    config.setMaxNumShards(4);
+    EXPECT_EQ(0, KVStoreConfig(config, 0).getDbHandleCacheSize());
+
+    config.setCouchstoreDbHandleCacheSize(2);
+    EXPECT_EQ(1, KVStoreConfig(config, 0).getDbHandleCacheSize());
+
+    config.setCouchstoreDbHandleCacheSize(9);
+    EXPECT_EQ(3, KVStoreConfig(config, 0).getDbHandleCacheSize());
+}
+
+// Verify the read-only store reuses its Db handles, and that a commit by the
+// read-write store invalidates them (so the new data is seen).
+TEST_F(CouchKVStoreTest, DbHandleCache) {
+    KVStoreConfig config(
+            1024, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    config.setDbHandleCacheSize(4);
+    auto kvstore = KVStoreFactory::create(config);
+    initialize_kv_store(kvstore.rw.get());
+
+    auto store = [&kvstore](const std::string& value) {
+        kvstore.rw->begin();
+        Item item(makeStoredDocKey("key"), 0, 0, value.data(), value.size());
+        WriteCallback wc;
+        kvstore.rw->set(item, wc);
+        ASSERT_TRUE(kvstore.rw->commit(nullptr /*no collections manifest*/));
+    };
+    auto getStats = [&kvstore]() {
+        std::map<std::string, std::string> stats;
+        kvstore.ro->addStats(add_stat_callback, &stats);
+        return stats;
+    };
+
+    store("value1");
+    auto gv = kvstore.ro->get(makeStoredDocKey("key"), 0);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("value1", gv.item->getValue()->to_s());
+    auto stats = getStats();
+    EXPECT_EQ("0", stats["ro_0:db_handle_cache_hits"]);
+    EXPECT_EQ("1", stats["ro_0:db_handle_cache_misses"]);
+
+    gv = kvstore.ro->get(makeStoredDocKey("key"), 0);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    stats = getStats();
+    EXPECT_EQ("1", stats["ro_0:db_handle_cache_hits"]);
+
+    // The cached handle only sees the old header; it must not be reused.
+    store("value2");
+    gv = kvstore.ro->get(makeStoredDocKey("key"), 0);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("value2", gv.item->getValue()->to_s());
+    stats = getStats();
+    EXPECT_EQ("1", stats["ro_0:db_handle_cache_hits"]);
+    EXPECT_EQ("2", stats["ro_0:db_handle_cache_misses"]);
+
+    // Only the read-only store reports the cache.
+    std::map<std::string, std::string> rwStats;
+    kvstore.rw->addStats(add_stat_callback, &rwStats);
+    EXPECT_EQ(0, rwStats.count("rw_0:db_handle_cache_hits"));
+}
+
 /**
  * The CouchKVStoreErrorInjectionTest cases utilise GoogleMock to inject
  * errors into couchstore as if they come from the filesystem in order
@@ -51,7 +51,7 @@ public:
 
     /// Returns the number of bytes in the Fixed part of StoredValue
     static size_t getFixedSize() {
-        return sizeof(typename Factory::value_type);
+        return Factory::value_type::getFixedSize();
     }
 
     /// Allow testing access to StoredValue::getRequiredStorage
@@ -225,13 +225,133 @@ TYPED_TEST(ValueTest, deletedValueDatatypeIsBinary) {
             << "datatype should be RAW BYTES after deletion.";
 }
 
+/// Check that the seqno is correctly stored in the (packed) bySeqno field -
+/// including the negative values used by temporary items, and the range
+/// limits.
+TYPED_TEST(ValueTest, bySeqnoLimits) {
+    this->sv->setBySeqno(PackedInt48::max);
+    EXPECT_EQ(PackedInt48::max, this->sv->getBySeqno());
+
+    this->sv->setBySeqno(1);
+    EXPECT_EQ(1, this->sv->getBySeqno());
+
+    this->sv->setTempDeleted();
+    EXPECT_TRUE(this->sv->isTempDeletedItem());
+    EXPECT_EQ(StoredValue::state_deleted_key, this->sv->getBySeqno());
+
+    EXPECT_THROW(this->sv->setBySeqno(PackedInt48::max + 1),
+                 std::overflow_error);
+}
+
+/// Check the (trailing) lock expiry is independent of the key.
+TYPED_TEST(ValueTest, lockDoesNotAffectKey) {
+    this->sv->lock(1000);
+    EXPECT_TRUE(this->sv->isLocked(999));
+    EXPECT_TRUE(this->sv->hasKey(makeStoredDocKey("key")));
+    this->sv->unlock();
+    EXPECT_FALSE(this->sv->isLocked(999));
+    EXPECT_TRUE(this->sv->hasKey(makeStoredDocKey("key")));
+}
+
+/**
+ * Test fixture for StoredValues with inline values. Type-parameterized to
+ * test both StoredValue and OrderedStoredValue.
+ */
+template <typename Factory>
+class InlineValueTest : public ::testing::Test {
+public:
+    InlineValueTest()
+        : factory(stats, /*inlineValueMaxSize*/ 16),
+          item(make_item(0, makeStoredDocKey("key"), "value")) {
+    }
+
+    void SetUp() override {
+        sv = factory(item, {});
+    }
+
+protected:
+    EPStats stats;
+    Factory factory;
+    Item item;
+    StoredValue::UniquePtr sv;
+};
+
+TYPED_TEST_CASE(InlineValueTest, ValueFactories);
+
+TYPED_TEST(InlineValueTest, ValueIsInline) {
+    EXPECT_TRUE(this->sv->isValueInline());
+    EXPECT_TRUE(this->sv->hasValue());
+    EXPECT_FALSE(this->sv->getValue());
+    EXPECT_EQ(5, this->sv->valuelen());
+    EXPECT_EQ("value", std::string(this->sv->getValueData(), 5));
+    EXPECT_TRUE(this->sv->hasKey(makeStoredDocKey("key")));
+}
+
+TYPED_TEST(InlineValueTest, getObjectSize) {
+    // Fixed size, key (3 + len + namespace), inline header (2) and value (5).
+    EXPECT_EQ(TypeParam::value_type::getFixedSize() + 5 + 2 + 5,
+              this->sv->getObjectSize());
+    EXPECT_EQ(this->sv->getObjectSize(),
+              TypeParam::value_type::getRequiredStorage(this->item, 16));
+    // Inline storage isn't metadata, but is included in size().
+    EXPECT_EQ(this->sv->getObjectSize() - 2 - 5, this->sv->metaDataSize());
+    EXPECT_EQ(this->sv->getObjectSize(), this->sv->size());
+}
+
+TYPED_TEST(InlineValueTest, LargeValueNotInline) {
+    auto big = make_item(0, makeStoredDocKey("key"), std::string(17, 'x'));
+    auto sv = this->factory(big, {});
+    EXPECT_FALSE(sv->isValueInline());
+    EXPECT_TRUE(sv->getValue());
+    EXPECT_EQ(17, sv->valuelen());
+    EXPECT_EQ(TypeParam::value_type::getFixedSize() + 5,
+              sv->getObjectSize());
+}
+
+/// Check a value is stored inline only while it fits the inline storage.
+TYPED_TEST(InlineValueTest, SetValue) {
+    auto bigger = make_item(0, makeStoredDocKey("key"), "longer value");
+    this->sv->setValue(bigger);
+    EXPECT_FALSE(this->sv->isValueInline());
+    EXPECT_EQ(12, this->sv->valuelen());
+    EXPECT_EQ("longer value", this->sv->getValue()->to_s());
+
+    auto smaller = make_item(0, makeStoredDocKey("key"), "val");
+    this->sv->setValue(smaller);
+    EXPECT_TRUE(this->sv->isValueInline());
+    EXPECT_FALSE(this->sv->getValue());
+    EXPECT_EQ("val", std::string(this->sv->getValueData(), 3));
+}
+
+TYPED_TEST(InlineValueTest, ToItem) {
+    auto itm = this->sv->toItem(false, 0);
+    ASSERT_TRUE(itm->getValue());
+    EXPECT_EQ("value", itm->getValue()->to_s());
+}
+
+TYPED_TEST(InlineValueTest, Delete) {
+    this->sv->del();
+    EXPECT_FALSE(this->sv->isValueInline());
+    EXPECT_FALSE(this->sv->hasValue());
+    EXPECT_EQ(0, this->sv->valuelen());
+    // Inline storage remains allocated.
+    EXPECT_EQ(TypeParam::value_type::getFixedSize() + 5 + 2 + 5,
+              this->sv->getObjectSize());
+}
+
+TYPED_TEST(InlineValueTest, NotEligibleForValueEviction) {
+    this->sv->markClean();
+    EXPECT_FALSE(this->sv->eligibleForEviction(VALUE_ONLY));
+    EXPECT_TRUE(this->sv->eligibleForEviction(FULL_EVICTION));
+}
+
 /// Check that StoredValue / OrderedStoredValue don't unexpectedly change in
 /// size (we've carefully crafted them to be as efficient as possible).
 TEST(StoredValueTest, expectedSize) {
-    EXPECT_EQ(56, sizeof(StoredValue))
+    EXPECT_EQ(48, sizeof(StoredValue))
             << "Unexpected change in StoredValue fixed size";
     auto item = make_item(0, makeStoredDocKey("k"), "v");
-    EXPECT_EQ(59, StoredValue::getRequiredStorage(item))
+    EXPECT_EQ(55, StoredValue::getRequiredStorage(item))
             << "Unexpected change in StoredValue storage size for item: "
             << item;
 }
@@ -48,7 +48,10 @@
  *    There is a special DCP stream named "ewb_internal" which is an
  *    endless stream of items. You may also add a number at the end
  *    e.g. "ewb_internal:10" and it'll create a stream with 10 entries.
- *    It will always send the same K-V pair.
+ *    It will always send the same K-V pair. Once all of the entries are
+ *    sent dcp_step returns ENGINE_EWOULDBLOCK, unless a second number is
+ *    added e.g. "ewb_internal:10:<ENGINE_ERROR_CODE>" in which case it
+ *    returns that error code instead.
  *    Note that we don't register for disconnect events so you might
  *    experience weirdness if you first try to use the internal dcp
  *    stream, and then later on want to use the one provided by the
@@ -419,6 +422,26 @@ public:
         }
     }
 
+    static std::vector<cb::EngineErrorItemPair> get_multi(
+            ENGINE_HANDLE* handle,
+            const void* cookie,
+            const std::vector<cb::KeyAndVBucket>& keys) {
+        EWB_Engine* ewb = to_engine(handle);
+        ENGINE_ERROR_CODE err = ENGINE_SUCCESS;
+        if (ewb->should_inject_error(Cmd::GET, cookie, err)) {
+            // Inject the same error for every key in the batch.
+            std::vector<cb::EngineErrorItemPair> ret;
+            ret.reserve(keys.size());
+            for (size_t ii = 0; ii < keys.size(); ++ii) {
+                ret.emplace_back(
+                        cb::makeEngineErrorItemPair(cb::engine_errc(err)));
+            }
+            return ret;
+        } else {
+            return ewb->real_engine->get_multi(ewb->real_handle, cookie, keys);
+        }
+    }
+
     static cb::EngineErrorItemPair get_if(ENGINE_HANDLE* handle,
                                           const void* cookie,
                                           const DocKey& key,
@@ -1197,11 +1220,18 @@ private:
         std::vector<uint8_t> value;
     } dcp_mutation_item;
 
+    struct InternalDcpStream {
+        /// The number of objects left to send on the stream
+        uint64_t count = std::numeric_limits<uint64_t>::max();
+        /// What dcp_step returns once all of the objects are sent
+        ENGINE_ERROR_CODE endStatus = ENGINE_EWOULDBLOCK;
+    };
+
     /**
-     * The dcp_stream map is used to map a cookie to the count of objects
-     * it should send on the stream.
+     * The dcp_stream map is used to map a cookie to the internal stream
+     * (count of objects and end status) it should send.
      */
-    std::map<const void*, uint64_t> dcp_stream;
+    std::map<const void*, InternalDcpStream> dcp_stream;
 
     friend class BlockMonitorThread;
     std::map<uint32_t, const void*> suspended_map;
@@ -1288,6 +1318,7 @@ EWB_Engine::EWB_Engine(GET_SERVER_API gsa_)
     ENGINE_HANDLE_V1::remove = remove;
     ENGINE_HANDLE_V1::release = release;
     ENGINE_HANDLE_V1::get = get;
+    ENGINE_HANDLE_V1::get_multi = get_multi;
     ENGINE_HANDLE_V1::get_if = get_if;
     ENGINE_HANDLE_V1::get_locked = get_locked;
     ENGINE_HANDLE_V1::get_meta = get_meta;
@@ -1371,7 +1402,7 @@ ENGINE_ERROR_CODE EWB_Engine::dcp_step(ENGINE_HANDLE* handle,
     EWB_Engine* ewb = to_engine(handle);
     auto stream = ewb->dcp_stream.find(cookie);
     if (stream != ewb->dcp_stream.end()) {
-        auto& count = stream->second;
+        auto& count = stream->second.count;
         if (count > 0) {
             // This is using the internal dcp implementation which always
             // send the same item back
@@ -1392,7 +1423,7 @@ ENGINE_ERROR_CODE EWB_Engine::dcp_step(ENGINE_HANDLE* handle,
             }
             return ret;
         }
-        return ENGINE_EWOULDBLOCK;
+        return stream->second.endStatus;
     }
 
     if (ewb->real_engine->dcp.step == nullptr) {
@@ -1413,14 +1444,19 @@ ENGINE_ERROR_CODE EWB_Engine::dcp_open(ENGINE_HANDLE* handle,
     std::string nm = cb::to_string(name);
     if (nm.find("ewb_internal") == 0) {
         // Yeah, this is a request for the internal "magic" DCP stream
-        // The user could specify the iteration count by adding a colon
-        // at the end...
-        auto idx = nm.rfind(":");
+        // The user could specify the iteration count (and the status to
+        // return once they're sent) by adding a colon at the end...
+        InternalDcpStream stream;
+        auto idx = nm.find(":");
         if (idx != nm.npos) {
-            ewb->dcp_stream[cookie] = std::stoull(nm.substr(idx + 1));
-        } else {
-            ewb->dcp_stream[cookie] = std::numeric_limits<uint64_t>::max();
+            auto statusIdx = nm.find(":", idx + 1);
+            stream.count = std::stoull(nm.substr(idx + 1, statusIdx - idx - 1));
+            if (statusIdx != nm.npos) {
+                stream.endStatus =
+                        ENGINE_ERROR_CODE(std::stoi(nm.substr(statusIdx + 1)));
+            }
         }
+        ewb->dcp_stream[cookie] = stream;
         return ENGINE_SUCCESS;
     }
 
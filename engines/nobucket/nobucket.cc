@@ -43,6 +43,7 @@ public:
         ENGINE_HANDLE_V1::remove = item_delete;
         ENGINE_HANDLE_V1::release = item_release;
         ENGINE_HANDLE_V1::get = get;
+        ENGINE_HANDLE_V1::get_multi = get_multi;
         ENGINE_HANDLE_V1::get_if = get_if;
         ENGINE_HANDLE_V1::get_and_touch = get_and_touch;
         ENGINE_HANDLE_V1::get_locked = get_locked;
@@ -141,6 +142,19 @@ private:
         return cb::makeEngineErrorItemPair(cb::engine_errc::no_bucket);
     }
 
+    static std::vector<cb::EngineErrorItemPair> get_multi(
+            ENGINE_HANDLE*,
+            const void*,
+            const std::vector<cb::KeyAndVBucket>& keys) {
+        std::vector<cb::EngineErrorItemPair> ret;
+        ret.reserve(keys.size());
+        for (size_t ii = 0; ii < keys.size(); ++ii) {
+            ret.emplace_back(
+                    cb::makeEngineErrorItemPair(cb::engine_errc::no_bucket));
+        }
+        return ret;
+    }
+
     static cb::EngineErrorItemPair get_if(ENGINE_HANDLE* handle,
                                           const void*,
                                           const DocKey&,
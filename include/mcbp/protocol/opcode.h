@@ -239,6 +239,11 @@ enum class ClientOpcode : uint8_t {
      */
     CollectionsSetManifest = 0xb9,
 
+    /**
+     * Command to get multiple keys in a single request
+     */
+    GetMulti = 0xba,
+
     /**
      * Commands for GO-XDCR
      */
@@ -9,6 +9,7 @@
 #include <memory>
 #include <sys/types.h>
 #include <utility>
+#include <vector>
 
 #include <boost/optional/optional.hpp>
 
@@ -161,6 +162,15 @@ using EngineErrorItemPair = std::pair<cb::engine_errc, cb::unique_item_ptr>;
 
 using EngineErrorMetadataPair = std::pair<engine_errc, item_info>;
 
+/**
+ * A key (and the vbucket it lives in) to look up as part of a get_multi
+ * request.
+ */
+struct KeyAndVBucket {
+    DocKey key;
+    uint16_t vbucket;
+};
+
 enum class StoreIfStatus {
     Continue,
     Fail,
@@ -335,6 +345,30 @@ typedef struct engine_interface_v1 {
                                    uint16_t vbucket,
                                    DocStateFilter documentStateFilter);
 
+    /**
+     * Retrieve a batch of items in a single call.
+     *
+     * Semantically equivalent to calling get() for each key in turn with
+     * DocStateFilter::Alive, but allows the engine to amortise per-call
+     * overheads and to schedule any required background fetches together.
+     *
+     * For each key which cannot be completed immediately the engine returns
+     * ENGINE_EWOULDBLOCK for that key. The cookie is notified once, when
+     * all of those keys may be retried, and the frontend then re-issues
+     * get_multi for just those keys.
+     *
+     * @param handle the engine handle
+     * @param cookie The cookie provided by the frontend
+     * @param keys the keys (and their vbuckets) to look up
+     *
+     * @return one pair of error code and (optionally) item per key, in the
+     *         same order as `keys`
+     */
+    std::vector<cb::EngineErrorItemPair> (*get_multi)(
+            ENGINE_HANDLE* handle,
+            const void* cookie,
+            const std::vector<cb::KeyAndVBucket>& keys);
+
     /**
      * Retrieve metadata for a given item.
      *
@@ -260,6 +260,29 @@ static cb::EngineErrorItemPair mock_get(ENGINE_HANDLE* handle,
     return ret;
 }
 
+static std::vector<cb::EngineErrorItemPair> mock_get_multi(
+        ENGINE_HANDLE* handle,
+        const void* cookie,
+        const std::vector<cb::KeyAndVBucket>& keys) {
+    struct mock_connstruct* c = get_or_create_mock_connstruct(cookie);
+    auto ret = get_engine_v1_from_handle(handle)->get_multi(
+            get_engine_from_handle(handle), static_cast<const void*>(c), keys);
+    check_and_destroy_mock_connstruct(c, cookie);
+
+    // A batch may be notified once per blocked key; rather than tracking
+    // those individually simply block on each outstanding key in turn.
+    for (size_t ii = 0; ii < ret.size(); ++ii) {
+        if (ret[ii].first == cb::engine_errc::would_block) {
+            ret[ii] = mock_get(handle,
+                               cookie,
+                               keys[ii].key,
+                               keys[ii].vbucket,
+                               DocStateFilter::Alive);
+        }
+    }
+    return ret;
+}
+
 static cb::EngineErrorItemPair mock_get_if(ENGINE_HANDLE* handle,
                                            const void* cookie,
                                            const DocKey& key,
@@ -867,6 +890,7 @@ static ENGINE_HANDLE_V1* create_bucket(bool initialize, const char* cfg) {
         mock_engine->me.remove = mock_remove;
         mock_engine->me.release = mock_release;
         mock_engine->me.get = mock_get;
+        mock_engine->me.get_multi = mock_get_multi;
         mock_engine->me.get_if = mock_get_if;
         mock_engine->me.get_and_touch = mock_get_and_touch;
         mock_engine->me.get_locked = mock_get_locked;
@@ -864,6 +864,30 @@ TEST_F(SettingsTest, XattrEnabled) {
     }
 }
 
+TEST_F(SettingsTest, IoUring) {
+    nonBooleanValuesShouldFail("io_uring");
+
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    cJSON_AddTrueToObject(obj.get(), "io_uring");
+    try {
+        Settings settings(obj);
+        EXPECT_TRUE(settings.isIoUringEnabled());
+        EXPECT_TRUE(settings.has.io_uring);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    obj.reset(cJSON_CreateObject());
+    cJSON_AddFalseToObject(obj.get(), "io_uring");
+    try {
+        Settings settings(obj);
+        EXPECT_FALSE(settings.isIoUringEnabled());
+        EXPECT_TRUE(settings.has.io_uring);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
 TEST(SettingsUpdateTest, EmptySettingsShouldWork) {
     Settings updated;
     Settings settings;
@@ -930,6 +954,20 @@ TEST(SettingsUpdateTest, AuditFileIsNotDynamic) {
                  std::invalid_argument);
 }
 
+TEST(SettingsUpdateTest, IoUringIsNotDynamic) {
+    Settings updated;
+    Settings settings;
+    // setting it to the same value should work
+    settings.setIoUringEnabled(true);
+    updated.setIoUringEnabled(settings.isIoUringEnabled());
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+
+    // Changing it should fail
+    updated.setIoUringEnabled(false);
+    EXPECT_THROW(settings.updateSettings(updated, false),
+                 std::invalid_argument);
+}
+
 TEST(SettingsUpdateTest, ThreadsIsNotDynamic) {
     Settings updated;
     Settings settings;
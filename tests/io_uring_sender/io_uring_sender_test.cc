@@ -0,0 +1,157 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include <daemon/io_uring_sender.h>
+#include <gtest/gtest.h>
+#include <platform/make_unique.h>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <memory>
+#include <string>
+#include <system_error>
+
+/**
+ * Tests for IoUringSender, sending over a non-blocking socket pair.
+ *
+ * The kernel running the tests may not support io_uring (or the build may
+ * not have it); in which case the sender can't be created and the tests
+ * have nothing to check.
+ */
+class IoUringSenderTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        try {
+            sender = std::make_unique<IoUringSender>(entries);
+        } catch (const std::system_error&) {
+            return;
+        }
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+        for (const auto sock : sockets) {
+            ASSERT_EQ(0,
+                      fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK));
+        }
+    }
+
+    void TearDown() override {
+        if (sender) {
+            close(sockets[0]);
+            close(sockets[1]);
+        }
+    }
+
+    /// A msghdr sending the given data
+    struct Message {
+        explicit Message(const std::string& data) : data(data) {
+            iov.iov_base = const_cast<char*>(this->data.data());
+            iov.iov_len = this->data.size();
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+        }
+
+        const std::string data;
+        iovec iov;
+        msghdr msg = {};
+    };
+
+    /// Read everything available from the receiving end of the pair
+    std::string receive() {
+        std::string ret;
+        char buffer[4096];
+        ssize_t nr;
+        while ((nr = read(sockets[1], buffer, sizeof(buffer))) > 0) {
+            ret.append(buffer, nr);
+        }
+        return ret;
+    }
+
+    // Deliberately tiny, so that flushes need more than one submission
+    const unsigned int entries = 2;
+    std::unique_ptr<IoUringSender> sender;
+    int sockets[2];
+};
+
+TEST_F(IoUringSenderTest, FlushSendsInOrder) {
+    if (!sender) {
+        return;
+    }
+
+    Message first("first;"), second("second;"), third("third;");
+    EXPECT_TRUE(sender->empty());
+    sender->add(sockets[0], &first.msg, &first);
+    sender->add(sockets[0], &second.msg, &second);
+    sender->add(sockets[0], &third.msg, &third);
+    EXPECT_FALSE(sender->empty());
+
+    const auto results = sender->flush();
+    EXPECT_TRUE(sender->empty());
+    EXPECT_FALSE(sender->isBroken());
+    ASSERT_EQ(3, results.size());
+    EXPECT_EQ(&first, results[0].first);
+    EXPECT_EQ(int(first.data.size()), results[0].second);
+    EXPECT_EQ(&second, results[1].first);
+    EXPECT_EQ(int(second.data.size()), results[1].second);
+    EXPECT_EQ(&third, results[2].first);
+    EXPECT_EQ(int(third.data.size()), results[2].second);
+
+    EXPECT_EQ("first;second;third;", receive());
+}
+
+TEST_F(IoUringSenderTest, CancelledSendIsDropped) {
+    if (!sender) {
+        return;
+    }
+
+    Message first("first;"), second("second;");
+    sender->add(sockets[0], &first.msg, &first);
+    sender->add(sockets[0], &second.msg, &second);
+    sender->cancel(&first);
+
+    const auto results = sender->flush();
+    ASSERT_EQ(1, results.size());
+    EXPECT_EQ(&second, results[0].first);
+    EXPECT_EQ("second;", receive());
+}
+
+TEST_F(IoUringSenderTest, FlushOfNothing) {
+    if (!sender) {
+        return;
+    }
+    EXPECT_TRUE(sender->flush().empty());
+}
+
+/// A send which can't make progress completes with -EAGAIN (just like a
+/// non-blocking sendmsg) rather than blocking the thread.
+TEST_F(IoUringSenderTest, FullSocketReturnsEAGAIN) {
+    if (!sender) {
+        return;
+    }
+
+    const std::string chunk(4096, 'x');
+    while (write(sockets[0], chunk.data(), chunk.size()) > 0) {
+    }
+    ASSERT_EQ(EAGAIN, errno);
+
+    Message message("more");
+    sender->add(sockets[0], &message.msg, &message);
+    const auto results = sender->flush();
+    ASSERT_EQ(1, results.size());
+    EXPECT_EQ(&message, results[0].first);
+    EXPECT_EQ(-EAGAIN, results[0].second);
+    EXPECT_FALSE(sender->isBroken());
+}
@@ -2766,6 +2766,94 @@ TEST_F(GetLockedValidatorTest, InvalidBodylen) {
     EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
 }
 
+// PROTOCOL_BINARY_CMD_GET_MULTI
+class GetMultiValidatorTest : public ValidatorTest {
+    void SetUp() override {
+        ValidatorTest::SetUp();
+        // Two keys: "key1" in vbucket 0 and "key22" in vbucket 1
+        body.clear();
+        addKey(0, "key1");
+        addKey(1, "key22");
+    }
+
+protected:
+    void addKey(uint16_t vbucket, const std::string& key) {
+        const uint16_t vb = htons(vbucket);
+        const uint16_t klen = htons(uint16_t(key.size()));
+        const auto* vbp = reinterpret_cast<const uint8_t*>(&vb);
+        const auto* klp = reinterpret_cast<const uint8_t*>(&klen);
+        body.insert(body.end(), vbp, vbp + sizeof(vb));
+        body.insert(body.end(), klp, klp + sizeof(klen));
+        body.insert(body.end(), key.begin(), key.end());
+    }
+
+    protocol_binary_response_status validate() {
+        std::copy(body.begin(), body.end(), blob + sizeof(request.bytes));
+        request.message.header.request.bodylen = htonl(uint32_t(body.size()));
+        return ValidatorTest::validate(PROTOCOL_BINARY_CMD_GET_MULTI,
+                                       static_cast<void*>(&request));
+    }
+
+    std::vector<uint8_t> body;
+};
+
+TEST_F(GetMultiValidatorTest, CorrectMessage) {
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_SUCCESS, validate());
+}
+
+TEST_F(GetMultiValidatorTest, InvalidMagic) {
+    request.message.header.request.magic = 0;
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+}
+
+TEST_F(GetMultiValidatorTest, InvalidExtlen) {
+    request.message.header.request.extlen = 2;
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+}
+
+TEST_F(GetMultiValidatorTest, InvalidKey) {
+    request.message.header.request.keylen = htons(2);
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+}
+
+TEST_F(GetMultiValidatorTest, InvalidDatatype) {
+    request.message.header.request.datatype = PROTOCOL_BINARY_DATATYPE_JSON;
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+}
+
+TEST_F(GetMultiValidatorTest, InvalidCas) {
+    request.message.header.request.cas = 1;
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+}
+
+TEST_F(GetMultiValidatorTest, NoKeys) {
+    body.clear();
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+}
+
+TEST_F(GetMultiValidatorTest, EmptyKey) {
+    addKey(0, "");
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+}
+
+TEST_F(GetMultiValidatorTest, KeyTooLong) {
+    // Keys are at most 250 bytes (KEY_MAX_LENGTH)
+    addKey(0, std::string(250, 'k'));
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_SUCCESS, validate());
+    addKey(0, std::string(251, 'k'));
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+}
+
+TEST_F(GetMultiValidatorTest, TruncatedKey) {
+    body.pop_back();
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+}
+
+TEST_F(GetMultiValidatorTest, TrailingBytes) {
+    body.push_back(0);
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_EINVAL, validate());
+}
+
 // PROTOCOL_BINARY_CMD_UNLOCK
 class UnlockValidatorTest : public ValidatorTest {
     void SetUp() override {
@@ -0,0 +1,149 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include <daemon/pipe_pool.h>
+#include <gtest/gtest.h>
+#include <platform/make_unique.h>
+
+#include <cstring>
+
+class PipePoolTest : public ::testing::Test {
+protected:
+    static std::unique_ptr<cb::Pipe> makePipe(size_t size = 2048) {
+        return std::make_unique<cb::Pipe>(size);
+    }
+
+    /// Put some data into the pipe (as a connection reading a packet would)
+    static void fill(cb::Pipe& pipe, size_t size) {
+        pipe.ensureCapacity(size);
+        pipe.produce([size](cb::byte_buffer buffer) -> ssize_t {
+            std::memset(buffer.data(), 'a', size);
+            return ssize_t(size);
+        });
+    }
+
+    PipePool pool;
+};
+
+TEST_F(PipePoolTest, TakeFromEmptyPool) {
+    EXPECT_EQ(0, pool.size());
+    EXPECT_EQ(0, pool.bytes());
+    EXPECT_FALSE(pool.take());
+}
+
+TEST_F(PipePoolTest, GiveAndTake) {
+    auto pipe = makePipe();
+    auto* raw = pipe.get();
+    const auto capacity = pipe->capacity();
+
+    EXPECT_TRUE(pool.give(pipe));
+    EXPECT_FALSE(pipe) << "give() should take ownership of the buffer";
+    EXPECT_EQ(1, pool.size());
+    EXPECT_EQ(capacity, pool.bytes());
+
+    auto taken = pool.take();
+    EXPECT_EQ(raw, taken.get());
+    EXPECT_EQ(0, pool.size());
+    EXPECT_EQ(0, pool.bytes());
+    EXPECT_FALSE(pool.take());
+}
+
+TEST_F(PipePoolTest, GiveNothing) {
+    std::unique_ptr<cb::Pipe> pipe;
+    EXPECT_FALSE(pool.give(pipe));
+    EXPECT_EQ(0, pool.size());
+}
+
+/// The most recently returned buffer is handed out first
+TEST_F(PipePoolTest, TakeIsLifo) {
+    auto first = makePipe();
+    auto second = makePipe();
+    auto* rawFirst = first.get();
+    auto* rawSecond = second.get();
+
+    pool.give(first);
+    pool.give(second);
+    EXPECT_EQ(rawSecond, pool.take().get());
+    EXPECT_EQ(rawFirst, pool.take().get());
+}
+
+TEST_F(PipePoolTest, PoolIsBounded) {
+    for (size_t ii = 0; ii < PipePool::MaxBuffers; ++ii) {
+        auto pipe = makePipe();
+        EXPECT_TRUE(pool.give(pipe));
+    }
+    EXPECT_EQ(PipePool::MaxBuffers, pool.size());
+
+    auto pipe = makePipe();
+    EXPECT_FALSE(pool.give(pipe));
+    EXPECT_FALSE(pipe) << "A buffer which isn't pooled should be released";
+    EXPECT_EQ(PipePool::MaxBuffers, pool.size());
+}
+
+TEST_F(PipePoolTest, LargeBufferIsReleased) {
+    auto pipe = makePipe(PipePool::MaxBufferSize * 2);
+    ASSERT_GT(pipe->capacity(), PipePool::MaxBufferSize);
+    EXPECT_FALSE(pool.give(pipe));
+    EXPECT_FALSE(pipe);
+    EXPECT_EQ(0, pool.size());
+    EXPECT_EQ(0, pool.bytes());
+}
+
+TEST_F(PipePoolTest, Clear) {
+    auto first = makePipe();
+    auto second = makePipe();
+    pool.give(first);
+    pool.give(second);
+    pool.clear();
+    EXPECT_EQ(0, pool.size());
+    EXPECT_EQ(0, pool.bytes());
+    EXPECT_FALSE(pool.take());
+}
+
+/**
+ * When a connection closes its buffers are cleared and handed back to its
+ * thread's pool (see conn_cleanup()); the next connection served by the
+ * thread must get one of them back, with none of the old connection's
+ * data left in it.
+ */
+TEST_F(PipePoolTest, ReuseAfterConnectionCloses) {
+    // The first connection reads a packet into a pooled buffer
+    auto pipe = makePipe();
+    auto* raw = pipe.get();
+    EXPECT_TRUE(pool.give(pipe));
+    auto read = pool.take();
+    fill(*read, 100);
+    EXPECT_FALSE(read->empty());
+
+    // ... and closes before it is consumed
+    read->clear();
+    EXPECT_TRUE(pool.give(read));
+
+    // The next connection gets the same (empty) buffer
+    auto next = pool.take();
+    ASSERT_EQ(raw, next.get());
+    EXPECT_TRUE(next->empty());
+    EXPECT_EQ(0, next->rsize());
+}
+
+/// A buffer handed back with data still in it is cleared by the pool
+TEST_F(PipePoolTest, GiveClearsBuffer) {
+    auto pipe = makePipe();
+    fill(*pipe, 100);
+    EXPECT_TRUE(pool.give(pipe));
+    auto taken = pool.take();
+    EXPECT_TRUE(taken->empty());
+}
@@ -104,3 +104,87 @@ TEST_P(DcpTest, MB24145_RollbackShouldContainSeqno) {
     EXPECT_EQ(0, *value);
 
 }
+
+/**
+ * The producer sends the messages in batches; make sure that all of the
+ * messages make it to the client when there is more than a single batch
+ * of them.
+ */
+TEST_P(DcpTest, BatchedMutations) {
+    auto& conn = getConnection();
+
+    const int numMutations = 100;
+    conn.sendCommand(BinprotDcpOpenCommand{
+            "ewb_internal:" + std::to_string(numMutations),
+            0,
+            DCP_OPEN_PRODUCER});
+
+    BinprotResponse rsp;
+    conn.recvResponse(rsp);
+    ASSERT_TRUE(rsp.isSuccess());
+
+    Frame frame;
+    for (int ii = 0; ii < numMutations; ++ii) {
+        conn.recvFrame(frame);
+        ASSERT_EQ(cb::mcbp::Magic::ClientRequest, frame.getMagic());
+        EXPECT_EQ(cb::mcbp::ClientOpcode::DcpMutation,
+                  frame.getRequest()->getClientOpcode());
+    }
+}
+
+/**
+ * The producer must close the connection if the engine can't fit a message
+ * into an empty write buffer (rather than keep stepping the engine), but
+ * only after it has sent the messages batched before it.
+ */
+TEST_P(DcpTest, MessageTooBigClosesConnection) {
+    auto& conn = getConnection();
+
+    const int numMutations = 10;
+    conn.sendCommand(BinprotDcpOpenCommand{
+            "ewb_internal:" + std::to_string(numMutations) + ":" +
+                    std::to_string(int(ENGINE_E2BIG)),
+            0,
+            DCP_OPEN_PRODUCER});
+
+    BinprotResponse rsp;
+    conn.recvResponse(rsp);
+    ASSERT_TRUE(rsp.isSuccess());
+
+    Frame frame;
+    for (int ii = 0; ii < numMutations; ++ii) {
+        conn.recvFrame(frame);
+        ASSERT_EQ(cb::mcbp::Magic::ClientRequest, frame.getMagic());
+        EXPECT_EQ(cb::mcbp::ClientOpcode::DcpMutation,
+                  frame.getRequest()->getClientOpcode());
+    }
+    EXPECT_THROW(conn.recvFrame(frame), std::runtime_error);
+}
+
+/**
+ * An engine error ends the batch; the producer should send the messages
+ * batched before it and then close the connection.
+ */
+TEST_P(DcpTest, ErrorClosesConnectionAfterBatch) {
+    auto& conn = getConnection();
+
+    const int numMutations = 10;
+    conn.sendCommand(BinprotDcpOpenCommand{
+            "ewb_internal:" + std::to_string(numMutations) + ":" +
+                    std::to_string(int(ENGINE_EINVAL)),
+            0,
+            DCP_OPEN_PRODUCER});
+
+    BinprotResponse rsp;
+    conn.recvResponse(rsp);
+    ASSERT_TRUE(rsp.isSuccess());
+
+    Frame frame;
+    for (int ii = 0; ii < numMutations; ++ii) {
+        conn.recvFrame(frame);
+        ASSERT_EQ(cb::mcbp::Magic::ClientRequest, frame.getMagic());
+        EXPECT_EQ(cb::mcbp::ClientOpcode::DcpMutation,
+                  frame.getRequest()->getClientOpcode());
+    }
+    EXPECT_THROW(conn.recvFrame(frame), std::runtime_error);
+}
@@ -100,6 +100,7 @@ public:
             case PROTOCOL_BINARY_CMD_DELQ_WITH_META:
             case PROTOCOL_BINARY_CMD_ENABLE_TRAFFIC:
             case PROTOCOL_BINARY_CMD_DISABLE_TRAFFIC:
+            case PROTOCOL_BINARY_CMD_EVICT_KEY:
                 return false;
             default:
                 return true;
@@ -19,6 +19,7 @@
 #include "testapp_client_test.h"
 
 #include <algorithm>
+#include <map>
 #include <platform/compress.h>
 
 class GetSetTest : public TestappXattrClientTest {
@@ -214,6 +215,73 @@ TEST_P(GetSetTest, TestGetSuccess) {
     EXPECT_EQ(document.value, stored.value);
 }
 
+/**
+ * A GET_MULTI of keys which have all been evicted has to fetch every one
+ * of them from disk before it can respond (in one batch, with a single
+ * notification of the connection), and must then return all of them.
+ */
+TEST_P(GetSetTest, TestGetMultiNonResident) {
+    if (!GetTestBucket().supportsOp(PROTOCOL_BINARY_CMD_EVICT_KEY)) {
+        return;
+    }
+
+    MemcachedConnection& conn = getConnection();
+    std::map<std::string, std::string> expected;
+    std::string body;
+    for (int ii = 0; ii < 10; ++ii) {
+        Document doc = document;
+        doc.info.id = name + "_" + std::to_string(ii);
+        doc.info.datatype = cb::mcbp::Datatype::Raw;
+        const std::string value = "value_" + std::to_string(ii);
+        doc.value.assign(value.begin(), value.end());
+        conn.mutate(doc, 0, MutationType::Set);
+        expected[doc.info.id] = value;
+
+        const uint16_t vbucket = htons(0);
+        const uint16_t keylen = htons(uint16_t(doc.info.id.size()));
+        body.append(reinterpret_cast<const char*>(&vbucket), sizeof(vbucket));
+        body.append(reinterpret_cast<const char*>(&keylen), sizeof(keylen));
+        body.append(doc.info.id);
+    }
+
+    // Evict all of the keys; they can't be ejected until they've been
+    // persisted.
+    for (const auto& kv : expected) {
+        BinprotResponse resp;
+        while (true) {
+            resp.clear();
+            conn.executeCommand(
+                    BinprotGenericCommand(PROTOCOL_BINARY_CMD_EVICT_KEY,
+                                          kv.first),
+                    resp);
+            if (resp.getStatus() != PROTOCOL_BINARY_RESPONSE_KEY_EEXISTS) {
+                break;
+            }
+            usleep(100);
+        }
+        ASSERT_TRUE(resp.isSuccess()) << "Failed to evict " << kv.first;
+    }
+
+    BinprotGenericCommand cmd(PROTOCOL_BINARY_CMD_GET_MULTI);
+    cmd.setValue(body);
+    conn.sendCommand(cmd);
+
+    // One GetK style response per key, terminated by an empty success
+    std::map<std::string, std::string> found;
+    while (true) {
+        BinprotResponse resp;
+        conn.recvResponse(resp);
+        ASSERT_EQ(PROTOCOL_BINARY_CMD_GET_MULTI, resp.getOp());
+        ASSERT_TRUE(resp.isSuccess());
+        if (resp.getBodylen() == 0) {
+            break;
+        }
+        EXPECT_EQ(4, resp.getExtlen());
+        found[resp.getKeyString()] = resp.getDataString();
+    }
+    EXPECT_EQ(expected, found);
+}
+
 TEST_P(GetSetTest, TestAppend) {
     MemcachedConnection& conn = getConnection();
     document.info.datatype = cb::mcbp::Datatype::Raw;
@@ -477,6 +545,32 @@ TEST_P(GetSetTest, TestIllegalVbucket) {
     conn.reconnect();
 }
 
+TEST_P(GetSetTest, TestGetZeroCopyStats) {
+    MemcachedConnection& conn = getConnection();
+    conn.mutate(document, 0, MutationType::Set);
+
+    auto readStat = [&conn](const std::string& name) {
+        auto stats = conn.statsMap("");
+        const auto iter = stats.find(name);
+        if (iter == stats.cend()) {
+            throw std::logic_error("TestGetZeroCopyStats: No entry for: " +
+                                   name);
+        }
+        return std::stoull(iter->second);
+    };
+
+    const auto zeroCopyBefore = readStat("bytes_get_zero_copy");
+    const auto copiedBefore = readStat("bytes_get_copied");
+
+    const auto stored = conn.get(name, 0);
+    EXPECT_EQ(document.value, stored.value);
+
+    // An uncompressed document is sent straight from the item.
+    EXPECT_EQ(zeroCopyBefore + document.value.size(),
+              readStat("bytes_get_zero_copy"));
+    EXPECT_EQ(copiedBefore, readStat("bytes_get_copied"));
+}
+
 static void compress_vector(const std::vector<char>& input,
                             std::vector<uint8_t>& output) {
     cb::compression::Buffer compressed;
@@ -152,6 +152,7 @@ static bool validate_engine_interface(const ENGINE_HANDLE_V1* v1,
     check(remove);
     check(release);
     check(get);
+    check(get_multi);
     check(get_if);
     check(get_locked);
     check(get_meta);
@@ -167,7 +167,8 @@ static const std::map<uint8_t, std::string> commandmap {
     {PROTOCOL_BINARY_CMD_EWOULDBLOCK_CTL,"EWB_CTL"},
     {PROTOCOL_BINARY_CMD_GET_ERROR_MAP, "GET_ERROR_MAP"},
     {PROTOCOL_BINARY_CMD_DROP_PRIVILEGE, "DROP_PRIVILEGES"},
-    {PROTOCOL_BINARY_CMD_COLLECTIONS_SET_MANIFEST, "COLLECTIONS_SET_MANIFEST"}
+    {PROTOCOL_BINARY_CMD_COLLECTIONS_SET_MANIFEST, "COLLECTIONS_SET_MANIFEST"},
+    {PROTOCOL_BINARY_CMD_GET_MULTI, "GET_MULTI"}
 };
 
 const char *memcached_opcode_2_text(uint8_t opcode) {